@@ -0,0 +1,582 @@
+//
+// Vortexje -- Benchmarks of the panel kernels and of the solver.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <cmath>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <benchmark/benchmark.h>
+
+#include <vortexje/solver.hpp>
+#include <vortexje/surface-builder.hpp>
+#include <vortexje/lifting-surface-builder.hpp>
+#include <vortexje/shape-generators/ellipse-generator.hpp>
+#include <vortexje/shape-generators/airfoils/naca4-airfoil-generator.hpp>
+#include <vortexje/empirical-wakes/ramasamy-leishman-wake.hpp>
+#include <vortexje/surface-writers/gmsh-surface-writer.hpp>
+#include <vortexje/surface-writers/vtk-surface-writer.hpp>
+#include <vortexje/surface-writers/vtk-xml-surface-writer.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+static const double pi = 3.141592653589793238462643383279502884;
+
+// Maximum refinement level of the benchmark geometries:
+#define MAX_REFINEMENT 3
+
+// Number of wake rows kept during the time stepping benchmarks, so that every step does the same amount of work:
+#define N_WAKE_ROWS 16
+
+// Time step size:
+#define DT 0.01
+
+// Sets the number of OpenMP threads:
+static void
+set_threads(int n_threads)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(n_threads);
+#endif
+}
+
+// Benchmark arguments:  every refinement level, with 1, 2, 4, ... threads, up to the number of available threads.
+static void
+refinement_and_threads(benchmark::internal::Benchmark *b)
+{
+    int max_threads = 1;
+#ifdef _OPENMP
+    max_threads = omp_get_max_threads();
+#endif
+
+    for (int refinement = 1; refinement <= MAX_REFINEMENT; refinement++) {
+        for (int n_threads = 1; n_threads < max_threads; n_threads *= 2)
+            b->Args({refinement, n_threads});
+        b->Args({refinement, max_threads});
+    }
+
+    b->ArgNames({"refinement", "threads"});
+}
+
+// Creates a unit sphere with 10 * refinement rings of 20 * refinement panels, closed by triangle fans at the poles:
+static shared_ptr<Surface>
+make_sphere(int refinement)
+{
+    shared_ptr<Surface> sphere(new Surface());
+
+    SurfaceBuilder surface_builder(*sphere);
+
+    int n_rings  = 10 * refinement;
+    int n_points = 20 * refinement;
+
+    vector<int> first_nodes, prev_nodes;
+
+    for (int i = 0; i < n_rings; i++) {
+        double theta = pi * (i + 1) / (double) (n_rings + 1);
+
+        vector<Vector3d, Eigen::aligned_allocator<Vector3d> > points = EllipseGenerator::generate(sin(theta), sin(theta), n_points);
+        for (int j = 0; j < (int) points.size(); j++)
+            points[j](2) = cos(theta);
+
+        vector<int> nodes = surface_builder.create_nodes_for_points(points);
+
+        if (i == 0)
+            first_nodes = nodes;
+        else
+            surface_builder.create_panels_between_shapes(prev_nodes, nodes);
+
+        prev_nodes = nodes;
+    }
+
+    surface_builder.create_panels_inside_shape(first_nodes, Vector3d(0, 0, 1), 1);
+    surface_builder.create_panels_inside_shape(prev_nodes, Vector3d(0, 0, -1), -1);
+
+    surface_builder.finish();
+
+    return sphere;
+}
+
+// Creates a NACA 0012 wing of 10 * refinement spanwise strips, with 16 * refinement points per airfoil:
+static shared_ptr<LiftingSurface>
+make_wing(int refinement, double chord, double span)
+{
+    shared_ptr<LiftingSurface> wing(new LiftingSurface());
+
+    LiftingSurfaceBuilder surface_builder(*wing);
+
+    int n_points_per_airfoil = 16 * refinement;
+    int n_airfoils           = 10 * refinement + 1;
+
+    int trailing_edge_point_id;
+    vector<int> prev_airfoil_nodes;
+
+    vector<vector<int> > node_strips;
+    vector<vector<int> > panel_strips;
+
+    for (int i = 0; i < n_airfoils; i++) {
+        vector<Vector3d, Eigen::aligned_allocator<Vector3d> > airfoil_points =
+            NACA4AirfoilGenerator::generate(0, 0, 0.12, true, chord, n_points_per_airfoil, trailing_edge_point_id);
+        for (int j = 0; j < (int) airfoil_points.size(); j++)
+            airfoil_points[j](2) += i * span / (double) (n_airfoils - 1);
+
+        vector<int> airfoil_nodes = surface_builder.create_nodes_for_points(airfoil_points);
+        node_strips.push_back(airfoil_nodes);
+
+        if (i > 0) {
+            vector<int> airfoil_panels = surface_builder.create_panels_between_shapes(airfoil_nodes, prev_airfoil_nodes, trailing_edge_point_id);
+            panel_strips.push_back(airfoil_panels);
+        }
+
+        prev_airfoil_nodes = airfoil_nodes;
+    }
+
+    surface_builder.finish(node_strips, panel_strips, trailing_edge_point_id);
+
+    return wing;
+}
+
+// Creates a body consisting of a wing at an angle of attack of 5 degrees:
+static shared_ptr<Body>
+make_wing_body(int refinement)
+{
+    shared_ptr<LiftingSurface> wing = make_wing(refinement, 0.75, 4.5);
+    wing->rotate(Vector3d::UnitZ(), -5.0 / 180.0 * pi);
+
+    shared_ptr<Body> body(new Body(string("wing")));
+    body->add_lifting_surface(wing);
+
+    return body;
+}
+
+// Creates a two-bladed vertical axis wind turbine, with Ramasamy-Leishman wakes:
+static shared_ptr<Body>
+make_vawt(int refinement)
+{
+    const double chord        = 0.75;
+    const double span         = 4.5;
+    const double rotor_radius = 2.5;
+    const int    n_blades     = 2;
+
+    shared_ptr<Body> body(new Body(string("vawt")));
+    body->rotational_velocity = Vector3d(0, 0, 12.0);
+
+    for (int i = 0; i < n_blades; i++) {
+        shared_ptr<LiftingSurface> blade = make_wing(refinement, chord, span);
+
+        blade->translate(Vector3d(-chord / 3.0, 0.0, -span / 2.0));
+        blade->rotate(Vector3d::UnitZ(), -pi / 2.0);
+        blade->translate(Vector3d(rotor_radius, 0, 0));
+        blade->rotate(Vector3d::UnitZ(), 2 * pi / n_blades * i);
+
+        shared_ptr<RamasamyLeishmanWake> wake(new RamasamyLeishmanWake(blade));
+        body->add_lifting_surface(blade, wake);
+    }
+
+    return body;
+}
+
+// Creates a solver for a single body:
+static shared_ptr<Solver>
+make_solver(const shared_ptr<Body> &body, bool convect_wake)
+{
+    shared_ptr<Solver> solver(new Solver("vortexje-bench-log"));
+
+    solver->parameters.convect_wake  = convect_wake;
+    solver->parameters.max_wake_rows = N_WAKE_ROWS;
+
+    solver->add_body(body);
+
+    solver->set_freestream_velocity(Vector3d(30, 0, 0));
+    solver->set_fluid_density(1.2);
+
+    return solver;
+}
+
+// Runs time steps until the wakes have reached their maximum length:
+static void
+fill_wakes(Solver &solver)
+{
+    solver.initialize_wakes(DT);
+
+    for (int i = 0; i < N_WAKE_ROWS; i++) {
+        solver.solve(DT);
+        solver.update_wakes(DT);
+    }
+}
+
+// Number of panels of the lifting surfaces of a body:
+static int
+count_panels(const shared_ptr<Body> &body)
+{
+    int n_panels = 0;
+    for (int i = 0; i < (int) body->lifting_surfaces.size(); i++)
+        n_panels += body->lifting_surfaces[i]->surface->n_panels();
+
+    return n_panels;
+}
+
+// Collocation points of all panels of a surface:
+static Matrix3Xd
+collocation_points(const shared_ptr<Surface> &surface)
+{
+    Matrix3Xd points(3, surface->n_panels());
+    for (int i = 0; i < surface->n_panels(); i++)
+        points.col(i) = surface->panel_collocation_point(i, true);
+
+    return points;
+}
+
+// Influence coefficients of all panels of the sphere on all of its collocation points:
+static void
+BM_SourceAndDoubletInfluence(benchmark::State &state)
+{
+    set_threads(state.range(1));
+
+    shared_ptr<Surface> sphere = make_sphere(state.range(0));
+
+    Matrix3Xd points = collocation_points(sphere);
+
+    MatrixXd source_influence(sphere->n_panels(), sphere->n_panels());
+    MatrixXd doublet_influence(sphere->n_panels(), sphere->n_panels());
+
+    for (auto _ : state) {
+        int j;
+
+        #pragma omp parallel
+        {
+            #pragma omp for schedule(dynamic, 1)
+            for (j = 0; j < sphere->n_panels(); j++)
+                sphere->source_and_doublet_influence(points, j, source_influence.col(j), doublet_influence.col(j));
+        }
+
+        benchmark::DoNotOptimize(source_influence.data());
+        benchmark::DoNotOptimize(doublet_influence.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * sphere->n_panels() * sphere->n_panels());
+    state.counters["panels"] = sphere->n_panels();
+}
+BENCHMARK(BM_SourceAndDoubletInfluence)->Apply(refinement_and_threads)->Unit(benchmark::kMillisecond);
+
+// Velocity induced by all vortex rings of the wing on all of its collocation points:
+static void
+BM_VortexRingUnitVelocity(benchmark::State &state)
+{
+    set_threads(state.range(1));
+
+    shared_ptr<LiftingSurface> wing = make_wing(state.range(0), 0.75, 4.5);
+
+    Matrix3Xd points = collocation_points(wing);
+
+    Matrix3Xd velocities(3, points.cols());
+
+    for (auto _ : state) {
+        int i;
+
+        #pragma omp parallel
+        {
+            #pragma omp for schedule(dynamic, 1)
+            for (i = 0; i < (int) points.cols(); i++) {
+                Vector3d velocity(0, 0, 0);
+                for (int j = 0; j < wing->n_panels(); j++)
+                    velocity += wing->vortex_ring_unit_velocity(points.col(i), j);
+
+                velocities.col(i) = velocity;
+            }
+        }
+
+        benchmark::DoNotOptimize(velocities.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * points.cols() * wing->n_panels());
+    state.counters["panels"] = wing->n_panels();
+}
+BENCHMARK(BM_VortexRingUnitVelocity)->Apply(refinement_and_threads)->Unit(benchmark::kMillisecond);
+
+// Velocity induced by all panels of a Ramasamy-Leishman wake on the collocation points of its blade:
+static void
+BM_RamasamyLeishmanVelocity(benchmark::State &state)
+{
+    set_threads(state.range(1));
+
+    shared_ptr<Body> body = make_vawt(state.range(0));
+
+    shared_ptr<Solver> solver = make_solver(body, true);
+    fill_wakes(*solver);
+
+    const shared_ptr<Wake> &wake = body->lifting_surfaces[0]->wake;
+
+    Matrix3Xd points = collocation_points(body->lifting_surfaces[0]->surface);
+
+    Matrix3Xd velocities(3, points.cols());
+
+    for (auto _ : state) {
+        int i;
+
+        #pragma omp parallel
+        {
+            #pragma omp for schedule(dynamic, 1)
+            for (i = 0; i < (int) points.cols(); i++) {
+                Vector3d velocity(0, 0, 0);
+                for (int j = 0; j < wake->n_panels(); j++)
+                    velocity += wake->vortex_ring_unit_velocity(points.col(i), j);
+
+                velocities.col(i) = velocity;
+            }
+        }
+
+        benchmark::DoNotOptimize(velocities.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * points.cols() * wake->n_panels());
+    state.counters["wake_panels"] = wake->n_panels();
+}
+BENCHMARK(BM_RamasamyLeishmanVelocity)->Apply(refinement_and_threads)->Unit(benchmark::kMillisecond);
+
+// As above, using the batched kernel, which evaluates each vortex ring for all points at once:
+static void
+BM_RamasamyLeishmanBatchVelocity(benchmark::State &state)
+{
+    set_threads(state.range(1));
+
+    shared_ptr<Body> body = make_vawt(state.range(0));
+
+    shared_ptr<Solver> solver = make_solver(body, true);
+    fill_wakes(*solver);
+
+    const shared_ptr<Wake> &wake = body->lifting_surfaces[0]->wake;
+
+    Matrix3Xd points = collocation_points(body->lifting_surfaces[0]->surface);
+
+    Matrix3Xd velocities(3, points.cols());
+
+    for (auto _ : state) {
+        velocities.setZero();
+
+        int j;
+
+        #pragma omp parallel
+        {
+            Matrix3Xd panel_velocities(3, points.cols());
+            Matrix3Xd thread_velocities = Matrix3Xd::Zero(3, points.cols());
+
+            #pragma omp for schedule(dynamic, 1)
+            for (j = 0; j < wake->n_panels(); j++) {
+                wake->vortex_ring_unit_velocity(points, j, panel_velocities);
+
+                thread_velocities += panel_velocities;
+            }
+
+            #pragma omp critical
+            velocities += thread_velocities;
+        }
+
+        benchmark::DoNotOptimize(velocities.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * points.cols() * wake->n_panels());
+    state.counters["wake_panels"] = wake->n_panels();
+}
+BENCHMARK(BM_RamasamyLeishmanBatchVelocity)->Apply(refinement_and_threads)->Unit(benchmark::kMillisecond);
+
+// Assembly of the matrices of influence coefficients of the sphere.  The geometry is recomputed before every
+// iteration, so that the matrices are never reused.  Only the assembly phase of Solver::solve() is timed:
+static void
+BM_Assembly(benchmark::State &state)
+{
+    set_threads(state.range(1));
+
+    shared_ptr<Surface> sphere = make_sphere(state.range(0));
+
+    shared_ptr<Body> body(new Body(string("sphere")));
+    body->add_non_lifting_surface(sphere);
+
+    shared_ptr<Solver> solver = make_solver(body, false);
+
+    for (auto _ : state) {
+        sphere->compute_geometry();
+
+        double assembly_time = solver->profiler->total_wall_time("assembly");
+
+        solver->solve();
+
+        state.SetIterationTime(solver->profiler->total_wall_time("assembly") - assembly_time);
+    }
+
+    state.counters["panels"] = sphere->n_panels();
+}
+BENCHMARK(BM_Assembly)->Apply(refinement_and_threads)->UseManualTime()->Unit(benchmark::kMillisecond);
+
+// BiCGSTAB solution of the doublet distribution of the wing.  The freestream direction alternates between
+// iterations, so that the initial guess is never the solution.  Only the linear solve phase is timed:
+static void
+BM_LinearSolve(benchmark::State &state)
+{
+    set_threads(state.range(1));
+
+    shared_ptr<Body> body = make_wing_body(state.range(0));
+
+    shared_ptr<Solver> solver = make_solver(body, false);
+    solver->initialize_wakes();
+
+    int iteration = 0;
+
+    for (auto _ : state) {
+        double angle = (iteration++ % 2 == 0 ? 1.0 : -1.0) / 180.0 * pi;
+        solver->set_freestream_velocity(30 * Vector3d(cos(angle), sin(angle), 0));
+
+        double solve_time = solver->profiler->total_wall_time("linear_solve");
+
+        solver->solve();
+
+        state.SetIterationTime(solver->profiler->total_wall_time("linear_solve") - solve_time);
+    }
+
+    state.counters["panels"] = count_panels(body);
+    state.counters["iterations"] = benchmark::Counter(solver->profiler->total_counter("linear_solver_iterations"), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_LinearSolve)->Apply(refinement_and_threads)->UseManualTime()->Unit(benchmark::kMillisecond);
+
+// Convection of the wake of the wing, with a wake of constant length.  Only Solver::update_wakes() is timed:
+static void
+BM_UpdateWakes(benchmark::State &state)
+{
+    set_threads(state.range(1));
+
+    shared_ptr<Body> body = make_wing_body(state.range(0));
+
+    shared_ptr<Solver> solver = make_solver(body, true);
+    fill_wakes(*solver);
+
+    for (auto _ : state) {
+        solver->solve(DT);
+
+        double update_time = solver->profiler->total_wall_time("update_wakes");
+
+        solver->update_wakes(DT);
+
+        state.SetIterationTime(solver->profiler->total_wall_time("update_wakes") - update_time);
+    }
+
+    state.counters["wake_nodes"] = body->lifting_surfaces[0]->wake->n_nodes();
+}
+BENCHMARK(BM_UpdateWakes)->Apply(refinement_and_threads)->UseManualTime()->Unit(benchmark::kMillisecond);
+
+// Writes the sphere, with a single data vector:
+template <class Writer>
+static void
+BM_SurfaceWriter(benchmark::State &state)
+{
+    shared_ptr<Surface> sphere = make_sphere(state.range(0));
+
+    vector<string> view_names;
+    view_names.push_back("DataVector");
+
+    vector<MatrixXd, Eigen::aligned_allocator<MatrixXd> > view_data;
+    view_data.push_back(VectorXd::Random(sphere->n_panels()));
+
+    Writer writer;
+
+    string filename = string("vortexje-bench-surface") + writer.file_extension();
+
+    for (auto _ : state)
+        writer.write(sphere, filename, 0, 0, view_names, view_data);
+
+    state.SetItemsProcessed(state.iterations() * sphere->n_panels());
+    state.counters["panels"] = sphere->n_panels();
+}
+BENCHMARK_TEMPLATE(BM_SurfaceWriter, GmshSurfaceWriter)->DenseRange(1, MAX_REFINEMENT)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_SurfaceWriter, VTKSurfaceWriter)->DenseRange(1, MAX_REFINEMENT)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_SurfaceWriter, VTKXMLSurfaceWriter)->DenseRange(1, MAX_REFINEMENT)->Unit(benchmark::kMillisecond);
+
+// Steady solution of the flow around the sphere, including the assembly of the matrices:
+static void
+BM_SphereSolve(benchmark::State &state)
+{
+    set_threads(state.range(1));
+
+    shared_ptr<Surface> sphere = make_sphere(state.range(0));
+
+    shared_ptr<Body> body(new Body(string("sphere")));
+    body->add_non_lifting_surface(sphere);
+
+    shared_ptr<Solver> solver = make_solver(body, false);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        sphere->compute_geometry();
+        state.ResumeTiming();
+
+        solver->solve();
+    }
+
+    state.counters["panels"] = sphere->n_panels();
+}
+BENCHMARK(BM_SphereSolve)->Apply(refinement_and_threads)->Unit(benchmark::kMillisecond);
+
+// Time step of the wing with a convecting wake of constant length:
+static void
+BM_WingStep(benchmark::State &state)
+{
+    set_threads(state.range(1));
+
+    shared_ptr<Body> body = make_wing_body(state.range(0));
+
+    shared_ptr<Solver> solver = make_solver(body, true);
+    fill_wakes(*solver);
+
+    for (auto _ : state) {
+        solver->solve(DT);
+        solver->update_wakes(DT);
+    }
+
+    state.counters["panels"] = count_panels(body);
+}
+BENCHMARK(BM_WingStep)->Apply(refinement_and_threads)->Unit(benchmark::kMillisecond);
+
+// Time step of the rotating VAWT, with convecting Ramasamy-Leishman wakes of constant length:
+static void
+BM_VAWTStep(benchmark::State &state)
+{
+    set_threads(state.range(1));
+
+    shared_ptr<Body> body = make_vawt(state.range(0));
+
+    shared_ptr<Solver> solver = make_solver(body, true);
+    fill_wakes(*solver);
+
+    for (auto _ : state) {
+        solver->solve(DT);
+
+        Quaterniond attitude = AngleAxis<double>(body->rotational_velocity(2) * DT, Vector3d::UnitZ()) * body->attitude;
+        body->set_attitude(attitude);
+
+        solver->update_wakes(DT);
+    }
+
+    state.counters["panels"] = count_panels(body);
+}
+BENCHMARK(BM_VAWTStep)->Apply(refinement_and_threads)->Unit(benchmark::kMillisecond);
+
+int
+main(int argc, char **argv)
+{
+    // Silence the status messages of the library.  The benchmark results are reported independently of the logger:
+    Logger::default_logger()->level = Logger::Quiet;
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+
+    benchmark::RunSpecifiedBenchmarks();
+
+    return 0;
+}
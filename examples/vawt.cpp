@@ -11,6 +11,8 @@
 #include <fstream>
 
 #include <vortexje/solver.hpp>
+#include <vortexje/async-logger.hpp>
+#include <vortexje/monitor.hpp>
 #include <vortexje/lifting-surface-builder.hpp>
 #include <vortexje/shape-generators/airfoils/naca4-airfoil-generator.hpp>
 #include <vortexje/shape-generators/ellipse-generator.hpp>
@@ -199,9 +201,20 @@ main (int argc, char **argv)
     // Set up file format for logging:
     VTKSurfaceWriter surface_writer;
     
-    // Log shaft moments:
-    ofstream f;
-    f.open("vawt-log/shaft_moment.txt");
+    // Write log files in the background:
+    AsyncLogger logger(solver, surface_writer);
+    
+    // Record the shaft moment, and the velocity on a rake downstream of the rotor, after every solve:
+    shared_ptr<Monitor> monitor(new Monitor(solver, "vawt-log/monitors.bin"));
+    
+    monitor->add_moment_monitor("shaft_moment", vawt, position);
+    
+    Matrix3Xd rake(3, 21);
+    for (int i = 0; i < rake.cols(); i++)
+        rake.col(i) = position + Vector3d(2 * MILL_RADIUS, (i - 10) * 0.15 * MILL_RADIUS, 0);
+    monitor->add_velocity_probes("wake_rake", rake);
+    
+    solver.add_monitor(monitor);
     
     // Run simulation:
     double t = 0.0;
@@ -214,12 +227,8 @@ main (int argc, char **argv)
         solver.solve(dt);
         
         // Log coefficients:
-        solver.log(step_number, surface_writer);
+        logger.log(step_number);
         
-        // Log shaft moment:
-        Vector3d M = solver.moment(vawt, position);
-        f << M(2) << endl;
-
         // Rotate blades:
         vawt->rotate(dt);
         
@@ -231,8 +240,11 @@ main (int argc, char **argv)
         step_number++;
     }
     
-    // Close shaft log file:
-    f.close();
+    // Write the remaining monitor records:
+    monitor->flush();
+    
+    // Wait for the remaining log files:
+    logger.flush();
     
     // Done:
     return 0;
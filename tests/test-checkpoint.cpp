@@ -0,0 +1,273 @@
+//
+// Vortexje -- Rectangular wing with NACA0012 airfoil.  Checks that a simulation interrupted by a checkpoint continues
+// as if uninterrupted, and that corrupt checkpoints are rejected.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <stdint.h>
+
+#include <vortexje/solver.hpp>
+#include <vortexje/lifting-surface-builder.hpp>
+#include <vortexje/shape-generators/airfoils/naca4-airfoil-generator.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+static const double pi = 3.141592653589793238462643383279502884;
+
+#define DELTA_T          1e-2
+#define N_STEPS          10
+#define CHECKPOINT_STEP  5
+
+#define FORCE_TEST_TOLERANCE 1e-10
+
+#define CHECKPOINT_FILENAME "test-checkpoint.vjc"
+
+// Create a rectangular wing:
+static shared_ptr<Body>
+create_wing()
+{
+    shared_ptr<LiftingSurface> wing(new LiftingSurface());
+
+    LiftingSurfaceBuilder surface_builder(*wing);
+
+    const double chord = 0.75;
+    const double span  = 4.5;
+
+    const int n_airfoils = 11;
+
+    const int n_points_per_airfoil = 24;
+
+    int trailing_edge_point_id;
+    vector<int> prev_airfoil_nodes;
+
+    vector<vector<int> > node_strips;
+    vector<vector<int> > panel_strips;
+
+    for (int i = 0; i < n_airfoils; i++) {
+        double z = -span / 2.0 + span * i / (double) (n_airfoils - 1);
+
+        vector<Vector3d, Eigen::aligned_allocator<Vector3d> > airfoil_points =
+            NACA4AirfoilGenerator::generate(0, 0, 0.12, true, chord, n_points_per_airfoil, trailing_edge_point_id);
+        for (int j = 0; j < (int) airfoil_points.size(); j++)
+            airfoil_points[j](2) += z;
+
+        vector<int> airfoil_nodes = surface_builder.create_nodes_for_points(airfoil_points);
+        node_strips.push_back(airfoil_nodes);
+
+        if (i > 0) {
+            vector<int> airfoil_panels = surface_builder.create_panels_between_shapes(airfoil_nodes, prev_airfoil_nodes, trailing_edge_point_id);
+            panel_strips.push_back(airfoil_panels);
+        }
+
+        prev_airfoil_nodes = airfoil_nodes;
+    }
+
+    surface_builder.finish(node_strips, panel_strips, trailing_edge_point_id);
+
+    // Rotate the span onto the y-axis, so that the wing lifts in the z-direction:
+    wing->rotate(Vector3d::UnitX(), -pi / 2.0);
+
+    // Create body:
+    shared_ptr<Body> body(new Body(string("wing")));
+    body->add_lifting_surface(wing);
+
+    return body;
+}
+
+// Set up a solver for the given wing:
+static shared_ptr<Solver>
+create_solver(const shared_ptr<Body> &body)
+{
+    shared_ptr<Solver> solver(new Solver("test-checkpoint-log"));
+    solver->add_body(body);
+
+    Vector3d freestream_velocity(30, 0, 3);
+    solver->set_freestream_velocity(freestream_velocity);
+
+    double fluid_density = 1.2;
+    solver->set_fluid_density(fluid_density);
+
+    solver->initialize_wakes(DELTA_T);
+
+    return solver;
+}
+
+// Run the given steps of an unsteady simulation:
+static void
+run_steps(Solver &solver, int first_step, int last_step)
+{
+    for (int step_number = first_step; step_number < last_step; step_number++) {
+        solver.solve(DELTA_T);
+
+        solver.update_wakes(DELTA_T);
+    }
+}
+
+// Read a file into a string:
+static string
+read_file(const string &filename)
+{
+    ifstream f(filename.c_str(), ios::in | ios::binary);
+
+    stringstream data;
+    data << f.rdbuf();
+
+    return data.str();
+}
+
+// Write a string into a file:
+static void
+write_file(const string &filename, const string &data)
+{
+    ofstream f(filename.c_str(), ios::out | ios::binary);
+
+    f.write(data.data(), data.size());
+}
+
+// Check that a simulation restarted from a checkpoint matches the uninterrupted simulation:
+static bool
+test_restart()
+{
+    // Uninterrupted simulation:
+    shared_ptr<Body> body = create_wing();
+    shared_ptr<Solver> solver = create_solver(body);
+
+    run_steps(*solver, 0, N_STEPS);
+
+    Vector3d F_ref = solver->force(body);
+
+    // Interrupted simulation:
+    body = create_wing();
+    solver = create_solver(body);
+
+    run_steps(*solver, 0, CHECKPOINT_STEP);
+
+    if (!solver->save_checkpoint(CHECKPOINT_FILENAME)) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " Saving the checkpoint failed." << endl;
+        cerr << " ******************* " << endl;
+
+        return false;
+    }
+
+    // Continue in a fresh solver:
+    body = create_wing();
+    solver = create_solver(body);
+
+    if (!solver->load_checkpoint(CHECKPOINT_FILENAME)) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " Loading the checkpoint failed." << endl;
+        cerr << " ******************* " << endl;
+
+        return false;
+    }
+
+    run_steps(*solver, CHECKPOINT_STEP, N_STEPS);
+
+    Vector3d F = solver->force(body);
+
+    cout << "Restart: F(ref) = " << F_ref.transpose() << " N, F = " << F.transpose() << " N" << endl;
+
+    if ((F - F_ref).norm() / F_ref.norm() > FORCE_TEST_TOLERANCE) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " F(ref) = " << F_ref.transpose() << endl;
+        cerr << " F = " << F.transpose() << endl;
+        cerr << " ******************* " << endl;
+
+        return false;
+    }
+
+    // Done.
+    return true;
+}
+
+// Check that corrupt and truncated checkpoints are rejected without changing the solver, and without aborting:
+static bool
+test_corruption()
+{
+    shared_ptr<Body> body = create_wing();
+    shared_ptr<Solver> solver = create_solver(body);
+
+    string data = read_file(CHECKPOINT_FILENAME);
+
+    if (!solver->load_checkpoint(CHECKPOINT_FILENAME))
+        return false;
+
+    const Vector3d x(0.3, 0.5, 0.4);
+    Vector3d V = solver->velocity(x);
+
+    // Write an absurd element count into every record in turn.  Corrupting a scalar record may result in a valid
+    // checkpoint, after which the original state is restored:
+    const string corrupt_filename = string(CHECKPOINT_FILENAME) + ".corrupt";
+
+    int n_rejected = 0;
+    for (int offset = 0; offset + (int) sizeof(int64_t) <= (int) data.size(); offset += sizeof(int64_t)) {
+        string corrupt_data = data;
+
+        int64_t count = ((int64_t) 1) << 40;
+        corrupt_data.replace(offset, sizeof(count), (const char *) &count, sizeof(count));
+
+        write_file(corrupt_filename, corrupt_data);
+
+        if (solver->load_checkpoint(corrupt_filename)) {
+            solver->load_checkpoint(CHECKPOINT_FILENAME);
+
+            continue;
+        }
+
+        if ((solver->velocity(x) - V).norm() > 0) {
+            cerr << " *** TEST FAILED *** " << endl;
+            cerr << " Rejected checkpoint corrupted at offset " << offset << " changed the solver." << endl;
+            cerr << " ******************* " << endl;
+
+            return false;
+        }
+
+        n_rejected++;
+    }
+
+    // Truncated file:
+    write_file(corrupt_filename, data.substr(0, data.size() / 2));
+
+    if (solver->load_checkpoint(corrupt_filename) || (solver->velocity(x) - V).norm() > 0) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " Truncated checkpoint was not rejected." << endl;
+        cerr << " ******************* " << endl;
+
+        return false;
+    }
+
+    cout << "Corruption: Rejected " << n_rejected << " corrupt checkpoints." << endl;
+
+    if (n_rejected == 0)
+        return false;
+
+    // Done.
+    return true;
+}
+
+int
+main (int argc, char **argv)
+{
+    // Set up parameters for unsteady simulation:
+    Parameters::unsteady_bernoulli = true;
+    Parameters::convect_wake       = true;
+
+    if (!test_restart())
+        exit(1);
+
+    if (!test_corruption())
+        exit(1);
+
+    return 0;
+}
@@ -0,0 +1,185 @@
+//
+// Vortexje -- Rotor with NACA0012 blades.  Checks the cyclic symmetry against the full rotor.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <cmath>
+#include <iostream>
+
+#include <vortexje/solver.hpp>
+#include <vortexje/lifting-surface-builder.hpp>
+#include <vortexje/shape-generators/airfoils/naca4-airfoil-generator.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+static const double pi = 3.141592653589793238462643383279502884;
+
+#define DELTA_T     1e-2
+#define N_STEPS     8
+
+#define FORCE_TEST_TOLERANCE    1e-8
+#define VELOCITY_TEST_TOLERANCE 1e-8
+
+// Create a rotor blade, with its airfoils stacked along the x-axis from the root radius to the tip radius:
+static shared_ptr<LiftingSurface>
+create_blade(double root_radius, double tip_radius, double pitch, int n_airfoils)
+{
+    shared_ptr<LiftingSurface> blade(new LiftingSurface());
+
+    LiftingSurfaceBuilder surface_builder(*blade);
+
+    const double chord = 0.3;
+
+    const int n_points_per_airfoil = 24;
+
+    int trailing_edge_point_id;
+    vector<int> prev_airfoil_nodes;
+
+    vector<vector<int> > node_strips;
+    vector<vector<int> > panel_strips;
+
+    for (int i = 0; i < n_airfoils; i++) {
+        double z = root_radius + (tip_radius - root_radius) * i / (double) (n_airfoils - 1);
+
+        vector<Vector3d, Eigen::aligned_allocator<Vector3d> > airfoil_points =
+            NACA4AirfoilGenerator::generate(0, 0, 0.12, true, chord, n_points_per_airfoil, trailing_edge_point_id);
+        for (int j = 0; j < (int) airfoil_points.size(); j++)
+            airfoil_points[j](2) += z;
+
+        vector<int> airfoil_nodes = surface_builder.create_nodes_for_points(airfoil_points);
+        node_strips.push_back(airfoil_nodes);
+
+        if (i > 0) {
+            vector<int> airfoil_panels = surface_builder.create_panels_between_shapes(airfoil_nodes, prev_airfoil_nodes, trailing_edge_point_id);
+            panel_strips.push_back(airfoil_panels);
+        }
+
+        prev_airfoil_nodes = airfoil_nodes;
+    }
+
+    surface_builder.finish(node_strips, panel_strips, trailing_edge_point_id);
+
+    // Rotate the span onto the x-axis, and the chord onto the negative y-axis, so that the leading edge moves ahead
+    // when the rotor rotates about the positive z-axis.  Then pitch the blade:
+    blade->rotate(Vector3d::UnitY(), pi / 2.0);
+    blade->rotate(Vector3d::UnitX(), -pi / 2.0 + pitch);
+
+    return blade;
+}
+
+// Run an unsteady simulation of a rotor, and return the thrust and torque of the full rotor, and the velocity at a
+// point in the flow:
+static void
+run_simulation(int n_blades, int n_sectors, double &thrust, double &torque, Vector3d &V)
+{
+    const double root_radius = 0.5;
+    const double tip_radius  = 2.5;
+    const double pitch       = 10.0 / 180.0 * pi;
+
+    // Set up the cyclic symmetry:
+    Parameters::cyclic_symmetry_sectors = n_sectors;
+
+    // Create the blades of one sector, or of the full rotor:
+    shared_ptr<Body> body(new Body(string("rotor")));
+
+    int n_meshed_blades = n_blades / n_sectors;
+    for (int i = 0; i < n_meshed_blades; i++) {
+        shared_ptr<LiftingSurface> blade = create_blade(root_radius, tip_radius, pitch, 11);
+        blade->rotate(Vector3d::UnitZ(), 2 * pi / n_blades * i);
+
+        body->add_lifting_surface(blade);
+    }
+
+    body->set_rotational_velocity(Vector3d(0, 0, 20.0));
+
+    // Set up solver:
+    Solver solver("test-cyclic-symmetry-log");
+    solver.add_body(body);
+
+    Vector3d freestream_velocity(0, 0, -5);
+    solver.set_freestream_velocity(freestream_velocity);
+
+    double fluid_density = 1.2;
+    solver.set_fluid_density(fluid_density);
+
+    // Run simulation:
+    double dt = DELTA_T;
+
+    solver.initialize_wakes(dt);
+
+    for (int step_number = 0; step_number < N_STEPS; step_number++) {
+        solver.solve(dt);
+
+        solver.update_wakes(dt);
+
+        Quaterniond attitude = AngleAxis<double>(body->rotational_velocity(2) * dt, Vector3d::UnitZ()) * body->attitude;
+        body->set_attitude(attitude);
+    }
+
+    // Compute thrust and torque.  Only the meshed sector is integrated over when the cyclic symmetry is in use:
+    thrust = n_sectors * solver.force(body)(2);
+    torque = n_sectors * solver.moment(body, Vector3d(0, 0, 0))(2);
+
+    // Evaluate the velocity field off the axis, where the rotated images contribute:
+    V = solver.velocity(Vector3d(0.3, 0.5, 0.4));
+
+    Parameters::cyclic_symmetry_sectors = 1;
+}
+
+// Run a test for a single number of sectors:
+static bool
+run_test(int n_blades, int n_sectors)
+{
+    double thrust_full, torque_full;
+    Vector3d V_full;
+    run_simulation(n_blades, 1, thrust_full, torque_full, V_full);
+
+    double thrust_sector, torque_sector;
+    Vector3d V_sector;
+    run_simulation(n_blades, n_sectors, thrust_sector, torque_sector, V_sector);
+
+    cout << n_blades << " blades, " << n_sectors << " sectors: T(full) = " << thrust_full << " N, T(sector) = " << thrust_sector << " N" << endl;
+
+    // Compare the thrust and torque, and the velocity field:
+    double thrust_error = fabs(thrust_sector - thrust_full) / fabs(thrust_full);
+    double torque_error = fabs(torque_sector - torque_full) / fabs(torque_full);
+    double V_error      = (V_sector - V_full).norm() / V_full.norm();
+
+    if (thrust_error > FORCE_TEST_TOLERANCE || torque_error > FORCE_TEST_TOLERANCE || V_error > VELOCITY_TEST_TOLERANCE) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " Blades = " << n_blades << ", sectors = " << n_sectors << endl;
+        cerr << " T(full) = " << thrust_full << ", Q(full) = " << torque_full << endl;
+        cerr << " T(sector) = " << thrust_sector << ", Q(sector) = " << torque_sector << endl;
+        cerr << " V(full) = " << V_full.transpose() << endl;
+        cerr << " V(sector) = " << V_sector.transpose() << endl;
+        cerr << " ******************* " << endl;
+
+        return false;
+    }
+
+    // Done.
+    return true;
+}
+
+int
+main (int argc, char **argv)
+{
+    // Set up parameters for unsteady simulation:
+    Parameters::unsteady_bernoulli = true;
+    Parameters::convect_wake       = true;
+
+    // A two-bladed rotor, with one blade per sector:
+    if (!run_test(2, 2))
+        exit(1);
+
+    // A three-bladed rotor, with one blade per sector:
+    if (!run_test(3, 3))
+        exit(1);
+
+    return 0;
+}
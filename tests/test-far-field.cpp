@@ -0,0 +1,224 @@
+//
+// Vortexje -- Single quadrangle and triangle panels.  Checks the far-field expansions of the panel kernels against
+// the exact kernels, and the exact source potential against numerical quadrature.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <cmath>
+#include <iostream>
+
+#include <vortexje/surface.hpp>
+#include <vortexje/parameters.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+static const double pi = 3.141592653589793238462643383279502884;
+
+#define FAR_FIELD_DISTANCE_FACTOR 10.0
+
+// The potentials are expanded up to the quadrupole term, the velocities only up to the dipole term:
+#define POTENTIAL_TEST_TOLERANCE  1e-3
+#define VELOCITY_TEST_TOLERANCE   5e-3
+#define QUADRATURE_TEST_TOLERANCE 1e-5
+
+#define N_QUADRATURE_POINTS 400
+
+// Create a tilted, irregular quadrangle and a tilted triangle, so that all second moments of area contribute:
+static shared_ptr<Surface>
+create_panels()
+{
+    shared_ptr<Surface> surface(new Surface());
+
+    Matrix3d rotation;
+    rotation = AngleAxis<double>(0.3, Vector3d::UnitX()) * AngleAxis<double>(-0.5, Vector3d::UnitY());
+
+    const Vector3d points[7] = { Vector3d(0.0, 0.0, 0.0), Vector3d(1.0, 0.1, 0.0), Vector3d(0.8, 0.9, 0.0), Vector3d(-0.1, 0.6, 0.0),
+                                 Vector3d(2.0, 0.0, 0.0), Vector3d(2.7, 0.2, 0.0), Vector3d(2.2, 0.5, 0.0) };
+
+    for (int i = 0; i < 7; i++) {
+        surface->nodes.push_back(rotation * points[i]);
+        surface->node_panel_neighbors.push_back(make_shared<vector<int> >());
+    }
+
+    surface->add_quadrangle(0, 1, 2, 3);
+    surface->add_triangle(4, 5, 6);
+
+    surface->compute_geometry();
+
+    return surface;
+}
+
+// Check an approximation against a reference value, relative to the given scale:
+static bool
+check(const char *name, int panel, int direction, double value, double reference, double scale, double tolerance)
+{
+    double error = fabs(value - reference) / scale;
+    if (error > tolerance) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " " << name << ", panel = " << panel << ", direction = " << direction << endl;
+        cerr << " value(ref) = " << reference << ", value = " << value << ", relative error = " << error << endl;
+        cerr << " ******************* " << endl;
+
+        return false;
+    }
+
+    return true;
+}
+
+// Compare the far-field expansions with the exact kernels, just beyond the far-field distance, in a number of
+// directions on both sides of the panels.  The errors are taken relative to the leading terms of the expansions:
+static bool
+test_far_field(const shared_ptr<Surface> &surface)
+{
+    const Vector3d directions[6] = { Vector3d(1, 0, 0), Vector3d(0, -1, 0), Vector3d(0, 0, 1),
+                                     Vector3d(1, 2, -3), Vector3d(-2, 1, 1), Vector3d(-1, -1, -1) };
+
+    double max_potential_error = 0.0, max_velocity_error = 0.0;
+
+    for (int i = 0; i < surface->n_panels(); i++) {
+        double area = surface->panel_surface_area(i);
+
+        Matrix3Xd x(3, 6);
+        for (int k = 0; k < 6; k++) {
+            double r = 1.1 * FAR_FIELD_DISTANCE_FACTOR * surface->panel_diameter(i);
+
+            x.col(k) = surface->panel_collocation_point(i, false) + r * directions[k].normalized();
+        }
+
+        // Exact kernels:
+        Parameters::far_field_distance_factor = 0.0;
+
+        VectorXd source_influence(6), doublet_influence(6);
+        surface->source_and_doublet_influence(x, i, source_influence, doublet_influence);
+
+        Matrix3Xd vortex_ring_velocity(3, 6);
+        surface->vortex_ring_unit_velocity(x, i, vortex_ring_velocity);
+
+        // Far-field expansions:
+        Parameters::far_field_distance_factor = FAR_FIELD_DISTANCE_FACTOR;
+
+        VectorXd far_source_influence(6), far_doublet_influence(6);
+        surface->source_and_doublet_influence(x, i, far_source_influence, far_doublet_influence);
+
+        Matrix3Xd far_vortex_ring_velocity(3, 6);
+        surface->vortex_ring_unit_velocity(x, i, far_vortex_ring_velocity);
+
+        for (int k = 0; k < 6; k++) {
+            double r = (x.col(k) - surface->panel_collocation_point(i, false)).norm();
+
+            double source_scale  = area / (4 * pi * r);
+            double doublet_scale = area / (4 * pi * r * r);
+
+            // The scalar kernels:
+            double far_source, far_doublet;
+            surface->source_and_doublet_influence(Vector3d(x.col(k)), i, far_source, far_doublet);
+
+            Vector3d far_source_velocity = surface->source_unit_velocity(x.col(k), i);
+
+            Parameters::far_field_distance_factor = 0.0;
+
+            Vector3d source_velocity = surface->source_unit_velocity(x.col(k), i);
+
+            Parameters::far_field_distance_factor = FAR_FIELD_DISTANCE_FACTOR;
+
+            // The expansions must actually be in use:
+            if (far_source_influence(k) == source_influence(k)) {
+                cerr << " *** TEST FAILED *** " << endl;
+                cerr << " The far-field expansion was not used, panel = " << i << ", direction = " << k << endl;
+                cerr << " ******************* " << endl;
+
+                return false;
+            }
+
+            if (!check("Batched source potential", i, k, far_source_influence(k), source_influence(k), source_scale, POTENTIAL_TEST_TOLERANCE) ||
+                !check("Batched doublet potential", i, k, far_doublet_influence(k), doublet_influence(k), doublet_scale, POTENTIAL_TEST_TOLERANCE) ||
+                !check("Source potential", i, k, far_source, source_influence(k), source_scale, POTENTIAL_TEST_TOLERANCE) ||
+                !check("Doublet potential", i, k, far_doublet, doublet_influence(k), doublet_scale, POTENTIAL_TEST_TOLERANCE))
+                return false;
+
+            if (!check("Source velocity", i, k, (far_source_velocity - source_velocity).norm(), 0.0, doublet_scale, VELOCITY_TEST_TOLERANCE) ||
+                !check("Vortex ring velocity", i, k, (far_vortex_ring_velocity.col(k) - vortex_ring_velocity.col(k)).norm(), 0.0, doublet_scale / r, VELOCITY_TEST_TOLERANCE))
+                return false;
+
+            max_potential_error = max(max_potential_error, fabs(far_source_influence(k) - source_influence(k)) / source_scale);
+            max_potential_error = max(max_potential_error, fabs(far_doublet_influence(k) - doublet_influence(k)) / doublet_scale);
+
+            max_velocity_error = max(max_velocity_error, (far_source_velocity - source_velocity).norm() / doublet_scale);
+            max_velocity_error = max(max_velocity_error, (far_vortex_ring_velocity.col(k) - vortex_ring_velocity.col(k)).norm() / (doublet_scale / r));
+        }
+    }
+
+    Parameters::far_field_distance_factor = 0.0;
+
+    cout << "Far field: Maximum relative error of the potentials = " << max_potential_error << ", of the velocities = " << max_velocity_error << endl;
+
+    return true;
+}
+
+// Compare the exact source potential of the quadrangle with the midpoint rule, on both sides of the panel:
+static bool
+test_quadrature(const shared_ptr<Surface> &surface)
+{
+    const int panel = 0;
+
+    const Vector3d &a = surface->nodes[surface->panel_nodes[panel][0]];
+    const Vector3d &b = surface->nodes[surface->panel_nodes[panel][1]];
+    const Vector3d &c = surface->nodes[surface->panel_nodes[panel][2]];
+    const Vector3d &d = surface->nodes[surface->panel_nodes[panel][3]];
+
+    const Vector3d &center = surface->panel_collocation_point(panel, false);
+    const Vector3d &normal = surface->panel_normal(panel);
+
+    const Vector3d offsets[4] = { 0.5 * normal, -0.5 * normal, 0.3 * normal + 0.4 * (b - a), -0.3 * normal - 0.2 * (d - a) };
+
+    for (int k = 0; k < 4; k++) {
+        Vector3d x = center + offsets[k];
+
+        // Integrate 1 / (4 pi r) over the bilinear parametrization of the quadrangle:
+        double quadrature = 0.0;
+        for (int i = 0; i < N_QUADRATURE_POINTS; i++) {
+            double s = (i + 0.5) / N_QUADRATURE_POINTS;
+
+            for (int j = 0; j < N_QUADRATURE_POINTS; j++) {
+                double t = (j + 0.5) / N_QUADRATURE_POINTS;
+
+                Vector3d y = (1 - s) * (1 - t) * a + s * (1 - t) * b + s * t * c + (1 - s) * t * d;
+
+                Vector3d dy_ds = (1 - t) * (b - a) + t * (c - d);
+                Vector3d dy_dt = (1 - s) * (d - a) + s * (c - b);
+
+                double jacobian = dy_ds.cross(dy_dt).norm();
+
+                quadrature += jacobian / (4 * pi * (x - y).norm()) / (N_QUADRATURE_POINTS * N_QUADRATURE_POINTS);
+            }
+        }
+
+        double source_influence = surface->source_influence(x, panel);
+
+        cout << "Quadrature: Offset " << k << ": phi(ref) = " << quadrature << ", phi = " << source_influence << endl;
+
+        if (!check("Source potential quadrature", panel, k, source_influence, quadrature, fabs(quadrature), QUADRATURE_TEST_TOLERANCE))
+            return false;
+    }
+
+    return true;
+}
+
+int
+main (int argc, char **argv)
+{
+    shared_ptr<Surface> surface = create_panels();
+
+    if (!test_far_field(surface))
+        exit(1);
+
+    if (!test_quadrature(surface))
+        exit(1);
+
+    return 0;
+}
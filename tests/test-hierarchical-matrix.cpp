@@ -0,0 +1,157 @@
+//
+// Vortexje -- Rectangular wing with NACA0012 airfoil.  Checks the hierarchical matrices against the dense matrices.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <cmath>
+#include <iostream>
+
+#include <vortexje/solver.hpp>
+#include <vortexje/lifting-surface-builder.hpp>
+#include <vortexje/shape-generators/airfoils/naca4-airfoil-generator.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+static const double pi = 3.141592653589793238462643383279502884;
+
+#define DELTA_T     1e-2
+#define N_STEPS     8
+
+// The relative force error must be below this multiple of the tolerance of the low-rank approximations:
+#define FORCE_TEST_TOLERANCE_FACTOR 10.0
+
+// Create a rectangular wing:
+static shared_ptr<Body>
+create_wing()
+{
+    shared_ptr<LiftingSurface> wing(new LiftingSurface());
+
+    LiftingSurfaceBuilder surface_builder(*wing);
+
+    const double chord = 0.75;
+    const double span  = 4.5;
+
+    const int n_airfoils = 21;
+
+    const int n_points_per_airfoil = 24;
+
+    int trailing_edge_point_id;
+    vector<int> prev_airfoil_nodes;
+
+    vector<vector<int> > node_strips;
+    vector<vector<int> > panel_strips;
+
+    for (int i = 0; i < n_airfoils; i++) {
+        double z = -span / 2.0 + span * i / (double) (n_airfoils - 1);
+
+        vector<Vector3d, Eigen::aligned_allocator<Vector3d> > airfoil_points =
+            NACA4AirfoilGenerator::generate(0, 0, 0.12, true, chord, n_points_per_airfoil, trailing_edge_point_id);
+        for (int j = 0; j < (int) airfoil_points.size(); j++)
+            airfoil_points[j](2) += z;
+
+        vector<int> airfoil_nodes = surface_builder.create_nodes_for_points(airfoil_points);
+        node_strips.push_back(airfoil_nodes);
+
+        if (i > 0) {
+            vector<int> airfoil_panels = surface_builder.create_panels_between_shapes(airfoil_nodes, prev_airfoil_nodes, trailing_edge_point_id);
+            panel_strips.push_back(airfoil_panels);
+        }
+
+        prev_airfoil_nodes = airfoil_nodes;
+    }
+
+    surface_builder.finish(node_strips, panel_strips, trailing_edge_point_id);
+
+    // Rotate the span onto the y-axis, so that the wing lifts in the z-direction:
+    wing->rotate(Vector3d::UnitX(), -pi / 2.0);
+
+    // Create body:
+    shared_ptr<Body> body(new Body(string("wing")));
+    body->add_lifting_surface(wing);
+
+    return body;
+}
+
+// Run an unsteady simulation with the given hierarchical matrix tolerance, and return the force:
+static Vector3d
+run_simulation(double hierarchical_matrix_tolerance)
+{
+    Parameters::hierarchical_matrix_tolerance = hierarchical_matrix_tolerance;
+
+    shared_ptr<Body> body = create_wing();
+
+    // Set up solver:
+    Solver solver("test-hierarchical-matrix-log");
+    solver.add_body(body);
+
+    Vector3d freestream_velocity(30, 0, 3);
+    solver.set_freestream_velocity(freestream_velocity);
+
+    double fluid_density = 1.2;
+    solver.set_fluid_density(fluid_density);
+
+    // Run simulation:
+    solver.initialize_wakes(DELTA_T);
+
+    for (int step_number = 0; step_number < N_STEPS; step_number++) {
+        solver.solve(DELTA_T);
+
+        solver.update_wakes(DELTA_T);
+    }
+
+    Parameters::hierarchical_matrix_tolerance = 0.0;
+
+    return solver.force(body);
+}
+
+// Run a test for a single tolerance, against the force obtained with dense matrices:
+static bool
+run_test(double hierarchical_matrix_tolerance, const Vector3d &F_ref)
+{
+    Vector3d F = run_simulation(hierarchical_matrix_tolerance);
+
+    double error = (F - F_ref).norm() / F_ref.norm();
+
+    cout << "Tolerance " << hierarchical_matrix_tolerance << ": F(ref) = " << F_ref.transpose() << " N, F = " << F.transpose() << " N, relative error = " << error << endl;
+
+    if (error > FORCE_TEST_TOLERANCE_FACTOR * hierarchical_matrix_tolerance) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " Tolerance = " << hierarchical_matrix_tolerance << endl;
+        cerr << " F(ref) = " << F_ref.transpose() << endl;
+        cerr << " F = " << F.transpose() << endl;
+        cerr << " ******************* " << endl;
+
+        return false;
+    }
+
+    // Done.
+    return true;
+}
+
+int
+main (int argc, char **argv)
+{
+    // Set up parameters for unsteady simulation:
+    Parameters::unsteady_bernoulli = true;
+    Parameters::convect_wake       = true;
+
+    // Dense matrices:
+    Vector3d F_ref = run_simulation(0.0);
+
+    // Hierarchical matrices, with low-rank approximations of increasing accuracy:
+    if (!run_test(1e-4, F_ref))
+        exit(1);
+
+    if (!run_test(1e-6, F_ref))
+        exit(1);
+
+    if (!run_test(1e-8, F_ref))
+        exit(1);
+
+    return 0;
+}
@@ -0,0 +1,184 @@
+//
+// Vortexje -- Rectangular wing with NACA0012 airfoil.  Checks the iterative linear solvers against the direct solver.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <cmath>
+#include <iostream>
+
+#include <vortexje/solver.hpp>
+#include <vortexje/lifting-surface-builder.hpp>
+#include <vortexje/shape-generators/airfoils/naca4-airfoil-generator.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+static const double pi = 3.141592653589793238462643383279502884;
+
+#define DELTA_T     1e-2
+#define N_STEPS     10
+
+#define GMRES_RESTART       30
+#define BLOCK_SIZE          64
+#define RECYCLED_SOLUTIONS  3
+
+#define FORCE_TEST_TOLERANCE 1e-6
+
+// Create a rectangular wing:
+static shared_ptr<Body>
+create_wing()
+{
+    shared_ptr<LiftingSurface> wing(new LiftingSurface());
+
+    LiftingSurfaceBuilder surface_builder(*wing);
+
+    const double chord = 0.75;
+    const double span  = 4.5;
+
+    const int n_airfoils = 11;
+
+    const int n_points_per_airfoil = 24;
+
+    int trailing_edge_point_id;
+    vector<int> prev_airfoil_nodes;
+
+    vector<vector<int> > node_strips;
+    vector<vector<int> > panel_strips;
+
+    for (int i = 0; i < n_airfoils; i++) {
+        double z = -span / 2.0 + span * i / (double) (n_airfoils - 1);
+
+        vector<Vector3d, Eigen::aligned_allocator<Vector3d> > airfoil_points =
+            NACA4AirfoilGenerator::generate(0, 0, 0.12, true, chord, n_points_per_airfoil, trailing_edge_point_id);
+        for (int j = 0; j < (int) airfoil_points.size(); j++)
+            airfoil_points[j](2) += z;
+
+        vector<int> airfoil_nodes = surface_builder.create_nodes_for_points(airfoil_points);
+        node_strips.push_back(airfoil_nodes);
+
+        if (i > 0) {
+            vector<int> airfoil_panels = surface_builder.create_panels_between_shapes(airfoil_nodes, prev_airfoil_nodes, trailing_edge_point_id);
+            panel_strips.push_back(airfoil_panels);
+        }
+
+        prev_airfoil_nodes = airfoil_nodes;
+    }
+
+    surface_builder.finish(node_strips, panel_strips, trailing_edge_point_id);
+
+    // Rotate the span onto the y-axis, so that the wing lifts in the z-direction:
+    wing->rotate(Vector3d::UnitX(), -pi / 2.0);
+
+    // Create body:
+    shared_ptr<Body> body(new Body(string("wing")));
+    body->add_lifting_surface(wing);
+
+    return body;
+}
+
+// Run a simulation, and return the force on the wing.  A steady simulation solves the same system twice, so that the
+// second solve starts from the converged solution of the first.  Returns false if any of the solves fails:
+static bool
+run_simulation(bool unsteady, bool direct, int block_size, int recycled_solutions, Vector3d &F)
+{
+    Parameters::unsteady_bernoulli = unsteady;
+    Parameters::convect_wake       = unsteady;
+
+    shared_ptr<Body> body = create_wing();
+
+    // Set up solver:
+    Solver solver("test-linear-solvers-log");
+    solver.add_body(body);
+
+    solver.parameters.direct_linear_solver             = direct;
+    solver.parameters.linear_solver_gmres_restart      = direct ? 0 : GMRES_RESTART;
+    solver.parameters.linear_solver_block_size         = block_size;
+    solver.parameters.linear_solver_recycled_solutions = recycled_solutions;
+
+    Vector3d freestream_velocity(30, 0, 3);
+    solver.set_freestream_velocity(freestream_velocity);
+
+    double fluid_density = 1.2;
+    solver.set_fluid_density(fluid_density);
+
+    // Run simulation:
+    double dt = DELTA_T;
+
+    solver.initialize_wakes(dt);
+
+    int n_steps = unsteady ? N_STEPS : 2;
+    for (int step_number = 0; step_number < n_steps; step_number++) {
+        if (!solver.solve(dt))
+            return false;
+
+        if (unsteady)
+            solver.update_wakes(dt);
+    }
+
+    F = solver.force(body);
+
+    return true;
+}
+
+// Run a test for a single linear solver configuration:
+static bool
+run_test(const char *name, bool unsteady, int block_size, int recycled_solutions)
+{
+    Vector3d F_direct;
+    if (!run_simulation(unsteady, true, 0, 0, F_direct)) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " Configuration = " << name << endl;
+        cerr << " Direct solve failed." << endl;
+        cerr << " ******************* " << endl;
+
+        return false;
+    }
+
+    Vector3d F_gmres;
+    bool success = run_simulation(unsteady, false, block_size, recycled_solutions, F_gmres);
+
+    cout << name << ": F(direct) = " << F_direct.transpose() << " N, F(GMRES) = " << F_gmres.transpose() << " N" << endl;
+
+    double F_error = (F_gmres - F_direct).norm() / F_direct.norm();
+
+    if (!success || F_error > FORCE_TEST_TOLERANCE) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " Configuration = " << name << endl;
+        if (!success)
+            cerr << " GMRES solve failed." << endl;
+        else {
+            cerr << " F(direct) = " << F_direct.transpose() << endl;
+            cerr << " F(GMRES) = " << F_gmres.transpose() << endl;
+        }
+        cerr << " ******************* " << endl;
+
+        return false;
+    }
+
+    // Done.
+    return true;
+}
+
+int
+main (int argc, char **argv)
+{
+    // Repeated solve of an unchanged steady system:
+    if (!run_test("steady", false, 0, 0))
+        exit(1);
+
+    if (!run_test("steady, block-Jacobi", false, BLOCK_SIZE, 0))
+        exit(1);
+
+    // Unsteady simulation, with initial guesses from the recycled solutions of the previous steps:
+    if (!run_test("unsteady, recycled", true, 0, RECYCLED_SOLUTIONS))
+        exit(1);
+
+    if (!run_test("unsteady, recycled, block-Jacobi", true, BLOCK_SIZE, RECYCLED_SOLUTIONS))
+        exit(1);
+
+    return 0;
+}
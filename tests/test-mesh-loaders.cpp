@@ -0,0 +1,207 @@
+//
+// Vortexje -- Sphere in MSH 2.2 and MSH 4.1 formats.  Checks the Gmsh and cached surface loaders.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+
+#include <stdint.h>
+
+#include <vortexje/surface-loaders/gmsh-surface-loader.hpp>
+#include <vortexje/surface-loaders/cached-surface-loader.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+// Check that two surfaces have identical nodes and panels:
+static bool
+compare_surfaces(const char *name, const shared_ptr<Surface> &surface, const shared_ptr<Surface> &reference)
+{
+    cout << name << ": " << surface->n_nodes() << " nodes, " << surface->n_panels() << " panels" << endl;
+
+    if (surface->nodes != reference->nodes || surface->panel_nodes != reference->panel_nodes) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " " << name << " differs from the reference mesh." << endl;
+        cerr << " nodes(ref) = " << reference->n_nodes() << ", panels(ref) = " << reference->n_panels() << endl;
+        cerr << " nodes = " << surface->n_nodes() << ", panels = " << surface->n_panels() << endl;
+        cerr << " ******************* " << endl;
+
+        return false;
+    }
+
+    return true;
+}
+
+// Check the numbers of cache hits and misses so far:
+static bool
+check_cache_counters(const char *name, const shared_ptr<Profiler> &profiler, int hits, int misses)
+{
+    if (profiler->total_counter("mesh_cache_hits") != hits || profiler->total_counter("mesh_cache_misses") != misses) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " " << name << ": unexpected cache behavior." << endl;
+        cerr << " hits(ref) = " << hits << ", misses(ref) = " << misses << endl;
+        cerr << " hits = " << profiler->total_counter("mesh_cache_hits") << ", misses = " << profiler->total_counter("mesh_cache_misses") << endl;
+        cerr << " ******************* " << endl;
+
+        return false;
+    }
+
+    return true;
+}
+
+// Copy a file:
+static void
+copy_file(const string &source, const string &destination)
+{
+    ifstream in(source.c_str(), ios::in | ios::binary);
+    ofstream out(destination.c_str(), ios::out | ios::binary | ios::trunc);
+
+    out << in.rdbuf();
+}
+
+int
+main (int argc, char **argv)
+{
+    GmshSurfaceLoader surface_loader;
+
+    // Load the MSH 2.2 reference:
+    shared_ptr<Surface> reference(new Surface());
+    if (!surface_loader.load(reference, string("sphere.msh"))) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " Unable to load sphere.msh." << endl;
+        cerr << " ******************* " << endl;
+
+        exit(1);
+    }
+
+    // The MSH 4.1 files contain the same nodes, with non-contiguous tags, and the same quadrangles.  The ASCII file
+    // contains a third order triangle, which is skipped, and both files contain a point or a line:
+    const char *msh41_files[] = { "sphere-msh41-ascii.msh", "sphere-msh41-binary.msh" };
+
+    for (int i = 0; i < 2; i++) {
+        shared_ptr<Surface> surface(new Surface());
+        if (!surface_loader.load(surface, string(msh41_files[i]))) {
+            cerr << " *** TEST FAILED *** " << endl;
+            cerr << " Unable to load " << msh41_files[i] << "." << endl;
+            cerr << " ******************* " << endl;
+
+            exit(1);
+        }
+
+        if (!compare_surfaces(msh41_files[i], surface, reference))
+            exit(1);
+    }
+
+    // Malformed MSH 4.1 files are rejected, and leave the surface untouched.  The first file declares a parametric
+    // node block of an entity of dimension 7, and the second file contains an element referring to an unknown node:
+    const char *malformed_msh41_data[] = {
+        "$MeshFormat\n4.1 0 8\n$EndMeshFormat\n"
+        "$Nodes\n1 4 1 4\n7 1 1 4\n1\n2\n3\n4\n"
+        "0 0 0 0 0 0 0 0 0 0\n1 0 0 0 0 0 0 0 0 0\n1 1 0 0 0 0 0 0 0 0\n0 1 0 0 0 0 0 0 0 0\n$EndNodes\n",
+        "$MeshFormat\n4.1 0 8\n$EndMeshFormat\n"
+        "$Nodes\n1 4 1 4\n2 1 0 4\n1\n2\n3\n4\n0 0 0\n1 0 0\n1 1 0\n0 1 0\n$EndNodes\n"
+        "$Elements\n1 1 1 1\n2 1 3 1\n1 1 2 3 5\n$EndElements\n"
+    };
+
+    string malformed_filename("test-mesh-loaders-malformed.msh");
+
+    for (int i = 0; i < 2; i++) {
+        {
+            ofstream f(malformed_filename.c_str(), ios::out | ios::trunc);
+            f << malformed_msh41_data[i];
+        }
+
+        shared_ptr<Surface> surface(new Surface());
+        if (surface_loader.load(surface, malformed_filename) || surface->n_nodes() != 0 || surface->n_panels() != 0) {
+            cerr << " *** TEST FAILED *** " << endl;
+            cerr << " Malformed MSH 4.1 file " << i << " was not rejected cleanly." << endl;
+            cerr << " ******************* " << endl;
+
+            exit(1);
+        }
+    }
+
+    remove(malformed_filename.c_str());
+
+    // Load a private copy of the sphere through the cache, so that the cache file is written from scratch:
+    string filename("test-mesh-loaders-sphere.msh");
+    string cache_filename = filename + ".vjmesh";
+
+    copy_file("sphere.msh", filename);
+    remove(cache_filename.c_str());
+
+    CachedSurfaceLoader cached_surface_loader(surface_loader);
+    cached_surface_loader.profiler = shared_ptr<Profiler>(new Profiler());
+
+    // The first load parses the source file, and writes the cache:
+    shared_ptr<Surface> miss(new Surface());
+    if (!cached_surface_loader.load(miss, filename) || !check_cache_counters("First load", cached_surface_loader.profiler, 0, 1))
+        exit(1);
+
+    if (!compare_surfaces("First load", miss, reference))
+        exit(1);
+
+    // The second load reads the cache:
+    shared_ptr<Surface> hit(new Surface());
+    if (!cached_surface_loader.load(hit, filename) || !check_cache_counters("Second load", cached_surface_loader.profiler, 1, 1))
+        exit(1);
+
+    if (!compare_surfaces("Second load", hit, reference))
+        exit(1);
+
+    // Replace the source file by a different mesh, a single quadrangle, so that the cache is stale:
+    {
+        ofstream f(filename.c_str(), ios::out | ios::trunc);
+        f << "$MeshFormat\n2.2 0 8\n$EndMeshFormat\n";
+        f << "$Nodes\n4\n1 0 0 0\n2 1 0 0\n3 1 1 0\n4 0 1 0\n$EndNodes\n";
+        f << "$Elements\n1\n1 3 2 0 1 1 2 3 4\n$EndElements\n";
+    }
+
+    shared_ptr<Surface> stale(new Surface());
+    if (!cached_surface_loader.load(stale, filename) || !check_cache_counters("Stale load", cached_surface_loader.profiler, 1, 2))
+        exit(1);
+
+    if (stale->n_nodes() != 4 || stale->n_panels() != 1) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " The stale cache was used." << endl;
+        cerr << " ******************* " << endl;
+
+        exit(1);
+    }
+
+    // The rewritten cache is used for the modified source:
+    shared_ptr<Surface> rewritten(new Surface());
+    if (!cached_surface_loader.load(rewritten, filename) || !check_cache_counters("Rewritten load", cached_surface_loader.profiler, 2, 2))
+        exit(1);
+
+    if (!compare_surfaces("Rewritten load", rewritten, stale))
+        exit(1);
+
+    // Corrupt the node count of the cache, which follows the checkpoint header and the cache header, 5 records in
+    // all.  The corrupt cache is ignored, and the source file is parsed again:
+    {
+        fstream f(cache_filename.c_str(), ios::in | ios::out | ios::binary);
+
+        int64_t count = ((int64_t) 1) << 40;
+        f.seekp(5 * sizeof(int64_t));
+        f.write((const char *) &count, sizeof(count));
+    }
+
+    shared_ptr<Surface> corrupt(new Surface());
+    if (!cached_surface_loader.load(corrupt, filename) || !check_cache_counters("Corrupt load", cached_surface_loader.profiler, 2, 3))
+        exit(1);
+
+    if (!compare_surfaces("Corrupt load", corrupt, stale))
+        exit(1);
+
+    remove(filename.c_str());
+    remove(cache_filename.c_str());
+
+    return 0;
+}
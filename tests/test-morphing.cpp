@@ -0,0 +1,200 @@
+//
+// Vortexje -- Rectangular wing with NACA00xx airfoil.  Checks morphed wings against freshly built wings.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <cmath>
+#include <iostream>
+
+#include <vortexje/solver.hpp>
+#include <vortexje/lifting-surface-builder.hpp>
+#include <vortexje/shape-generators/airfoils/naca4-airfoil-generator.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+static const double pi = 3.141592653589793238462643383279502884;
+
+#define DELTA_T     1e-2
+#define N_STEPS     8
+
+#define FORCE_TEST_TOLERANCE 1e-8
+
+// Create a rectangular wing with the given airfoil thickness:
+static shared_ptr<LiftingSurface>
+create_wing(double thickness)
+{
+    shared_ptr<LiftingSurface> wing(new LiftingSurface());
+
+    LiftingSurfaceBuilder surface_builder(*wing);
+
+    const double chord = 0.75;
+    const double span  = 4.5;
+
+    const int n_airfoils = 11;
+
+    const int n_points_per_airfoil = 24;
+
+    int trailing_edge_point_id;
+    vector<int> prev_airfoil_nodes;
+
+    vector<vector<int> > node_strips;
+    vector<vector<int> > panel_strips;
+
+    for (int i = 0; i < n_airfoils; i++) {
+        double z = -span / 2.0 + span * i / (double) (n_airfoils - 1);
+
+        vector<Vector3d, Eigen::aligned_allocator<Vector3d> > airfoil_points =
+            NACA4AirfoilGenerator::generate(0, 0, thickness, true, chord, n_points_per_airfoil, trailing_edge_point_id);
+        for (int j = 0; j < (int) airfoil_points.size(); j++)
+            airfoil_points[j](2) += z;
+
+        vector<int> airfoil_nodes = surface_builder.create_nodes_for_points(airfoil_points);
+        node_strips.push_back(airfoil_nodes);
+
+        if (i > 0) {
+            vector<int> airfoil_panels = surface_builder.create_panels_between_shapes(airfoil_nodes, prev_airfoil_nodes, trailing_edge_point_id);
+            panel_strips.push_back(airfoil_panels);
+        }
+
+        prev_airfoil_nodes = airfoil_nodes;
+    }
+
+    surface_builder.finish(node_strips, panel_strips, trailing_edge_point_id);
+
+    // Rotate the span onto the y-axis, so that the wing lifts in the z-direction:
+    wing->rotate(Vector3d::UnitX(), -pi / 2.0);
+
+    return wing;
+}
+
+// Set up a solver for the given body:
+static shared_ptr<Solver>
+create_solver(const shared_ptr<Body> &body)
+{
+    shared_ptr<Solver> solver(new Solver("test-morphing-log"));
+    solver->add_body(body);
+
+    Vector3d freestream_velocity(30, 0, 3);
+    solver->set_freestream_velocity(freestream_velocity);
+
+    double fluid_density = 1.2;
+    solver->set_fluid_density(fluid_density);
+
+    solver->initialize_wakes(DELTA_T);
+
+    return solver;
+}
+
+// Run the given number of steps of a simulation:
+static void
+run_steps(Solver &solver, int n_steps)
+{
+    for (int step_number = 0; step_number < n_steps; step_number++) {
+        solver.solve(DELTA_T);
+
+        solver.update_wakes(DELTA_T);
+    }
+}
+
+// Run a test for a single thickness:
+static bool
+run_test(double thickness)
+{
+    // Freshly built wing:
+    shared_ptr<LiftingSurface> reference_wing = create_wing(thickness);
+
+    shared_ptr<Body> reference_body(new Body(string("wing")));
+    reference_body->add_lifting_surface(reference_wing);
+
+    shared_ptr<Solver> reference_solver = create_solver(reference_body);
+
+    run_steps(*reference_solver, N_STEPS);
+
+    Vector3d F_ref = reference_solver->force(reference_body);
+
+    // Wing with a 12% thick airfoil, solved once before it is morphed into the freshly built wing.  The first solve
+    // does not convect the wake, so that the wake of the morphed wing starts at its trailing edge as well:
+    shared_ptr<LiftingSurface> wing = create_wing(0.12);
+
+    shared_ptr<Body> body(new Body(string("wing")));
+    body->add_lifting_surface(wing);
+
+    shared_ptr<Solver> solver = create_solver(body);
+
+    solver->solve(DELTA_T);
+
+    if (!body->morph_surface(wing, reference_wing->nodes)) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " Morphing the wing failed." << endl;
+        cerr << " ******************* " << endl;
+
+        return false;
+    }
+
+    run_steps(*solver, N_STEPS);
+
+    Vector3d F = solver->force(body);
+
+    cout << "Thickness " << thickness << ": F(ref) = " << F_ref.transpose() << " N, F = " << F.transpose() << " N" << endl;
+
+    if ((F - F_ref).norm() / F_ref.norm() > FORCE_TEST_TOLERANCE) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " Thickness = " << thickness << ", convect wake = " << Parameters::convect_wake << endl;
+        cerr << " F(ref) = " << F_ref.transpose() << endl;
+        cerr << " F = " << F.transpose() << endl;
+        cerr << " ******************* " << endl;
+
+        return false;
+    }
+
+    // Done.
+    return true;
+}
+
+int
+main (int argc, char **argv)
+{
+    const double thicknesses[3] = { 0.13, 0.15, 0.17 };
+
+    // Unsteady simulation, with a convected wake:
+    Parameters::unsteady_bernoulli = true;
+    Parameters::convect_wake       = true;
+
+    for (int i = 0; i < 3; i++) {
+        if (!run_test(thicknesses[i]))
+            exit(1);
+    }
+
+    // Static wake:
+    Parameters::unsteady_bernoulli = false;
+    Parameters::convect_wake       = false;
+
+    for (int i = 0; i < 3; i++) {
+        if (!run_test(thicknesses[i]))
+            exit(1);
+    }
+
+    // A node count that does not match is rejected:
+    shared_ptr<LiftingSurface> wing = create_wing(0.12);
+
+    shared_ptr<Body> body(new Body(string("wing")));
+    body->add_lifting_surface(wing);
+
+    vector<Vector3d, Eigen::aligned_allocator<Vector3d> > nodes = wing->nodes;
+    nodes.pop_back();
+
+    if (body->morph_surface(wing, nodes)) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " A node count that does not match was accepted." << endl;
+        cerr << " ******************* " << endl;
+
+        exit(1);
+    }
+
+    return 0;
+}
@@ -0,0 +1,196 @@
+//
+// Vortexje -- Rectangular wing with NACA0012 airfoil.  Checks the adjoint force sensitivities against re-solves.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <cmath>
+#include <iostream>
+
+#include <vortexje/solver.hpp>
+#include <vortexje/lifting-surface-builder.hpp>
+#include <vortexje/shape-generators/airfoils/naca4-airfoil-generator.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+static const double pi = 3.141592653589793238462643383279502884;
+
+#define NODE_PERTURBATION     1e-5
+#define VELOCITY_PERTURBATION 1e-4
+
+#define NODE_GRADIENT_TEST_TOLERANCE 1e-4
+
+// The geometry of the wake is held fixed by the sensitivities, see Solver::force_sensitivities():
+#define FREESTREAM_TEST_TOLERANCE    1e-2
+
+// Force component, for the current solution:
+static double
+force_component(Solver &solver, const shared_ptr<Body> &body, const Vector3d &direction)
+{
+    return direction.dot(solver.force(body));
+}
+
+// Check a derivative against its central difference approximation:
+static bool
+check_derivative(const char *name, double derivative, double reference, double scale, double tolerance)
+{
+    cout << name << ": adjoint = " << derivative << ", central difference = " << reference << endl;
+
+    if (fabs(derivative - reference) > tolerance * scale) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " " << name << "(ref) = " << reference << endl;
+        cerr << " " << name << " = " << derivative << endl;
+        cerr << " ******************* " << endl;
+
+        return false;
+    }
+
+    return true;
+}
+
+int
+main (int argc, char **argv)
+{
+    // Set up parameters for steady simulation:
+    Parameters::convect_wake            = false;
+    Parameters::linear_solver_tolerance = 1e-13;
+
+    // Create wing:
+    shared_ptr<LiftingSurface> wing(new LiftingSurface());
+
+    LiftingSurfaceBuilder surface_builder(*wing);
+
+    const double chord = 0.75;
+    const double span = 4.5;
+
+    const int n_points_per_airfoil = 24;
+    const int n_airfoils = 11;
+
+    int trailing_edge_point_id;
+    vector<int> prev_airfoil_nodes;
+
+    vector<vector<int> > node_strips;
+    vector<vector<int> > panel_strips;
+
+    for (int i = 0; i < n_airfoils; i++) {
+        vector<Vector3d, Eigen::aligned_allocator<Vector3d> > airfoil_points =
+            NACA4AirfoilGenerator::generate(0, 0, 0.12, true, chord, n_points_per_airfoil, trailing_edge_point_id);
+        for (int j = 0; j < (int) airfoil_points.size(); j++)
+            airfoil_points[j](2) += span * i / (double) (n_airfoils - 1);
+
+        vector<int> airfoil_nodes = surface_builder.create_nodes_for_points(airfoil_points);
+        node_strips.push_back(airfoil_nodes);
+
+        if (i > 0) {
+            vector<int> airfoil_panels = surface_builder.create_panels_between_shapes(airfoil_nodes, prev_airfoil_nodes, trailing_edge_point_id);
+            panel_strips.push_back(airfoil_panels);
+        }
+
+        prev_airfoil_nodes = airfoil_nodes;
+    }
+
+    surface_builder.finish(node_strips, panel_strips, trailing_edge_point_id);
+
+    // Rotate by angle of attack:
+    wing->rotate(Vector3d::UnitZ(), -5.0 / 180.0 * pi);
+
+    // Create body:
+    shared_ptr<Body> body(new Body(string("wing")));
+    body->add_lifting_surface(wing);
+
+    // Set up solver:
+    Solver solver("test-sensitivities-log");
+    solver.add_body(body);
+
+    Vector3d freestream_velocity(30, 0, 0);
+    solver.set_freestream_velocity(freestream_velocity);
+
+    double fluid_density = 1.2;
+    solver.set_fluid_density(fluid_density);
+
+    // Solve:
+    solver.initialize_wakes(0.0);
+    solver.solve();
+
+    // Compute the sensitivities of the lift:
+    Vector3d direction(0, 1, 0);
+
+    vector<Vector3d, Eigen::aligned_allocator<Vector3d> > nodes = wing->nodes;
+
+    Vector3d collocation_point = wing->panel_collocation_point(0, false);
+
+    Solver::Sensitivities sensitivities;
+    if (!solver.force_sensitivities(body, direction, sensitivities)) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " Computing the sensitivities failed." << endl;
+        cerr << " ******************* " << endl;
+
+        exit(1);
+    }
+
+    // The shared geometry must be left untouched:
+    if (wing->nodes != nodes || wing->panel_collocation_point(0, false) != collocation_point) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " The sensitivities modified the geometry of the wing." << endl;
+        cerr << " ******************* " << endl;
+
+        exit(1);
+    }
+
+    // Compare the node gradients against full re-solves, for nodes on the leading edge, the trailing edge, the tip,
+    // and the root:
+    int test_nodes[] = { n_points_per_airfoil / 2, wing->trailing_edge_node(n_airfoils / 2),
+                         (n_airfoils / 2) * n_points_per_airfoil + 5, (int) wing->nodes.size() - 3, 7 };
+
+    double max_node_gradient = sensitivities.node_gradients[0].cwiseAbs().maxCoeff();
+
+    for (int l = 0; l < 5; l++) {
+        int k = test_nodes[l];
+
+        for (int c = 0; c < 3; c++) {
+            vector<Vector3d, Eigen::aligned_allocator<Vector3d> > perturbed_nodes = nodes;
+
+            perturbed_nodes[k](c) = nodes[k](c) + NODE_PERTURBATION;
+            body->morph_surface(wing, perturbed_nodes);
+            solver.solve();
+            double forward = force_component(solver, body, direction);
+
+            perturbed_nodes[k](c) = nodes[k](c) - NODE_PERTURBATION;
+            body->morph_surface(wing, perturbed_nodes);
+            solver.solve();
+            double backward = force_component(solver, body, direction);
+
+            double reference = (forward - backward) / (2.0 * NODE_PERTURBATION);
+
+            if (!check_derivative("dL/dx", sensitivities.node_gradients[0](c, k), reference, max_node_gradient, NODE_GRADIENT_TEST_TOLERANCE))
+                exit(1);
+        }
+    }
+
+    body->morph_surface(wing, nodes);
+
+    // Compare the freestream derivatives against full re-solves:
+    for (int c = 0; c < 3; c++) {
+        Vector3d perturbation(0, 0, 0);
+        perturbation(c) = VELOCITY_PERTURBATION;
+
+        solver.set_freestream_velocity(freestream_velocity + perturbation);
+        solver.solve();
+        double forward = force_component(solver, body, direction);
+
+        solver.set_freestream_velocity(freestream_velocity - perturbation);
+        solver.solve();
+        double backward = force_component(solver, body, direction);
+
+        double reference = (forward - backward) / (2.0 * VELOCITY_PERTURBATION);
+
+        if (!check_derivative("dL/dV", sensitivities.freestream_velocity(c), reference, sensitivities.freestream_velocity.norm(), FREESTREAM_TEST_TOLERANCE))
+            exit(1);
+    }
+
+    return 0;
+}
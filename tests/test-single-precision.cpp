@@ -0,0 +1,154 @@
+//
+// Vortexje -- Rectangular wing with NACA0012 airfoil.  Checks single precision influence coefficients with iterative
+// refinement against double precision.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <cmath>
+#include <iostream>
+
+#include <vortexje/solver.hpp>
+#include <vortexje/lifting-surface-builder.hpp>
+#include <vortexje/shape-generators/airfoils/naca4-airfoil-generator.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+static const double pi = 3.141592653589793238462643383279502884;
+
+#define DELTA_T     1e-2
+#define N_STEPS     8
+
+// Maximum doublet coefficient error, relative to the largest doublet coefficient, with iterative refinement:
+#define DOUBLET_TEST_TOLERANCE 1e-10
+
+// Create a rectangular wing:
+static shared_ptr<Body>
+create_wing()
+{
+    shared_ptr<LiftingSurface> wing(new LiftingSurface());
+
+    LiftingSurfaceBuilder surface_builder(*wing);
+
+    const double chord = 0.75;
+    const double span  = 4.5;
+
+    const int n_airfoils = 11;
+
+    const int n_points_per_airfoil = 24;
+
+    int trailing_edge_point_id;
+    vector<int> prev_airfoil_nodes;
+
+    vector<vector<int> > node_strips;
+    vector<vector<int> > panel_strips;
+
+    for (int i = 0; i < n_airfoils; i++) {
+        double z = -span / 2.0 + span * i / (double) (n_airfoils - 1);
+
+        vector<Vector3d, Eigen::aligned_allocator<Vector3d> > airfoil_points =
+            NACA4AirfoilGenerator::generate(0, 0, 0.12, true, chord, n_points_per_airfoil, trailing_edge_point_id);
+        for (int j = 0; j < (int) airfoil_points.size(); j++)
+            airfoil_points[j](2) += z;
+
+        vector<int> airfoil_nodes = surface_builder.create_nodes_for_points(airfoil_points);
+        node_strips.push_back(airfoil_nodes);
+
+        if (i > 0) {
+            vector<int> airfoil_panels = surface_builder.create_panels_between_shapes(airfoil_nodes, prev_airfoil_nodes, trailing_edge_point_id);
+            panel_strips.push_back(airfoil_panels);
+        }
+
+        prev_airfoil_nodes = airfoil_nodes;
+    }
+
+    surface_builder.finish(node_strips, panel_strips, trailing_edge_point_id);
+
+    // Rotate the span onto the y-axis, so that the wing lifts in the z-direction:
+    wing->rotate(Vector3d::UnitX(), -pi / 2.0);
+
+    // Create body:
+    shared_ptr<Body> body(new Body(string("wing")));
+    body->add_lifting_surface(wing);
+
+    return body;
+}
+
+// Run an unsteady simulation, and return the doublet coefficients of the wing:
+static VectorXd
+run_simulation(bool single_precision, int iterative_refinement_steps)
+{
+    Parameters::single_precision_influence_coefficients = single_precision;
+    Parameters::iterative_refinement_steps              = iterative_refinement_steps;
+
+    shared_ptr<Body> body = create_wing();
+
+    // Set up solver:
+    Solver solver("test-single-precision-log");
+    solver.add_body(body);
+
+    Vector3d freestream_velocity(30, 0, 3);
+    solver.set_freestream_velocity(freestream_velocity);
+
+    double fluid_density = 1.2;
+    solver.set_fluid_density(fluid_density);
+
+    // Run simulation:
+    solver.initialize_wakes(DELTA_T);
+
+    for (int step_number = 0; step_number < N_STEPS; step_number++) {
+        solver.solve(DELTA_T);
+
+        solver.update_wakes(DELTA_T);
+    }
+
+    Parameters::single_precision_influence_coefficients = false;
+    Parameters::iterative_refinement_steps              = 3;
+
+    // The wing is at rest, so that the surface velocity potential is the freestream potential minus the doublet
+    // coefficient:
+    const shared_ptr<Surface> &wing = body->lifting_surfaces[0]->surface;
+
+    VectorXd doublet_coefficients(wing->n_panels());
+    for (int i = 0; i < wing->n_panels(); i++)
+        doublet_coefficients(i) = freestream_velocity.dot(wing->panel_collocation_point(i, false)) - solver.surface_velocity_potential(wing, i);
+
+    return doublet_coefficients;
+}
+
+int
+main (int argc, char **argv)
+{
+    // Set up parameters for unsteady simulation:
+    Parameters::unsteady_bernoulli = true;
+    Parameters::convect_wake       = true;
+
+    // Double precision:
+    VectorXd mu_ref = run_simulation(false, 0);
+
+    // Single precision, without and with iterative refinement:
+    VectorXd mu_single  = run_simulation(true, 0);
+    VectorXd mu_refined = run_simulation(true, 3);
+
+    double error_single  = (mu_single - mu_ref).cwiseAbs().maxCoeff() / mu_ref.cwiseAbs().maxCoeff();
+    double error_refined = (mu_refined - mu_ref).cwiseAbs().maxCoeff() / mu_ref.cwiseAbs().maxCoeff();
+
+    cout << "Single precision: relative error = " << error_single << endl;
+    cout << "Single precision with iterative refinement: relative error = " << error_refined << endl;
+
+    // Iterative refinement must recover double precision accuracy:
+    if (error_refined > DOUBLET_TEST_TOLERANCE || error_refined >= error_single) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " Relative error without refinement = " << error_single << endl;
+        cerr << " Relative error with refinement = " << error_refined << endl;
+        cerr << " ******************* " << endl;
+
+        exit(1);
+    }
+
+    return 0;
+}
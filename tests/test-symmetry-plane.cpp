@@ -0,0 +1,180 @@
+//
+// Vortexje -- Rectangular wing with NACA0012 airfoil.  Checks the symmetry plane against the full wing.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <cmath>
+#include <iostream>
+
+#include <vortexje/solver.hpp>
+#include <vortexje/lifting-surface-builder.hpp>
+#include <vortexje/shape-generators/airfoils/naca4-airfoil-generator.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+static const double pi = 3.141592653589793238462643383279502884;
+
+#define DELTA_T     1e-2
+#define N_STEPS     8
+
+#define FORCE_TEST_TOLERANCE    1e-4
+#define VELOCITY_TEST_TOLERANCE 1e-6
+
+// Create a rectangular wing, with its airfoils stacked along the z-axis from z_min to z_min + span:
+static shared_ptr<Body>
+create_wing(double z_min, double span, int n_airfoils)
+{
+    shared_ptr<LiftingSurface> wing(new LiftingSurface());
+
+    LiftingSurfaceBuilder surface_builder(*wing);
+
+    const double chord = 0.75;
+
+    const int n_points_per_airfoil = 24;
+
+    int trailing_edge_point_id;
+    vector<int> prev_airfoil_nodes;
+
+    vector<vector<int> > node_strips;
+    vector<vector<int> > panel_strips;
+
+    for (int i = 0; i < n_airfoils; i++) {
+        double z = z_min + span * i / (double) (n_airfoils - 1);
+
+        vector<Vector3d, Eigen::aligned_allocator<Vector3d> > airfoil_points =
+            NACA4AirfoilGenerator::generate(0, 0, 0.12, true, chord, n_points_per_airfoil, trailing_edge_point_id);
+        for (int j = 0; j < (int) airfoil_points.size(); j++)
+            airfoil_points[j](2) += z;
+
+        vector<int> airfoil_nodes = surface_builder.create_nodes_for_points(airfoil_points);
+        node_strips.push_back(airfoil_nodes);
+
+        if (i > 0) {
+            vector<int> airfoil_panels = surface_builder.create_panels_between_shapes(airfoil_nodes, prev_airfoil_nodes, trailing_edge_point_id);
+            panel_strips.push_back(airfoil_panels);
+        }
+
+        prev_airfoil_nodes = airfoil_nodes;
+    }
+
+    surface_builder.finish(node_strips, panel_strips, trailing_edge_point_id);
+
+    // Rotate the span onto the y-axis, so that the wing lifts in the z-direction:
+    wing->rotate(Vector3d::UnitX(), -pi / 2.0);
+
+    // Create body:
+    shared_ptr<Body> body(new Body(string("wing")));
+    body->add_lifting_surface(wing);
+
+    return body;
+}
+
+// Run an unsteady simulation, and return the force on the wing and the velocity at a point in the flow:
+static void
+run_simulation(bool half, Vector3d &F, Vector3d &V)
+{
+    const double span = 4.5;
+
+    // Set up the symmetry plane:
+    Parameters::symmetry_plane = half;
+
+    shared_ptr<Body> body;
+    if (half)
+        body = create_wing(0.0, span / 2.0, 11);
+    else
+        body = create_wing(-span / 2.0, span, 21);
+
+    // Set up solver:
+    Solver solver("test-symmetry-plane-log");
+    solver.add_body(body);
+
+    Vector3d freestream_velocity(30, 0, 3);
+    solver.set_freestream_velocity(freestream_velocity);
+
+    double fluid_density = 1.2;
+    solver.set_fluid_density(fluid_density);
+
+    // Run simulation:
+    double dt = DELTA_T;
+
+    solver.initialize_wakes(dt);
+
+    for (int step_number = 0; step_number < N_STEPS; step_number++) {
+        solver.solve(dt);
+
+        solver.update_wakes(dt);
+    }
+
+    // Compute force.  Only the meshed half is integrated over when the symmetry plane is in use:
+    F = solver.force(body);
+    if (half)
+        F *= 2.0;
+
+    // Evaluate the velocity field off the plane, where the mirror images contribute:
+    V = solver.velocity(Vector3d(0.3, 0.5, 0.4));
+
+    Parameters::symmetry_plane = false;
+}
+
+// Run a test for a single kernel configuration:
+bool
+run_test(const char *name)
+{
+    Vector3d F_full, V_full;
+    run_simulation(false, F_full, V_full);
+
+    Vector3d F_half, V_half;
+    run_simulation(true, F_half, V_half);
+
+    cout << name << ": F(full) = " << F_full.transpose() << " N, F(half) = " << F_half.transpose() << " N" << endl;
+
+    // Compare the drag and lift, and the velocity field:
+    double F_error = max(fabs(F_half(0) - F_full(0)), fabs(F_half(2) - F_full(2))) / F_full.norm();
+    double V_error = (V_half - V_full).norm() / V_full.norm();
+
+    if (F_error > FORCE_TEST_TOLERANCE || V_error > VELOCITY_TEST_TOLERANCE) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " Configuration = " << name << endl;
+        cerr << " F(full) = " << F_full.transpose() << endl;
+        cerr << " F(half) = " << F_half.transpose() << endl;
+        cerr << " V(full) = " << V_full.transpose() << endl;
+        cerr << " V(half) = " << V_half.transpose() << endl;
+        cerr << " ******************* " << endl;
+
+        return false;
+    }
+
+    // Done.
+    return true;
+}
+
+int
+main (int argc, char **argv)
+{
+    // Set up parameters for unsteady simulation:
+    Parameters::unsteady_bernoulli = true;
+    Parameters::convect_wake       = true;
+
+    // Dense assembly, with direct wake node velocities:
+    if (!run_test("dense"))
+        exit(1);
+
+    // Hierarchical matrix assembly, using adaptive cross approximation:
+    Parameters::hierarchical_matrix_tolerance = 1e-8;
+    if (!run_test("hierarchical"))
+        exit(1);
+    Parameters::hierarchical_matrix_tolerance = 0.0;
+
+    // Treecode wake node velocities:
+    Parameters::treecode_opening_angle = 0.3;
+    if (!run_test("treecode"))
+        exit(1);
+    Parameters::treecode_opening_angle = 0.0;
+
+    return 0;
+}
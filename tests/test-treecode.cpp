@@ -0,0 +1,165 @@
+//
+// Vortexje -- Rectangular wing with NACA0012 airfoil.  Checks the treecode velocities at the wake nodes against the
+// direct sum.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <cmath>
+#include <iostream>
+
+#include <vortexje/solver.hpp>
+#include <vortexje/lifting-surface-builder.hpp>
+#include <vortexje/shape-generators/airfoils/naca4-airfoil-generator.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+static const double pi = 3.141592653589793238462643383279502884;
+
+#define DELTA_T     1e-2
+#define N_STEPS     30
+
+// Maximum velocity error at the wake nodes, relative to the maximum disturbance velocity, for an opening angle of 0.2:
+#define OPENING_ANGLE           0.2
+#define VELOCITY_TEST_TOLERANCE 5e-3
+
+// The expansions include the quadrupole terms, so halving the opening angle must reduce the error by at least this factor:
+#define CONVERGENCE_FACTOR      8.0
+
+// Create a rectangular wing:
+static shared_ptr<Body>
+create_wing()
+{
+    shared_ptr<LiftingSurface> wing(new LiftingSurface());
+
+    LiftingSurfaceBuilder surface_builder(*wing);
+
+    const double chord = 0.75;
+    const double span  = 4.5;
+
+    const int n_airfoils = 21;
+
+    const int n_points_per_airfoil = 24;
+
+    int trailing_edge_point_id;
+    vector<int> prev_airfoil_nodes;
+
+    vector<vector<int> > node_strips;
+    vector<vector<int> > panel_strips;
+
+    for (int i = 0; i < n_airfoils; i++) {
+        double z = -span / 2.0 + span * i / (double) (n_airfoils - 1);
+
+        vector<Vector3d, Eigen::aligned_allocator<Vector3d> > airfoil_points =
+            NACA4AirfoilGenerator::generate(0, 0, 0.12, true, chord, n_points_per_airfoil, trailing_edge_point_id);
+        for (int j = 0; j < (int) airfoil_points.size(); j++)
+            airfoil_points[j](2) += z;
+
+        vector<int> airfoil_nodes = surface_builder.create_nodes_for_points(airfoil_points);
+        node_strips.push_back(airfoil_nodes);
+
+        if (i > 0) {
+            vector<int> airfoil_panels = surface_builder.create_panels_between_shapes(airfoil_nodes, prev_airfoil_nodes, trailing_edge_point_id);
+            panel_strips.push_back(airfoil_panels);
+        }
+
+        prev_airfoil_nodes = airfoil_nodes;
+    }
+
+    surface_builder.finish(node_strips, panel_strips, trailing_edge_point_id);
+
+    // Rotate the span onto the y-axis, so that the wing lifts in the z-direction:
+    wing->rotate(Vector3d::UnitX(), -pi / 2.0);
+
+    // Create body:
+    shared_ptr<Body> body(new Body(string("wing")));
+    body->add_lifting_surface(wing);
+
+    return body;
+}
+
+// Compare the treecode velocities at the wake nodes, for the given opening angle, with the direct sum, and return the
+// maximum error relative to the maximum disturbance velocity:
+static double
+velocity_error(Solver &solver, const shared_ptr<Wake> &wake, double opening_angle)
+{
+    Matrix3Xd x(3, wake->n_nodes());
+    for (int i = 0; i < wake->n_nodes(); i++)
+        x.col(i) = wake->nodes[i];
+
+    solver.parameters.treecode_opening_angle = 0.0;
+
+    Matrix3Xd V_ref = solver.velocity(x);
+
+    solver.parameters.treecode_opening_angle = opening_angle;
+
+    Matrix3Xd V = solver.velocity(x);
+
+    solver.parameters.treecode_opening_angle = 0.0;
+
+    // Compare with the largest disturbance velocity:
+    double max_disturbance = 0.0, max_error = 0.0;
+    for (int i = 0; i < wake->n_nodes(); i++) {
+        max_disturbance = max(max_disturbance, (V_ref.col(i) - solver.freestream_velocity).norm());
+        max_error       = max(max_error, (V.col(i) - V_ref.col(i)).norm());
+    }
+
+    double error = max_error / max_disturbance;
+
+    cout << "Opening angle " << opening_angle << ": " << wake->n_nodes() << " wake nodes, relative error = " << error << endl;
+
+    return error;
+}
+
+int
+main (int argc, char **argv)
+{
+    // Set up parameters for unsteady simulation:
+    Parameters::unsteady_bernoulli = true;
+    Parameters::convect_wake       = true;
+
+    // Set up solver:
+    shared_ptr<Body> body = create_wing();
+
+    Solver solver("test-treecode-log");
+    solver.add_body(body);
+
+    Vector3d freestream_velocity(30, 0, 3);
+    solver.set_freestream_velocity(freestream_velocity);
+
+    double fluid_density = 1.2;
+    solver.set_fluid_density(fluid_density);
+
+    // Develop the wake, using the direct sum:
+    solver.initialize_wakes(DELTA_T);
+
+    for (int step_number = 0; step_number < N_STEPS; step_number++) {
+        solver.solve(DELTA_T);
+
+        solver.update_wakes(DELTA_T);
+    }
+
+    solver.solve(DELTA_T);
+
+    // Compare:
+    const shared_ptr<Wake> &wake = body->lifting_surfaces[0]->wake;
+
+    double error        = velocity_error(solver, wake, OPENING_ANGLE);
+    double error_halved = velocity_error(solver, wake, OPENING_ANGLE / 2.0);
+
+    // The far-field expansions must actually be in use, and converge:
+    if (error == 0.0 || error > VELOCITY_TEST_TOLERANCE || error_halved > error / CONVERGENCE_FACTOR) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " Opening angle = " << OPENING_ANGLE << ", relative error = " << error << endl;
+        cerr << " Opening angle = " << OPENING_ANGLE / 2.0 << ", relative error = " << error_halved << endl;
+        cerr << " ******************* " << endl;
+
+        exit(1);
+    }
+
+    return 0;
+}
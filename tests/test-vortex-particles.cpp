@@ -0,0 +1,191 @@
+//
+// Vortexje -- Rectangular wing with NACA0012 airfoil.  Checks that vortex particles induce the same velocity as the
+// wake panels they replace.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <cmath>
+#include <iostream>
+
+#include <vortexje/solver.hpp>
+#include <vortexje/lifting-surface-builder.hpp>
+#include <vortexje/shape-generators/airfoils/naca4-airfoil-generator.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+static const double pi = 3.141592653589793238462643383279502884;
+
+#define DELTA_T     1e-2
+#define N_STEPS     20
+
+#define N_CONVERTED_ROWS 2
+
+// Maximum velocity error at the collocation points of the wing, relative to the maximum velocity induced by the
+// converted wake panels:
+#define VELOCITY_TEST_TOLERANCE 5e-2
+
+// The vortex particles have the same total vorticity, and the same first moment of vorticity, as the panels they
+// replace.  Doubling the distance from the particles must therefore reduce the relative velocity error by at least
+// this factor:
+#define CONVERGENCE_FACTOR      2.0
+
+// Create a rectangular wing:
+static shared_ptr<Body>
+create_wing()
+{
+    shared_ptr<LiftingSurface> wing(new LiftingSurface());
+
+    LiftingSurfaceBuilder surface_builder(*wing);
+
+    const double chord = 0.75;
+    const double span  = 4.5;
+
+    const int n_airfoils = 11;
+
+    const int n_points_per_airfoil = 24;
+
+    int trailing_edge_point_id;
+    vector<int> prev_airfoil_nodes;
+
+    vector<vector<int> > node_strips;
+    vector<vector<int> > panel_strips;
+
+    for (int i = 0; i < n_airfoils; i++) {
+        double z = -span / 2.0 + span * i / (double) (n_airfoils - 1);
+
+        vector<Vector3d, Eigen::aligned_allocator<Vector3d> > airfoil_points =
+            NACA4AirfoilGenerator::generate(0, 0, 0.12, true, chord, n_points_per_airfoil, trailing_edge_point_id);
+        for (int j = 0; j < (int) airfoil_points.size(); j++)
+            airfoil_points[j](2) += z;
+
+        vector<int> airfoil_nodes = surface_builder.create_nodes_for_points(airfoil_points);
+        node_strips.push_back(airfoil_nodes);
+
+        if (i > 0) {
+            vector<int> airfoil_panels = surface_builder.create_panels_between_shapes(airfoil_nodes, prev_airfoil_nodes, trailing_edge_point_id);
+            panel_strips.push_back(airfoil_panels);
+        }
+
+        prev_airfoil_nodes = airfoil_nodes;
+    }
+
+    surface_builder.finish(node_strips, panel_strips, trailing_edge_point_id);
+
+    // Rotate the span onto the y-axis, so that the wing lifts in the z-direction:
+    wing->rotate(Vector3d::UnitX(), -pi / 2.0);
+
+    // Create body:
+    shared_ptr<Body> body(new Body(string("wing")));
+    body->add_lifting_surface(wing);
+
+    return body;
+}
+
+// Velocity induced by the given wake panels:
+static Matrix3Xd
+panel_velocities(const shared_ptr<Wake> &wake, int n_panels, const Matrix3Xd &x)
+{
+    Matrix3Xd velocities = Matrix3Xd::Zero(3, x.cols());
+    for (int i = 0; i < x.cols(); i++) {
+        for (int j = 0; j < n_panels; j++)
+            velocities.col(i) += wake->doublet_coefficients[j] * wake->vortex_ring_unit_velocity(x.col(i), j);
+    }
+
+    return velocities;
+}
+
+// Velocity induced by all vortex particles:
+static Matrix3Xd
+particle_velocities(const shared_ptr<Wake> &wake, const Matrix3Xd &x)
+{
+    Matrix3Xd velocities = Matrix3Xd::Zero(3, x.cols());
+    for (int i = 0; i < x.cols(); i++) {
+        for (int j = 0; j < wake->n_particles(); j++)
+            velocities.col(i) += wake->particle_velocity(x.col(i), j);
+    }
+
+    return velocities;
+}
+
+// Maximum velocity error, relative to the maximum reference velocity:
+static double
+velocity_error(const Matrix3Xd &V, const Matrix3Xd &V_ref)
+{
+    return (V - V_ref).colwise().norm().maxCoeff() / V_ref.colwise().norm().maxCoeff();
+}
+
+int
+main (int argc, char **argv)
+{
+    // Set up parameters for unsteady simulation:
+    Parameters::unsteady_bernoulli = true;
+    Parameters::convect_wake       = true;
+
+    shared_ptr<Body> body = create_wing();
+
+    // Set up solver:
+    Solver solver("test-vortex-particles-log");
+    solver.add_body(body);
+
+    Vector3d freestream_velocity(30, 0, 3);
+    solver.set_freestream_velocity(freestream_velocity);
+
+    double fluid_density = 1.2;
+    solver.set_fluid_density(fluid_density);
+
+    // Develop the wake:
+    solver.initialize_wakes(DELTA_T);
+
+    for (int step_number = 0; step_number < N_STEPS; step_number++) {
+        solver.solve(DELTA_T);
+
+        solver.update_wakes(DELTA_T);
+    }
+
+    const shared_ptr<LiftingSurface> &wing = body->lifting_surfaces[0]->lifting_surface;
+    const shared_ptr<Wake> &wake = body->lifting_surfaces[0]->wake;
+
+    // Evaluate the velocities at the collocation points of the wing, and at the nodes of two wake rows, the second of
+    // which is about twice as far from the converted rows as the first:
+    Matrix3Xd x_wing(3, wing->n_panels());
+    for (int i = 0; i < wing->n_panels(); i++)
+        x_wing.col(i) = wing->panel_collocation_point(i, false);
+
+    Matrix3Xd x_near(3, wing->n_spanwise_nodes()), x_far(3, wing->n_spanwise_nodes());
+    for (int i = 0; i < wing->n_spanwise_nodes(); i++) {
+        x_near.col(i) = wake->nodes[(N_CONVERTED_ROWS + 2) * wing->n_spanwise_nodes() + i];
+        x_far.col(i)  = wake->nodes[(N_CONVERTED_ROWS + 6) * wing->n_spanwise_nodes() + i];
+    }
+
+    int n_converted_panels = N_CONVERTED_ROWS * wing->n_spanwise_panels();
+
+    Matrix3Xd V_wing_ref = panel_velocities(wake, n_converted_panels, x_wing);
+    Matrix3Xd V_near_ref = panel_velocities(wake, n_converted_panels, x_near);
+    Matrix3Xd V_far_ref  = panel_velocities(wake, n_converted_panels, x_far);
+
+    // Convert:
+    wake->convert_rows_to_particles(N_CONVERTED_ROWS);
+
+    double wing_error = velocity_error(particle_velocities(wake, x_wing), V_wing_ref);
+    double near_error = velocity_error(particle_velocities(wake, x_near), V_near_ref);
+    double far_error  = velocity_error(particle_velocities(wake, x_far), V_far_ref);
+
+    cout << wake->n_particles() << " particles: relative error at the wing = " << wing_error << ", near = " << near_error
+         << ", far = " << far_error << endl;
+
+    if (wing_error > VELOCITY_TEST_TOLERANCE || far_error > near_error / CONVERGENCE_FACTOR) {
+        cerr << " *** TEST FAILED *** " << endl;
+        cerr << " Relative error at the wing = " << wing_error << endl;
+        cerr << " Relative error near = " << near_error << ", far = " << far_error << endl;
+        cerr << " ******************* " << endl;
+
+        exit(1);
+    }
+
+    return 0;
+}
@@ -0,0 +1,166 @@
+//
+// Vortexje -- Rectangular wing with NACA0012 airfoil.  Checks the convergence of the Runge-Kutta wake integration
+// schemes with the time step.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <cmath>
+#include <iostream>
+
+#include <vortexje/solver.hpp>
+#include <vortexje/lifting-surface-builder.hpp>
+#include <vortexje/shape-generators/airfoils/naca4-airfoil-generator.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+static const double pi = 3.141592653589793238462643383279502884;
+
+#define DELTA_T     1e-2
+#define N_STEPS     8
+
+// Over a single step of size h, the forward Euler method and Heun's method deviate from the classical fourth-order
+// method by O(h^2) and O(h^3), respectively.  Halving h must reduce these deviations by at least these factors:
+#define EULER_CONVERGENCE_FACTOR 3.5
+#define HEUN_CONVERGENCE_FACTOR  7.0
+
+// Create a rectangular wing:
+static shared_ptr<Body>
+create_wing()
+{
+    shared_ptr<LiftingSurface> wing(new LiftingSurface());
+
+    LiftingSurfaceBuilder surface_builder(*wing);
+
+    const double chord = 0.75;
+    const double span  = 4.5;
+
+    const int n_airfoils = 11;
+
+    const int n_points_per_airfoil = 24;
+
+    int trailing_edge_point_id;
+    vector<int> prev_airfoil_nodes;
+
+    vector<vector<int> > node_strips;
+    vector<vector<int> > panel_strips;
+
+    for (int i = 0; i < n_airfoils; i++) {
+        double z = -span / 2.0 + span * i / (double) (n_airfoils - 1);
+
+        vector<Vector3d, Eigen::aligned_allocator<Vector3d> > airfoil_points =
+            NACA4AirfoilGenerator::generate(0, 0, 0.12, true, chord, n_points_per_airfoil, trailing_edge_point_id);
+        for (int j = 0; j < (int) airfoil_points.size(); j++)
+            airfoil_points[j](2) += z;
+
+        vector<int> airfoil_nodes = surface_builder.create_nodes_for_points(airfoil_points);
+        node_strips.push_back(airfoil_nodes);
+
+        if (i > 0) {
+            vector<int> airfoil_panels = surface_builder.create_panels_between_shapes(airfoil_nodes, prev_airfoil_nodes, trailing_edge_point_id);
+            panel_strips.push_back(airfoil_panels);
+        }
+
+        prev_airfoil_nodes = airfoil_nodes;
+    }
+
+    surface_builder.finish(node_strips, panel_strips, trailing_edge_point_id);
+
+    // Rotate the span onto the y-axis, so that the wing lifts in the z-direction:
+    wing->rotate(Vector3d::UnitX(), -pi / 2.0);
+
+    // Create body:
+    shared_ptr<Body> body(new Body(string("wing")));
+    body->add_lifting_surface(wing);
+
+    return body;
+}
+
+// Develop the wake of a wing with the forward Euler method, and then update the wake once more, with a time step h
+// and the given integration order.  Return the positions of the nodes of the oldest row of the wake, which is far
+// enough from the wing for the velocity field to be smooth:
+static Matrix3Xd
+run_simulation(int wake_integration_order, double h)
+{
+    shared_ptr<Body> body = create_wing();
+
+    // Set up solver:
+    Solver solver("test-wake-integration-log");
+    solver.add_body(body);
+
+    Vector3d freestream_velocity(30, 0, 3);
+    solver.set_freestream_velocity(freestream_velocity);
+
+    double fluid_density = 1.2;
+    solver.set_fluid_density(fluid_density);
+
+    // Develop the wake:
+    solver.initialize_wakes(DELTA_T);
+
+    for (int step_number = 0; step_number < N_STEPS; step_number++) {
+        solver.solve(DELTA_T);
+
+        solver.update_wakes(DELTA_T);
+    }
+
+    // Update the wake using the given scheme:
+    solver.solve(DELTA_T);
+
+    solver.parameters.wake_integration_order = wake_integration_order;
+
+    solver.update_wakes(h);
+
+    const shared_ptr<Wake> &wake = body->lifting_surfaces[0]->wake;
+
+    int n_nodes = body->lifting_surfaces[0]->lifting_surface->n_spanwise_nodes();
+
+    Matrix3Xd x(3, n_nodes);
+    for (int i = 0; i < n_nodes; i++)
+        x.col(i) = wake->nodes[i];
+
+    return x;
+}
+
+int
+main (int argc, char **argv)
+{
+    // Set up parameters for unsteady simulation:
+    Parameters::unsteady_bernoulli = true;
+    Parameters::convect_wake       = true;
+
+    // Deviations of the forward Euler method and of Heun's method from the classical fourth-order method:
+    double prev_euler_deviation = 0.0, prev_heun_deviation = 0.0;
+
+    for (double h = 1e-2; h > 2e-3; h /= 2) {
+        Matrix3Xd x_euler = run_simulation(1, h);
+        Matrix3Xd x_heun  = run_simulation(2, h);
+        Matrix3Xd x_rk4   = run_simulation(4, h);
+
+        double euler_deviation = (x_euler - x_rk4).norm();
+        double heun_deviation  = (x_heun - x_rk4).norm();
+
+        cout << "h = " << h << ": |x(Euler) - x(RK4)| = " << euler_deviation << ", |x(Heun) - x(RK4)| = " << heun_deviation << endl;
+
+        // The schemes must differ, and converge:
+        if (euler_deviation == 0.0 || heun_deviation == 0.0 ||
+            (prev_euler_deviation > 0.0 &&
+             (euler_deviation > prev_euler_deviation / EULER_CONVERGENCE_FACTOR || heun_deviation > prev_heun_deviation / HEUN_CONVERGENCE_FACTOR))) {
+            cerr << " *** TEST FAILED *** " << endl;
+            cerr << " h = " << h << endl;
+            cerr << " |x(Euler) - x(RK4)| = " << euler_deviation << ", previous = " << prev_euler_deviation << endl;
+            cerr << " |x(Heun) - x(RK4)| = " << heun_deviation << ", previous = " << prev_heun_deviation << endl;
+            cerr << " ******************* " << endl;
+
+            exit(1);
+        }
+
+        prev_euler_deviation = euler_deviation;
+        prev_heun_deviation  = heun_deviation;
+    }
+
+    return 0;
+}
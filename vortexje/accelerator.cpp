@@ -0,0 +1,534 @@
+//
+// Vortexje -- Accelerator backend for the evaluation of panel influences.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <cmath>
+
+#include <vortexje/accelerator.hpp>
+#include <vortexje/parameters.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+// Number of values stored per panel in the flat buffers:
+#define TRANSFORMATION_SIZE    12
+#define TRANSFORMED_POINT_SIZE (2 * Surface::max_panel_nodes)
+#define NODE_SIZE              (3 * Surface::max_panel_nodes)
+
+// Device view of the flat panel buffers:
+struct PanelBuffers
+{
+    const int    *node_counts;
+    const double *transformations;
+    const double *transformed_points;
+    const double *nodes;
+    const double *centroids;
+    const double *surface_areas;
+    const double *second_moments;
+    const double *diameters;
+
+    double far_field_distance_factor;
+    double inversion_tolerance;
+};
+
+#ifdef VORTEXJE_OPENMP_OFFLOAD
+#pragma omp declare target
+#endif
+
+// Avoid having to divide by 4 pi all the time:
+static const double one_over_4pi = 1.0 / (4 * 3.141592653589793238462643383279502884);
+
+// Transforms a point into the panel coordinate system.  Returns true if the far-field approximations apply, in which
+// case r is set to the vector from the panel centroid to the point.
+static inline bool
+transform_point(const PanelBuffers &b, int panel, const double *x, double *x_normalized, double *r)
+{
+    const double *T = &b.transformations[TRANSFORMATION_SIZE * panel];
+
+    x_normalized[0] = T[0] * x[0] + T[1] * x[1] + T[2] * x[2] + T[9];
+    x_normalized[1] = T[3] * x[0] + T[4] * x[1] + T[5] * x[2] + T[10];
+    x_normalized[2] = T[6] * x[0] + T[7] * x[1] + T[8] * x[2] + T[11];
+
+    if (b.far_field_distance_factor <= 0)
+        return false;
+
+    const double *centroid = &b.centroids[3 * panel];
+
+    r[0] = x_normalized[0] - centroid[0];
+    r[1] = x_normalized[1] - centroid[1];
+    r[2] = x_normalized[2] - centroid[2];
+
+    double threshold = b.far_field_distance_factor * b.diameters[panel];
+
+    return r[0] * r[0] + r[1] * r[1] + r[2] * r[2] > threshold * threshold;
+}
+
+// Rotates a vector from the panel coordinate system back into the global coordinate system, and adds it to v:
+static inline void
+add_rotated_back(const PanelBuffers &b, int panel, const double *local, double scale, double *v)
+{
+    const double *T = &b.transformations[TRANSFORMATION_SIZE * panel];
+
+    v[0] += scale * (T[0] * local[0] + T[3] * local[1] + T[6] * local[2]);
+    v[1] += scale * (T[1] * local[0] + T[4] * local[1] + T[7] * local[2]);
+    v[2] += scale * (T[2] * local[0] + T[5] * local[1] + T[8] * local[2]);
+}
+
+// Computes the source and doublet influence, and the source velocity, of an edge of a panel, following Hess.  See
+// Surface::source_and_doublet_influence() and Surface::source_unit_velocity().
+static inline void
+edge_influence(const PanelBuffers &b, const double *x, const double *node_a, const double *node_b,
+               double *source_influence, double *doublet_influence, double *source_velocity)
+{
+    double d = sqrt((node_b[0] - node_a[0]) * (node_b[0] - node_a[0]) + (node_b[1] - node_a[1]) * (node_b[1] - node_a[1]));
+
+    if (d < b.inversion_tolerance)
+        return;
+
+    double z = x[2];
+
+    double m = (node_b[1] - node_a[1]) / (node_b[0] - node_a[0]);
+
+    double e1 = (x[0] - node_a[0]) * (x[0] - node_a[0]) + z * z;
+    double e2 = (x[0] - node_b[0]) * (x[0] - node_b[0]) + z * z;
+
+    double r1 = sqrt(e1 + (x[1] - node_a[1]) * (x[1] - node_a[1]));
+    double r2 = sqrt(e2 + (x[1] - node_b[1]) * (x[1] - node_b[1]));
+
+    double h1 = (x[0] - node_a[0]) * (x[1] - node_a[1]);
+    double h2 = (x[0] - node_b[0]) * (x[1] - node_b[1]);
+
+    // IEEE-754 floating point division by zero results in +/- inf, and atan(inf) = pi / 2.
+    double u = (m * e1 - h1) / (z * r1);
+    double v = (m * e2 - h2) / (z * r2);
+
+    double delta_theta;
+    if (u == v)
+        delta_theta = 0.0;
+    else
+        delta_theta = atan2(u - v, 1 + u * v);
+
+    double l = log((r1 + r2 + d) / (r1 + r2 - d));
+
+    if (source_influence != NULL)
+        *source_influence += ((x[0] - node_a[0]) * (node_b[1] - node_a[1]) - (x[1] - node_a[1]) * (node_b[0] - node_a[0])) / d * l - z * delta_theta;
+    if (doublet_influence != NULL)
+        *doublet_influence += delta_theta;
+    if (source_velocity != NULL) {
+        source_velocity[0] -= (node_b[1] - node_a[1]) / d * l;
+        source_velocity[1] -= (node_a[0] - node_b[0]) / d * l;
+        source_velocity[2] += delta_theta;
+    }
+}
+
+// Computes the potential influences of unit source and doublet panels.  See Surface::source_and_doublet_influence().
+static inline void
+panel_influence(const PanelBuffers &b, int panel, const double *x, double *source_influence, double *doublet_influence)
+{
+    double x_normalized[3], r[3];
+
+    if (transform_point(b, panel, x, x_normalized, r)) {
+        const double *J = &b.second_moments[3 * panel];
+
+        double area     = b.surface_areas[panel];
+        double r_sqnorm = r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+        double r_norm   = sqrt(r_sqnorm);
+
+        double rJr     = r[0] * r[0] * J[0] + 2 * r[0] * r[1] * J[1] + r[1] * r[1] * J[2];
+        double J_trace = J[0] + J[2];
+
+        *source_influence  =  one_over_4pi * (area / r_norm + (3 * rJr - r_sqnorm * J_trace) / (2 * r_sqnorm * r_sqnorm * r_norm));
+        *doublet_influence = -one_over_4pi * r[2] / (r_sqnorm * r_norm) * (area + 15 * rJr / (2 * r_sqnorm * r_sqnorm) - 3 * J_trace / (2 * r_sqnorm));
+
+        return;
+    }
+
+    double source = 0.0, doublet = 0.0;
+
+    const double *points = &b.transformed_points[TRANSFORMED_POINT_SIZE * panel];
+
+    int n = b.node_counts[panel];
+    for (int i = 0; i < n; i++) {
+        int next_idx = (i == n - 1) ? 0 : i + 1;
+
+        edge_influence(b, x_normalized, &points[2 * i], &points[2 * next_idx], &source, &doublet, NULL);
+    }
+
+    *source_influence  = -one_over_4pi * source;
+    *doublet_influence =  one_over_4pi * doublet;
+}
+
+// Computes the velocity induced by a panel with the given doublet and source strengths, and adds it to v.  See
+// Surface::vortex_ring_unit_velocity() and Surface::source_unit_velocity().
+static inline void
+panel_velocity(const PanelBuffers &b, int panel, const double *x, double doublet_coefficient, double source_coefficient, double *v)
+{
+    double x_normalized[3], r[3];
+
+    if (transform_point(b, panel, x, x_normalized, r)) {
+        double area     = b.surface_areas[panel];
+        double r_sqnorm = r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+        double r_norm   = sqrt(r_sqnorm);
+        double r_norm_3 = r_sqnorm * r_norm;
+
+        // Point doublet with moment -area times the normal, and point source:
+        double m = -area * doublet_coefficient;
+
+        double local[3];
+        for (int k = 0; k < 3; k++)
+            local[k] = (3 * m * r[2] * r[k] / r_sqnorm - (k == 2 ? m : 0.0) - area * source_coefficient * r[k]) / r_norm_3;
+
+        add_rotated_back(b, panel, local, one_over_4pi, v);
+
+        return;
+    }
+
+    int n = b.node_counts[panel];
+
+    // Vortex ring:
+    if (doublet_coefficient != 0.0) {
+        const double *nodes = &b.nodes[NODE_SIZE * panel];
+
+        double velocity[3] = { 0.0, 0.0, 0.0 };
+
+        for (int i = 0; i < n; i++) {
+            int previous_idx = (i == 0) ? n - 1 : i - 1;
+
+            const double *node_a = &nodes[3 * previous_idx];
+            const double *node_b = &nodes[3 * i];
+
+            double r_0[3], r_1[3], r_2[3];
+            for (int k = 0; k < 3; k++) {
+                r_0[k] = node_b[k] - node_a[k];
+                r_1[k] = node_a[k] - x[k];
+                r_2[k] = node_b[k] - x[k];
+            }
+
+            double r_1_norm = sqrt(r_1[0] * r_1[0] + r_1[1] * r_1[1] + r_1[2] * r_1[2]);
+            double r_2_norm = sqrt(r_2[0] * r_2[0] + r_2[1] * r_2[1] + r_2[2] * r_2[2]);
+
+            double r_1xr_2[3] = { r_1[1] * r_2[2] - r_1[2] * r_2[1],
+                                  r_1[2] * r_2[0] - r_1[0] * r_2[2],
+                                  r_1[0] * r_2[1] - r_1[1] * r_2[0] };
+            double r_1xr_2_sqnorm = r_1xr_2[0] * r_1xr_2[0] + r_1xr_2[1] * r_1xr_2[1] + r_1xr_2[2] * r_1xr_2[2];
+
+            if (r_1_norm < b.inversion_tolerance ||
+                r_2_norm < b.inversion_tolerance ||
+                r_1xr_2_sqnorm < b.inversion_tolerance)
+                continue;
+
+            double s = 0.0;
+            for (int k = 0; k < 3; k++)
+                s += r_0[k] * (r_1[k] / r_1_norm - r_2[k] / r_2_norm);
+
+            for (int k = 0; k < 3; k++)
+                velocity[k] += r_1xr_2[k] / r_1xr_2_sqnorm * s;
+        }
+
+        for (int k = 0; k < 3; k++)
+            v[k] += one_over_4pi * doublet_coefficient * velocity[k];
+    }
+
+    // Source panel:
+    if (source_coefficient != 0.0) {
+        const double *points = &b.transformed_points[TRANSFORMED_POINT_SIZE * panel];
+
+        double local[3] = { 0.0, 0.0, 0.0 };
+
+        for (int i = 0; i < n; i++) {
+            int next_idx = (i == n - 1) ? 0 : i + 1;
+
+            edge_influence(b, x_normalized, &points[2 * i], &points[2 * next_idx], NULL, NULL, local);
+        }
+
+        add_rotated_back(b, panel, local, one_over_4pi * source_coefficient, v);
+    }
+}
+
+#ifdef VORTEXJE_OPENMP_OFFLOAD
+#pragma omp end declare target
+#endif
+
+/**
+   Constructs an empty Accelerator.
+*/
+Accelerator::Accelerator() : uploaded(false)
+{
+}
+
+/**
+   Destructor.  Releases the device buffers.
+*/
+Accelerator::~Accelerator()
+{
+    release();
+}
+
+/**
+   Returns whether the kernels are offloaded to a device, i.e., whether Vortexje was built with VORTEXJE_OPENMP_OFFLOAD.
+
+   @returns true if the kernels are offloaded.
+*/
+bool
+Accelerator::offloading()
+{
+#ifdef VORTEXJE_OPENMP_OFFLOAD
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+   Copies the panel geometry of the given surface into the flat panel buffers.  The panels are numbered in the order
+   in which they are added.
+
+   @param[in]   surface   Surface to add.
+
+   @returns Number of the first panel of the surface.
+*/
+int
+Accelerator::add_surface(const shared_ptr<Surface> &surface)
+{
+    release();
+
+    int first_panel = n_panels();
+
+    for (int i = 0; i < surface->n_panels(); i++) {
+        panel_node_counts.push_back(surface->panel_node_counts[i]);
+
+        const Transform<double, 3, Affine> &transformation = surface->panel_coordinate_transformation(i);
+        for (int k = 0; k < 3; k++)
+            for (int l = 0; l < 3; l++)
+                panel_transformations.push_back(transformation.linear()(k, l));
+        for (int k = 0; k < 3; k++)
+            panel_transformations.push_back(transformation.translation()(k));
+
+        const int *single_panel_nodes = &surface->panel_node_table[Surface::max_panel_nodes * i];
+        for (int j = 0; j < Surface::max_panel_nodes; j++) {
+            panel_transformed_points.push_back(surface->panel_transformed_points[0](j, i));
+            panel_transformed_points.push_back(surface->panel_transformed_points[1](j, i));
+
+            for (int k = 0; k < 3; k++)
+                panel_nodes.push_back(surface->nodes[single_panel_nodes[j]](k));
+        }
+
+        for (int k = 0; k < 3; k++) {
+            panel_centroids.push_back(surface->panel_centroid(i)(k));
+            panel_second_moments.push_back(surface->panel_second_moment(i)(k));
+        }
+
+        panel_surface_areas.push_back(surface->panel_surface_area(i));
+        panel_diameters.push_back(surface->panel_diameter(i));
+    }
+
+    return first_panel;
+}
+
+/**
+   Uploads the flat panel buffers to the device.  This must be called after all surfaces were added, and before any
+   of the kernels is called.
+*/
+void
+Accelerator::upload()
+{
+    release();
+
+#ifdef VORTEXJE_OPENMP_OFFLOAD
+    int n = n_panels();
+
+    const int    *node_counts        = panel_node_counts.data();
+    const double *transformations    = panel_transformations.data();
+    const double *transformed_points = panel_transformed_points.data();
+    const double *nodes              = panel_nodes.data();
+    const double *centroids          = panel_centroids.data();
+    const double *surface_areas      = panel_surface_areas.data();
+    const double *second_moments     = panel_second_moments.data();
+    const double *diameters          = panel_diameters.data();
+
+    // GCC does not count the map clauses of the data directives as uses of the buffer pointers:
+    (void) node_counts; (void) transformations; (void) transformed_points; (void) nodes;
+    (void) centroids; (void) surface_areas; (void) second_moments; (void) diameters;
+
+    #pragma omp target enter data map(to: node_counts[0:n], transformations[0:TRANSFORMATION_SIZE * n], \
+                                          transformed_points[0:TRANSFORMED_POINT_SIZE * n], nodes[0:NODE_SIZE * n], \
+                                          centroids[0:3 * n], surface_areas[0:n], second_moments[0:3 * n], diameters[0:n])
+#endif
+
+    uploaded = true;
+}
+
+// Releases the device buffers, if any.
+void
+Accelerator::release()
+{
+    if (!uploaded)
+        return;
+
+#ifdef VORTEXJE_OPENMP_OFFLOAD
+    int n = n_panels();
+
+    const int    *node_counts        = panel_node_counts.data();
+    const double *transformations    = panel_transformations.data();
+    const double *transformed_points = panel_transformed_points.data();
+    const double *nodes              = panel_nodes.data();
+    const double *centroids          = panel_centroids.data();
+    const double *surface_areas      = panel_surface_areas.data();
+    const double *second_moments     = panel_second_moments.data();
+    const double *diameters          = panel_diameters.data();
+
+    // See upload():
+    (void) node_counts; (void) transformations; (void) transformed_points; (void) nodes;
+    (void) centroids; (void) surface_areas; (void) second_moments; (void) diameters;
+
+    #pragma omp target exit data map(delete: node_counts[0:n], transformations[0:TRANSFORMATION_SIZE * n], \
+                                             transformed_points[0:TRANSFORMED_POINT_SIZE * n], nodes[0:NODE_SIZE * n], \
+                                             centroids[0:3 * n], surface_areas[0:n], second_moments[0:3 * n], diameters[0:n])
+#endif
+
+    uploaded = false;
+}
+
+/**
+   Computes the potential influence coefficients of unit source and doublet panels, for a range of panels and a set
+   of points.
+
+   @param[in]   x                   Points at which the influence coefficients are evaluated, one per column.
+   @param[in]   first_panel         First panel of the range.
+   @param[in]   n_panels            Number of panels in the range.
+   @param[out]  source_influence    Source influence coefficients, one row per point, and one column per panel.
+   @param[out]  doublet_influence   Doublet influence coefficients, one row per point, and one column per panel.
+*/
+void
+Accelerator::influence_coefficients(const Eigen::Matrix3Xd &x, int first_panel, int n_panels,
+                                    Eigen::MatrixXd &source_influence, Eigen::MatrixXd &doublet_influence) const
+{
+    int n_points = x.cols();
+
+    source_influence.resize(n_points, n_panels);
+    doublet_influence.resize(n_points, n_panels);
+
+    const double *points  = x.data();
+    double       *source  = source_influence.data();
+    double       *doublet = doublet_influence.data();
+
+    const int    *node_counts        = panel_node_counts.data();
+    const double *transformations    = panel_transformations.data();
+    const double *transformed_points = panel_transformed_points.data();
+    const double *nodes              = panel_nodes.data();
+    const double *centroids          = panel_centroids.data();
+    const double *surface_areas      = panel_surface_areas.data();
+    const double *second_moments     = panel_second_moments.data();
+    const double *diameters          = panel_diameters.data();
+
+    double far_field_distance_factor = Parameters::far_field_distance_factor;
+    double inversion_tolerance       = Parameters::inversion_tolerance;
+
+#ifdef VORTEXJE_OPENMP_OFFLOAD
+    int n = this->n_panels();
+#endif
+
+    int j;
+
+#ifdef VORTEXJE_OPENMP_OFFLOAD
+    #pragma omp target teams distribute \
+        map(to: points[0:3 * n_points]) map(from: source[0:n_points * n_panels], doublet[0:n_points * n_panels]) \
+        map(to: node_counts[0:n], transformations[0:TRANSFORMATION_SIZE * n], \
+                transformed_points[0:TRANSFORMED_POINT_SIZE * n], nodes[0:NODE_SIZE * n], \
+                centroids[0:3 * n], surface_areas[0:n], second_moments[0:3 * n], diameters[0:n])
+    for (j = 0; j < n_panels; j++) {
+#else
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(dynamic, 1)
+        for (j = 0; j < n_panels; j++) {
+#endif
+            PanelBuffers b = { node_counts, transformations, transformed_points, nodes,
+                               centroids, surface_areas, second_moments, diameters,
+                               far_field_distance_factor, inversion_tolerance };
+
+#ifdef VORTEXJE_OPENMP_OFFLOAD
+            #pragma omp parallel for
+#endif
+            for (int i = 0; i < n_points; i++)
+                panel_influence(b, first_panel + j, &points[3 * i], &source[j * n_points + i], &doublet[j * n_points + i]);
+        }
+#ifndef VORTEXJE_OPENMP_OFFLOAD
+    }
+#endif
+}
+
+/**
+   Computes the velocity induced by all panels in this accelerator, with the given singularity strengths, at a set of
+   points.
+
+   @param[in]   x                      Points at which the velocity is evaluated, one per column.
+   @param[in]   doublet_coefficients   Doublet panel, or vortex ring, strengths, one per panel.
+   @param[in]   source_coefficients    Source panel strengths, one per panel.
+   @param[out]  velocities             Induced velocities, one per column.
+*/
+void
+Accelerator::velocities(const Eigen::Matrix3Xd &x, const Eigen::VectorXd &doublet_coefficients, const Eigen::VectorXd &source_coefficients,
+                        Eigen::Matrix3Xd &velocities) const
+{
+    int n_points = x.cols();
+
+    velocities.resize(3, n_points);
+
+    const double *points  = x.data();
+    const double *doublet = doublet_coefficients.data();
+    const double *source  = source_coefficients.data();
+    double       *v       = velocities.data();
+
+    const int    *node_counts        = panel_node_counts.data();
+    const double *transformations    = panel_transformations.data();
+    const double *transformed_points = panel_transformed_points.data();
+    const double *nodes              = panel_nodes.data();
+    const double *centroids          = panel_centroids.data();
+    const double *surface_areas      = panel_surface_areas.data();
+    const double *second_moments     = panel_second_moments.data();
+    const double *diameters          = panel_diameters.data();
+
+    double far_field_distance_factor = Parameters::far_field_distance_factor;
+    double inversion_tolerance       = Parameters::inversion_tolerance;
+
+    int n = n_panels();
+
+    int i;
+
+#ifdef VORTEXJE_OPENMP_OFFLOAD
+    #pragma omp target teams distribute parallel for \
+        map(to: points[0:3 * n_points], doublet[0:n], source[0:n]) map(from: v[0:3 * n_points]) \
+        map(to: node_counts[0:n], transformations[0:TRANSFORMATION_SIZE * n], \
+                transformed_points[0:TRANSFORMED_POINT_SIZE * n], nodes[0:NODE_SIZE * n], \
+                centroids[0:3 * n], surface_areas[0:n], second_moments[0:3 * n], diameters[0:n])
+    for (i = 0; i < n_points; i++) {
+#else
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(dynamic, 1)
+        for (i = 0; i < n_points; i++) {
+#endif
+            PanelBuffers b = { node_counts, transformations, transformed_points, nodes,
+                               centroids, surface_areas, second_moments, diameters,
+                               far_field_distance_factor, inversion_tolerance };
+
+            double velocity[3] = { 0.0, 0.0, 0.0 };
+
+            for (int j = 0; j < n; j++) {
+                if (doublet[j] != 0.0 || source[j] != 0.0)
+                    panel_velocity(b, j, &points[3 * i], doublet[j], source[j], velocity);
+            }
+
+            for (int k = 0; k < 3; k++)
+                v[3 * i + k] = velocity[k];
+        }
+#ifndef VORTEXJE_OPENMP_OFFLOAD
+    }
+#endif
+}
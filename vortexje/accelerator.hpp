@@ -0,0 +1,80 @@
+//
+// Vortexje -- Accelerator backend for the evaluation of panel influences.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#ifndef __ACCELERATOR_HPP__
+#define __ACCELERATOR_HPP__
+
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <vortexje/surface.hpp>
+
+namespace Vortexje
+{
+
+/**
+   Accelerator backend for the evaluation of potential influence coefficients and induced velocities of large numbers
+   of source and doublet panels.
+
+   The panel geometry of the added surfaces is copied into flat arrays, which are uploaded to the device once, and
+   then shared by all subsequent evaluations.  The kernels are expressed as OpenMP target regions.  If Vortexje is
+   built with VORTEXJE_OPENMP_OFFLOAD, these are offloaded to the default device (e.g., a GPU).  Otherwise, they are
+   executed on the host, using regular OpenMP threads.
+
+   The kernels implement the panel influences of the Surface base class.  Surfaces that override these, such as
+   the RamasamyLeishmanWake, must not be added.
+
+   @brief Accelerator backend.
+*/
+class Accelerator
+{
+public:
+    Accelerator();
+
+    ~Accelerator();
+
+    static bool offloading();
+
+    int add_surface(const std::shared_ptr<Surface> &surface);
+
+    void upload();
+
+    void influence_coefficients(const Eigen::Matrix3Xd &x, int first_panel, int n_panels,
+                                Eigen::MatrixXd &source_influence, Eigen::MatrixXd &doublet_influence) const;
+
+    void velocities(const Eigen::Matrix3Xd &x, const Eigen::VectorXd &doublet_coefficients, const Eigen::VectorXd &source_coefficients,
+                    Eigen::Matrix3Xd &velocities) const;
+
+    /**
+       Returns the number of panels in this accelerator.
+
+       @returns Number of panels.
+    */
+    int n_panels() const { return (int) panel_node_counts.size(); }
+
+private:
+    // Flat panel buffers, one entry per panel, or per panel node:
+    std::vector<int>    panel_node_counts;
+    std::vector<double> panel_transformations;
+    std::vector<double> panel_transformed_points;
+    std::vector<double> panel_nodes;
+    std::vector<double> panel_centroids;
+    std::vector<double> panel_surface_areas;
+    std::vector<double> panel_second_moments;
+    std::vector<double> panel_diameters;
+
+    bool uploaded;
+
+    void release();
+};
+
+};
+
+#endif // __ACCELERATOR_HPP__
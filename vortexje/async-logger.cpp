@@ -0,0 +1,121 @@
+//
+// Vortexje -- Asynchronous logger.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <algorithm>
+
+#include <vortexje/async-logger.hpp>
+#include <vortexje/distributed.hpp>
+
+using namespace std;
+using namespace Vortexje;
+
+/**
+   Constructs an AsyncLogger, and starts its background thread.
+   
+   @param[in]   solver             Solver whose state to log.
+   @param[in]   writer             SurfaceWriter object to use.
+   @param[in]   max_queue_length   Maximum number of snapshots waiting to be written.
+*/
+AsyncLogger::AsyncLogger(const Solver &solver, SurfaceWriter &writer, int max_queue_length) :
+    solver(solver), writer(writer), max_queue_length(max(max_queue_length, 1)), writing(false), stopping(false)
+{
+    thread = std::thread(&AsyncLogger::run, this);
+}
+
+/**
+   Destructor.  Writes all queued snapshots, and stops the background thread.
+*/
+AsyncLogger::~AsyncLogger()
+{
+    {
+        unique_lock<std::mutex> lock(mutex);
+        
+        stopping = true;
+    }
+    
+    queue_changed.notify_all();
+    
+    thread.join();
+}
+
+/**
+   Takes a snapshot of the source and doublet distributions, as well as the pressure coefficients, and queues it for
+   writing into files in the logging folder tagged with the specified step number.  Blocks if the queue is full.
+   This also closes the current step of the profiler of the solver.
+   
+   @param[in]   step_number   Step number used to name the output files.
+*/
+void
+AsyncLogger::log(int step_number)
+{
+    // In distributed mode, the replicated results are logged by the first process only:
+    if (Distributed::rank() == 0) {
+        Profiler::Timer timer(solver.profiler, "log");
+        
+        shared_ptr<Solver::LogSnapshot> snapshot = make_shared<Solver::LogSnapshot>();
+        solver.log_snapshot(step_number, writer, true, *snapshot);
+        
+        unique_lock<std::mutex> lock(mutex);
+        
+        while ((int) queue.size() >= max_queue_length)
+            queue_changed.wait(lock);
+            
+        queue.push_back(snapshot);
+        
+        lock.unlock();
+        
+        queue_changed.notify_all();
+    }
+    
+    // Close the current step of the profiler:
+    solver.profiler->end_step(step_number);
+}
+
+/**
+   Waits until all queued snapshots have been written.
+*/
+void
+AsyncLogger::flush()
+{
+    unique_lock<std::mutex> lock(mutex);
+    
+    while (queue.size() > 0 || writing)
+        queue_changed.wait(lock);
+}
+
+// Background thread:
+void
+AsyncLogger::run()
+{
+    unique_lock<std::mutex> lock(mutex);
+    
+    while (true) {
+        while (queue.size() == 0 && !stopping)
+            queue_changed.wait(lock);
+            
+        if (queue.size() == 0)
+            break;
+            
+        shared_ptr<Solver::LogSnapshot> snapshot = queue.front();
+        queue.pop_front();
+        
+        writing = true;
+        
+        lock.unlock();
+        
+        queue_changed.notify_all();
+        
+        Solver::write_log_snapshot(*snapshot, writer);
+        
+        lock.lock();
+        
+        writing = false;
+        
+        queue_changed.notify_all();
+    }
+}
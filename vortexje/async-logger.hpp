@@ -0,0 +1,71 @@
+//
+// Vortexje -- Asynchronous logger.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#ifndef __ASYNC_LOGGER_HPP__
+#define __ASYNC_LOGGER_HPP__
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <vortexje/solver.hpp>
+#include <vortexje/surface-writer.hpp>
+
+namespace Vortexje
+{
+
+/**
+   Asynchronous replacement for Solver::log().
+   
+   log() takes a snapshot of the coefficient vectors and of the surface and wake geometry, and queues it.  The
+   snapshots are formatted and written to disk by a background thread, while the solver continues with the next time
+   step.  log() only blocks if the queue is full.
+   
+   The SurfaceWriter is used by the background thread, and must not be used elsewhere for as long as the logger
+   exists.
+   
+   @brief Asynchronous logger.
+*/
+class AsyncLogger
+{
+public:
+    AsyncLogger(const Solver &solver, SurfaceWriter &writer, int max_queue_length = 2);
+    
+    ~AsyncLogger();
+    
+    void log(int step_number);
+    
+    void flush();
+    
+private:
+    const Solver &solver;
+    
+    SurfaceWriter &writer;
+    
+    int max_queue_length;
+    
+    std::deque<std::shared_ptr<Solver::LogSnapshot> > queue;
+    
+    bool writing;
+    
+    bool stopping;
+    
+    std::mutex mutex;
+    
+    std::condition_variable queue_changed;
+    
+    std::thread thread;
+    
+    void run();
+};
+
+};
+
+#endif // __ASYNC_LOGGER_HPP__
@@ -28,6 +28,9 @@ Body::Body(const string &id) : id(id)
     
     attitude = Quaterniond(1, 0, 0, 0);
     rotational_velocity = Vector3d(0, 0, 0);
+    
+    // No adjacency table yet:
+    adjacency_revision = 0;
 }
 
 /**
@@ -108,14 +111,11 @@ Body::panel_neighbors(const shared_ptr<Surface> &surface, int panel) const
     vector<SurfacePanelEdge> neighbors;
     
     // List in-surface neighbors:
-    for (int i = 0; i < (int) surface->panel_nodes[panel].size(); i++) {
-        map<int, pair<int, int> >::const_iterator isit = surface->panel_neighbors[panel].find(i);
-        if (isit != surface->panel_neighbors[panel].end())
-            neighbors.push_back(SurfacePanelEdge(surface, isit->second.first, isit->second.second));           
-    }
+    for (int i = surface->panel_neighbor_offsets[panel]; i < surface->panel_neighbor_offsets[panel + 1]; i++)
+        neighbors.push_back(SurfacePanelEdge(surface, surface->panel_neighbor_panels[i], surface->panel_neighbor_panel_edges[i]));
     
     // List stitches:
-    for (int i = 0; i < (int) surface->panel_nodes[panel].size(); i++) {
+    for (int i = 0; i < surface->panel_node_counts[panel]; i++) {
         map<SurfacePanelEdge, SurfacePanelEdge, CompareSurfacePanelEdge>::const_iterator it =
             stitches.find(SurfacePanelEdge(surface, panel, i));
         if (it != stitches.end())
@@ -141,9 +141,10 @@ Body::panel_neighbors(const shared_ptr<Surface> &surface, int panel, int edge) c
     vector<SurfacePanelEdge> neighbors;
     
     // List in-surface neighbor:
-    map<int, pair<int, int> >::const_iterator isit = surface->panel_neighbors[panel].find(edge);
-    if (isit != surface->panel_neighbors[panel].end())
-        neighbors.push_back(SurfacePanelEdge(surface, isit->second.first, isit->second.second));
+    int neighbor_edge;
+    int neighbor = surface->panel_neighbor(panel, edge, neighbor_edge);
+    if (neighbor >= 0)
+        neighbors.push_back(SurfacePanelEdge(surface, neighbor, neighbor_edge));
     
     // List stitches:
     map<SurfacePanelEdge, SurfacePanelEdge, CompareSurfacePanelEdge>::const_iterator it =
@@ -158,6 +159,154 @@ Body::panel_neighbors(const shared_ptr<Surface> &surface, int panel, int edge) c
     return neighbors;
 }
 
+/**
+   Builds the panel adjacency table, which lists the in-surface and across-surface (stitched) neighbors of all panels
+   of this body in compressed sparse row format.  The table is a snapshot:  it must be rebuilt after surfaces are added,
+   panels are stitched, or the topology of a surface is modified.  The Solver does so upon adding the body, and at
+   the start of every solve.  The adjacency revision is incremented if the table changed.
+*/
+void
+Body::compute_adjacency()
+{
+    vector<shared_ptr<Surface> > new_adjacency_surfaces;
+    
+    vector<shared_ptr<SurfaceData> >::const_iterator si;
+    for (si = non_lifting_surfaces.begin(); si != non_lifting_surfaces.end(); si++)
+        new_adjacency_surfaces.push_back((*si)->surface);
+        
+    vector<shared_ptr<LiftingSurfaceData> >::const_iterator lsi;
+    for (lsi = lifting_surfaces.begin(); lsi != lifting_surfaces.end(); lsi++)
+        new_adjacency_surfaces.push_back((*lsi)->surface);
+        
+    // Keep the current table for comparison:
+    vector<int> old_adjacency_surface_offsets, old_adjacency_offsets;
+    vector<PanelNeighbor> old_adjacency;
+    
+    old_adjacency_surface_offsets.swap(adjacency_surface_offsets);
+    old_adjacency_offsets.swap(adjacency_offsets);
+    old_adjacency.swap(adjacency);
+    
+    bool surfaces_changed = (new_adjacency_surfaces != adjacency_surfaces);
+    
+    adjacency_surfaces.swap(new_adjacency_surfaces);
+    
+    adjacency_surface_offsets.resize(adjacency_surfaces.size() + 1);
+    adjacency_surface_offsets[0] = 0;
+    for (int i = 0; i < (int) adjacency_surfaces.size(); i++)
+        adjacency_surface_offsets[i + 1] = adjacency_surface_offsets[i] + adjacency_surfaces[i]->n_panels();
+        
+    adjacency_offsets.reserve(adjacency_surface_offsets.back() + 1);
+    adjacency.reserve(old_adjacency.size());
+    
+    for (int i = 0; i < (int) adjacency_surfaces.size(); i++) {
+        const shared_ptr<Surface> &surface = adjacency_surfaces[i];
+        
+        for (int j = 0; j < surface->n_panels(); j++) {
+            adjacency_offsets.push_back(adjacency.size());
+            
+            // In-surface neighbors:
+            for (int k = surface->panel_neighbor_offsets[j]; k < surface->panel_neighbor_offsets[j + 1]; k++) {
+                PanelNeighbor neighbor;
+                neighbor.surface        = i;
+                neighbor.panel          = surface->panel_neighbor_panels[k];
+                neighbor.edge           = surface->panel_neighbor_panel_edges[k];
+                neighbor.reference_edge = surface->panel_neighbor_edges[k];
+                
+                adjacency.push_back(neighbor);
+            }
+            
+            // Stitches:
+            if (stitches.empty())
+                continue;
+                
+            for (int k = 0; k < surface->panel_node_counts[j]; k++) {
+                map<SurfacePanelEdge, SurfacePanelEdge, CompareSurfacePanelEdge>::const_iterator it =
+                    stitches.find(SurfacePanelEdge(surface, j, k));
+                if (it == stitches.end())
+                    continue;
+                    
+                PanelNeighbor neighbor;
+                neighbor.surface        = surface_index(it->second.surface.get());
+                neighbor.panel          = it->second.panel;
+                neighbor.edge           = it->second.edge;
+                neighbor.reference_edge = k;
+                
+                assert(neighbor.surface >= 0);
+                    
+                adjacency.push_back(neighbor);
+            }
+        }
+    }
+    
+    adjacency_offsets.push_back(adjacency.size());
+    
+    if (surfaces_changed || adjacency_surface_offsets != old_adjacency_surface_offsets ||
+        adjacency_offsets != old_adjacency_offsets || adjacency != old_adjacency)
+        adjacency_revision++;
+}
+
+/**
+   Returns the index of the given surface in the panel adjacency table.
+   
+   @param[in]   surface   Reference surface.
+   
+   @returns Surface index, or -1 if the surface is not part of the table.
+*/
+int
+Body::surface_index(const Surface *surface) const
+{
+    for (int i = 0; i < (int) adjacency_surfaces.size(); i++) {
+        if (adjacency_surfaces[i].get() == surface)
+            return i;
+    }
+    
+    return -1;
+}
+
+/**
+   Lists both in-surface and across-surface (stitched) neighbors of the given panel, from the panel adjacency table.
+   The in-surface neighbors come first.
+   
+   @param[in]   surface_index   Reference surface index.
+   @param[in]   panel           Reference panel.
+   @param[out]  n_neighbors     Number of neighbors.
+   
+   @returns Pointer to the first neighbor.
+*/
+const Body::PanelNeighbor *
+Body::panel_neighbors(int surface_index, int panel, int &n_neighbors) const
+{
+    int index = adjacency_surface_offsets[surface_index] + panel;
+    
+    n_neighbors = adjacency_offsets[index + 1] - adjacency_offsets[index];
+    
+    return adjacency.data() + adjacency_offsets[index];
+}
+
+/**
+   Returns the in-surface or across-surface (stitched) neighbor of the given panel and edge, from the panel adjacency
+   table.
+   
+   @param[in]   surface_index   Reference surface index.
+   @param[in]   panel           Reference panel.
+   @param[in]   edge            Reference edge.
+   
+   @returns Pointer to the neighbor, or NULL if the edge has no neighbor.
+*/
+const Body::PanelNeighbor *
+Body::panel_neighbor(int surface_index, int panel, int edge) const
+{
+    int n_neighbors;
+    const PanelNeighbor *neighbors = panel_neighbors(surface_index, panel, n_neighbors);
+    
+    for (int i = 0; i < n_neighbors; i++) {
+        if (neighbors[i].reference_edge == edge)
+            return &neighbors[i];
+    }
+    
+    return NULL;
+}
+
 /**
    Sets the linear position of this body.
    
@@ -222,6 +371,55 @@ Body::set_attitude(const Quaterniond &attitude)
     this->attitude = attitude;
 }
 
+/**
+   Moves the nodes of a surface of this body to new positions, keeping its topology.  Only the panel geometry is
+   recomputed, and the wake of a lifting surface stays attached to the moved trailing edge.  Solvers detect the new
+   geometry through the geometry revisions of the surfaces, and only recompute the affected blocks of influence
+   coefficients upon the next solve.  The positions are given in the current, world frame.
+   
+   @param[in]   surface   Surface to morph.
+   @param[in]   nodes     New node positions, one per node of the surface.
+   
+   @returns true on success.
+*/
+bool
+Body::morph_surface(const std::shared_ptr<Surface> &surface, const vector<Vector3d, Eigen::aligned_allocator<Vector3d> > &nodes)
+{
+    vector<shared_ptr<LiftingSurfaceData> >::iterator lsi;
+    for (lsi = lifting_surfaces.begin(); lsi != lifting_surfaces.end(); lsi++) {
+        shared_ptr<LiftingSurfaceData> d = *lsi;
+        if (d->surface.get() != surface.get())
+            continue;
+            
+        // Keep the trailing edge positions, so that the wake can follow:
+        int n_spanwise_nodes = d->lifting_surface->n_spanwise_nodes();
+        
+        vector<Vector3d, Eigen::aligned_allocator<Vector3d> > displacements(n_spanwise_nodes);
+        for (int k = 0; k < n_spanwise_nodes; k++)
+            displacements[k] = -d->lifting_surface->nodes[d->lifting_surface->trailing_edge_node(k)];
+            
+        if (!surface->set_nodes(nodes))
+            return false;
+            
+        for (int k = 0; k < n_spanwise_nodes; k++)
+            displacements[k] += d->lifting_surface->nodes[d->lifting_surface->trailing_edge_node(k)];
+            
+        d->wake->displace_trailing_edge(displacements);
+        
+        return true;
+    }
+    
+    vector<shared_ptr<SurfaceData> >::iterator si;
+    for (si = non_lifting_surfaces.begin(); si != non_lifting_surfaces.end(); si++) {
+        if ((*si)->surface.get() == surface.get())
+            return surface->set_nodes(nodes);
+    }
+    
+    VORTEXJE_LOG(surface->logger, Logger::Error, "Body " << id << ": Surface " << surface->id << " not found.");
+        
+    return false;
+}
+
 /**
    Sets the linear velocity of this body.
    
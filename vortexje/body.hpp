@@ -162,6 +162,72 @@ public:
     
     std::vector<SurfacePanelEdge> panel_neighbors(const std::shared_ptr<Surface> &surface, int panel, int edge) const;
     
+    /**
+       Entry of the panel adjacency table.  Identifies a neighboring panel by surface index, panel ID, and edge
+       number, together with the edge of the reference panel that it borders on.
+       
+       @brief Panel adjacency table entry.
+    */
+    class PanelNeighbor {
+    public:
+        /**
+           Surface index, as returned by surface_index().
+        */
+        int surface;
+        
+        /**
+           Panel ID.
+        */
+        int panel;
+        
+        /**
+           Edge ID.
+        */
+        int edge;
+        
+        /**
+           Edge ID of the reference panel.
+        */
+        int reference_edge;
+        
+        /**
+           Equality operator.
+        */
+        bool operator==(const PanelNeighbor &other) const
+        {
+            return (surface == other.surface) && (panel == other.panel) && (edge == other.edge) && (reference_edge == other.reference_edge);
+        }
+    };
+    
+    /**
+       Revision number of the panel adjacency table.  Incremented whenever compute_adjacency() changes the table.
+    */
+    int adjacency_revision;
+    
+    void compute_adjacency();
+    
+    /**
+       Returns the number of surfaces in the panel adjacency table.
+       
+       @returns Number of surfaces.
+    */
+    int n_surfaces() const { return (int) adjacency_surfaces.size(); }
+    
+    /**
+       Returns the surface with the given index in the panel adjacency table.
+       
+       @param[in]   index   Surface index.
+       
+       @returns Surface object.
+    */
+    const std::shared_ptr<Surface> &surface(int index) const { return adjacency_surfaces[index]; }
+    
+    int surface_index(const Surface *surface) const;
+    
+    const PanelNeighbor *panel_neighbors(int surface_index, int panel, int &n_neighbors) const;
+    
+    const PanelNeighbor *panel_neighbor(int surface_index, int panel, int edge) const;
+    
     /**
        Linear position of the entire body.
     */
@@ -185,6 +251,8 @@ public:
     void set_position(const Eigen::Vector3d &position);
     void set_attitude(const Eigen::Quaterniond &attitude);
     
+    bool morph_surface(const std::shared_ptr<Surface> &surface, const std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > &nodes);
+    
     void set_velocity(const Eigen::Vector3d &velocity);
     void set_rotational_velocity(const Eigen::Vector3d &rotational_velocity);
     
@@ -222,6 +290,27 @@ protected:
        List of stitches.
     */
     std::map<SurfacePanelEdge, SurfacePanelEdge, CompareSurfacePanelEdge> stitches;
+    
+    /**
+       Surfaces of the panel adjacency table:  first the non-lifting surfaces, then the lifting surfaces.
+    */
+    std::vector<std::shared_ptr<Surface> > adjacency_surfaces;
+    
+    /**
+       Surface index to offset in adjacency_offsets map.  Contains n_surfaces() + 1 entries.
+    */
+    std::vector<int> adjacency_surface_offsets;
+    
+    /**
+       Panel to offset in adjacency map, in compressed sparse row format.  Panels are numbered consecutively over
+       all surfaces.
+    */
+    std::vector<int> adjacency_offsets;
+    
+    /**
+       In-surface and across-surface (stitched) panel neighbors.
+    */
+    std::vector<PanelNeighbor> adjacency;
 };
 
 };
@@ -59,6 +59,43 @@ public:
        @returns Friction force acting on the given panel.
     */
     virtual Eigen::Vector3d friction(const std::shared_ptr<Surface> &surface, int panel) const = 0;
+    
+    /**
+       Returns true if this boundary layer neither blows nor exerts friction, i.e., if the flow is inviscid.  The
+       solver then skips the boundary layer altogether.  The default returns false.
+       
+       @returns true if the flow is inviscid.
+    */
+    virtual bool inviscid() const
+    {
+        return false;
+    }
+    
+    /**
+       Computes the blowing velocities of all panels of the given surface.  The default calls blowing_velocity() for
+       every panel;  models may override this to evaluate the panels of a surface in batch.
+       
+       @param[in]   surface              Reference surface.
+       @param[out]  blowing_velocities   Blowing velocities, one per panel.
+    */
+    virtual void blowing_velocities(const std::shared_ptr<Surface> &surface, Eigen::Ref<Eigen::VectorXd> blowing_velocities) const
+    {
+        for (int i = 0; i < surface->n_panels(); i++)
+            blowing_velocities(i) = blowing_velocity(surface, i);
+    }
+    
+    /**
+       Computes the friction forces acting on all panels of the given surface.  The default calls friction() for every
+       panel;  models may override this to evaluate the panels of a surface in batch.
+       
+       @param[in]   surface           Reference surface.
+       @param[out]  friction_forces   Friction forces, one per column.
+    */
+    virtual void friction_forces(const std::shared_ptr<Surface> &surface, Eigen::Ref<Eigen::Matrix3Xd> friction_forces) const
+    {
+        for (int i = 0; i < surface->n_panels(); i++)
+            friction_forces.col(i) = friction(surface, i);
+    }
 };
 
 };
@@ -52,3 +52,38 @@ DummyBoundaryLayer::friction(const shared_ptr<Surface> &surface, int panel) cons
 {
     return Vector3d(0, 0, 0);
 }
+
+/**
+   Returns true, as the dummy boundary layer neither blows nor exerts friction.
+   
+   @returns Always true.
+ */
+bool
+DummyBoundaryLayer::inviscid() const
+{
+    return true;
+}
+
+/**
+   Computes the blowing velocities of all panels of the given surface.
+   
+   @param[in]   surface              Reference surface.
+   @param[out]  blowing_velocities   Blowing velocities, one per panel.
+ */
+void
+DummyBoundaryLayer::blowing_velocities(const shared_ptr<Surface> &surface, Ref<VectorXd> blowing_velocities) const
+{
+    blowing_velocities.setZero();
+}
+
+/**
+   Computes the friction forces acting on all panels of the given surface.
+   
+   @param[in]   surface           Reference surface.
+   @param[out]  friction_forces   Friction forces, one per column.
+ */
+void
+DummyBoundaryLayer::friction_forces(const shared_ptr<Surface> &surface, Ref<Matrix3Xd> friction_forces) const
+{
+    friction_forces.setZero();
+}
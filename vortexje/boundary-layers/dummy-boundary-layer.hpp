@@ -27,6 +27,12 @@ public:
     double blowing_velocity(const std::shared_ptr<Surface> &surface, int panel) const;
     
     Eigen::Vector3d friction(const std::shared_ptr<Surface> &surface, int panel) const;
+    
+    bool inviscid() const;
+    
+    void blowing_velocities(const std::shared_ptr<Surface> &surface, Eigen::Ref<Eigen::VectorXd> blowing_velocities) const;
+    
+    void friction_forces(const std::shared_ptr<Surface> &surface, Eigen::Ref<Eigen::Matrix3Xd> friction_forces) const;
 };
 
 };
@@ -0,0 +1,379 @@
+//
+// Vortexje -- Binary checkpoint files.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <cstring>
+
+#include <vortexje/checkpoint.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+// File signature and format version:
+static const char signature[8] = {'V', 'J', 'X', 'C', 'H', 'E', 'C', 'K'};
+
+#define CHECKPOINT_VERSION 1
+
+/**
+   Creates a checkpoint file, and writes its header.
+   
+   @param[in]   filename   Destination filename.
+*/
+CheckpointWriter::CheckpointWriter(const string &filename)
+{
+    f.open(filename.c_str(), ios::out | ios::binary);
+    
+    f.write(signature, sizeof(signature));
+    
+    write((int64_t) CHECKPOINT_VERSION);
+}
+
+/**
+   Returns whether all records were written successfully.
+   
+   @returns true on success.
+*/
+bool
+CheckpointWriter::good() const
+{
+    return f.good();
+}
+
+/**
+   Writes a 64-bit integer scalar.
+   
+   @param[in]   value   Value.
+*/
+void
+CheckpointWriter::write(int64_t value)
+{
+    f.write((const char *) &value, sizeof(value));
+}
+
+/**
+   Writes a double precision scalar.
+   
+   @param[in]   value   Value.
+*/
+void
+CheckpointWriter::write(double value)
+{
+    f.write((const char *) &value, sizeof(value));
+}
+
+/**
+   Writes an array of integers.
+   
+   @param[in]   data   Array.
+   @param[in]   n      Number of elements.
+*/
+void
+CheckpointWriter::write(const int *data, int64_t n)
+{
+    write(n);
+    
+    f.write((const char *) data, n * sizeof(int));
+    
+    write_padding(n * sizeof(int));
+}
+
+/**
+   Writes an array of doubles.
+   
+   @param[in]   data   Array.
+   @param[in]   n      Number of elements.
+*/
+void
+CheckpointWriter::write(const double *data, int64_t n)
+{
+    write(n);
+    
+    f.write((const char *) data, n * sizeof(double));
+}
+
+/**
+   Writes a vector of integers.
+   
+   @param[in]   data   Vector.
+*/
+void
+CheckpointWriter::write(const vector<int> &data)
+{
+    write(data.data(), data.size());
+}
+
+/**
+   Writes a vector of doubles.
+   
+   @param[in]   data   Vector.
+*/
+void
+CheckpointWriter::write(const vector<double> &data)
+{
+    write(data.data(), data.size());
+}
+
+/**
+   Writes a vector of points, as an array of 3 doubles per point.
+   
+   @param[in]   data   Vector.
+*/
+void
+CheckpointWriter::write(const vector<Vector3d, Eigen::aligned_allocator<Vector3d> > &data)
+{
+    write((int64_t) (3 * data.size()));
+    
+    for (int i = 0; i < (int) data.size(); i++)
+        f.write((const char *) data[i].data(), 3 * sizeof(double));
+}
+
+/**
+   Writes a string, as an array of characters.
+   
+   @param[in]   data   String.
+*/
+void
+CheckpointWriter::write(const string &data)
+{
+    write((int64_t) data.size());
+    
+    f.write(data.data(), data.size());
+    
+    write_padding(data.size());
+}
+
+/**
+   Writes all buffered records to the file, so that they may be read while the file is still being written.
+*/
+void
+CheckpointWriter::flush()
+{
+    f.flush();
+}
+
+// Pads an array of the given size to a multiple of 8 bytes:
+void
+CheckpointWriter::write_padding(int64_t n_bytes)
+{
+    static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    
+    if (n_bytes % 8 != 0)
+        f.write(zeros, 8 - n_bytes % 8);
+}
+
+/**
+   Opens a checkpoint file, and verifies its header.
+   
+   @param[in]   filename   Source filename.
+*/
+CheckpointReader::CheckpointReader(const string &filename)
+{
+    f.open(filename.c_str(), ios::in | ios::binary);
+    
+    // The file size bounds the element counts of the arrays:
+    f.seekg(0, ios::end);
+    file_size = f.tellg();
+    f.seekg(0, ios::beg);
+    
+    char file_signature[sizeof(signature)];
+    f.read(file_signature, sizeof(file_signature));
+    
+    int64_t version;
+    valid = f.good() && memcmp(file_signature, signature, sizeof(signature)) == 0 && read(version) && version == CHECKPOINT_VERSION;
+}
+
+/**
+   Returns whether the file is a valid checkpoint, and whether all records were read successfully.
+   
+   @returns true on success.
+*/
+bool
+CheckpointReader::good() const
+{
+    return valid && f.good();
+}
+
+/**
+   Reads a 64-bit integer scalar.
+   
+   @param[out]  value   Value.
+   
+   @returns true on success.
+*/
+bool
+CheckpointReader::read(int64_t &value)
+{
+    f.read((char *) &value, sizeof(value));
+    
+    return f.good();
+}
+
+/**
+   Reads a double precision scalar.
+   
+   @param[out]  value   Value.
+   
+   @returns true on success.
+*/
+bool
+CheckpointReader::read(double &value)
+{
+    f.read((char *) &value, sizeof(value));
+    
+    return f.good();
+}
+
+/**
+   Reads an array of integers of known size.
+   
+   @param[out]  data   Array.
+   @param[in]   n      Expected number of elements.
+   
+   @returns true on success.
+*/
+bool
+CheckpointReader::read(int *data, int64_t n)
+{
+    int64_t m;
+    if (!read_count(m, sizeof(int)) || m != n)
+        return false;
+        
+    f.read((char *) data, n * sizeof(int));
+    
+    return read_padding(n * sizeof(int));
+}
+
+/**
+   Reads an array of doubles of known size.
+   
+   @param[out]  data   Array.
+   @param[in]   n      Expected number of elements.
+   
+   @returns true on success.
+*/
+bool
+CheckpointReader::read(double *data, int64_t n)
+{
+    int64_t m;
+    if (!read_count(m, sizeof(double)) || m != n)
+        return false;
+        
+    f.read((char *) data, n * sizeof(double));
+    
+    return f.good();
+}
+
+/**
+   Reads a vector of integers.
+   
+   @param[out]  data   Vector.
+   
+   @returns true on success.
+*/
+bool
+CheckpointReader::read(vector<int> &data)
+{
+    int64_t n;
+    if (!read_count(n, sizeof(int)))
+        return false;
+        
+    data.resize(n);
+    
+    f.read((char *) data.data(), n * sizeof(int));
+    
+    return read_padding(n * sizeof(int));
+}
+
+/**
+   Reads a vector of doubles.
+   
+   @param[out]  data   Vector.
+   
+   @returns true on success.
+*/
+bool
+CheckpointReader::read(vector<double> &data)
+{
+    int64_t n;
+    if (!read_count(n, sizeof(double)))
+        return false;
+        
+    data.resize(n);
+    
+    f.read((char *) data.data(), n * sizeof(double));
+    
+    return f.good();
+}
+
+/**
+   Reads a vector of points, stored as an array of 3 doubles per point.
+   
+   @param[out]  data   Vector.
+   
+   @returns true on success.
+*/
+bool
+CheckpointReader::read(vector<Vector3d, Eigen::aligned_allocator<Vector3d> > &data)
+{
+    int64_t n;
+    if (!read_count(n, sizeof(double)) || n % 3 != 0)
+        return false;
+        
+    data.resize(n / 3);
+    
+    for (int i = 0; i < (int) data.size(); i++)
+        f.read((char *) data[i].data(), 3 * sizeof(double));
+        
+    return f.good();
+}
+
+/**
+   Reads a string, stored as an array of characters.
+   
+   @param[out]  data   String.
+   
+   @returns true on success.
+*/
+bool
+CheckpointReader::read(string &data)
+{
+    int64_t n;
+    if (!read_count(n, sizeof(char)))
+        return false;
+        
+    data.resize(n);
+    
+    f.read(&data[0], n);
+    
+    return read_padding(n);
+}
+
+// Reads the element count of an array, and checks that the elements of the given size fit in the remainder of the
+// file:
+bool
+CheckpointReader::read_count(int64_t &n, int64_t element_size)
+{
+    if (!read(n) || n < 0)
+        return false;
+        
+    int64_t remaining_size = file_size - (int64_t) f.tellg();
+    
+    return n <= remaining_size / element_size;
+}
+
+// Skips the padding of an array of the given size:
+bool
+CheckpointReader::read_padding(int64_t n_bytes)
+{
+    char padding[8];
+    
+    if (n_bytes % 8 != 0)
+        f.read(padding, 8 - n_bytes % 8);
+        
+    return f.good();
+}
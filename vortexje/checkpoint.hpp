@@ -0,0 +1,102 @@
+//
+// Vortexje -- Binary checkpoint files.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#ifndef __CHECKPOINT_HPP__
+#define __CHECKPOINT_HPP__
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+namespace Vortexje
+{
+
+/**
+   Writer for binary checkpoint files.
+   
+   A checkpoint file consists of a header, followed by a sequence of records.  Every record is either a 64-bit
+   scalar, or an array consisting of a 64-bit element count followed by the elements.  Arrays are padded to a
+   multiple of 8 bytes, so that all records are naturally aligned if the file is memory-mapped.  All data is stored
+   in the byte order of the writing machine.
+   
+   @brief Checkpoint writer.
+*/
+class CheckpointWriter
+{
+public:
+    CheckpointWriter(const std::string &filename);
+    
+    bool good() const;
+    
+    void write(int64_t value);
+    void write(double value);
+    
+    void write(const int *data, int64_t n);
+    void write(const double *data, int64_t n);
+    
+    void write(const std::vector<int> &data);
+    void write(const std::vector<double> &data);
+    void write(const std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > &data);
+    
+    void write(const std::string &data);
+    
+    void flush();
+    
+private:
+    std::ofstream f;
+    
+    void write_padding(int64_t n_bytes);
+};
+
+/**
+   Reader for binary checkpoint files written by CheckpointWriter.  The records must be read in the order in which
+   they were written.  All methods return false if the file is truncated, or if the record does not match the
+   requested type or size.  Element counts larger than the remainder of the file are rejected before any memory is
+   allocated for them.
+   
+   @brief Checkpoint reader.
+*/
+class CheckpointReader
+{
+public:
+    CheckpointReader(const std::string &filename);
+    
+    bool good() const;
+    
+    bool read(int64_t &value);
+    bool read(double &value);
+    
+    bool read(int *data, int64_t n);
+    bool read(double *data, int64_t n);
+    
+    bool read(std::vector<int> &data);
+    bool read(std::vector<double> &data);
+    bool read(std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > &data);
+    
+    bool read(std::string &data);
+    
+private:
+    std::ifstream f;
+    
+    bool valid;
+    
+    int64_t file_size;
+    
+    bool read_count(int64_t &n, int64_t element_size);
+    
+    bool read_padding(int64_t n_bytes);
+};
+
+};
+
+#endif // __CHECKPOINT_HPP__
@@ -0,0 +1,142 @@
+//
+// Vortexje -- Distributed-memory parallelization helpers.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <algorithm>
+#include <vector>
+
+#ifdef VORTEXJE_MPI
+#include <mpi.h>
+#endif
+
+#include <vortexje/distributed.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+#ifdef VORTEXJE_MPI
+// Exchanges blocks of a replicated array.  Every process owns the entries [begin * block_size, end * block_size), in
+// process order.
+static void
+allgather_blocks(double *data, int begin, int end, int block_size)
+{
+    int size = Distributed::size();
+
+    vector<int> counts(size), displacements(size);
+
+    int count = (end - begin) * block_size;
+    MPI_Allgather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+
+    for (int i = 0, displacement = 0; i < size; i++) {
+        displacements[i] = displacement;
+
+        displacement += counts[i];
+    }
+
+    MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, data, counts.data(), displacements.data(), MPI_DOUBLE, MPI_COMM_WORLD);
+}
+#endif
+
+/**
+   Returns the rank of this process.
+
+   @returns Process rank.
+*/
+int
+Distributed::rank()
+{
+#ifdef VORTEXJE_MPI
+    int initialized;
+    MPI_Initialized(&initialized);
+    if (initialized) {
+        int rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+        return rank;
+    }
+#endif
+
+    return 0;
+}
+
+/**
+   Returns the number of processes.
+
+   @returns Number of processes.
+*/
+int
+Distributed::size()
+{
+#ifdef VORTEXJE_MPI
+    int initialized;
+    MPI_Initialized(&initialized);
+    if (initialized) {
+        int size;
+        MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+        return size;
+    }
+#endif
+
+    return 1;
+}
+
+/**
+   Partitions the index range [0, n) into contiguous blocks of nearly equal size, and returns the block owned by this
+   process.
+
+   @param[in]   n       Number of indices.
+   @param[out]  begin   First index owned by this process.
+   @param[out]  end     One past the last index owned by this process.
+*/
+void
+Distributed::partition(int n, int &begin, int &end)
+{
+    int rank = Distributed::rank();
+    int size = Distributed::size();
+
+    int block_size = n / size;
+    int remainder  = n % size;
+
+    begin = rank * block_size + min(rank, remainder);
+    end   = begin + block_size + (rank < remainder ? 1 : 0);
+}
+
+/**
+   Exchanges the entries of a replicated vector.  On entry, the entries [begin, end) of the block owned by this process,
+   as returned by partition(), are valid.  On exit, all entries are valid on all processes.
+
+   @param[in,out]   x       Replicated vector.
+   @param[in]       begin   First index owned by this process.
+   @param[in]       end     One past the last index owned by this process.
+*/
+void
+Distributed::allgather(VectorXd &x, int begin, int end)
+{
+#ifdef VORTEXJE_MPI
+    if (size() > 1)
+        allgather_blocks(x.data(), begin, end, 1);
+#endif
+}
+
+/**
+   Exchanges the columns of a replicated matrix of points or vectors.  On entry, the columns [begin, end) of the block
+   owned by this process, as returned by partition(), are valid.  On exit, all columns are valid on all processes.
+
+   @param[in,out]   x       Replicated matrix.
+   @param[in]       begin   First column owned by this process.
+   @param[in]       end     One past the last column owned by this process.
+*/
+void
+Distributed::allgather(Matrix3Xd &x, int begin, int end)
+{
+#ifdef VORTEXJE_MPI
+    if (size() > 1)
+        allgather_blocks(x.data(), begin, end, 3);
+#endif
+}
@@ -0,0 +1,45 @@
+//
+// Vortexje -- Distributed-memory parallelization helpers.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#ifndef __DISTRIBUTED_HPP__
+#define __DISTRIBUTED_HPP__
+
+#include <Eigen/Core>
+
+namespace Vortexje
+{
+
+/**
+   Helpers for distributing work over the processes of MPI_COMM_WORLD.
+
+   Every process holds a replicated copy of the geometry.  Index ranges, such as the rows of the matrices of influence
+   coefficients, or the wake nodes, are partitioned into contiguous blocks, one per process.  Every process computes
+   the entries of its own block, after which the blocks are exchanged using allgather().
+
+   If Vortexje is built without VORTEXJE_MPI, or if MPI has not been initialized, there is a single process that owns
+   all indices, and allgather() does nothing.
+
+   @brief Distributed-memory helpers.
+*/
+class Distributed
+{
+public:
+    static int rank();
+
+    static int size();
+
+    static void partition(int n, int &begin, int &end);
+
+    static void allgather(Eigen::VectorXd &x, int begin, int end);
+
+    static void allgather(Eigen::Matrix3Xd &x, int begin, int end);
+};
+
+};
+
+#endif // __DISTRIBUTED_HPP__
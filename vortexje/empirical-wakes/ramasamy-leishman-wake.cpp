@@ -6,6 +6,7 @@
 // Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
 //
 
+#include <algorithm>
 #include <cmath>
 
 #include <vortexje/empirical-wakes/ramasamy-leishman-wake.hpp>
@@ -54,6 +55,11 @@ static ramasamy_leishman_data_row ramasamy_leishman_data[12] = { {    1, 1.0000,
 // Avoid having to divide by 4 pi all the time:
 static const double one_over_4pi = 1.0 / (4 * pi);
 
+// Number of points processed at once by the batched velocity kernel:
+#define BATCH_SIZE 64
+
+typedef Array<double, Dynamic, 1, ColMajor, BATCH_SIZE, 1> BatchArray;
+
 /**
    Constructs an empty Ramasamy-Leishman wake.
    
@@ -61,6 +67,11 @@ static const double one_over_4pi = 1.0 / (4 * pi);
 */
 RamasamyLeishmanWake::RamasamyLeishmanWake(std::shared_ptr<LiftingSurface> lifting_surface): Wake(lifting_surface)
 {
+    fluid_kinematic_viscosity  = RamasamyLeishmanWake::Parameters::fluid_kinematic_viscosity;
+    initial_vortex_core_radius = RamasamyLeishmanWake::Parameters::initial_vortex_core_radius;
+    min_vortex_core_radius     = RamasamyLeishmanWake::Parameters::min_vortex_core_radius;
+    lambs_constant             = RamasamyLeishmanWake::Parameters::lambs_constant;
+    a_prime                    = RamasamyLeishmanWake::Parameters::a_prime;
 }
 
 /**
@@ -80,7 +91,7 @@ RamasamyLeishmanWake::add_layer()
             // Add initial vortex core radii. 
             vector<double> panel_vortex_core_radii;
             for (int i = 0; i < 4; i++)
-                panel_vortex_core_radii.push_back(RamasamyLeishmanWake::Parameters::initial_vortex_core_radius);
+                panel_vortex_core_radii.push_back(initial_vortex_core_radius);
             vortex_core_radii.push_back(panel_vortex_core_radii);
             
             // Store base edge lengths.
@@ -100,32 +111,184 @@ RamasamyLeishmanWake::add_layer()
             }
             base_edge_lengths.push_back(edge_lengths);
         }
+        
+        update_vortex_ring_coefficients(n_panels() - lifting_surface->n_spanwise_panels());
     }
 }
 
 /**
-   Computes the unit velocity induced by a Ramasamy-Leishman vortex ring.
+   Deletes the given number of oldest rows of wake panels, together with their R-L data.
    
-   @param[in]   x            Point at which the velocity is evaluated.
-   @param[in]   this_panel   Panel on which the vortex ring is located.
-   
-   @returns Unit velocity induced by the Ramasamy-Leishman vortex ring.
+   @param[in]   n   Number of rows to delete.
+*/
+void
+RamasamyLeishmanWake::delete_rows(int n)
+{
+    int n_deleted_panels = n * lifting_surface->n_spanwise_panels();
+    
+    vortex_core_radii.erase(vortex_core_radii.begin(), vortex_core_radii.begin() + n_deleted_panels);
+    base_edge_lengths.erase(base_edge_lengths.begin(), base_edge_lengths.begin() + n_deleted_panels);
+    
+    vortex_ring_coefficients.erase(vortex_ring_coefficients.begin(),
+                                   vortex_ring_coefficients.begin() + min(n_deleted_panels, (int) vortex_ring_coefficients.size()));
+    
+    this->Wake::delete_rows(n);
+}
+
+/**
+   Merges consecutive rows of wake panels into a single row, together with their R-L data.  The spanwise filaments of
+   the merged vortex rings are those of the outer rows.  The streamwise filaments are chained; their base lengths
+   add up, and their core radii are averaged, weighted by base length.
    
-   @note See M. Ramasamy and J. G. Leishman, Reynolds Number Based Blade Tip Vortex Model, University of Maryland, 2005.
+   @param[in]   first_row   First row to merge.
+   @param[in]   n           Number of rows to merge.
 */
-Vector3d
-RamasamyLeishmanWake::vortex_ring_unit_velocity(const Eigen::Vector3d &x, int this_panel) const
+void
+RamasamyLeishmanWake::merge_rows(int first_row, int n)
 {
-    if (this_panel >= n_panels() - lifting_surface->n_spanwise_panels()) {
-        // This panel is contained in the latest row of wake panels.  To satisfy the Kutta condition
-        // exactly, we use the unmodified vortex ring unit velocity here.
-        return this->Surface::vortex_ring_unit_velocity(x, this_panel);
+    if (n < 2)
+        return;
+        
+    int n_spanwise_panels = lifting_surface->n_spanwise_panels();
+    
+    for (int k = 0; k < n_spanwise_panels; k++) {
+        int first_panel = first_row * n_spanwise_panels + k;
+        int last_panel  = (first_row + n - 1) * n_spanwise_panels + k;
+        
+        // Edge 0 is the spanwise filament on the trailing edge side, and edge 2 the one on the far side:
+        vortex_core_radii[first_panel][0] = vortex_core_radii[last_panel][0];
+        base_edge_lengths[first_panel][0] = base_edge_lengths[last_panel][0];
+        
+        // Edges 1 and 3 are streamwise:
+        for (int i = 1; i < 4; i += 2) {
+            double length          = 0.0;
+            double weighted_radius = 0.0;
+            for (int row = first_row; row < first_row + n; row++) {
+                int panel = row * n_spanwise_panels + k;
+                
+                length          += base_edge_lengths[panel][i];
+                weighted_radius += base_edge_lengths[panel][i] * vortex_core_radii[panel][i];
+            }
+            
+            base_edge_lengths[first_panel][i] = length;
+            if (length > Vortexje::Parameters::inversion_tolerance)
+                vortex_core_radii[first_panel][i] = weighted_radius / length;
+        }
     }
-     
-    // Compute vortex Reynolds number:                          
-    double vortex_reynolds_number = doublet_coefficients[this_panel] / RamasamyLeishmanWake::Parameters::fluid_kinematic_viscosity;
     
-    // Interpolate Ramasamy-Leishman series values piecewise-linearly:
+    vortex_core_radii.erase(vortex_core_radii.begin() + (first_row + 1) * n_spanwise_panels,
+                            vortex_core_radii.begin() + (first_row + n) * n_spanwise_panels);
+    base_edge_lengths.erase(base_edge_lengths.begin() + (first_row + 1) * n_spanwise_panels,
+                            base_edge_lengths.begin() + (first_row + n) * n_spanwise_panels);
+                            
+    vortex_ring_coefficients.clear();
+    
+    this->Wake::merge_rows(first_row, n);
+    
+    // The merged rows have new doublet coefficients and core radii:
+    update_vortex_ring_coefficients(0);
+}
+
+// Writes a list of per-panel filament values into a checkpoint:
+static void
+write_filament_values(CheckpointWriter &writer, const vector<vector<double> > &values)
+{
+    vector<int> counts;
+    vector<double> list;
+    for (int i = 0; i < (int) values.size(); i++) {
+        counts.push_back(values[i].size());
+        list.insert(list.end(), values[i].begin(), values[i].end());
+    }
+    
+    writer.write(counts);
+    writer.write(list);
+}
+
+// Reads a list of per-panel filament values from a checkpoint:
+static bool
+read_filament_values(CheckpointReader &reader, vector<vector<double> > &values)
+{
+    vector<int> counts;
+    vector<double> list;
+    if (!reader.read(counts) || !reader.read(list))
+        return false;
+        
+    values.clear();
+    
+    int offset = 0;
+    for (int i = 0; i < (int) counts.size(); i++) {
+        if (counts[i] < 0 || offset + counts[i] > (int) list.size())
+            return false;
+            
+        values.push_back(vector<double>(list.begin() + offset, list.begin() + offset + counts[i]));
+        
+        offset += counts[i];
+    }
+    
+    return true;
+}
+
+/**
+   Writes the state of this wake into a checkpoint, including the vortex core radii.
+   
+   @param[in]   writer   Checkpoint writer.
+*/
+void
+RamasamyLeishmanWake::write_checkpoint(CheckpointWriter &writer) const
+{
+    this->Wake::write_checkpoint(writer);
+    
+    write_filament_values(writer, vortex_core_radii);
+    write_filament_values(writer, base_edge_lengths);
+}
+
+/**
+   Reads the state of this wake from a checkpoint written by write_checkpoint(), and validates it.  The wake itself is
+   left unchanged; the state is applied by restore_checkpoint().
+   
+   @param[in]   reader   Checkpoint reader.
+   
+   @returns The state read, or a null pointer on failure.
+*/
+shared_ptr<Wake::CheckpointState>
+RamasamyLeishmanWake::read_checkpoint(CheckpointReader &reader) const
+{
+    shared_ptr<CheckpointState> state(new CheckpointState());
+    if (!read_wake_checkpoint(reader, *state))
+        return shared_ptr<Wake::CheckpointState>();
+        
+    if (!read_filament_values(reader, state->vortex_core_radii) || !read_filament_values(reader, state->base_edge_lengths))
+        return shared_ptr<Wake::CheckpointState>();
+        
+    if (state->vortex_core_radii.size() != state->panel_nodes.size() || state->base_edge_lengths.size() != state->panel_nodes.size())
+        return shared_ptr<Wake::CheckpointState>();
+        
+    return state;
+}
+
+/**
+   Restores the state of this wake from a state returned by read_checkpoint() of this wake.
+   
+   @param[in]   state   Checkpoint state.
+*/
+void
+RamasamyLeishmanWake::restore_checkpoint(const Wake::CheckpointState &state)
+{
+    this->Wake::restore_checkpoint(state);
+    
+    const CheckpointState &filament_state = static_cast<const CheckpointState &>(state);
+    
+    vortex_core_radii = filament_state.vortex_core_radii;
+    base_edge_lengths = filament_state.base_edge_lengths;
+    
+    vortex_ring_coefficients.clear();
+    update_vortex_ring_coefficients(0);
+}
+
+// Interpolates the Ramasamy-Leishman series coefficients piecewise-linearly in the vortex Reynolds number:
+static void
+interpolate_ramasamy_leishman_series(double vortex_reynolds_number, double a[3], double b[3])
+{
     int less_than_idx;
     for (less_than_idx = 0; less_than_idx < 12; less_than_idx++) {
         ramasamy_leishman_data_row &row = ramasamy_leishman_data[less_than_idx];
@@ -134,8 +297,6 @@ RamasamyLeishmanWake::vortex_ring_unit_velocity(const Eigen::Vector3d &x, int th
             break;
     }
     
-    double a[3];
-    double b[3];
     if (less_than_idx == 0) {
         a[0] = ramasamy_leishman_data[0].a_1;
         a[1] = ramasamy_leishman_data[0].a_2;
@@ -173,31 +334,111 @@ RamasamyLeishmanWake::vortex_ring_unit_velocity(const Eigen::Vector3d &x, int th
     }
     
     a[2] = 1 - a[0] - a[1];
+}
+
+/**
+   Computes the kernel coefficients of a vortex ring from its current doublet coefficient and vortex core radii.
+   
+   @param[in]   panel          Panel on which the vortex ring is located.
+   @param[out]  coefficients   Kernel coefficients.
+*/
+void
+RamasamyLeishmanWake::compute_vortex_ring_coefficients(int panel, VortexRingCoefficients &coefficients) const
+{
+    coefficients.doublet_coefficient = doublet_coefficients[panel];
+    
+    // Compute vortex Reynolds number:
+    double vortex_reynolds_number = doublet_coefficients[panel] / fluid_kinematic_viscosity;
+    
+    interpolate_ramasamy_leishman_series(vortex_reynolds_number, coefficients.a, coefficients.b);
+    
+    for (int i = 0; i < 4; i++)
+        coefficients.inverse_squared_core_radii[i] = 1.0 / (vortex_core_radii[panel][i] * vortex_core_radii[panel][i]);
+}
+
+/**
+   Returns the kernel coefficients of a vortex ring.  The cached coefficients are returned if they match the current
+   doublet coefficient of the panel.  If not, the coefficients are computed into the given scratch space.
+   
+   @param[in]   panel     Panel on which the vortex ring is located.
+   @param[in]   scratch   Scratch space.
+   
+   @returns Kernel coefficients.
+*/
+const RamasamyLeishmanWake::VortexRingCoefficients &
+RamasamyLeishmanWake::get_vortex_ring_coefficients(int panel, VortexRingCoefficients &scratch) const
+{
+    if (panel < (int) vortex_ring_coefficients.size() &&
+        vortex_ring_coefficients[panel].doublet_coefficient == doublet_coefficients[panel])
+        return vortex_ring_coefficients[panel];
+        
+    compute_vortex_ring_coefficients(panel, scratch);
+    
+    return scratch;
+}
+
+/**
+   Recomputes the cached kernel coefficients of all vortex rings starting at the given panel.
+   
+   @param[in]   first_panel   First panel to update.
+*/
+void
+RamasamyLeishmanWake::update_vortex_ring_coefficients(int first_panel)
+{
+    vortex_ring_coefficients.resize(n_panels());
+    
+    for (int i = first_panel; i < n_panels(); i++)
+        compute_vortex_ring_coefficients(i, vortex_ring_coefficients[i]);
+}
+
+/**
+   Computes the unit velocity induced by a Ramasamy-Leishman vortex ring.
+   
+   @param[in]   x            Point at which the velocity is evaluated.
+   @param[in]   this_panel   Panel on which the vortex ring is located.
+   
+   @returns Unit velocity induced by the Ramasamy-Leishman vortex ring.
+   
+   @note See M. Ramasamy and J. G. Leishman, Reynolds Number Based Blade Tip Vortex Model, University of Maryland, 2005.
+*/
+Vector3d
+RamasamyLeishmanWake::vortex_ring_unit_velocity(const Eigen::Vector3d &x, int this_panel) const
+{
+    if (this_panel >= n_panels() - lifting_surface->n_spanwise_panels()) {
+        // This panel is contained in the latest row of wake panels.  To satisfy the Kutta condition
+        // exactly, we use the unmodified vortex ring unit velocity here.
+        return this->Surface::vortex_ring_unit_velocity(x, this_panel);
+    }
+    
+    VortexRingCoefficients scratch;
+    const VortexRingCoefficients &coefficients = get_vortex_ring_coefficients(this_panel, scratch);
     
     // Compute velocity:
     Vector3d velocity(0, 0, 0);
     
-    for (int i = 0; i < (int) panel_nodes[this_panel].size(); i++) {
+    const int *single_panel_nodes = &panel_node_table[max_panel_nodes * this_panel];
+    
+    for (int i = 0; i < panel_node_counts[this_panel]; i++) {
         int previous_idx;
         if (i == 0)
-            previous_idx = panel_nodes[this_panel].size() - 1;
+            previous_idx = panel_node_counts[this_panel] - 1;
         else
             previous_idx = i - 1;
             
-        const Vector3d &node_a = nodes[panel_nodes[this_panel][previous_idx]];
-        const Vector3d &node_b = nodes[panel_nodes[this_panel][i]];
+        const Vector3d &node_a = nodes[single_panel_nodes[previous_idx]];
+        const Vector3d &node_b = nodes[single_panel_nodes[i]];
         
         Vector3d r_0 = node_b - node_a;
         Vector3d r_1 = node_a - x;
         Vector3d r_2 = node_b - x;
         
-        double r_0_norm = r_0.norm();
+        double r_0_sqnorm = r_0.squaredNorm();
+        double r_0_norm = sqrt(r_0_sqnorm);
         double r_1_norm = r_1.norm();
         double r_2_norm = r_2.norm();
         
         Vector3d r_1xr_2 = r_1.cross(r_2);
         double r_1xr_2_sqnorm = r_1xr_2.squaredNorm();
-        double r_1xr_2_norm = sqrt(r_1xr_2_sqnorm);
         
         if (r_0_norm < Vortexje::Parameters::inversion_tolerance ||
             r_1_norm < Vortexje::Parameters::inversion_tolerance ||
@@ -205,13 +446,15 @@ RamasamyLeishmanWake::vortex_ring_unit_velocity(const Eigen::Vector3d &x, int th
             r_1xr_2_sqnorm < Vortexje::Parameters::inversion_tolerance)
             continue;
             
-        double d = r_1xr_2_norm / r_0_norm;
-        
-        double dr = pow(d / vortex_core_radii[this_panel][i], 2);
+        // Squared ratio of the distance to the filament, and the vortex core radius:
+        double dr = r_1xr_2_sqnorm / r_0_sqnorm * coefficients.inverse_squared_core_radii[i];
             
+        // Series terms with a zero coefficient are skipped, saving their exponentials:
         double sum = 0;
-        for (int j = 0; j < 3; j++)
-            sum += a[j] * exp(-b[j] * dr);
+        for (int j = 0; j < 3; j++) {
+            if (coefficients.a[j] != 0.0)
+                sum += coefficients.a[j] * exp(-coefficients.b[j] * dr);
+        }
 
         velocity += (1 - sum) * r_1xr_2 / r_1xr_2_sqnorm * r_0.dot(r_1 / r_1_norm - r_2 / r_2_norm);
     }
@@ -219,6 +462,104 @@ RamasamyLeishmanWake::vortex_ring_unit_velocity(const Eigen::Vector3d &x, int th
     return one_over_4pi * velocity;
 }
 
+/**
+   Computes the unit velocities induced by a Ramasamy-Leishman vortex ring, for a batch of points.  The points are
+   processed in blocks, so that the filament kernel, including its exponentials, is evaluated using SIMD instructions.
+   
+   @param[in]   x            Points at which the velocity is evaluated, one per column.
+   @param[in]   this_panel   Panel on which the vortex ring is located.
+   @param[out]  velocities   Unit velocities induced by the Ramasamy-Leishman vortex ring, one per column.
+   
+   @note See M. Ramasamy and J. G. Leishman, Reynolds Number Based Blade Tip Vortex Model, University of Maryland, 2005.
+*/
+void
+RamasamyLeishmanWake::vortex_ring_unit_velocity(const Eigen::Matrix3Xd &x, int this_panel, Ref<Matrix3Xd> velocities) const
+{
+    if (this_panel >= n_panels() - lifting_surface->n_spanwise_panels()) {
+        // Latest row of wake panels, see above:
+        this->Surface::vortex_ring_unit_velocity(x, this_panel, velocities);
+        
+        return;
+    }
+    
+    VortexRingCoefficients scratch;
+    const VortexRingCoefficients &coefficients = get_vortex_ring_coefficients(this_panel, scratch);
+    
+    const double tolerance = Vortexje::Parameters::inversion_tolerance;
+    
+    const int *single_panel_nodes = &panel_node_table[max_panel_nodes * this_panel];
+    
+    for (int offset = 0; offset < x.cols(); offset += BATCH_SIZE) {
+        int n = min((int) x.cols() - offset, BATCH_SIZE);
+        
+        BatchArray x_0 = x.block(0, offset, 1, n).transpose().array();
+        BatchArray x_1 = x.block(1, offset, 1, n).transpose().array();
+        BatchArray x_2 = x.block(2, offset, 1, n).transpose().array();
+        
+        BatchArray velocity_0 = BatchArray::Zero(n);
+        BatchArray velocity_1 = BatchArray::Zero(n);
+        BatchArray velocity_2 = BatchArray::Zero(n);
+        
+        for (int i = 0; i < panel_node_counts[this_panel]; i++) {
+            int previous_idx;
+            if (i == 0)
+                previous_idx = panel_node_counts[this_panel] - 1;
+            else
+                previous_idx = i - 1;
+                
+            const Vector3d &node_a = nodes[single_panel_nodes[previous_idx]];
+            const Vector3d &node_b = nodes[single_panel_nodes[i]];
+            
+            Vector3d r_0 = node_b - node_a;
+            
+            double r_0_sqnorm = r_0.squaredNorm();
+            if (sqrt(r_0_sqnorm) < tolerance)
+                continue;
+            
+            BatchArray r_1_0 = node_a(0) - x_0;
+            BatchArray r_1_1 = node_a(1) - x_1;
+            BatchArray r_1_2 = node_a(2) - x_2;
+            
+            BatchArray r_2_0 = node_b(0) - x_0;
+            BatchArray r_2_1 = node_b(1) - x_1;
+            BatchArray r_2_2 = node_b(2) - x_2;
+            
+            BatchArray r_1_norm = (r_1_0.square() + r_1_1.square() + r_1_2.square()).sqrt();
+            BatchArray r_2_norm = (r_2_0.square() + r_2_1.square() + r_2_2.square()).sqrt();
+            
+            BatchArray r_1xr_2_0 = r_1_1 * r_2_2 - r_1_2 * r_2_1;
+            BatchArray r_1xr_2_1 = r_1_2 * r_2_0 - r_1_0 * r_2_2;
+            BatchArray r_1xr_2_2 = r_1_0 * r_2_1 - r_1_1 * r_2_0;
+            
+            BatchArray r_1xr_2_sqnorm = r_1xr_2_0.square() + r_1xr_2_1.square() + r_1xr_2_2.square();
+            
+            BatchArray dr = r_1xr_2_sqnorm * (coefficients.inverse_squared_core_radii[i] / r_0_sqnorm);
+            
+            BatchArray sum = BatchArray::Zero(n);
+            for (int j = 0; j < 3; j++) {
+                if (coefficients.a[j] != 0.0)
+                    sum += coefficients.a[j] * (-coefficients.b[j] * dr).exp();
+            }
+            
+            BatchArray projection = r_0(0) * (r_1_0 / r_1_norm - r_2_0 / r_2_norm) +
+                                    r_0(1) * (r_1_1 / r_1_norm - r_2_1 / r_2_norm) +
+                                    r_0(2) * (r_1_2 / r_1_norm - r_2_2 / r_2_norm);
+                                    
+            // Points on or near the filament do not contribute:
+            BatchArray factor = ((r_1_norm < tolerance) || (r_2_norm < tolerance) || (r_1xr_2_sqnorm < tolerance)).select(
+                BatchArray::Zero(n), (1 - sum) * projection / r_1xr_2_sqnorm);
+            
+            velocity_0 += factor * r_1xr_2_0;
+            velocity_1 += factor * r_1xr_2_1;
+            velocity_2 += factor * r_1xr_2_2;
+        }
+        
+        velocities.block(0, offset, 1, n) = one_over_4pi * velocity_0.matrix().transpose();
+        velocities.block(1, offset, 1, n) = one_over_4pi * velocity_1.matrix().transpose();
+        velocities.block(2, offset, 1, n) = one_over_4pi * velocity_2.matrix().transpose();
+    }
+}
+
 /**
    Updates the Ramasamy-Leishman vortex ring core radii.
   
@@ -237,15 +578,15 @@ RamasamyLeishmanWake::update_vortex_ring_radii(int panel, double dt)
         else
             prev_idx = i - 1;
             
-        double vortex_reynolds_number = fabs(doublet_coefficients[panel]) / RamasamyLeishmanWake::Parameters::fluid_kinematic_viscosity;
+        double vortex_reynolds_number = fabs(doublet_coefficients[panel]) / fluid_kinematic_viscosity;
         
-        double t_multiplier = 4 * RamasamyLeishmanWake::Parameters::lambs_constant *
-            (1 + vortex_reynolds_number * RamasamyLeishmanWake::Parameters::a_prime) *
-             RamasamyLeishmanWake::Parameters::fluid_kinematic_viscosity;
+        double t_multiplier = 4 * lambs_constant *
+            (1 + vortex_reynolds_number * a_prime) *
+             fluid_kinematic_viscosity;
         
-        double t = (pow(vortex_core_radii[panel][i], 2) - pow(RamasamyLeishmanWake::Parameters::initial_vortex_core_radius, 2)) / t_multiplier;
+        double t = (pow(vortex_core_radii[panel][i], 2) - pow(initial_vortex_core_radius, 2)) / t_multiplier;
         
-        double vortex_core_size_0 = sqrt(pow(RamasamyLeishmanWake::Parameters::initial_vortex_core_radius, 2) + t_multiplier * (t + dt));
+        double vortex_core_size_0 = sqrt(pow(initial_vortex_core_radius, 2) + t_multiplier * (t + dt));
         
         Vector3d node_a = nodes[panel_nodes[panel][prev_idx]];
         Vector3d node_b = nodes[panel_nodes[panel][i]];
@@ -254,12 +595,16 @@ RamasamyLeishmanWake::update_vortex_ring_radii(int panel, double dt)
         
         double strain = (edge.norm() - base_edge_lengths[panel][i]) / base_edge_lengths[panel][i];
         
-        vortex_core_radii[panel][i] = fmax(RamasamyLeishmanWake::Parameters::min_vortex_core_radius, vortex_core_size_0 / sqrt(1 + strain));
+        vortex_core_radii[panel][i] = fmax(min_vortex_core_radius, vortex_core_size_0 / sqrt(1 + strain));
     }
+    
+    compute_vortex_ring_coefficients(panel, vortex_ring_coefficients[panel]);
 }
 
 /**
-   Updates the Ramasamy-Leishman vortex ring core radii.
+   Updates the Ramasamy-Leishman vortex ring core radii, as well as the cached kernel coefficients of the vortex
+   rings.  The kernel coefficients of a vortex ring are looked up from the series data once per time step, rather
+   than on every velocity evaluation.
   
    @param[in]   dt   Time step size.
    
@@ -270,6 +615,8 @@ RamasamyLeishmanWake::update_properties(double dt)
 {
     int i;
     
+    vortex_ring_coefficients.resize(n_panels());
+    
     #pragma omp parallel
     {
         #pragma omp for schedule(dynamic, 1)
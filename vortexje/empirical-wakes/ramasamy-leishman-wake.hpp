@@ -32,7 +32,33 @@ public:
     
     void update_properties(double dt);
     
+    void delete_rows(int n);
+    void merge_rows(int first_row, int n);
+    
+    /**
+       State of a Ramasamy-Leishman wake as read from a checkpoint, including the vortex core radii.
+       
+       @brief Ramasamy-Leishman wake checkpoint state.
+    */
+    class CheckpointState : public Wake::CheckpointState {
+    public:
+        /**
+           Radii of the vortex filaments forming the vortex rings.
+        */
+        std::vector<std::vector<double> > vortex_core_radii;
+        
+        /**
+           Initial lengths of the vortex filaments forming the vortex rings.
+        */
+        std::vector<std::vector<double> > base_edge_lengths;
+    };
+    
+    void write_checkpoint(CheckpointWriter &writer) const;
+    std::shared_ptr<Wake::CheckpointState> read_checkpoint(CheckpointReader &reader) const;
+    void restore_checkpoint(const Wake::CheckpointState &state);
+    
     Eigen::Vector3d vortex_ring_unit_velocity(const Eigen::Vector3d &x, int this_panel) const;
+    void vortex_ring_unit_velocity(const Eigen::Matrix3Xd &x, int this_panel, Eigen::Ref<Eigen::Matrix3Xd> velocities) const;
 
     /**
        Radii of the vortex filaments forming the vortex rings.
@@ -40,7 +66,33 @@ public:
     std::vector<std::vector<double> > vortex_core_radii;
     
     /**
-       Ramasamy-Leishman wake model parameters.
+       Kinematic viscosity of the fluid.  Initialized from Parameters::fluid_kinematic_viscosity.
+    */
+    double fluid_kinematic_viscosity;
+    
+    /**
+       Initial vortex filament radius.  Initialized from Parameters::initial_vortex_core_radius.
+    */
+    double initial_vortex_core_radius;
+    
+    /**
+       Minimum vortex filament radius.  Initialized from Parameters::min_vortex_core_radius.
+    */
+    double min_vortex_core_radius;
+    
+    /**
+       Lamb's constant.  Initialized from Parameters::lambs_constant.
+    */
+    double lambs_constant;
+    
+    /**
+       a' constant.  Initialized from Parameters::a_prime.
+    */
+    double a_prime;
+    
+    /**
+       Ramasamy-Leishman wake model parameters.  These are the defaults for the model parameters of every newly
+       constructed wake.
        
        @brief Wake model parameters.
     */
@@ -86,6 +138,43 @@ private:
     */
     std::vector<std::vector<double> > base_edge_lengths;
     
+    /**
+       Coefficients of the velocity kernel of a single vortex ring.
+       
+       @brief Vortex ring kernel coefficients.
+    */
+    class VortexRingCoefficients {
+    public:
+        /**
+           Doublet coefficient from which the series coefficients were interpolated.
+        */
+        double doublet_coefficient;
+        
+        /**
+           Ramasamy-Leishman series coefficients a_1, a_2, and a_3.
+        */
+        double a[3];
+        
+        /**
+           Ramasamy-Leishman series coefficients b_1, b_2, and b_3.
+        */
+        double b[3];
+        
+        /**
+           Inverse squares of the vortex core radii of the filaments.
+        */
+        double inverse_squared_core_radii[4];
+    };
+    
+    /**
+       Kernel coefficients of the vortex rings, updated together with the vortex core radii.
+    */
+    std::vector<VortexRingCoefficients> vortex_ring_coefficients;
+    
+    void compute_vortex_ring_coefficients(int panel, VortexRingCoefficients &coefficients) const;
+    const VortexRingCoefficients &get_vortex_ring_coefficients(int panel, VortexRingCoefficients &scratch) const;
+    void update_vortex_ring_coefficients(int first_panel);
+    
     void update_vortex_ring_radii(int panel, double dt);
 };
 
@@ -83,6 +83,34 @@ public:
                                                 double y_min, double y_max,
                                                 double z_min, double z_max,
                                                 double dx, double dy, double dz) = 0;
+                                                
+protected:
+    /**
+       Lists the points of one Z-slice of a rectilinear grid, with the X coordinate running fastest.  Fields are
+       evaluated one slice at a time, using the batched Solver evaluations, so that the memory use is bounded for large
+       grids.
+       
+       @param[in]   x_min   Minimum X coordinate of grid.
+       @param[in]   y_min   Minimum Y coordinate of grid.
+       @param[in]   z       Z coordinate of slice.
+       @param[in]   dx      Grid step size in X-direction.
+       @param[in]   dy      Grid step size in Y-direction.
+       @param[in]   nx      Number of grid points in X-direction.
+       @param[in]   ny      Number of grid points in Y-direction.
+       
+       @returns Grid points, one per column.
+    */
+    static Eigen::Matrix3Xd grid_slice(double x_min, double y_min, double z, double dx, double dy, int nx, int ny)
+    {
+        Eigen::Matrix3Xd points(3, nx * ny);
+        
+        for (int j = 0; j < ny; j++) {
+            for (int k = 0; k < nx; k++)
+                points.col(j * nx + k) = Eigen::Vector3d(x_min + k * dx, y_min + j * dy, z);
+        }
+        
+        return points;
+    }
 };
 
 };
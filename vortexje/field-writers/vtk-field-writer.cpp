@@ -9,6 +9,7 @@
 #include <cmath>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 
 #include <vortexje/field-writers/vtk-field-writer.hpp>
 
@@ -53,7 +54,7 @@ VTKFieldWriter::write_velocity_field(const Solver &solver, const std::string &fi
                                      double z_min, double z_max,
                                      int nx, int ny, int nz)
 {
-    cout << "Solver: Computing and saving velocity vector field to " << filename << "." << endl;
+    VORTEXJE_LOG(solver.logger, Logger::Info, "Solver: Computing and saving velocity vector field to " << filename << ".");
     
     double dx;
     if (nx > 1) dx = (x_max - x_min)/(nx - 1);
@@ -67,28 +68,19 @@ VTKFieldWriter::write_velocity_field(const Solver &solver, const std::string &fi
     
     write_preamble(f, x_min, y_min, z_min, dx, dy, dz, nx, ny, nz);
     
-    double x, y, z;
-    
-    // Velocity vector field;    
+    // Velocity vector field.  The field is evaluated and written one Z-slice at a time:
     f << "VECTORS Velocity double" << endl;
     
-    z = z_min;
     for (int i = 0; i < nz; i++) {
-        y = y_min;
-        for (int j = 0; j < ny; j++) {
-            x = x_min;
-            for (int k = 0; k < nx; k++) {
-                Vector3d v = solver.velocity(Vector3d(x, y, z));
-                
-                f << v(0) << " " << v(1) << " " << v(2) << endl;
-            
-                x += dx;
-            }
-            
-            y += dy;
-        }
+        Matrix3Xd velocities = solver.velocity(grid_slice(x_min, y_min, z_min + i * dz, dx, dy, nx, ny));
         
-        z += dz;
+        ostringstream buffer;
+        buffer.precision(f.precision());
+        
+        for (int j = 0; j < velocities.cols(); j++)
+            buffer << velocities(0, j) << ' ' << velocities(1, j) << ' ' << velocities(2, j) << '\n';
+            
+        f << buffer.str();
     }
     
     // Close file:
@@ -124,7 +116,7 @@ VTKFieldWriter::write_velocity_potential_field(const Solver &solver, const std::
                                                double z_min, double z_max,
                                                double dx, double dy, double dz)
 {
-    cout << "Solver: Computing and saving velocity potential field to " << filename << "." << endl;
+    VORTEXJE_LOG(solver.logger, Logger::Info, "Solver: Computing and saving velocity potential field to " << filename << ".");
 
     int nx = round((x_max - x_min) / dx) + 1;
     int ny = round((y_max - y_min) / dy) + 1;
@@ -136,29 +128,20 @@ VTKFieldWriter::write_velocity_potential_field(const Solver &solver, const std::
     
     write_preamble(f, x_min, y_min, z_min, dx, dy, dz, nx, ny, nz);
     
-    double x, y, z;
-    
-    // Velocity potential field:    
+    // Velocity potential field.  The field is evaluated and written one Z-slice at a time:
     f << "SCALARS VelocityPotential double 1" << endl;
     f << "LOOKUP_TABLE default" << endl;
     
-    z = z_min;
     for (int i = 0; i < nz; i++) {
-        y = y_min;
-        for (int j = 0; j < ny; j++) {
-            x = z_min;
-            for (int k = 0; k < nx; k++) {
-                double p = solver.velocity_potential(Vector3d(x, y, z));
-                
-                f << p << endl;
-            
-                x += dx;
-            }
-            
-            y += dy;
-        }
+        VectorXd potentials = solver.velocity_potential(grid_slice(x_min, y_min, z_min + i * dz, dx, dy, nx, ny));
         
-        z += dz;
+        ostringstream buffer;
+        buffer.precision(f.precision());
+        
+        for (int j = 0; j < potentials.size(); j++)
+            buffer << potentials(j) << '\n';
+            
+        f << buffer.str();
     }
     
     // Close file:
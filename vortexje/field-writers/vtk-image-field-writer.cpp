@@ -0,0 +1,188 @@
+//
+// Vortexje -- VTK XML image data field writer.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <cmath>
+#include <iostream>
+#include <fstream>
+#include <stdint.h>
+
+#include <vortexje/field-writers/vtk-image-field-writer.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+/**
+   Returns the VTK XML image data file extension (".vti").
+   
+   @returns The VTK XML image data file extension (".vti").
+*/
+const char *
+VTKImageFieldWriter::file_extension() const
+{
+    return ".vti";
+}
+
+/**
+   Logs the velocity vector field into a VTK XML image data file.
+  
+   @param[in]   solver     Solver whose state to output.
+   @param[in]   filename   Destination filename.
+   @param[in]   x_min      Minimum X coordinate of grid.
+   @param[in]   x_max      Maximum X coordinate of grid.
+   @param[in]   y_min      Minimum Y coordinate of grid.
+   @param[in]   y_max      Maximum Y coordinate of grid.
+   @param[in]   z_min      Minimum Z coordinate of grid.
+   @param[in]   z_max      Maximum Z coordinate of grid.
+   @param[in]   nx         Number of grid points in X-direction.
+   @param[in]   ny         Number of grid points in Y-direction.
+   @param[in]   nz         Number of grid points in Z-direction.
+   
+   @returns true on success.
+*/
+bool
+VTKImageFieldWriter::write_velocity_field(const Solver &solver, const std::string &filename,
+                                          double x_min, double x_max,
+                                          double y_min, double y_max,
+                                          double z_min, double z_max,
+                                          int nx, int ny, int nz)
+{
+    VORTEXJE_LOG(solver.logger, Logger::Info, "Solver: Computing and saving velocity vector field to " << filename << ".");
+    
+    double dx, dy, dz;
+    if (nx > 1) dx = (x_max - x_min)/(nx - 1);
+    else dx = 0;
+    if (ny > 1) dy = (y_max - y_min)/(ny - 1);
+    else dy = 0;
+    if (nz > 1) dz = (z_max - z_min)/(nz - 1);
+    else dz = 0;
+
+    // Write output in VTK XML format:
+    ofstream f;
+    f.open(filename.c_str(), ios::out | ios::binary);
+    
+    write_header(f, "Velocity", "Vectors", 3, x_min, y_min, z_min, dx, dy, dz, nx, ny, nz);
+    
+    // Velocity vector field.  The field is evaluated and written one Z-slice at a time:
+    for (int i = 0; i < nz; i++) {
+        Matrix3Xd velocities = solver.velocity(grid_slice(x_min, y_min, z_min + i * dz, dx, dy, nx, ny));
+        
+        f.write((const char *) velocities.data(), velocities.size() * sizeof(double));
+    }
+    
+    write_footer(f);
+    
+    // Close file:
+    f.close();
+    
+    // Done:
+    return !f.fail();
+}
+
+/**
+   Logs the velocity potential scalar field into a VTK XML image data file.
+  
+   @param[in]   solver     Solver whose state to output.
+   @param[in]   filename   Destination filename.
+   @param[in]   x_min      Minimum X coordinate of grid.
+   @param[in]   x_max      Maximum X coordinate of grid.
+   @param[in]   y_min      Minimum Y coordinate of grid.
+   @param[in]   y_max      Maximum Y coordinate of grid.
+   @param[in]   z_min      Minimum Z coordinate of grid.
+   @param[in]   z_max      Maximum Z coordinate of grid.
+   @param[in]   dx         Grid step size in X-direction.
+   @param[in]   dy         Grid step size in Y-direction.
+   @param[in]   dz         Grid step size in Z-direction.
+   
+   @returns true on success.
+*/
+bool
+VTKImageFieldWriter::write_velocity_potential_field(const Solver &solver, const std::string &filename,
+                                                    double x_min, double x_max,
+                                                    double y_min, double y_max,
+                                                    double z_min, double z_max,
+                                                    double dx, double dy, double dz)
+{
+    VORTEXJE_LOG(solver.logger, Logger::Info, "Solver: Computing and saving velocity potential field to " << filename << ".");
+
+    int nx = round((x_max - x_min) / dx) + 1;
+    int ny = round((y_max - y_min) / dy) + 1;
+    int nz = round((z_max - z_min) / dz) + 1;
+    
+    // Write output in VTK XML format:
+    ofstream f;
+    f.open(filename.c_str(), ios::out | ios::binary);
+    
+    write_header(f, "VelocityPotential", "Scalars", 1, x_min, y_min, z_min, dx, dy, dz, nx, ny, nz);
+    
+    // Velocity potential field.  The field is evaluated and written one Z-slice at a time:
+    for (int i = 0; i < nz; i++) {
+        VectorXd potentials = solver.velocity_potential(grid_slice(x_min, y_min, z_min + i * dz, dx, dy, nx, ny));
+        
+        f.write((const char *) potentials.data(), potentials.size() * sizeof(double));
+    }
+    
+    write_footer(f);
+    
+    // Close file:
+    f.close();
+    
+    // Done:
+    return !f.fail();
+}
+
+/**
+   Write XML header for VTK image data output file, up to and including the size prefix of the appended data array.
+*/
+void
+VTKImageFieldWriter::write_header(ofstream &f,
+                                  const std::string &array_name, const char *attribute, int n_components,
+                                  double x_min, double y_min, double z_min,
+                                  double dx, double dy, double dz,
+                                  int nx, int ny, int nz) const
+{
+    // Determine the byte order of this machine:
+    const uint16_t byte_order_probe = 1;
+    const char *byte_order;
+    if (*((const uint8_t *) &byte_order_probe) == 1)
+        byte_order = "LittleEndian";
+    else
+        byte_order = "BigEndian";
+    
+    f.precision(17);
+    
+    f << "<?xml version=\"1.0\"?>" << endl;
+    f << "<VTKFile type=\"ImageData\" version=\"1.0\" byte_order=\"" << byte_order << "\" header_type=\"UInt64\">" << endl;
+    f << "  <ImageData WholeExtent=\"0 " << nx - 1 << " 0 " << ny - 1 << " 0 " << nz - 1 << "\"";
+    f << " Origin=\"" << x_min << " " << y_min << " " << z_min << "\"";
+    f << " Spacing=\"" << dx << " " << dy << " " << dz << "\">" << endl;
+    f << "    <Piece Extent=\"0 " << nx - 1 << " 0 " << ny - 1 << " 0 " << nz - 1 << "\">" << endl;
+    f << "      <PointData " << attribute << "=\"" << array_name << "\">" << endl;
+    f << "        <DataArray type=\"Float64\" Name=\"" << array_name << "\" NumberOfComponents=\"" << n_components << "\" format=\"appended\" offset=\"0\"/>" << endl;
+    f << "      </PointData>" << endl;
+    f << "      <CellData>" << endl;
+    f << "      </CellData>" << endl;
+    f << "    </Piece>" << endl;
+    f << "  </ImageData>" << endl;
+    f << "  <AppendedData encoding=\"raw\">" << endl;
+    f << "   _";
+    
+    uint64_t n_bytes = (uint64_t) nx * ny * nz * n_components * sizeof(double);
+    f.write((const char *) &n_bytes, sizeof(n_bytes));
+}
+
+/**
+   Write XML footer for VTK image data output file.
+*/
+void
+VTKImageFieldWriter::write_footer(ofstream &f) const
+{
+    f << endl;
+    f << "  </AppendedData>" << endl;
+    f << "</VTKFile>" << endl;
+}
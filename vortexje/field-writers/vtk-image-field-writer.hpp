@@ -0,0 +1,57 @@
+//
+// Vortexje -- VTK XML image data field writer.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#ifndef __VTK_IMAGE_FIELD_WRITER_HPP__
+#define __VTK_IMAGE_FIELD_WRITER_HPP__
+
+#include <string>
+#include <fstream>
+
+#include <vortexje/field-writer.hpp>
+
+namespace Vortexje
+{
+
+/**
+   VTK XML image data (.vti) field file writer.  The field is stored as raw binary appended data, which is written
+   in chunks of one Z-slice of the grid at a time.
+   
+   @brief VTK XML image data field writer.
+*/
+class VTKImageFieldWriter : public FieldWriter
+{
+public:
+    const char *file_extension() const;
+    
+    bool write_velocity_field(const Solver &solver,
+                              const std::string &filename,
+                              double x_min, double x_max,
+                              double y_min, double y_max,
+                              double z_min, double z_max,
+                              int nx, int ny, int nz);
+                              
+    bool write_velocity_potential_field(const Solver &solver,
+                                        const std::string &filename,
+                                        double x_min, double x_max,
+                                        double y_min, double y_max,
+                                        double z_min, double z_max,
+                                        double dx, double dy, double dz);
+                                        
+private:
+    void write_header(std::ofstream &f,
+                      const std::string &array_name, const char *attribute, int n_components,
+                      double x_min, double y_min, double z_min,
+                      double dx, double dy, double dz,
+                      int nx, int ny, int nz) const;
+                      
+    void write_footer(std::ofstream &f) const;
+};
+
+};
+
+#endif // __VTK_IMAGE_FIELD_WRITER_HPP__
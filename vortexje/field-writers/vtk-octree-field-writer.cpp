@@ -0,0 +1,483 @@
+//
+// Vortexje -- VTK adaptive octree field writer.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <stdint.h>
+
+#include <vortexje/field-writers/vtk-octree-field-writer.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+// Number of bits per coordinate of the keys of lattice points and cells:
+#define LATTICE_BITS 21
+
+// Packs integer lattice coordinates into a key:
+static uint64_t
+lattice_key(int i, int j, int k)
+{
+    return (uint64_t) i | ((uint64_t) j << LATTICE_BITS) | ((uint64_t) k << (2 * LATTICE_BITS));
+}
+
+// Clips lattice coordinates to the last point of the grid along the refined axes.  The coarse cells at the far
+// boundaries of the grid may therefore be smaller than the other coarse cells:
+static Vector3i
+clip_to_grid(const Vector3i &p, const int n[3], const bool active[3])
+{
+    Vector3i q = p;
+    for (int a = 0; a < 3; a++) {
+        if (active[a])
+            q(a) = min(q(a), n[a] - 1);
+    }
+
+    return q;
+}
+
+// Checks whether a cell, identified by the lattice coordinates of its first corner, lies outside of the grid:
+static bool
+outside_grid(const Vector3i &p, const int n[3], const bool active[3])
+{
+    for (int a = 0; a < 3; a++) {
+        if (active[a] && p(a) >= n[a] - 1)
+            return true;
+    }
+
+    return false;
+}
+
+namespace {
+
+// Field samples on the points of the finest lattice.  Points are requested as the cells are refined, and evaluated
+// in batches:
+class LatticeSamples
+{
+public:
+    LatticeSamples(const Vector3d &origin, const Vector3d &spacing, int n_components) :
+        origin(origin), spacing(spacing), n_components(n_components), n_evaluated(0) {}
+
+    Vector3d origin;
+    Vector3d spacing;
+
+    int n_components;
+
+    // Lattice coordinates of every point, and field values of every evaluated point:
+    vector<int> lattice;
+    vector<double> values;
+
+    int n_points() const { return lattice.size() / 3; }
+
+    Vector3d point(int id) const
+    {
+        return origin + spacing.cwiseProduct(Vector3d(lattice[3 * id], lattice[3 * id + 1], lattice[3 * id + 2]));
+    }
+
+    // Returns the ID of a lattice point, and queues it for evaluation if it is new:
+    int request(int i, int j, int k)
+    {
+        uint64_t key = lattice_key(i, j, k);
+
+        unordered_map<uint64_t, int>::const_iterator it = ids.find(key);
+        if (it != ids.end())
+            return it->second;
+
+        int id = n_points();
+        ids[key] = id;
+
+        lattice.push_back(i);
+        lattice.push_back(j);
+        lattice.push_back(k);
+
+        return id;
+    }
+
+    // Evaluates all queued points at once:
+    void evaluate(const Solver &solver, bool velocity)
+    {
+        int n_new = n_points() - n_evaluated;
+        if (n_new == 0)
+            return;
+
+        Matrix3Xd points(3, n_new);
+        for (int i = 0; i < n_new; i++)
+            points.col(i) = point(n_evaluated + i);
+
+        if (velocity) {
+            Matrix3Xd velocities = solver.velocity(points);
+            values.insert(values.end(), velocities.data(), velocities.data() + velocities.size());
+
+        } else {
+            VectorXd potentials = solver.velocity_potential(points);
+            values.insert(values.end(), potentials.data(), potentials.data() + potentials.size());
+        }
+
+        n_evaluated = n_points();
+    }
+
+private:
+    unordered_map<uint64_t, int> ids;
+
+    int n_evaluated;
+};
+
+};
+
+/**
+   Constructs a VTKOctreeFieldWriter.
+
+   @param[in]   max_levels            Number of refinement levels between the coarse grid and the requested grid.
+   @param[in]   tolerance             Relative variation of the field across a cell above which the cell is refined.
+   @param[in]   wake_node_threshold   Number of wake nodes in a cell at which the cell is refined.
+*/
+VTKOctreeFieldWriter::VTKOctreeFieldWriter(int max_levels, double tolerance, int wake_node_threshold) :
+    max_levels(max_levels), tolerance(tolerance), wake_node_threshold(wake_node_threshold)
+{
+}
+
+/**
+   Returns the VTK file extension (".vtk").
+
+   @returns The VTK file extension (".vtk").
+*/
+const char *
+VTKOctreeFieldWriter::file_extension() const
+{
+    return ".vtk";
+}
+
+/**
+   Logs the velocity vector field into a VTK file, sampled on an adaptive octree.
+
+   @param[in]   solver     Solver whose state to output.
+   @param[in]   filename   Destination filename.
+   @param[in]   x_min      Minimum X coordinate of grid.
+   @param[in]   x_max      Maximum X coordinate of grid.
+   @param[in]   y_min      Minimum Y coordinate of grid.
+   @param[in]   y_max      Maximum Y coordinate of grid.
+   @param[in]   z_min      Minimum Z coordinate of grid.
+   @param[in]   z_max      Maximum Z coordinate of grid.
+   @param[in]   nx         Number of points of the finest grid in X-direction.
+   @param[in]   ny         Number of points of the finest grid in Y-direction.
+   @param[in]   nz         Number of points of the finest grid in Z-direction.
+
+   @returns true on success.
+*/
+bool
+VTKOctreeFieldWriter::write_velocity_field(const Solver &solver, const std::string &filename,
+                                           double x_min, double x_max,
+                                           double y_min, double y_max,
+                                           double z_min, double z_max,
+                                           int nx, int ny, int nz)
+{
+    VORTEXJE_LOG(solver.logger, Logger::Info, "Solver: Computing and saving adaptive velocity vector field to " << filename << ".");
+
+    double dx = (nx > 1) ? (x_max - x_min) / (nx - 1) : 0.0;
+    double dy = (ny > 1) ? (y_max - y_min) / (ny - 1) : 0.0;
+    double dz = (nz > 1) ? (z_max - z_min) / (nz - 1) : 0.0;
+
+    return write_field(solver, filename, true, x_min, y_min, z_min, dx, dy, dz, nx, ny, nz);
+}
+
+/**
+   Logs the velocity potential scalar field into a VTK file, sampled on an adaptive octree.
+
+   @param[in]   solver     Solver whose state to output.
+   @param[in]   filename   Destination filename.
+   @param[in]   x_min      Minimum X coordinate of grid.
+   @param[in]   x_max      Maximum X coordinate of grid.
+   @param[in]   y_min      Minimum Y coordinate of grid.
+   @param[in]   y_max      Maximum Y coordinate of grid.
+   @param[in]   z_min      Minimum Z coordinate of grid.
+   @param[in]   z_max      Maximum Z coordinate of grid.
+   @param[in]   dx         Step size of the finest grid in X-direction.
+   @param[in]   dy         Step size of the finest grid in Y-direction.
+   @param[in]   dz         Step size of the finest grid in Z-direction.
+
+   @returns true on success.
+*/
+bool
+VTKOctreeFieldWriter::write_velocity_potential_field(const Solver &solver, const std::string &filename,
+                                                     double x_min, double x_max,
+                                                     double y_min, double y_max,
+                                                     double z_min, double z_max,
+                                                     double dx, double dy, double dz)
+{
+    VORTEXJE_LOG(solver.logger, Logger::Info, "Solver: Computing and saving adaptive velocity potential field to " << filename << ".");
+
+    int nx = (dx > 0) ? round((x_max - x_min) / dx) + 1 : 1;
+    int ny = (dy > 0) ? round((y_max - y_min) / dy) + 1 : 1;
+    int nz = (dz > 0) ? round((z_max - z_min) / dz) + 1 : 1;
+
+    return write_field(solver, filename, false, x_min, y_min, z_min, dx, dy, dz, nx, ny, nz);
+}
+
+// Samples the velocity or velocity potential field on an adaptive octree, and writes the leaf cells:
+bool
+VTKOctreeFieldWriter::write_field(const Solver &solver, const std::string &filename, bool velocity,
+                                  double x_min, double y_min, double z_min,
+                                  double dx, double dy, double dz,
+                                  int nx, int ny, int nz)
+{
+    // Size of the coarse cells, in steps of the finest grid, and the refined axes:
+    int n_levels  = max(max_levels, 0);
+    int base_size = 1 << n_levels;
+
+    int n[3]    = {nx, ny, nz};
+    double h[3] = {dx, dy, dz};
+
+    bool active[3];
+    int n_base_cells[3];
+
+    int n_axes = 0;
+    for (int a = 0; a < 3; a++) {
+        active[a]       = (n[a] > 1 && h[a] > 0);
+        n_base_cells[a] = active[a] ? (n[a] - 2) / base_size + 1 : 1;
+
+        if (active[a])
+            n_axes++;
+
+        if ((int64_t) n_base_cells[a] * base_size >= (1 << LATTICE_BITS)) {
+            VORTEXJE_LOG(solver.logger, Logger::Error, "Solver: Field grid is too fine for adaptive sampling.");
+
+            return false;
+        }
+    }
+
+    // Corner and child offsets of a cell, in units of its size along the refined axes:
+    vector<Vector3i> offsets;
+    for (int c = 0; c < 8; c++) {
+        bool valid = true;
+        for (int a = 0; a < 3; a++)
+            if (((c >> a) & 1) && !active[a])
+                valid = false;
+
+        if (valid)
+            offsets.push_back(Vector3i(c & 1, (c >> 1) & 1, (c >> 2) & 1));
+    }
+
+    LatticeSamples samples(Vector3d(x_min, y_min, z_min), Vector3d(dx, dy, dz), velocity ? 3 : 1);
+
+    // Wake nodes, in lattice coordinates:
+    vector<Vector3d, Eigen::aligned_allocator<Vector3d> > wake_nodes;
+    if (wake_node_threshold > 0) {
+        vector<shared_ptr<Solver::BodyData> >::const_iterator bdi;
+        for (bdi = solver.bodies.begin(); bdi != solver.bodies.end(); bdi++) {
+            vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
+            for (lsi = (*bdi)->body->lifting_surfaces.begin(); lsi != (*bdi)->body->lifting_surfaces.end(); lsi++) {
+                const shared_ptr<Wake> &wake = (*lsi)->wake;
+
+                for (int i = 0; i < wake->n_nodes(); i++) {
+                    Vector3d x = wake->nodes[i] - samples.origin;
+
+                    bool inside = true;
+                    for (int a = 0; a < 3; a++) {
+                        x(a) = active[a] ? x(a) / h[a] : 0.0;
+
+                        if (x(a) < 0 || x(a) > n[a] - 1)
+                            inside = false;
+                    }
+
+                    if (inside)
+                        wake_nodes.push_back(x);
+                }
+            }
+        }
+    }
+
+    // Coarse cells, identified by the lattice coordinates of their first corner:
+    vector<Vector3i> cells;
+    for (int k = 0; k < n_base_cells[2]; k++)
+        for (int j = 0; j < n_base_cells[1]; j++)
+            for (int i = 0; i < n_base_cells[0]; i++)
+                cells.push_back(Vector3i(i, j, k) * base_size);
+
+    vector<vector<int> > cell_corners;
+    for (int l = 0; l < (int) cells.size(); l++) {
+        vector<int> corners;
+        for (int c = 0; c < (int) offsets.size(); c++) {
+            Vector3i p = clip_to_grid(cells[l] + offsets[c] * base_size, n, active);
+            corners.push_back(samples.request(p(0), p(1), p(2)));
+        }
+        cell_corners.push_back(corners);
+    }
+
+    samples.evaluate(solver, velocity);
+
+    // Reference magnitude of the field:
+    double reference = 0.0;
+    if (velocity) {
+        reference = solver.freestream_velocity.norm();
+        for (int i = 0; i < samples.n_points(); i++)
+            reference = max(reference, Map<const Vector3d>(&samples.values[3 * i]).norm());
+
+    } else if (samples.n_points() > 0) {
+        double phi_min = *min_element(samples.values.begin(), samples.values.end());
+        double phi_max = *max_element(samples.values.begin(), samples.values.end());
+
+        reference = phi_max - phi_min;
+    }
+
+    double threshold = tolerance * reference;
+
+    // Refine level by level:
+    vector<vector<int> > leaves;
+
+    for (int level = 0; !cells.empty(); level++) {
+        int size = base_size >> level;
+
+        // The finest level is never refined:
+        if (size == 1 || n_axes == 0) {
+            leaves.insert(leaves.end(), cell_corners.begin(), cell_corners.end());
+
+            break;
+        }
+
+        // Number of wake nodes per cell of this level:
+        unordered_map<uint64_t, int> wake_node_counts;
+        for (int i = 0; i < (int) wake_nodes.size(); i++) {
+            int c[3];
+            for (int a = 0; a < 3; a++)
+                c[a] = active[a] ? min((int) floor(wake_nodes[i](a) / size), (n[a] - 2) / size) : 0;
+
+            wake_node_counts[lattice_key(c[0] * size, c[1] * size, c[2] * size)]++;
+        }
+
+        vector<Vector3i> next_cells;
+        vector<vector<int> > next_cell_corners;
+
+        for (int l = 0; l < (int) cells.size(); l++) {
+            const vector<int> &corners = cell_corners[l];
+
+            bool refine = false;
+
+            // Wake nodes:
+            if (wake_node_threshold > 0) {
+                unordered_map<uint64_t, int>::const_iterator it = wake_node_counts.find(lattice_key(cells[l](0), cells[l](1), cells[l](2)));
+                if (it != wake_node_counts.end() && it->second >= wake_node_threshold)
+                    refine = true;
+            }
+
+            // Variation of the field across the cell:
+            if (!refine) {
+                int n_components = samples.n_components;
+
+                VectorXd mean = VectorXd::Zero(n_components);
+                for (int c = 0; c < (int) corners.size(); c++)
+                    mean += Map<const VectorXd>(&samples.values[n_components * corners[c]], n_components);
+                mean /= corners.size();
+
+                for (int c = 0; c < (int) corners.size(); c++) {
+                    if ((Map<const VectorXd>(&samples.values[n_components * corners[c]], n_components) - mean).norm() > threshold) {
+                        refine = true;
+                        break;
+                    }
+                }
+            }
+
+            if (!refine) {
+                leaves.push_back(corners);
+
+                continue;
+            }
+
+            // Split the cell, and request the corners of its children:
+            int child_size = size / 2;
+
+            for (int m = 0; m < (int) offsets.size(); m++) {
+                Vector3i child = cells[l] + offsets[m] * child_size;
+                if (outside_grid(child, n, active))
+                    continue;
+
+                vector<int> child_corners;
+                for (int c = 0; c < (int) offsets.size(); c++) {
+                    Vector3i p = clip_to_grid(child + offsets[c] * child_size, n, active);
+                    child_corners.push_back(samples.request(p(0), p(1), p(2)));
+                }
+
+                next_cells.push_back(child);
+                next_cell_corners.push_back(child_corners);
+            }
+        }
+
+        samples.evaluate(solver, velocity);
+
+        cells.swap(next_cells);
+        cell_corners.swap(next_cell_corners);
+    }
+
+    int n_grid_points = (active[0] ? n[0] : 1) * (active[1] ? n[1] : 1) * (active[2] ? n[2] : 1);
+
+    VORTEXJE_LOG(solver.logger, Logger::Info, "Solver: Sampled " << samples.n_points() << " of " << n_grid_points << " grid points, in " << leaves.size() << " cells.");
+
+    solver.profiler->increment("field_evaluations", samples.n_points());
+
+    // Write output in VTK format:
+    ofstream f;
+    f.open(filename.c_str());
+    if (!f.is_open()) {
+        VORTEXJE_LOG(solver.logger, Logger::Error, "Solver: Could not open " << filename << " for writing.");
+
+        return false;
+    }
+
+    f << "# vtk DataFile Version 2.0" << endl;
+    f << "FieldData" << endl;
+    f << "ASCII" << endl;
+    f << "DATASET UNSTRUCTURED_GRID" << endl;
+
+    ostringstream buffer;
+    buffer.precision(f.precision());
+
+    buffer << "POINTS " << samples.n_points() << " double" << '\n';
+    for (int i = 0; i < samples.n_points(); i++) {
+        Vector3d x = samples.point(i);
+        buffer << x(0) << ' ' << x(1) << ' ' << x(2) << '\n';
+    }
+
+    // The corners of every cell follow the ordering of VTK voxels, pixels, and lines, with X running fastest:
+    buffer << '\n' << "CELLS " << leaves.size() << " " << leaves.size() * (1 + offsets.size()) << '\n';
+    for (int l = 0; l < (int) leaves.size(); l++) {
+        buffer << offsets.size();
+        for (int c = 0; c < (int) offsets.size(); c++)
+            buffer << ' ' << leaves[l][c];
+        buffer << '\n';
+    }
+
+    static const int cell_types[4] = {1, 3, 8, 11};
+
+    buffer << '\n' << "CELL_TYPES " << leaves.size() << '\n';
+    for (int l = 0; l < (int) leaves.size(); l++)
+        buffer << cell_types[n_axes] << '\n';
+
+    buffer << '\n' << "POINT_DATA " << samples.n_points() << '\n';
+
+    if (velocity) {
+        buffer << "VECTORS Velocity double" << '\n';
+        for (int i = 0; i < samples.n_points(); i++)
+            buffer << samples.values[3 * i] << ' ' << samples.values[3 * i + 1] << ' ' << samples.values[3 * i + 2] << '\n';
+
+    } else {
+        buffer << "SCALARS VelocityPotential double 1" << '\n';
+        buffer << "LOOKUP_TABLE default" << '\n';
+        for (int i = 0; i < samples.n_points(); i++)
+            buffer << samples.values[i] << '\n';
+    }
+
+    f << buffer.str();
+
+    // Close file:
+    f.close();
+
+    // Done:
+    return true;
+}
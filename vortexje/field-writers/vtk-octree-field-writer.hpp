@@ -0,0 +1,85 @@
+//
+// Vortexje -- VTK adaptive octree field writer.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#ifndef __VTK_OCTREE_FIELD_WRITER_HPP__
+#define __VTK_OCTREE_FIELD_WRITER_HPP__
+
+#include <string>
+#include <fstream>
+#include <vector>
+
+#include <vortexje/field-writer.hpp>
+
+namespace Vortexje
+{
+
+/**
+   VTK unstructured grid field file writer, sampling the field on an adaptively refined octree.
+
+   The requested grid defines the finest sample spacing.  The field is first evaluated on the corners of a coarse
+   grid of cells, max_levels refinements coarser than the requested grid.  Cells are then split into octants, level
+   by level, wherever the field varies across the corners of the cell by more than the tolerance, or where the cell
+   contains at least wake_node_threshold wake nodes.  All corners that are new at a level are evaluated in a single
+   batched Solver evaluation.  Away from the bodies and the wakes, the flow is therefore represented by large cells,
+   within which visualization tools interpolate, at a fraction of the evaluations of the uniform grid.
+
+   The leaf cells are written as VTK voxels, and the field values as point data of their corners.  Grid dimensions
+   with a single point are not refined, so that planar grids give rise to pixels.  The coarse cells at the far
+   boundaries of the grid are clipped to it, so that no points beyond the requested grid are sampled.
+
+   @brief VTK adaptive octree field writer.
+*/
+class VTKOctreeFieldWriter : public FieldWriter
+{
+public:
+    VTKOctreeFieldWriter(int max_levels = 4, double tolerance = 0.01, int wake_node_threshold = 1);
+
+    /**
+       Number of refinement levels between the coarse grid and the requested grid.
+    */
+    int max_levels;
+
+    /**
+       Cells are refined if a corner value deviates from the mean of the corner values of the cell by more than this
+       fraction of the reference magnitude of the field.  For the velocity, the reference magnitude is the largest of
+       the freestream velocity and the velocities on the coarse grid;  for the velocity potential, it is the range of
+       the potential on the coarse grid.
+    */
+    double tolerance;
+
+    /**
+       Cells containing at least this number of wake nodes are refined.  Zero disables wake-based refinement.
+    */
+    int wake_node_threshold;
+
+    const char *file_extension() const;
+
+    bool write_velocity_field(const Solver &solver,
+                              const std::string &filename,
+                              double x_min, double x_max,
+                              double y_min, double y_max,
+                              double z_min, double z_max,
+                              int nx, int ny, int nz);
+
+    bool write_velocity_potential_field(const Solver &solver,
+                                        const std::string &filename,
+                                        double x_min, double x_max,
+                                        double y_min, double y_max,
+                                        double z_min, double z_max,
+                                        double dx, double dy, double dz);
+
+private:
+    bool write_field(const Solver &solver, const std::string &filename, bool velocity,
+                     double x_min, double y_min, double z_min,
+                     double dx, double dy, double dz,
+                     int nx, int ny, int nz);
+};
+
+};
+
+#endif // __VTK_OCTREE_FIELD_WRITER_HPP__
@@ -0,0 +1,343 @@
+//
+// Vortexje -- Hierarchical matrix.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <algorithm>
+#include <cmath>
+
+#include <vortexje/hierarchical-matrix.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+// Comparison of points along a coordinate axis, by index:
+class PointIndexComparator
+{
+public:
+    PointIndexComparator(const vector<Vector3d, Eigen::aligned_allocator<Vector3d> > &points, int axis) : points(points), axis(axis) {}
+
+    bool operator()(int a, int b) const
+    {
+        return points[a](axis) < points[b](axis);
+    }
+
+private:
+    const vector<Vector3d, Eigen::aligned_allocator<Vector3d> > &points;
+    int axis;
+};
+
+/**
+   Constructs a HierarchicalMatrix, and organizes the given points in a cluster tree.  The matrix entries are
+   computed by compute().
+
+   @param[in]   points          Points associated with the rows and columns of the matrix.
+   @param[in]   leaf_size       Maximum number of points per leaf of the cluster tree.
+   @param[in]   admissibility   Maximum ratio of cluster diameter to cluster distance for low-rank approximation.
+*/
+HierarchicalMatrix::HierarchicalMatrix(const vector<Vector3d, Eigen::aligned_allocator<Vector3d> > &points, int leaf_size, double admissibility)
+    : leaf_size(leaf_size), admissibility(admissibility), points(points)
+{
+    for (int i = 0; i < (int) points.size(); i++)
+        permutation.push_back(i);
+
+    if (points.size() > 0) {
+        build_cluster(0, points.size());
+
+        build_blocks(0, 0);
+    }
+}
+
+// Recursively builds the cluster tree for the given range of permuted points, and returns the index of the new cluster.
+int
+HierarchicalMatrix::build_cluster(int begin, int end)
+{
+    int index = clusters.size();
+    clusters.push_back(Cluster());
+
+    // Bounding box:
+    Vector3d lower = points[permutation[begin]];
+    Vector3d upper = points[permutation[begin]];
+    for (int i = begin + 1; i < end; i++) {
+        lower = lower.cwiseMin(points[permutation[i]]);
+        upper = upper.cwiseMax(points[permutation[i]]);
+    }
+
+    Cluster &cluster = clusters[index];
+
+    cluster.begin  = begin;
+    cluster.end    = end;
+    cluster.center = 0.5 * (lower + upper);
+    cluster.radius = 0.5 * (upper - lower).norm();
+
+    cluster.children[0] = -1;
+    cluster.children[1] = -1;
+
+    // Split along the longest axis, at the median:
+    if (end - begin > leaf_size) {
+        int axis;
+        (upper - lower).maxCoeff(&axis);
+
+        int middle = (begin + end) / 2;
+
+        nth_element(permutation.begin() + begin, permutation.begin() + middle, permutation.begin() + end, PointIndexComparator(points, axis));
+
+        // Note that the cluster reference may be invalidated by the recursion.
+        int child_a = build_cluster(begin, middle);
+        int child_b = build_cluster(middle, end);
+
+        clusters[index].children[0] = child_a;
+        clusters[index].children[1] = child_b;
+    }
+
+    return index;
+}
+
+// Checks whether two clusters are well-separated.
+bool
+HierarchicalMatrix::admissible(const Cluster &row_cluster, const Cluster &col_cluster) const
+{
+    double distance = (row_cluster.center - col_cluster.center).norm() - row_cluster.radius - col_cluster.radius;
+    if (distance <= 0.0)
+        return false;
+
+    return 2 * min(row_cluster.radius, col_cluster.radius) <= admissibility * distance;
+}
+
+// Recursively partitions the matrix into blocks.
+void
+HierarchicalMatrix::build_blocks(int row_cluster, int col_cluster)
+{
+    const Cluster &r = clusters[row_cluster];
+    const Cluster &c = clusters[col_cluster];
+
+    bool is_admissible = admissible(r, c);
+
+    if (is_admissible || r.children[0] < 0 || c.children[0] < 0) {
+        Block block;
+
+        block.row_begin = r.begin;
+        block.row_end   = r.end;
+        block.col_begin = c.begin;
+        block.col_end   = c.end;
+
+        block.low_rank  = is_admissible;
+
+        blocks.push_back(block);
+
+    } else {
+        int row_children[2] = { r.children[0], r.children[1] };
+        int col_children[2] = { c.children[0], c.children[1] };
+
+        for (int k = 0; k < 2; k++)
+            for (int l = 0; l < 2; l++)
+                build_blocks(row_children[k], col_children[l]);
+    }
+}
+
+/**
+   Computes all blocks of this matrix.
+
+   @param[in]   entry       Function computing the matrix entries.
+   @param[in]   tolerance   Relative tolerance of the low-rank approximations.
+*/
+void
+HierarchicalMatrix::compute(const EntryFunction &entry, double tolerance)
+{
+    int i;
+
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(dynamic, 1)
+        for (i = 0; i < (int) blocks.size(); i++) {
+            Block &block = blocks[i];
+
+            if (block.low_rank) {
+                // Fall back to a dense block if the block does not compress well:
+                if (!compute_low_rank_block(block, entry, tolerance))
+                    block.low_rank = false;
+            }
+
+            if (!block.low_rank)
+                compute_dense_block(block, entry);
+        }
+    }
+}
+
+// Computes a dense block.
+void
+HierarchicalMatrix::compute_dense_block(Block &block, const EntryFunction &entry) const
+{
+    int m = block.row_end - block.row_begin;
+    int n = block.col_end - block.col_begin;
+
+    block.dense.resize(m, n);
+
+    for (int i = 0; i < m; i++)
+        for (int j = 0; j < n; j++)
+            block.dense(i, j) = entry(permutation[block.row_begin + i], permutation[block.col_begin + j]);
+
+    block.U.resize(0, 0);
+    block.V.resize(0, 0);
+}
+
+// Computes a low-rank block, block = U V^T, using ACA with partial pivoting.  Returns false if the rank required
+// to reach the given tolerance is too large for the approximation to pay off.
+bool
+HierarchicalMatrix::compute_low_rank_block(Block &block, const EntryFunction &entry, double tolerance) const
+{
+    int m = block.row_end - block.row_begin;
+    int n = block.col_end - block.col_begin;
+
+    int max_rank = m * n / (m + n);
+
+    vector<VectorXd> us, vs;
+    vector<bool> used_rows(m, false);
+
+    double approximation_squared_norm = 0.0;
+
+    int pivot_row = 0;
+
+    while (true) {
+        used_rows[pivot_row] = true;
+
+        // Residual row:
+        VectorXd row(n);
+        for (int j = 0; j < n; j++)
+            row(j) = entry(permutation[block.row_begin + pivot_row], permutation[block.col_begin + j]);
+        for (int k = 0; k < (int) us.size(); k++)
+            row -= us[k](pivot_row) * vs[k];
+
+        int pivot_col;
+        double pivot = row.cwiseAbs().maxCoeff(&pivot_col);
+
+        if (pivot > 0.0) {
+            VectorXd v = row / row(pivot_col);
+
+            // Residual column:
+            VectorXd u(m);
+            for (int i = 0; i < m; i++)
+                u(i) = entry(permutation[block.row_begin + i], permutation[block.col_begin + pivot_col]);
+            for (int k = 0; k < (int) us.size(); k++)
+                u -= vs[k](pivot_col) * us[k];
+
+            // Update the Frobenius norm of the approximation:
+            for (int k = 0; k < (int) us.size(); k++)
+                approximation_squared_norm += 2 * u.dot(us[k]) * v.dot(vs[k]);
+            approximation_squared_norm += u.squaredNorm() * v.squaredNorm();
+
+            us.push_back(u);
+            vs.push_back(v);
+
+            // Converged?
+            if (u.norm() * v.norm() <= tolerance * sqrt(fabs(approximation_squared_norm)))
+                break;
+
+            if ((int) us.size() > max_rank)
+                return false;
+
+            // Next pivot row:
+            pivot_row = -1;
+            for (int i = 0; i < m; i++) {
+                if (!used_rows[i] && (pivot_row < 0 || fabs(u(i)) > fabs(u(pivot_row))))
+                    pivot_row = i;
+            }
+
+        } else {
+            // Zero residual row.  Try the next unused row:
+            pivot_row = -1;
+            for (int i = 0; i < m; i++) {
+                if (!used_rows[i]) {
+                    pivot_row = i;
+                    break;
+                }
+            }
+        }
+
+        if (pivot_row < 0)
+            break;
+    }
+
+    block.U.resize(m, us.size());
+    block.V.resize(n, vs.size());
+    for (int k = 0; k < (int) us.size(); k++) {
+        block.U.col(k) = us[k];
+        block.V.col(k) = vs[k];
+    }
+
+    block.dense.resize(0, 0);
+
+    return true;
+}
+
+/**
+   Computes the product of this matrix with a vector.
+
+   @param[in]   x   Vector.
+
+   @returns Matrix-vector product.
+*/
+VectorXd
+HierarchicalMatrix::operator*(const VectorXd &x) const
+{
+    // Permute:
+    VectorXd x_permuted(x.size());
+    for (int i = 0; i < (int) permutation.size(); i++)
+        x_permuted(i) = x(permutation[i]);
+
+    // Evaluate the product of every block:
+    vector<VectorXd> block_products(blocks.size());
+
+    #pragma omp parallel
+    {
+        int i;
+
+        #pragma omp for schedule(dynamic, 1)
+        for (i = 0; i < (int) blocks.size(); i++) {
+            const Block &block = blocks[i];
+
+            int n = block.col_end - block.col_begin;
+
+            if (block.low_rank)
+                block_products[i] = block.U * (block.V.transpose() * x_permuted.segment(block.col_begin, n));
+            else
+                block_products[i] = block.dense * x_permuted.segment(block.col_begin, n);
+        }
+    }
+
+    // Sum the block products serially, in block order, so that the product does not depend on the number of threads
+    // or on the scheduling:
+    VectorXd y_permuted = VectorXd::Zero(x.size());
+    for (int i = 0; i < (int) blocks.size(); i++)
+        y_permuted.segment(blocks[i].row_begin, blocks[i].row_end - blocks[i].row_begin) += block_products[i];
+
+    // Permute back:
+    VectorXd y(x.size());
+    for (int i = 0; i < (int) permutation.size(); i++)
+        y(permutation[i]) = y_permuted(i);
+
+    return y;
+}
+
+/**
+   Returns the ratio of the number of stored coefficients to the number of coefficients of the full matrix.
+
+   @returns Compression ratio.
+*/
+double
+HierarchicalMatrix::compression_ratio() const
+{
+    double n_stored = 0.0;
+
+    vector<Block>::const_iterator bi;
+    for (bi = blocks.begin(); bi != blocks.end(); bi++)
+        n_stored += bi->dense.size() + bi->U.size() + bi->V.size();
+
+    double n = permutation.size();
+
+    return n_stored / (n * n);
+}
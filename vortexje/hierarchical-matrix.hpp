@@ -0,0 +1,117 @@
+//
+// Vortexje -- Hierarchical matrix.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#ifndef __HIERARCHICAL_MATRIX_HPP__
+#define __HIERARCHICAL_MATRIX_HPP__
+
+#include <vector>
+#include <functional>
+
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+namespace Vortexje
+{
+
+/**
+   Hierarchical matrix approximation of a square matrix of influence coefficients.
+
+   The rows and columns are associated with points in space, e.g., panel collocation points.  The points are
+   organized in a binary cluster tree.  Blocks of the matrix that couple well-separated clusters are approximated
+   by low-rank factorizations, computed using adaptive cross approximation (ACA) with partial pivoting.  All
+   other blocks are stored densely.  The matrix entries are computed on demand, so that the full matrix is never
+   formed.
+
+   @brief Hierarchical matrix.
+*/
+class HierarchicalMatrix
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    /**
+       Function computing a single matrix entry, given its row and column index.
+    */
+    typedef std::function<double (int, int)> EntryFunction;
+
+    HierarchicalMatrix(const std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > &points,
+                       int leaf_size = 32, double admissibility = 1.0);
+
+    void compute(const EntryFunction &entry, double tolerance);
+
+    Eigen::VectorXd operator*(const Eigen::VectorXd &x) const;
+
+    /**
+       Returns the number of rows, and columns, of this matrix.
+
+       @returns Number of rows.
+    */
+    int rows() const { return (int) permutation.size(); }
+
+    double compression_ratio() const;
+
+private:
+    int leaf_size;
+    double admissibility;
+
+    class Cluster {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        Cluster() : begin(0), end(0), center(Eigen::Vector3d::Zero()), radius(0.0)
+        {
+            children[0] = -1;
+            children[1] = -1;
+        }
+
+        int begin;
+        int end;
+
+        int children[2];
+
+        Eigen::Vector3d center;
+        double radius;
+    };
+
+    class Block {
+    public:
+        int row_begin;
+        int row_end;
+        int col_begin;
+        int col_end;
+
+        bool low_rank;
+
+        Eigen::MatrixXd dense;
+
+        Eigen::MatrixXd U;
+        Eigen::MatrixXd V;
+    };
+
+    std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > points;
+
+    std::vector<int> permutation;
+
+    std::vector<Cluster, Eigen::aligned_allocator<Cluster> > clusters;
+
+    std::vector<Block> blocks;
+
+    int build_cluster(int begin, int end);
+
+    bool admissible(const Cluster &row_cluster, const Cluster &col_cluster) const;
+
+    void build_blocks(int row_cluster, int col_cluster);
+
+    void compute_dense_block(Block &block, const EntryFunction &entry) const;
+
+    bool compute_low_rank_block(Block &block, const EntryFunction &entry, double tolerance) const;
+};
+
+};
+
+#endif // __HIERARCHICAL_MATRIX_HPP__
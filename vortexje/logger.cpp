@@ -0,0 +1,108 @@
+//
+// Vortexje -- Diagnostic message logging.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <vortexje/logger.hpp>
+
+using namespace std;
+using namespace Vortexje;
+
+// The default logger, shared by all objects that were not given a logger of their own.  It is created upon first
+// use, so that it is available to objects constructed during static initialization:
+static mutex default_logger_mutex;
+
+static shared_ptr<Logger> &
+default_logger_instance()
+{
+    static shared_ptr<Logger> logger(new StreamLogger());
+    
+    return logger;
+}
+
+/**
+   Constructs a Logger.
+
+   @param[in]   level   Threshold level.
+*/
+Logger::Logger(Level level) : level(level)
+{
+}
+
+/**
+   Returns the default logger.  Newly constructed solvers and surfaces log to this logger.  Unless replaced using
+   set_default_logger(), this is a StreamLogger writing to standard output and standard error.
+
+   @returns Default logger.
+*/
+shared_ptr<Logger>
+Logger::default_logger()
+{
+    lock_guard<mutex> lock(default_logger_mutex);
+
+    return default_logger_instance();
+}
+
+/**
+   Replaces the default logger.  Objects constructed before this call keep their current logger.
+
+   @param[in]   logger   New default logger.
+*/
+void
+Logger::set_default_logger(const shared_ptr<Logger> &logger)
+{
+    lock_guard<mutex> lock(default_logger_mutex);
+
+    default_logger_instance() = logger;
+}
+
+/**
+   Constructs a StreamLogger.
+
+   @param[in]   out              Stream for debug and informational messages.
+   @param[in]   err              Stream for warnings and errors.
+   @param[in]   level            Threshold level.
+   @param[in]   flush_messages   Whether or not to flush the output stream after every message.
+*/
+StreamLogger::StreamLogger(ostream &out, ostream &err, Level level, bool flush_messages) :
+    Logger(level), flush_messages(flush_messages), out(out), err(err)
+{
+}
+
+/**
+   Writes a message.
+
+   @param[in]   message_level   Message level.
+   @param[in]   message         Message, without trailing newline.
+*/
+void
+StreamLogger::write(Level message_level, const string &message)
+{
+    lock_guard<std::mutex> lock(mutex);
+
+    if (message_level >= Warning) {
+        out.flush();
+
+        err << message << endl;
+
+    } else {
+        out << message << '\n';
+
+        if (flush_messages)
+            out.flush();
+    }
+}
+
+/**
+   Flushes the output stream.
+*/
+void
+StreamLogger::flush()
+{
+    lock_guard<std::mutex> lock(mutex);
+
+    out.flush();
+}
@@ -0,0 +1,132 @@
+//
+// Vortexje -- Diagnostic message logging.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#ifndef __LOGGER_HPP__
+#define __LOGGER_HPP__
+
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+/**
+   Formats a message using stream output operators, and writes it to a Logger.  The message is only formatted if its
+   level is at or above the threshold of the logger, so that suppressed messages cost a single comparison.
+
+   @param[in]   logger    Pointer to the Logger.
+   @param[in]   level     Message level, e.g., Logger::Info.
+   @param[in]   message   Message, e.g., "Surface " << id << ": Loading."
+*/
+#define VORTEXJE_LOG(logger, level, message)                    \
+    do {                                                        \
+        if ((logger)->enabled(level)) {                         \
+            std::ostringstream vortexje_log_stream;             \
+            vortexje_log_stream << message;                     \
+            (logger)->write(level, vortexje_log_stream.str());  \
+        }                                                       \
+    } while (0)
+
+namespace Vortexje
+{
+
+/**
+   Logger base class.
+
+   All diagnostic messages of the library are routed through a Logger.  Messages below the threshold level are
+   discarded before they are formatted.  Setting the threshold to Quiet suppresses all messages.
+
+   @brief Logger base class.
+*/
+class Logger
+{
+public:
+    /**
+       Message levels, in increasing order of severity.
+    */
+    enum Level {
+        Debug,
+        Info,
+        Warning,
+        Error,
+        Quiet
+    };
+
+    Logger(Level level = Info);
+
+    /**
+       Destructor.
+    */
+    virtual ~Logger() {};
+
+    /**
+       Threshold level.  Messages below this level are discarded.
+    */
+    Level level;
+
+    /**
+       Returns whether messages of the given level are written.
+
+       @param[in]   message_level   Message level.
+
+       @returns true if messages of the given level are written.
+    */
+    bool enabled(Level message_level) const { return message_level >= level; }
+
+    /**
+       Writes a message.  This is only called for messages at or above the threshold level.
+
+       @param[in]   message_level   Message level.
+       @param[in]   message         Message, without trailing newline.
+    */
+    virtual void write(Level message_level, const std::string &message) = 0;
+
+    /**
+       Writes out any buffered messages.
+    */
+    virtual void flush() {};
+
+    static std::shared_ptr<Logger> default_logger();
+
+    static void set_default_logger(const std::shared_ptr<Logger> &logger);
+};
+
+/**
+   Logger writing to a pair of output streams.
+
+   Debug and informational messages are written to the output stream, warnings and errors to the error stream.
+   Unless flush_messages is set, the output stream is not flushed after every message, so that the messages are
+   buffered by the stream.  The output stream is always flushed before writing to the error stream, so that the order
+   of the messages is preserved.  Messages may be written from multiple threads.
+
+   @brief Stream logger.
+*/
+class StreamLogger : public Logger
+{
+public:
+    StreamLogger(std::ostream &out = std::cout, std::ostream &err = std::cerr, Level level = Info, bool flush_messages = false);
+
+    /**
+       Whether or not to flush the output stream after every message.
+    */
+    bool flush_messages;
+
+    void write(Level message_level, const std::string &message);
+
+    void flush();
+
+private:
+    std::ostream &out;
+    std::ostream &err;
+
+    std::mutex mutex;
+};
+
+};
+
+#endif // __LOGGER_HPP__
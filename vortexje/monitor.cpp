@@ -0,0 +1,395 @@
+//
+// Vortexje -- Probe and load time series.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <algorithm>
+
+#include <vortexje/monitor.hpp>
+#include <vortexje/distributed.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+// Version of the layout of monitor files:
+#define MONITOR_VERSION 1
+
+/**
+   Constructs a Monitor, and starts its background thread.  The file is created upon the first record.
+
+   @param[in]   solver             Solver whose state to record.
+   @param[in]   filename           Destination filename.
+   @param[in]   chunk_length       Number of records per chunk.
+   @param[in]   max_queue_length   Maximum number of chunks waiting to be written.
+*/
+Monitor::Monitor(const Solver &solver, const string &filename, int chunk_length, int max_queue_length) :
+    time(0.0), solver(solver), filename(filename), chunk_length(max(chunk_length, 1)),
+    max_queue_length(max(max_queue_length, 1)), n_columns(0), n_chunk_rows(0), writing(false), stopping(false)
+{
+    thread = std::thread(&Monitor::run, this);
+}
+
+/**
+   Destructor.  Writes all pending records, and stops the background thread.
+*/
+Monitor::~Monitor()
+{
+    queue_chunk();
+
+    {
+        unique_lock<std::mutex> lock(mutex);
+
+        stopping = true;
+    }
+
+    queue_changed.notify_all();
+
+    thread.join();
+}
+
+/**
+   Adds a channel recording the velocity at a set of points.
+
+   @param[in]   name     Channel name.
+   @param[in]   points   Probe points, one per column.
+
+   @returns Channel index, or -1 if recording has already started.
+*/
+int
+Monitor::add_velocity_probes(const string &name, const Eigen::Matrix3Xd &points)
+{
+    Channel channel;
+    channel.name      = name;
+    channel.type      = VelocityProbes;
+    channel.points    = points;
+    channel.n_columns = 3 * points.cols();
+
+    return add_channel(channel);
+}
+
+/**
+   Adds a channel recording the velocity potential at a set of points.
+
+   @param[in]   name     Channel name.
+   @param[in]   points   Probe points, one per column.
+
+   @returns Channel index, or -1 if recording has already started.
+*/
+int
+Monitor::add_velocity_potential_probes(const string &name, const Eigen::Matrix3Xd &points)
+{
+    Channel channel;
+    channel.name      = name;
+    channel.type      = VelocityPotentialProbes;
+    channel.points    = points;
+    channel.n_columns = points.cols();
+
+    return add_channel(channel);
+}
+
+/**
+   Adds a channel recording the force acting on a body.
+
+   @param[in]   name   Channel name.
+   @param[in]   body   Body.
+
+   @returns Channel index, or -1 if recording has already started.
+*/
+int
+Monitor::add_force_monitor(const string &name, const shared_ptr<Body> &body)
+{
+    Channel channel;
+    channel.name      = name;
+    channel.type      = Force;
+    channel.body      = body;
+    channel.n_columns = 3;
+
+    return add_channel(channel);
+}
+
+/**
+   Adds a channel recording the moment acting on a body.
+
+   @param[in]   name   Channel name.
+   @param[in]   body   Body.
+   @param[in]   x      Point around which the moment is computed.
+
+   @returns Channel index, or -1 if recording has already started.
+*/
+int
+Monitor::add_moment_monitor(const string &name, const shared_ptr<Body> &body, const Eigen::Vector3d &x)
+{
+    Channel channel;
+    channel.name      = name;
+    channel.type      = Moment;
+    channel.body      = body;
+    channel.points    = x;
+    channel.n_columns = 3;
+
+    return add_channel(channel);
+}
+
+// Adds a channel, unless recording has already started:
+int
+Monitor::add_channel(const Channel &channel)
+{
+    if (writer) {
+        VORTEXJE_LOG(solver.logger, Logger::Error, "Monitor: Cannot add channel " << channel.name << " after the first record.");
+
+        return -1;
+    }
+
+    channels.push_back(channel);
+
+    n_columns += channel.n_columns;
+
+    return channels.size() - 1;
+}
+
+/**
+   Evaluates all channels, and appends their values to the time series at the current time.  The time is then
+   advanced by the given time step.  Blocks if the chunk queue is full.
+
+   @param[in]   dt   Time step.
+*/
+void
+Monitor::record(double dt)
+{
+    // In distributed mode, the replicated results are recorded by the first process only:
+    if (Distributed::rank() == 0) {
+        Profiler::Timer timer(solver.profiler, "monitors");
+
+        // Write the header upon the first record:
+        if (!writer) {
+            writer = shared_ptr<CheckpointWriter>(new CheckpointWriter(filename));
+
+            writer->write((int64_t) MONITOR_VERSION);
+            writer->write((int64_t) channels.size());
+
+            vector<Channel>::const_iterator ci;
+            for (ci = channels.begin(); ci != channels.end(); ci++) {
+                writer->write(ci->name);
+                writer->write((int64_t) ci->type);
+                writer->write((int64_t) ci->n_columns);
+            }
+
+            writer->flush();
+
+            if (!writer->good())
+                VORTEXJE_LOG(solver.logger, Logger::Error, "Monitor: Could not open " << filename << " for writing.");
+
+            chunk.reserve(chunk_length * (1 + n_columns));
+        }
+
+        // Evaluate the channels.  All probe points of a channel are evaluated at once:
+        chunk.push_back(time);
+
+        vector<Channel>::const_iterator ci;
+        for (ci = channels.begin(); ci != channels.end(); ci++) {
+            switch (ci->type) {
+            case VelocityProbes:
+                if (ci->points.cols() > 0) {
+                    Matrix3Xd velocities = solver.velocity(ci->points);
+                    chunk.insert(chunk.end(), velocities.data(), velocities.data() + velocities.size());
+                }
+                break;
+
+            case VelocityPotentialProbes:
+                if (ci->points.cols() > 0) {
+                    VectorXd phi = solver.velocity_potential(ci->points);
+                    chunk.insert(chunk.end(), phi.data(), phi.data() + phi.size());
+                }
+                break;
+
+            case Force: {
+                Vector3d F = solver.force(ci->body);
+                chunk.insert(chunk.end(), F.data(), F.data() + 3);
+                break;
+            }
+
+            case Moment: {
+                Vector3d M = solver.moment(ci->body, ci->points.col(0));
+                chunk.insert(chunk.end(), M.data(), M.data() + 3);
+                break;
+            }
+            }
+        }
+
+        solver.profiler->increment("monitor_records");
+
+        n_chunk_rows++;
+        if (n_chunk_rows >= chunk_length)
+            queue_chunk();
+    }
+
+    time += dt;
+}
+
+/**
+   Queues the pending records for writing, and waits until all queued chunks have been written.
+*/
+void
+Monitor::flush()
+{
+    queue_chunk();
+
+    unique_lock<std::mutex> lock(mutex);
+
+    while (queue.size() > 0 || writing)
+        queue_changed.wait(lock);
+}
+
+// Queues the pending records as a chunk.  Blocks if the queue is full:
+void
+Monitor::queue_chunk()
+{
+    if (n_chunk_rows == 0)
+        return;
+
+    shared_ptr<vector<double> > rows = make_shared<vector<double> >();
+    rows->swap(chunk);
+
+    chunk.reserve(chunk_length * (1 + n_columns));
+
+    n_chunk_rows = 0;
+
+    unique_lock<std::mutex> lock(mutex);
+
+    while ((int) queue.size() >= max_queue_length)
+        queue_changed.wait(lock);
+
+    queue.push_back(rows);
+
+    lock.unlock();
+
+    queue_changed.notify_all();
+}
+
+// Background thread:
+void
+Monitor::run()
+{
+    unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        while (queue.size() == 0 && !stopping)
+            queue_changed.wait(lock);
+
+        if (queue.size() == 0)
+            break;
+
+        shared_ptr<vector<double> > rows = queue.front();
+        queue.pop_front();
+
+        writing = true;
+
+        lock.unlock();
+
+        queue_changed.notify_all();
+
+        // Every chunk is a single array record, and is flushed so that readers see complete chunks only:
+        writer->write(*rows);
+        writer->flush();
+
+        lock.lock();
+
+        writing = false;
+
+        queue_changed.notify_all();
+    }
+}
+
+/**
+   Reads a time series from a monitor file.  The file may still be written to; only complete chunks are read.
+
+   @param[in]   filename      Source filename.
+   @param[out]  time_series   Time series.
+
+   @returns true on success.
+*/
+bool
+Monitor::read(const string &filename, TimeSeries &time_series)
+{
+    CheckpointReader reader(filename);
+
+    int64_t version, n_channels;
+    if (!reader.good() || !reader.read(version) || version != MONITOR_VERSION || !reader.read(n_channels) || n_channels < 0) {
+        VORTEXJE_LOG(Logger::default_logger(), Logger::Error, "Monitor: " << filename << " is not a monitor file.");
+
+        return false;
+    }
+
+    time_series.names.clear();
+    time_series.types.clear();
+    time_series.n_columns.clear();
+
+    int n_columns = 0;
+
+    for (int i = 0; i < n_channels; i++) {
+        string name;
+        int64_t type, channel_n_columns;
+        if (!reader.read(name) || !reader.read(type) || !reader.read(channel_n_columns)) {
+            VORTEXJE_LOG(Logger::default_logger(), Logger::Error, "Monitor: Truncated header in " << filename << ".");
+
+            return false;
+        }
+
+        time_series.names.push_back(name);
+        time_series.types.push_back((ChannelType) type);
+        time_series.n_columns.push_back(channel_n_columns);
+
+        n_columns += channel_n_columns;
+    }
+
+    // Read chunks until the end of the file, or until an incomplete chunk:
+    vector<double> rows, chunk;
+    while (reader.read(chunk) && chunk.size() % (1 + n_columns) == 0)
+        rows.insert(rows.end(), chunk.begin(), chunk.end());
+
+    int n_rows = rows.size() / (1 + n_columns);
+
+    Map<Matrix<double, Dynamic, Dynamic, RowMajor> > table(rows.data(), n_rows, 1 + n_columns);
+
+    time_series.times = table.col(0);
+    time_series.data  = table.rightCols(n_columns);
+
+    return true;
+}
+
+/**
+   Returns the index of the channel with the given name.
+
+   @param[in]   name   Channel name.
+
+   @returns Channel index, or -1 if there is no such channel.
+*/
+int
+Monitor::TimeSeries::channel(const string &name) const
+{
+    for (int i = 0; i < (int) names.size(); i++)
+        if (names[i] == name)
+            return i;
+
+    return -1;
+}
+
+/**
+   Returns the first column of a channel in the data matrix.
+
+   @param[in]   channel   Channel index.
+
+   @returns Column offset.
+*/
+int
+Monitor::TimeSeries::column_offset(int channel) const
+{
+    int offset = 0;
+    for (int i = 0; i < channel; i++)
+        offset += n_columns[i];
+
+    return offset;
+}
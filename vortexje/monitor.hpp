@@ -0,0 +1,173 @@
+//
+// Vortexje -- Probe and load time series.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#ifndef __MONITOR_HPP__
+#define __MONITOR_HPP__
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <vortexje/solver.hpp>
+#include <vortexje/checkpoint.hpp>
+
+namespace Vortexje
+{
+
+/**
+   Records time series of probe values and body loads.
+
+   Channels, such as velocity probes at a set of points or the force on a body, are registered once, before the first
+   record.  Every call to record() evaluates all channels in batch, and appends a row consisting of the time and the
+   values of all channels to the time series.  A monitor registered with Solver::add_monitor() is recorded at the end
+   of every successful Solver::solve().
+
+   Rows are collected in chunks, which are appended to a binary file by a background thread, so that the solver
+   continues with the next time step while a chunk is being written.  The file uses the record format of
+   CheckpointWriter, and is flushed after every chunk, so that it may be read with read() while the simulation is
+   still running.
+
+   @brief Probe and load time series.
+*/
+class Monitor
+{
+public:
+    Monitor(const Solver &solver, const std::string &filename, int chunk_length = 64, int max_queue_length = 2);
+
+    ~Monitor();
+
+    /**
+       Channel types.
+    */
+    enum ChannelType {
+        VelocityProbes,
+        VelocityPotentialProbes,
+        Force,
+        Moment
+    };
+
+    int add_velocity_probes(const std::string &name, const Eigen::Matrix3Xd &points);
+
+    int add_velocity_potential_probes(const std::string &name, const Eigen::Matrix3Xd &points);
+
+    int add_force_monitor(const std::string &name, const std::shared_ptr<Body> &body);
+
+    int add_moment_monitor(const std::string &name, const std::shared_ptr<Body> &body, const Eigen::Vector3d &x);
+
+    /**
+       Time of the next record.  This starts at zero, and is advanced by the time step of every record.
+    */
+    double time;
+
+    void record(double dt = 0.0);
+
+    void flush();
+
+    /**
+       Time series, as read back from a monitor file.
+
+       @brief Time series.
+    */
+    class TimeSeries {
+    public:
+        /**
+           Channel names.
+        */
+        std::vector<std::string> names;
+
+        /**
+           Channel types.
+        */
+        std::vector<ChannelType> types;
+
+        /**
+           Number of columns of every channel.  Velocity probes, forces and moments have three columns per point,
+           velocity potential probes one.
+        */
+        std::vector<int> n_columns;
+
+        /**
+           Time of every record.
+        */
+        Eigen::VectorXd times;
+
+        /**
+           Channel values, with one row per record, and the columns of all channels side by side.
+        */
+        Eigen::MatrixXd data;
+
+        int channel(const std::string &name) const;
+
+        int column_offset(int channel) const;
+    };
+
+    static bool read(const std::string &filename, TimeSeries &time_series);
+
+private:
+    const Solver &solver;
+
+    std::string filename;
+
+    int chunk_length;
+
+    int max_queue_length;
+
+    // Channels:
+    class Channel {
+    public:
+        std::string name;
+
+        ChannelType type;
+
+        Eigen::Matrix3Xd points;
+
+        std::shared_ptr<Body> body;
+
+        int n_columns;
+    };
+
+    std::vector<Channel> channels;
+
+    int n_columns;
+
+    // Rows collected since the last chunk was queued, stored row by row:
+    std::vector<double> chunk;
+
+    int n_chunk_rows;
+
+    std::shared_ptr<CheckpointWriter> writer;
+
+    // Chunk queue of the background thread:
+    std::deque<std::shared_ptr<std::vector<double> > > queue;
+
+    bool writing;
+
+    bool stopping;
+
+    std::mutex mutex;
+
+    std::condition_variable queue_changed;
+
+    std::thread thread;
+
+    int add_channel(const Channel &channel);
+
+    void queue_chunk();
+
+    void run();
+};
+
+};
+
+#endif // __MONITOR_HPP__
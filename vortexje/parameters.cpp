@@ -19,22 +19,122 @@ int    Parameters::linear_solver_max_iterations       = 20000;
 
 double Parameters::linear_solver_tolerance            = numeric_limits<double>::epsilon();
 
+bool   Parameters::direct_linear_solver               = false;
+
+int    Parameters::linear_solver_block_size           = 0;
+
+int    Parameters::linear_solver_gmres_restart        = 0;
+
+int    Parameters::linear_solver_recycled_solutions   = 0;
+
+bool   Parameters::single_precision_influence_coefficients = false;
+
+int    Parameters::iterative_refinement_steps         = 3;
+
+bool   Parameters::store_source_influence_coefficients = true;
+
+double Parameters::hierarchical_matrix_tolerance      = 0.0;
+
+string Parameters::influence_coefficient_cache_folder = "";
+
+bool   Parameters::symmetry_plane                     = false;
+
+int    Parameters::cyclic_symmetry_sectors            = 1;
+
 bool   Parameters::unsteady_bernoulli                 = true;
 
 bool   Parameters::convect_wake                       = true;
 
+int    Parameters::wake_integration_order             = 1;
+
+int    Parameters::far_wake_update_interval           = 1;
+
+int    Parameters::far_wake_age                       = 10;
+
 bool   Parameters::wake_emission_follow_bisector      = false;
 
 double Parameters::wake_emission_distance_factor      = 0.25;
 
 double Parameters::static_wake_length                 = 100.0;
 
+int    Parameters::max_wake_rows                      = 0;
+
+double Parameters::max_wake_distance                  = 0.0;
+
+int    Parameters::wake_agglomeration_factor          = 0;
+
+int    Parameters::wake_agglomeration_age             = 10;
+
+int    Parameters::vortex_particle_wake_age           = 0;
+
+double Parameters::vortex_particle_core_radius_factor = 1.0;
+
 double Parameters::inversion_tolerance                = numeric_limits<double>::epsilon();
 
 double Parameters::collocation_point_delta            = 1e-12;
 
+double Parameters::far_field_distance_factor          = 0.0;
+
+double Parameters::relative_motion_tolerance          = 1e-12;
+
+double Parameters::treecode_opening_angle             = 0.0;
+
+bool   Parameters::use_accelerator                    = false;
+
 bool   Parameters::marcov_surface_velocity            = false;
 
 int    Parameters::max_boundary_layer_iterations      = 100;
 
 double Parameters::boundary_layer_iteration_tolerance = numeric_limits<double>::epsilon();
+
+double Parameters::boundary_layer_relaxation_factor   = 1.0;
+
+bool   Parameters::boundary_layer_aitken_acceleration = false;
+
+int    Parameters::boundary_layer_anderson_depth      = 0;
+
+double Parameters::sensitivity_perturbation           = 1e-6;
+
+/**
+   Constructs a SolverParameters object, initialized with the current values of the static defaults in Parameters.
+*/
+SolverParameters::SolverParameters() :
+    linear_solver_max_iterations(Parameters::linear_solver_max_iterations),
+    linear_solver_tolerance(Parameters::linear_solver_tolerance),
+    direct_linear_solver(Parameters::direct_linear_solver),
+    linear_solver_block_size(Parameters::linear_solver_block_size),
+    linear_solver_gmres_restart(Parameters::linear_solver_gmres_restart),
+    linear_solver_recycled_solutions(Parameters::linear_solver_recycled_solutions),
+    single_precision_influence_coefficients(Parameters::single_precision_influence_coefficients),
+    iterative_refinement_steps(Parameters::iterative_refinement_steps),
+    store_source_influence_coefficients(Parameters::store_source_influence_coefficients),
+    hierarchical_matrix_tolerance(Parameters::hierarchical_matrix_tolerance),
+    influence_coefficient_cache_folder(Parameters::influence_coefficient_cache_folder),
+    symmetry_plane(Parameters::symmetry_plane),
+    cyclic_symmetry_sectors(Parameters::cyclic_symmetry_sectors),
+    unsteady_bernoulli(Parameters::unsteady_bernoulli),
+    convect_wake(Parameters::convect_wake),
+    wake_integration_order(Parameters::wake_integration_order),
+    far_wake_update_interval(Parameters::far_wake_update_interval),
+    far_wake_age(Parameters::far_wake_age),
+    wake_emission_follow_bisector(Parameters::wake_emission_follow_bisector),
+    wake_emission_distance_factor(Parameters::wake_emission_distance_factor),
+    static_wake_length(Parameters::static_wake_length),
+    max_wake_rows(Parameters::max_wake_rows),
+    max_wake_distance(Parameters::max_wake_distance),
+    wake_agglomeration_factor(Parameters::wake_agglomeration_factor),
+    wake_agglomeration_age(Parameters::wake_agglomeration_age),
+    vortex_particle_wake_age(Parameters::vortex_particle_wake_age),
+    vortex_particle_core_radius_factor(Parameters::vortex_particle_core_radius_factor),
+    relative_motion_tolerance(Parameters::relative_motion_tolerance),
+    treecode_opening_angle(Parameters::treecode_opening_angle),
+    use_accelerator(Parameters::use_accelerator),
+    marcov_surface_velocity(Parameters::marcov_surface_velocity),
+    max_boundary_layer_iterations(Parameters::max_boundary_layer_iterations),
+    boundary_layer_iteration_tolerance(Parameters::boundary_layer_iteration_tolerance),
+    boundary_layer_relaxation_factor(Parameters::boundary_layer_relaxation_factor),
+    boundary_layer_aitken_acceleration(Parameters::boundary_layer_aitken_acceleration),
+    boundary_layer_anderson_depth(Parameters::boundary_layer_anderson_depth),
+    sensitivity_perturbation(Parameters::sensitivity_perturbation)
+{
+}
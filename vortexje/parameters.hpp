@@ -9,13 +9,18 @@
 #ifndef __PARAMETERS_HPP__
 #define __PARAMETERS_HPP__
 
+#include <string>
+
 namespace Vortexje
 {
 
 /**
    Parameter settings.
    
-   The static parameters of this class control the behavior of the solver.
+   The static parameters of this class control the behavior of the solver.  The solver-level parameters are copied
+   into a SolverParameters object by every Solver upon construction, so that they act as defaults that can be
+   overridden per solver.  The remaining parameters (inversion_tolerance, collocation_point_delta, and
+   far_field_distance_factor) describe the panel geometry and influence kernels, and are shared by all solvers.
    
    @brief Parameter settings.
 */
@@ -32,6 +37,96 @@ public:
     */
     static double linear_solver_tolerance;
     
+    /**
+       Whether or not to solve for the doublet distribution using a dense LU factorization instead of BiCGSTAB.  The
+       factorization is kept for as long as the matrices of influence coefficients remain valid.
+    */
+    static bool   direct_linear_solver;
+    
+    /**
+       Maximum size of the diagonal blocks of the block-Jacobi preconditioner of the iterative linear solver.  The
+       blocks follow the surface boundaries, and larger surfaces are split into consecutive ranges of panels.  The
+       blocks are LU-factorized once, and reused until the matrices of influence coefficients change, or until the
+       iteration count grows to twice that of the first solve with the factorization.  Set to zero to use the diagonal
+       preconditioner.  Applies to the assembled, non-distributed doublet system only.
+    */
+    static int    linear_solver_block_size;
+    
+    /**
+       Restart length of the GMRES linear solver.  Set to zero to use BiCGSTAB.  Applies to the assembled,
+       non-distributed doublet system only.
+    */
+    static int    linear_solver_gmres_restart;
+    
+    /**
+       Number of most recent doublet distributions from which the initial guess of the iterative linear solver is
+       assembled.  The initial guess is the combination of these distributions with the smallest residual.  In
+       unsteady simulations, this extrapolates the solution from the previous time steps.  Set to zero to start from
+       the previous doublet distribution only.  Applies to the assembled, non-distributed doublet system only.
+    */
+    static int    linear_solver_recycled_solutions;
+    
+    /**
+       Whether or not to store the dense matrices of influence coefficients in single precision.  This halves their
+       memory footprint, and the memory traffic of the iterative linear solver, which then runs in single precision.
+       Double precision accuracy of the doublet distribution is recovered by iterative refinement; see
+       iterative_refinement_steps.  Applies to the assembled, non-distributed doublet system, and is ignored if
+       direct_linear_solver or hierarchical_matrix_tolerance is set.
+    */
+    static bool   single_precision_influence_coefficients;
+    
+    /**
+       Maximum number of iterative refinement steps for single precision influence coefficients.  Every step computes
+       the residual of the doublet system in double precision, without storing the matrices, by re-evaluating the
+       influence kernels, and then solves for a correction in single precision.  The refinement ends once the relative
+       residual drops below linear_solver_tolerance.  Set to zero to accept the single precision solution.
+    */
+    static int    iterative_refinement_steps;
+    
+    /**
+       Whether or not to store the dense matrix of source influence coefficients.  If not, the right-hand side of the
+       doublet system is evaluated on the fly from the source influence kernels, on every solve and boundary layer
+       iteration, so that only the doublet influence coefficients are kept in memory.  Keep this enabled when the
+       source distribution changes frequently relative to the geometry, i.e., for boundary layer iterations or
+       rigid-body motion, where the stored matrix amortizes.  Ignored if hierarchical_matrix_tolerance is set.
+    */
+    static bool   store_source_influence_coefficients;
+    
+    /**
+       Relative tolerance of the low-rank approximations in the hierarchical matrix representation of the matrices of
+       influence coefficients.  If positive, the dense matrices are never formed, and the doublet distribution is
+       computed using matrix-free BiCGSTAB.  This takes precedence over direct_linear_solver.  Set to zero to use
+       dense matrices.
+    */
+    static double hierarchical_matrix_tolerance;
+    
+    /**
+       Folder in which the dense matrices of influence coefficients are cached between runs.  The cache files are
+       named after a hash of the geometry of all non-wake surfaces and of the kernel settings, so that a solver that is
+       set up with the same meshes reads the matrices instead of assembling them.  The files consist of naturally
+       aligned records, see CheckpointWriter, so that they may be memory-mapped.  Applies to the assembly of the
+       complete, non-distributed, double precision matrices only.  Leave empty to disable the cache.
+    */
+    static std::string influence_coefficient_cache_folder;
+    
+    /**
+       Whether or not the flow is symmetric about the plane y = 0.  If set, only one half of the geometry is meshed, and
+       every panel, wake panel, and vortex particle is accompanied by its mirror image about this plane.  This halves
+       the size of the doublet system.  Forces and moments are integrated over the meshed half only.
+    */
+    static bool   symmetry_plane;
+    
+    /**
+       Number of identical sectors of a cyclically symmetric configuration, such as a rotor with this number of
+       blades, about the z-axis.  If larger than one, only the sector containing one blade is meshed, and every panel,
+       wake panel, and vortex particle is accompanied by its copies rotated by multiples of 2 pi / sectors about the
+       z-axis.  This reduces the size of the doublet system, and the number of wakes to convect, by the number of
+       sectors.  The flow must be cyclically symmetric as well, i.e., the freestream velocity must be parallel to the
+       z-axis, and the rotor must rotate about it.  Forces and moments are integrated over the meshed sector only.
+       May be combined with symmetry_plane.
+    */
+    static int    cyclic_symmetry_sectors;
+    
     /**
        Whether or not to apply the unsteady Bernoulli equation.
     */
@@ -42,6 +137,27 @@ public:
     */
     static bool   convect_wake;
     
+    /**
+       Order of the explicit Runge-Kutta scheme used to convect the wake nodes and vortex particles: 1 for the forward
+       Euler method, 2 for Heun's method, or 4 for the classical fourth-order method.  The intermediate stages
+       evaluate the velocities with the wakes at their intermediate positions, and the bodies at the start of the time
+       step.  Higher orders allow larger time steps, at the cost of one velocity evaluation per stage.
+    */
+    static int    wake_integration_order;
+    
+    /**
+       Number of time steps between evaluations of the convection velocities of the far wake.  In between, the
+       velocities of the last evaluation are reused.  The far wake consists of the rows of wake panels older than
+       far_wake_age, and of the vortex particles.  Set to one to evaluate all velocities every time step.
+    */
+    static int    far_wake_update_interval;
+    
+    /**
+       Number of most recent rows of wake panels whose convection velocities are evaluated every time step.  See
+       far_wake_update_interval.
+    */
+    static int    far_wake_age;
+    
     /**
        Whether to emit new wake panels into the direction of the trailing edge bisector, rather than following the
        apparent velocity.
@@ -61,6 +177,38 @@ public:
     */
     static double static_wake_length;
     
+    /**
+       Maximum number of spanwise rows of wake panels.  Older rows are dropped.  Set to zero to keep all rows.
+    */
+    static int    max_wake_rows;
+    
+    /**
+       Distance from the trailing edge beyond which rows of wake panels are dropped.  Set to zero to keep all rows.
+    */
+    static double max_wake_distance;
+    
+    /**
+       Number of old rows of wake panels merged into a single, coarser row.  Set to zero or one to disable wake
+       agglomeration.
+    */
+    static int    wake_agglomeration_factor;
+    
+    /**
+       Number of most recent rows of wake panels that are never merged.
+    */
+    static int    wake_agglomeration_age;
+    
+    /**
+       Number of most recent rows of wake panels that are kept as vortex rings.  Older rows are converted into vortex
+       particles.  Set to zero to disable the vortex particle far wake.
+    */
+    static int    vortex_particle_wake_age;
+    
+    /**
+       Core radius of a vortex particle, in multiples of the length of the vortex filament it replaces.
+    */
+    static double vortex_particle_core_radius_factor;
+    
     /**
        Quantities below this threshold will be treated as nil.
     */
@@ -71,6 +219,33 @@ public:
     */
     static double collocation_point_delta;
     
+    /**
+       Distance from a panel, in multiples of the panel diameter, beyond which its influence is computed using
+       far-field multipole expansions instead of the exact expressions.  Set to zero to always use the exact
+       expressions.
+    */
+    static double far_field_distance_factor;
+    
+    /**
+       Tolerance below which two surfaces are considered not to have moved relative to each other.  Influence
+       coefficients between such surfaces are reused from the previous call to Solver::solve().
+    */
+    static double relative_motion_tolerance;
+    
+    /**
+       Opening angle of the Barnes-Hut treecode used to compute the velocities at the wake nodes.  Clusters of panels
+       whose radius divided by their distance is smaller than this value are evaluated using a far-field expansion.
+       Set to zero to evaluate all panels directly.
+    */
+    static double treecode_opening_angle;
+    
+    /**
+       Whether to evaluate the matrices of influence coefficients, and the velocities at the wake nodes, using the
+       Accelerator backend.  The backend is offloaded to a device, such as a GPU, if Vortexje was built with
+       VORTEXJE_OPENMP_OFFLOAD.  This is ignored when the hierarchical matrices or the treecode are in use.
+    */
+    static bool   use_accelerator;
+    
     /**
        Use N. Marcov's formula for computing the surface velocities.
        
@@ -87,6 +262,240 @@ public:
        Boundary layer iteration tolerance.
     */
     static double boundary_layer_iteration_tolerance;
+    
+    /**
+       Relaxation factor of the update of the source distribution in the boundary layer iteration.  With Aitken
+       acceleration, this is the factor of the first relaxed update only.  A factor of one, with Aitken and Anderson
+       acceleration disabled, gives the plain fixed-point iteration.  This is the default.
+    */
+    static double boundary_layer_relaxation_factor;
+    
+    /**
+       Adapt the relaxation factor of the boundary layer iteration in every iteration, using the Aitken delta-squared
+       method applied to the residuals of the source distribution.  Only used if Anderson acceleration is disabled.
+       
+       @note See B. M. Irons and R. C. Tuck, A version of the Aitken accelerator for computer iteration, International
+       Journal for Numerical Methods in Engineering 1 (3), 1969.
+    */
+    static bool   boundary_layer_aitken_acceleration;
+    
+    /**
+       Number of previous iterations combined by Anderson acceleration of the boundary layer iteration.  Zero disables
+       Anderson acceleration.  If enabled, Anderson acceleration takes the place of Aitken acceleration.
+       
+       @note See H. F. Walker and P. Ni, Anderson acceleration for fixed-point iterations, SIAM Journal on Numerical
+       Analysis 49 (4), 2011.
+    */
+    static int    boundary_layer_anderson_depth;
+    
+    /**
+       Perturbation of the node positions, relative to the diameter of the adjacent panels, used to differentiate the
+       influence kernels with respect to the geometry.  See Solver::force_sensitivities().
+    */
+    static double sensitivity_perturbation;
+};
+
+/**
+   Per-solver parameter settings.
+   
+   Every Solver owns a copy of these, initialized from the static defaults in Parameters.  Modifying the parameters
+   of one solver does not affect any other solver, so that differently configured solvers may run concurrently, in
+   separate threads, on shared surface geometry.  See the corresponding static members of Parameters for details.
+   
+   @brief Per-solver parameter settings.
+*/
+class SolverParameters
+{
+public:
+    SolverParameters();
+    
+    /**
+       Maximum number of iterations of BiCGSTAB linear solver.
+    */
+    int    linear_solver_max_iterations;
+    
+    /**
+       Tolerance of BiCGSTAB linear solver.
+    */
+    double linear_solver_tolerance;
+    
+    /**
+       Whether or not to solve for the doublet distribution using a dense LU factorization instead of BiCGSTAB.
+    */
+    bool   direct_linear_solver;
+    
+    /**
+       Maximum size of the diagonal blocks of the block-Jacobi preconditioner.  Set to zero to use the diagonal
+       preconditioner.
+    */
+    int    linear_solver_block_size;
+    
+    /**
+       Restart length of the GMRES linear solver.  Set to zero to use BiCGSTAB.
+    */
+    int    linear_solver_gmres_restart;
+    
+    /**
+       Number of most recent doublet distributions from which the initial guess of the iterative linear solver is
+       assembled.
+    */
+    int    linear_solver_recycled_solutions;
+    
+    /**
+       Whether or not to store the dense matrices of influence coefficients in single precision.
+    */
+    bool   single_precision_influence_coefficients;
+    
+    /**
+       Maximum number of iterative refinement steps for single precision influence coefficients.
+    */
+    int    iterative_refinement_steps;
+    
+    /**
+       Whether or not to store the dense matrix of source influence coefficients.
+    */
+    bool   store_source_influence_coefficients;
+    
+    /**
+       Relative tolerance of the hierarchical matrix approximations.  Set to zero to use dense matrices.
+    */
+    double hierarchical_matrix_tolerance;
+    
+    /**
+       Folder in which the dense matrices of influence coefficients are cached between runs.  Leave empty to disable
+       the cache.
+    */
+    std::string influence_coefficient_cache_folder;
+    
+    /**
+       Whether or not the flow is symmetric about the plane y = 0.
+    */
+    bool   symmetry_plane;
+    
+    /**
+       Number of identical sectors of a cyclically symmetric configuration about the z-axis.
+    */
+    int    cyclic_symmetry_sectors;
+    
+    /**
+       Whether or not to apply the unsteady Bernoulli equation.
+    */
+    bool   unsteady_bernoulli;
+    
+    /**
+       Whether or not to enable the convection of wake nodes.
+    */
+    bool   convect_wake;
+    
+    /**
+       Order of the explicit Runge-Kutta scheme used to convect the wakes.
+    */
+    int    wake_integration_order;
+    
+    /**
+       Number of time steps between evaluations of the convection velocities of the far wake.
+    */
+    int    far_wake_update_interval;
+    
+    /**
+       Number of most recent rows of wake panels whose convection velocities are evaluated every time step.
+    */
+    int    far_wake_age;
+    
+    /**
+       Whether to emit new wake panels into the direction of the trailing edge bisector.
+    */
+    bool   wake_emission_follow_bisector;
+    
+    /**
+       Multiplied with the trailing edge velocity to obtain the distance to the first wake vortex.
+    */
+    double wake_emission_distance_factor;
+    
+    /**
+       Length of the wake, in case of no wake convection.
+    */
+    double static_wake_length;
+    
+    /**
+       Maximum number of spanwise rows of wake panels.  Set to zero to keep all rows.
+    */
+    int    max_wake_rows;
+    
+    /**
+       Distance from the trailing edge beyond which rows of wake panels are dropped.  Set to zero to keep all rows.
+    */
+    double max_wake_distance;
+    
+    /**
+       Number of old rows of wake panels merged into a single, coarser row.
+    */
+    int    wake_agglomeration_factor;
+    
+    /**
+       Number of most recent rows of wake panels that are never merged.
+    */
+    int    wake_agglomeration_age;
+    
+    /**
+       Number of most recent rows of wake panels that are kept as vortex rings.
+    */
+    int    vortex_particle_wake_age;
+    
+    /**
+       Core radius of a vortex particle, in multiples of the length of the vortex filament it replaces.
+    */
+    double vortex_particle_core_radius_factor;
+    
+    /**
+       Tolerance below which two surfaces are considered not to have moved relative to each other.
+    */
+    double relative_motion_tolerance;
+    
+    /**
+       Opening angle of the Barnes-Hut treecode.  Set to zero to evaluate all panels directly.
+    */
+    double treecode_opening_angle;
+    
+    /**
+       Whether to evaluate influence coefficients and wake node velocities using the Accelerator backend.
+    */
+    bool   use_accelerator;
+    
+    /**
+       Use N. Marcov's formula for computing the surface velocities.
+    */
+    bool   marcov_surface_velocity;
+    
+    /**
+       Maximum number of potential and boundary layer computation iterations.
+    */
+    int    max_boundary_layer_iterations;
+    
+    /**
+       Boundary layer iteration tolerance.
+    */
+    double boundary_layer_iteration_tolerance;
+    
+    /**
+       Relaxation factor of the update of the source distribution in the boundary layer iteration.
+    */
+    double boundary_layer_relaxation_factor;
+    
+    /**
+       Adapt the relaxation factor of the boundary layer iteration using Aitken acceleration.
+    */
+    bool   boundary_layer_aitken_acceleration;
+    
+    /**
+       Number of previous iterations combined by Anderson acceleration of the boundary layer iteration.
+    */
+    int    boundary_layer_anderson_depth;
+    
+    /**
+       Relative perturbation of the node positions used to differentiate the influence kernels.
+    */
+    double sensitivity_perturbation;
 };
 
 };
@@ -0,0 +1,383 @@
+//
+// Vortexje -- Phase timers and performance counters.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <set>
+
+#include <vortexje/profiler.hpp>
+#include <vortexje/logger.hpp>
+
+using namespace std;
+using namespace Vortexje;
+
+// Writes a string as a JSON string literal.  Phase and counter names are plain identifiers, so that only quotes and
+// backslashes need escaping:
+static void
+write_json_string(ostream &f, const string &s)
+{
+    f << '"';
+    for (int i = 0; i < (int) s.size(); i++) {
+        if (s[i] == '"' || s[i] == '\\')
+            f << '\\';
+        f << s[i];
+    }
+    f << '"';
+}
+
+/**
+   Constructs an empty, enabled Profiler.
+*/
+Profiler::Profiler() : enabled(true)
+{
+}
+
+/**
+   Constructs a Timer, and starts timing.
+
+   @param[in]   profiler   Profiler to which the time is added.  May be NULL, in which case nothing is recorded.
+   @param[in]   phase      Phase name.
+*/
+Profiler::Timer::Timer(const shared_ptr<Profiler> &profiler, const string &phase) : phase(phase)
+{
+    if (profiler && profiler->enabled) {
+        this->profiler = profiler.get();
+
+        wall_start = wall_clock();
+        cpu_start  = cpu_clock();
+
+    } else
+        this->profiler = NULL;
+}
+
+/**
+   Destructor.  Stops timing, if stop() was not called before.
+*/
+Profiler::Timer::~Timer()
+{
+    stop();
+}
+
+/**
+   Stops timing, and adds the elapsed time to the phase.
+*/
+void
+Profiler::Timer::stop()
+{
+    if (profiler == NULL)
+        return;
+
+    profiler->add_time(phase, wall_clock() - wall_start, cpu_clock() - cpu_start);
+
+    profiler = NULL;
+}
+
+/**
+   Adds elapsed time to a phase of the current step.
+
+   @param[in]   phase       Phase name.
+   @param[in]   wall_time   Wall clock time, in seconds.
+   @param[in]   cpu_time    CPU time, in seconds.
+*/
+void
+Profiler::add_time(const string &phase, double wall_time, double cpu_time)
+{
+    if (!enabled)
+        return;
+
+    Phase &p = current_step.phases[phase];
+
+    p.wall_time += wall_time;
+    p.cpu_time  += cpu_time;
+    p.calls++;
+}
+
+/**
+   Increments a counter of the current step.
+
+   @param[in]   counter   Counter name.
+   @param[in]   value     Increment.
+*/
+void
+Profiler::increment(const string &counter, double value)
+{
+    if (!enabled)
+        return;
+
+    current_step.counters[counter] += value;
+}
+
+/**
+   Sets a counter of the current step.  Use this for quantities that are not cumulative, such as a residual or a
+   panel count.
+
+   @param[in]   counter   Counter name.
+   @param[in]   value     New value.
+*/
+void
+Profiler::set(const string &counter, double value)
+{
+    if (!enabled)
+        return;
+
+    current_step.counters[counter] = value;
+}
+
+/**
+   Closes the current step, appends it to the step history, and starts a new, empty step.
+
+   @param[in]   step_number   Step number.
+*/
+void
+Profiler::end_step(int step_number)
+{
+    if (!enabled)
+        return;
+
+    current_step.step_number = step_number;
+
+    steps.push_back(current_step);
+
+    current_step = Step();
+}
+
+/**
+   Discards the current step, and the step history.
+*/
+void
+Profiler::clear()
+{
+    current_step = Step();
+
+    steps.clear();
+}
+
+/**
+   Returns the wall clock time spent in a phase, over all completed steps and the current step.
+
+   @param[in]   phase   Phase name.
+
+   @returns Wall clock time, in seconds.
+*/
+double
+Profiler::total_wall_time(const string &phase) const
+{
+    double total = 0.0;
+
+    for (int i = 0; i <= (int) steps.size(); i++) {
+        const Step &step = (i < (int) steps.size()) ? steps[i] : current_step;
+
+        map<string, Phase>::const_iterator it = step.phases.find(phase);
+        if (it != step.phases.end())
+            total += it->second.wall_time;
+    }
+
+    return total;
+}
+
+/**
+   Returns the CPU time spent in a phase, over all completed steps and the current step.
+
+   @param[in]   phase   Phase name.
+
+   @returns CPU time, in seconds.
+*/
+double
+Profiler::total_cpu_time(const string &phase) const
+{
+    double total = 0.0;
+
+    for (int i = 0; i <= (int) steps.size(); i++) {
+        const Step &step = (i < (int) steps.size()) ? steps[i] : current_step;
+
+        map<string, Phase>::const_iterator it = step.phases.find(phase);
+        if (it != step.phases.end())
+            total += it->second.cpu_time;
+    }
+
+    return total;
+}
+
+/**
+   Returns the sum of a counter, over all completed steps and the current step.
+
+   @param[in]   counter   Counter name.
+
+   @returns Sum of the counter.
+*/
+double
+Profiler::total_counter(const string &counter) const
+{
+    double total = 0.0;
+
+    for (int i = 0; i <= (int) steps.size(); i++) {
+        const Step &step = (i < (int) steps.size()) ? steps[i] : current_step;
+
+        map<string, double>::const_iterator it = step.counters.find(counter);
+        if (it != step.counters.end())
+            total += it->second;
+    }
+
+    return total;
+}
+
+/**
+   Writes the step history to a JSON file.  The file contains an array of steps, each of which holds its step
+   number, its phases with wall clock time, CPU time, and number of calls, and its counters.
+
+   @param[in]   filename   Destination filename.
+
+   @returns true on success.
+*/
+bool
+Profiler::write_json(const string &filename) const
+{
+    ofstream f(filename.c_str());
+    if (!f.is_open()) {
+        VORTEXJE_LOG(Logger::default_logger(), Logger::Error, "Profiler: Could not open " << filename << " for writing.");
+
+        return false;
+    }
+
+    f << setprecision(12);
+
+    f << "[" << endl;
+
+    for (int i = 0; i < (int) steps.size(); i++) {
+        const Step &step = steps[i];
+
+        f << "  {\"step\": " << step.step_number << ", \"phases\": {";
+
+        map<string, Phase>::const_iterator pit;
+        for (pit = step.phases.begin(); pit != step.phases.end(); pit++) {
+            if (pit != step.phases.begin())
+                f << ", ";
+
+            write_json_string(f, pit->first);
+            f << ": {\"wall\": " << pit->second.wall_time << ", \"cpu\": " << pit->second.cpu_time;
+            f << ", \"calls\": " << pit->second.calls << "}";
+        }
+
+        f << "}, \"counters\": {";
+
+        map<string, double>::const_iterator cit;
+        for (cit = step.counters.begin(); cit != step.counters.end(); cit++) {
+            if (cit != step.counters.begin())
+                f << ", ";
+
+            write_json_string(f, cit->first);
+            f << ": " << cit->second;
+        }
+
+        f << "}}";
+        if (i < (int) steps.size() - 1)
+            f << ",";
+        f << endl;
+    }
+
+    f << "]" << endl;
+
+    return f.good();
+}
+
+/**
+   Writes the step history to a CSV file, with one row per step.  Every phase gives rise to the three columns
+   <phase>_wall, <phase>_cpu, and <phase>_calls, and every counter to a single column.  Phases and counters that were
+   not recorded in a step are written as zero.
+
+   @param[in]   filename   Destination filename.
+
+   @returns true on success.
+*/
+bool
+Profiler::write_csv(const string &filename) const
+{
+    ofstream f(filename.c_str());
+    if (!f.is_open()) {
+        VORTEXJE_LOG(Logger::default_logger(), Logger::Error, "Profiler: Could not open " << filename << " for writing.");
+
+        return false;
+    }
+
+    // Collect the column names of all steps:
+    std::set<string> phase_names, counter_names;
+
+    for (int i = 0; i < (int) steps.size(); i++) {
+        map<string, Phase>::const_iterator pit;
+        for (pit = steps[i].phases.begin(); pit != steps[i].phases.end(); pit++)
+            phase_names.insert(pit->first);
+
+        map<string, double>::const_iterator cit;
+        for (cit = steps[i].counters.begin(); cit != steps[i].counters.end(); cit++)
+            counter_names.insert(cit->first);
+    }
+
+    // Header:
+    f << "step";
+
+    std::set<string>::const_iterator it;
+    for (it = phase_names.begin(); it != phase_names.end(); it++)
+        f << "," << *it << "_wall," << *it << "_cpu," << *it << "_calls";
+    for (it = counter_names.begin(); it != counter_names.end(); it++)
+        f << "," << *it;
+    f << endl;
+
+    // Rows:
+    f << setprecision(12);
+
+    for (int i = 0; i < (int) steps.size(); i++) {
+        const Step &step = steps[i];
+
+        f << step.step_number;
+
+        for (it = phase_names.begin(); it != phase_names.end(); it++) {
+            map<string, Phase>::const_iterator pit = step.phases.find(*it);
+            if (pit != step.phases.end())
+                f << "," << pit->second.wall_time << "," << pit->second.cpu_time << "," << pit->second.calls;
+            else
+                f << ",0,0,0";
+        }
+
+        for (it = counter_names.begin(); it != counter_names.end(); it++) {
+            map<string, double>::const_iterator cit = step.counters.find(*it);
+            if (cit != step.counters.end())
+                f << "," << cit->second;
+            else
+                f << ",0";
+        }
+
+        f << endl;
+    }
+
+    return f.good();
+}
+
+/**
+   Returns the current wall clock time.
+
+   @returns Wall clock time, in seconds, relative to an arbitrary origin.
+*/
+double
+Profiler::wall_clock()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+   Returns the CPU time consumed by this process.
+
+   @returns CPU time, in seconds.
+*/
+double
+Profiler::cpu_clock()
+{
+    return clock() / (double) CLOCKS_PER_SEC;
+}
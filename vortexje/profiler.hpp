@@ -0,0 +1,159 @@
+//
+// Vortexje -- Phase timers and performance counters.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#ifndef __PROFILER_HPP__
+#define __PROFILER_HPP__
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Vortexje
+{
+
+/**
+   Phase timers and performance counters.
+
+   The solver accumulates the wall clock and CPU time spent in each of its phases, such as the assembly of the
+   matrices of influence coefficients, the solution of the linear system, or the convection of the wakes, as well as
+   counters such as the number of panel influence evaluations.  Every call to end_step() closes the current step, and
+   appends it to the step history, which can be exported as JSON or CSV.
+
+   CPU time is process time, and therefore includes the time spent by all threads.  A profiler must only be used
+   from a single thread at a time.
+
+   @brief Phase timers and performance counters.
+*/
+class Profiler
+{
+public:
+    Profiler();
+
+    /**
+       Accumulated timings of a single phase.
+
+       @brief Phase timings.
+    */
+    class Phase {
+    public:
+        /**
+           Constructs an empty Phase.
+        */
+        Phase() : wall_time(0.0), cpu_time(0.0), calls(0) {}
+
+        /**
+           Wall clock time, in seconds.
+        */
+        double wall_time;
+
+        /**
+           CPU time, in seconds.
+        */
+        double cpu_time;
+
+        /**
+           Number of times the phase was entered.
+        */
+        int calls;
+    };
+
+    /**
+       Timings and counters of a single step.
+
+       @brief Step record.
+    */
+    class Step {
+    public:
+        /**
+           Constructs an empty Step.
+        */
+        Step() : step_number(-1) {}
+
+        /**
+           Step number, as passed to end_step().
+        */
+        int step_number;
+
+        /**
+           Timings, by phase name.
+        */
+        std::map<std::string, Phase> phases;
+
+        /**
+           Counters, by name.
+        */
+        std::map<std::string, double> counters;
+    };
+
+    /**
+       Scoped phase timer.  The time between construction and destruction, or the call to stop(), is added to the
+       given phase.
+
+       @brief Scoped phase timer.
+    */
+    class Timer {
+    public:
+        Timer(const std::shared_ptr<Profiler> &profiler, const std::string &phase);
+
+        ~Timer();
+
+        void stop();
+
+    private:
+        Profiler *profiler;
+
+        std::string phase;
+
+        double wall_start;
+        double cpu_start;
+    };
+
+    /**
+       Whether or not to record timings and counters.
+    */
+    bool enabled;
+
+    /**
+       The step that is currently being recorded.
+    */
+    Step current_step;
+
+    /**
+       Completed steps, in order.
+    */
+    std::vector<Step> steps;
+
+    void add_time(const std::string &phase, double wall_time, double cpu_time);
+
+    void increment(const std::string &counter, double value = 1.0);
+
+    void set(const std::string &counter, double value);
+
+    void end_step(int step_number);
+
+    void clear();
+
+    double total_wall_time(const std::string &phase) const;
+
+    double total_cpu_time(const std::string &phase) const;
+
+    double total_counter(const std::string &counter) const;
+
+    bool write_json(const std::string &filename) const;
+
+    bool write_csv(const std::string &filename) const;
+
+    static double wall_clock();
+
+    static double cpu_clock();
+};
+
+};
+
+#endif // __PROFILER_HPP__
@@ -7,9 +7,10 @@
 //
 
 #include <cmath>
-#include <iostream>
+#include <cstdlib>
 
 #include <vortexje/shape-generators/airfoils/naca4-airfoil-generator.hpp>
+#include <vortexje/logger.hpp>
 
 using namespace std;
 using namespace Eigen;
@@ -80,7 +81,7 @@ vector<Vector3d, Eigen::aligned_allocator<Vector3d> >
 NACA4AirfoilGenerator::generate(double max_camber, double max_camber_dist, double max_thickness, bool finite_te_thickness, double chord, int n_points, int &trailing_edge_point_id)
 {
     if (n_points % 2 == 1) {
-        cerr << "NACA4::generate(): n_nodes must be even." << endl;
+        VORTEXJE_LOG(Logger::default_logger(), Logger::Error, "NACA4::generate(): n_nodes must be even.");
         exit(1);
     }
     
@@ -10,26 +10,304 @@
 #include <sys/stat.h>
 #include <errno.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <iomanip>
 #include <iostream>
 #include <limits>
+#include <sstream>
 #include <typeinfo>
 
 #ifdef _WIN32
 #include <direct.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
 #endif
 
 #include <Eigen/Geometry>
 #include <Eigen/SVD>
 #include <Eigen/IterativeLinearSolvers>
+#include <unsupported/Eigen/IterativeSolvers>
+#include <Eigen/SparseCore>
 
 #include <vortexje/solver.hpp>
 #include <vortexje/parameters.hpp>
+#include <vortexje/distributed.hpp>
+#include <vortexje/checkpoint.hpp>
+#include <vortexje/monitor.hpp>
 #include <vortexje/boundary-layers/dummy-boundary-layer.hpp>
 
 using namespace std;
 using namespace Eigen;
 using namespace Vortexje;
 
+// Matrix-free doublet system operator, A = D + W V^T, for use with the Eigen iterative solvers.  Here D is a
+// hierarchical matrix, W contains a column for every new wake panel, and V = [e_upper - e_lower].  Alternatively, the
+// operator wraps the rows of an assembled, dense A that are owned by this process, in which case the rows of the
+// product are exchanged between the processes.
+namespace Vortexje
+{
+
+class DoubletSystemOperator;
+
+};
+
+namespace Eigen
+{
+
+namespace internal
+{
+
+template<>
+struct traits<DoubletSystemOperator> : public Eigen::internal::traits<Eigen::SparseMatrix<double> > {};
+
+};
+
+};
+
+class Vortexje::DoubletSystemOperator : public EigenBase<DoubletSystemOperator>
+{
+public:
+    typedef double Scalar;
+    typedef double RealScalar;
+    typedef int StorageIndex;
+    
+    enum {
+        ColsAtCompileTime    = Eigen::Dynamic,
+        MaxColsAtCompileTime = Eigen::Dynamic,
+        IsRowMajor           = false
+    };
+    
+    DoubletSystemOperator(const HierarchicalMatrix &D, const MatrixXd &W, const vector<int> &upper_indices, const vector<int> &lower_indices)
+        : D(&D), W(&W), upper_indices(&upper_indices), lower_indices(&lower_indices), A_local(NULL), row_begin(0), row_end(0) {}
+        
+    DoubletSystemOperator(const MatrixXd &A_local, int row_begin, int row_end)
+        : D(NULL), W(NULL), upper_indices(NULL), lower_indices(NULL), A_local(&A_local), row_begin(row_begin), row_end(row_end) {}
+    
+    Index rows() const { return D ? D->rows() : A_local->cols(); }
+    Index cols() const { return rows(); }
+    
+    template<typename Rhs>
+    Product<DoubletSystemOperator, Rhs, AliasFreeProduct> operator*(const MatrixBase<Rhs> &x) const
+    {
+        return Product<DoubletSystemOperator, Rhs, AliasFreeProduct>(*this, x.derived());
+    }
+    
+    VectorXd apply(const VectorXd &x) const
+    {
+        if (A_local) {
+            VectorXd y(x.size());
+            y.segment(row_begin, row_end - row_begin) = (*A_local) * x;
+            
+            Distributed::allgather(y, row_begin, row_end);
+            
+            return y;
+        }
+        
+        VectorXd Vtx(W->cols());
+        for (int k = 0; k < (int) W->cols(); k++)
+            Vtx(k) = x((*upper_indices)[k]) - x((*lower_indices)[k]);
+            
+        return (*D) * x + (*W) * Vtx;
+    }
+    
+private:
+    const HierarchicalMatrix *D;
+    const MatrixXd *W;
+    const vector<int> *upper_indices;
+    const vector<int> *lower_indices;
+    
+    const MatrixXd *A_local;
+    int row_begin;
+    int row_end;
+};
+
+namespace Eigen
+{
+
+namespace internal
+{
+
+template<typename Rhs>
+struct generic_product_impl<DoubletSystemOperator, Rhs, SparseShape, DenseShape, GemvProduct>
+    : generic_product_impl_base<DoubletSystemOperator, Rhs, generic_product_impl<DoubletSystemOperator, Rhs> >
+{
+    typedef typename Product<DoubletSystemOperator, Rhs>::Scalar Scalar;
+    
+    template<typename Dest>
+    static void scaleAndAddTo(Dest &dst, const DoubletSystemOperator &lhs, const Rhs &rhs, const Scalar &alpha)
+    {
+        dst.noalias() += alpha * lhs.apply(rhs);
+    }
+};
+
+};
+
+};
+
+// Block-Jacobi preconditioner for use with the Eigen iterative solvers.  The LU factorizations of the diagonal blocks
+// are owned by the Solver, so that they can be reused across solves; compute() is therefore a no-op.
+namespace Vortexje
+{
+
+class BlockJacobiPreconditioner
+{
+public:
+    BlockJacobiPreconditioner() : offsets(NULL), blocks(NULL) {}
+    
+    template<typename MatrixType>
+    explicit BlockJacobiPreconditioner(const MatrixType &) : offsets(NULL), blocks(NULL) {}
+    
+    void set_blocks(const vector<int> &offsets, const vector<PartialPivLU<MatrixXd> > &blocks)
+    {
+        this->offsets = &offsets;
+        this->blocks  = &blocks;
+    }
+    
+    template<typename MatrixType>
+    BlockJacobiPreconditioner &analyzePattern(const MatrixType &) { return *this; }
+    
+    template<typename MatrixType>
+    BlockJacobiPreconditioner &factorize(const MatrixType &) { return *this; }
+    
+    template<typename MatrixType>
+    BlockJacobiPreconditioner &compute(const MatrixType &) { return *this; }
+    
+    template<typename Rhs>
+    VectorXd solve(const MatrixBase<Rhs> &b) const
+    {
+        VectorXd x(b.rows());
+        for (int i = 0; i < (int) blocks->size(); i++) {
+            int n = (*offsets)[i + 1] - (*offsets)[i];
+            
+            x.segment((*offsets)[i], n) = (*blocks)[i].solve(b.segment((*offsets)[i], n));
+        }
+        
+        return x;
+    }
+    
+    ComputationInfo info() { return Success; }
+    
+private:
+    const vector<int> *offsets;
+    const vector<PartialPivLU<MatrixXd> > *blocks;
+};
+
+};
+
+// Configuration of the iterative solvers.  Only GMRES has a restart length, and only the block-Jacobi preconditioner
+// needs its blocks:
+template<typename IterativeSolver>
+static void
+set_restart(IterativeSolver &solver, int restart)
+{
+}
+
+template<typename MatrixType, typename Preconditioner>
+static void
+set_restart(GMRES<MatrixType, Preconditioner> &solver, int restart)
+{
+    solver.set_restart(restart);
+}
+
+template<typename Preconditioner>
+static void
+set_blocks(Preconditioner &preconditioner, const vector<int> &offsets, const vector<PartialPivLU<MatrixXd> > &blocks)
+{
+}
+
+static void
+set_blocks(BlockJacobiPreconditioner &preconditioner, const vector<int> &offsets, const vector<PartialPivLU<MatrixXd> > &blocks)
+{
+    preconditioner.set_blocks(offsets, blocks);
+}
+
+// Scale of the tolerance of the iterative solvers.  BiCGSTAB measures the residual relative to the right-hand side,
+// but GMRES measures the preconditioned residual relative to that of the initial guess, a target that a good
+// initial guess cannot attain.  The tolerance of GMRES is therefore rescaled to that of a zero initial guess:
+template<typename IterativeSolver, typename VectorType>
+static double
+tolerance_scale(const IterativeSolver &solver, const VectorType &b, const VectorType &r0)
+{
+    return 1.0;
+}
+
+template<typename MatrixType, typename Preconditioner, typename VectorType>
+static double
+tolerance_scale(const GMRES<MatrixType, Preconditioner> &solver, const VectorType &b, const VectorType &r0)
+{
+    double r0_norm = solver.preconditioner().solve(r0).norm();
+    double b_norm  = solver.preconditioner().solve(b).norm();
+    
+    if (r0_norm == 0 || b_norm == 0)
+        return 1.0;
+        
+    return b_norm / r0_norm;
+}
+
+// Solves the assembled doublet system using the given type of Eigen iterative solver:
+template<typename IterativeSolver, typename MatrixType, typename VectorType>
+static bool
+iterative_solve(const MatrixType &A, const VectorType &b, const VectorType &guess, const SolverParameters &parameters,
+                const vector<int> &block_offsets, const vector<PartialPivLU<MatrixXd> > &blocks,
+                VectorType &x, int &iterations, double &error)
+{
+    // Is the initial guess good enough already?
+    VectorType r0 = b - A * guess;
+    
+    double b_norm = b.norm();
+    if (b_norm > 0 && r0.norm() <= parameters.linear_solver_tolerance * b_norm) {
+        x = guess;
+        
+        iterations = 0;
+        error      = r0.norm() / b_norm;
+        
+        return true;
+    }
+    
+    IterativeSolver solver(A);
+    solver.setMaxIterations(parameters.linear_solver_max_iterations);
+    
+    set_restart(solver, parameters.linear_solver_gmres_restart);
+    set_blocks(solver.preconditioner(), block_offsets, blocks);
+    
+    double scale = tolerance_scale(solver, b, r0);
+    solver.setTolerance(parameters.linear_solver_tolerance * scale);
+    
+    x = solver.solveWithGuess(b, guess);
+    
+    iterations = solver.iterations();
+    error      = solver.error() / scale;
+    
+    return (solver.info() == Success);
+}
+
+// Returns the given private copy of a surface in place of the surface that it copies, see compute_sensitivities():
+static const shared_ptr<Surface> &
+substitute_surface(const shared_ptr<Surface> &surface, const shared_ptr<Surface> &copy)
+{
+    if (copy && copy->id == surface->id)
+        return copy;
+
+    return surface;
+}
+
+// Number of points per tile in the batched velocity and velocity potential evaluations:
+#define POINT_TILE_SIZE 64
+
+// Number of panels per task in the phases that are executed as tasks over the panels of all surfaces:
+#define TASK_PANEL_CHUNK_SIZE 64
+
+// Numbers of rows and columns per tile in the assembly of the matrices of influence coefficients:
+#define ASSEMBLY_ROW_TILE_SIZE    256
+#define ASSEMBLY_COLUMN_TILE_SIZE 32
+
+// Pi:
+static const double pi = 3.141592653589793238462643383279502884;
+
 // String constants:
 #define VIEW_NAME_SOURCE_DISTRIBUTION   "sigma"
 #define VIEW_NAME_DOUBLET_DISTRIBUTION  "mu"
@@ -38,7 +316,7 @@ using namespace Vortexje;
 
 // Helper to create folders:
 static void
-mkdir_helper(const string folder)
+mkdir_helper(const string folder, const shared_ptr<Logger> &logger)
 {
 #ifdef _WIN32
     if (mkdir(folder.c_str()) < 0)
@@ -46,7 +324,26 @@ mkdir_helper(const string folder)
     if (mkdir(folder.c_str(), S_IRWXU) < 0)
 #endif
         if (errno != EEXIST)
-            cerr << "Could not create log folder " << folder << ": " << strerror(errno) << endl;
+            VORTEXJE_LOG(logger, Logger::Error, "Could not create log folder " << folder << ": " << strerror(errno));
+}
+
+// Version of the layout of the influence coefficient cache files.  Increment whenever the layout, or the evaluation
+// of the influence coefficients, changes:
+static const int64_t INFLUENCE_COEFFICIENT_CACHE_VERSION = 1;
+
+// Counter used to name temporary influence coefficient cache files uniquely within this process:
+static atomic<int> temporary_file_counter(0);
+
+// Updates a 64-bit FNV-1a hash with the given bytes:
+static void
+fnv1a_hash(uint64_t &hash, const void *data, size_t n_bytes)
+{
+    const unsigned char *bytes = (const unsigned char *) data;
+    
+    for (size_t i = 0; i < n_bytes; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
 }
 
 /**
@@ -64,9 +361,38 @@ Solver::Solver(const string &log_folder) : log_folder(log_folder)
     
     // Total number of panels:
     n_non_wake_panels = 0;
+    
+    // Rows of the matrices of influence coefficients owned by this process:
+    row_begin = 0;
+    row_end   = 0;
+    
+    // No influence coefficients, or factorization, yet:
+    influence_coefficients_symmetry_plane          = false;
+    influence_coefficients_cyclic_symmetry_sectors = 1;
+    doublet_influence_coefficients_factorized      = false;
+    
+    // No wake updates yet:
+    n_wake_updates = 0;
+    
+    // No unsteady solve yet:
+    last_solve_dt = 0.0;
+    
+    // Evaluate all outputs in solve():
+    all_outputs_required = true;
+    
+    // No preconditioner yet:
+    preconditioner_valid      = false;
+    preconditioner_block_size = 0;
+    preconditioner_iterations = -1;
+    
+    // Create profiler:
+    profiler = shared_ptr<Profiler>(new Profiler());
+    
+    // Log to the default logger:
+    logger = Logger::default_logger();
         
     // Open log files:
-    mkdir_helper(log_folder);
+    mkdir_helper(log_folder, logger);
 }
 
 /**
@@ -89,6 +415,35 @@ Solver::add_body(shared_ptr<Body> body)
     add_body(body, dummy_boundary_layer);
 }
 
+/**
+   Enters a surface in the lookup tables.
+   
+   @param[in]   surface   Surface to be entered.
+   @param[in]   bd        Owning body.
+   @param[in]   offset    Global index of the first panel of the surface, or -1 for wakes.
+*/
+void
+Solver::register_surface(const shared_ptr<Surface> &surface, const shared_ptr<BodyData> &bd, int offset)
+{
+    if (surface->id >= (int) surface_id_to_body.size()) {
+        surface_id_to_body.resize(surface->id + 1);
+        surface_id_to_offset.resize(surface->id + 1, -1);
+        
+        required_outputs.resize(surface->id + 1, false);
+        
+        surface_velocities_pending.resize(surface->id + 1, false);
+        surface_velocity_potentials_pending.resize(surface->id + 1, false);
+        pressure_coefficients_pending.resize(surface->id + 1, false);
+        
+        surface_forces.resize(surface->id + 1, Vector3d(0, 0, 0));
+        surface_moments.resize(surface->id + 1, Vector3d(0, 0, 0));
+        loads_valid.resize(surface->id + 1, false);
+    }
+    
+    surface_id_to_body[surface->id]   = bd;
+    surface_id_to_offset[surface->id] = offset;
+}
+
 /**
    Adds a body, with boundary layer model, to this solver.
    
@@ -108,7 +463,7 @@ Solver::add_body(shared_ptr<Body> body, shared_ptr<BoundaryLayer> boundary_layer
         
         non_wake_surfaces.push_back(d);
            
-        surface_id_to_body[d->surface->id] = bd;
+        register_surface(d->surface, bd, n_non_wake_panels);
         
         n_non_wake_panels += d->surface->n_panels();
     }
@@ -119,15 +474,30 @@ Solver::add_body(shared_ptr<Body> body, shared_ptr<BoundaryLayer> boundary_layer
         
         non_wake_surfaces.push_back(d);
            
-        surface_id_to_body[d->surface->id] = bd;
-        surface_id_to_body[d->wake->id]    = bd;
+        register_surface(d->surface, bd, n_non_wake_panels);
+        register_surface(d->wake, bd, -1);
+        
+        d->wake->parameters = parameters;
+        d->wake->logger     = logger;
+        
+        for (int j = 0; j < d->lifting_surface->n_spanwise_panels(); j++) {
+            trailing_edge_upper_indices.push_back(n_non_wake_panels + d->lifting_surface->trailing_edge_upper_panel(j));
+            trailing_edge_lower_indices.push_back(n_non_wake_panels + d->lifting_surface->trailing_edge_lower_panel(j));
+        }
         
         n_non_wake_panels += d->lifting_surface->n_panels();
     }
     
+    // Build panel adjacency table:
+    body->compute_adjacency();
+    
     doublet_coefficients.resize(n_non_wake_panels);
     doublet_coefficients.setZero();
     
+    // Invalidate matrices of influence coefficients:
+    influence_coefficients_geometry_revisions.clear();
+    influence_coefficients_transformations.clear();
+    
     source_coefficients.resize(n_non_wake_panels);
     source_coefficients.setZero();
     
@@ -140,20 +510,26 @@ Solver::add_body(shared_ptr<Body> body, shared_ptr<BoundaryLayer> boundary_layer
     pressure_coefficients.resize(n_non_wake_panels);
     pressure_coefficients.setZero();
     
+    surface_velocity_potential_time_derivatives.resize(n_non_wake_panels);
+    surface_velocity_potential_time_derivatives.setZero();
+    
+    panel_forces.resize(3, n_non_wake_panels);
+    loads_valid.assign(loads_valid.size(), false);
+    
     previous_surface_velocity_potentials.resize(n_non_wake_panels);
     previous_surface_velocity_potentials.setZero();
 
     // Open logs:
     string body_log_folder = log_folder + "/" + body->id;
     
-    mkdir_helper(body_log_folder);
+    mkdir_helper(body_log_folder, logger);
     
     for (int i = 0; i < (int) body->non_lifting_surfaces.size(); i++) {
         stringstream ss;
         ss << body_log_folder << "/non_lifting_surface_" << i;
         
         string s = ss.str();
-        mkdir_helper(s);
+        mkdir_helper(s, logger);
     }
     
     for (int i = 0; i < (int) body->lifting_surfaces.size(); i++) {
@@ -161,17 +537,29 @@ Solver::add_body(shared_ptr<Body> body, shared_ptr<BoundaryLayer> boundary_layer
         ss << body_log_folder << "/lifting_surface_" << i;
         
         string s = ss.str();
-        mkdir_helper(s);
+        mkdir_helper(s, logger);
         
         ss.str(string());
         ss.clear();
         ss << body_log_folder << "/wake_" << i;
         
         s = ss.str();
-        mkdir_helper(s);      
+        mkdir_helper(s, logger);      
     }
 }
 
+/**
+   Adds a monitor to this solver.  The monitor is recorded at the end of every successful solve(), with the time step
+   passed to solve().
+   
+   @param[in]   monitor   Monitor to be added.
+*/
+void
+Solver::add_monitor(const shared_ptr<Monitor> &monitor)
+{
+    monitors.push_back(monitor);
+}
+
 /**
    Sets the freestream velocity.
    
@@ -180,6 +568,9 @@ Solver::add_body(shared_ptr<Body> body, shared_ptr<BoundaryLayer> boundary_layer
 void
 Solver::set_freestream_velocity(const Vector3d &value)
 {
+    // Pending outputs refer to the previous freestream velocity:
+    evaluate_pending_outputs();
+    
     freestream_velocity = value;
 }
 
@@ -222,6 +613,41 @@ Solver::velocity(const Eigen::Vector3d &x) const
     return compute_disturbance_velocity(x) + freestream_velocity;
 }
 
+/**
+   Computes the velocity potential at a set of points.
+   
+   @param[in]   x   Reference points, one per column.
+   
+   @returns Velocity potentials, one per point.
+*/
+Eigen::VectorXd
+Solver::velocity_potential(const Eigen::Matrix3Xd &x) const
+{
+    VectorXd phi;
+    compute_disturbance_velocity_potentials(x, phi);
+    
+    // Sum disturbance potential with freestream velocity potential:
+    return phi + x.transpose() * freestream_velocity;
+}
+
+/**
+   Computes the total stream velocity at a set of points.  This uses the treecode, or the accelerator backend, if
+   requested.
+   
+   @param[in]   x   Reference points, one per column.
+   
+   @returns Stream velocities, one per column.
+*/
+Eigen::Matrix3Xd
+Solver::velocity(const Eigen::Matrix3Xd &x) const
+{
+    Matrix3Xd velocities;
+    compute_disturbance_velocities(x, velocities);
+    
+    // Sum disturbance velocity with freestream velocity:
+    return velocities.colwise() + freestream_velocity;
+}
+
 /**
    Returns the surface velocity potential for the given panel.
    
@@ -233,11 +659,13 @@ Solver::velocity(const Eigen::Vector3d &x) const
 double
 Solver::surface_velocity_potential(const shared_ptr<Surface> &surface, int panel) const
 {
+    evaluate_surface_velocity_potentials(surface);
+    
     int index = compute_index(surface, panel);
     if (index >= 0)
         return surface_velocity_potentials(index);
 
-    cerr << "Solver::surface_velocity_potential():  Panel " << panel << " not found on surface " << surface->id << "." << endl;
+    VORTEXJE_LOG(logger, Logger::Error, "Solver::surface_velocity_potential():  Panel " << panel << " not found on surface " << surface->id << ".");
     
     return 0.0;
 }
@@ -253,11 +681,13 @@ Solver::surface_velocity_potential(const shared_ptr<Surface> &surface, int panel
 Vector3d
 Solver::surface_velocity(const shared_ptr<Surface> &surface, int panel) const
 {
+    evaluate_surface_velocities(surface);
+    
     int index = compute_index(surface, panel);
     if (index >= 0)
         return surface_velocities.row(index);
     
-    cerr << "Solver::surface_velocity():  Panel " << panel << " not found on surface " << surface->id << "." << endl;
+    VORTEXJE_LOG(logger, Logger::Error, "Solver::surface_velocity():  Panel " << panel << " not found on surface " << surface->id << ".");
     
     return Vector3d(0, 0, 0);
 }
@@ -273,17 +703,21 @@ Solver::surface_velocity(const shared_ptr<Surface> &surface, int panel) const
 double
 Solver::pressure_coefficient(const shared_ptr<Surface> &surface, int panel) const
 {
+    evaluate_pressure_coefficients(surface);
+    
     int index = compute_index(surface, panel);
     if (index >= 0)
         return pressure_coefficients(index);
     
-    cerr << "Solver::pressure_coefficient():  Panel " << panel << " not found on surface " << surface->id << "." << endl;
+    VORTEXJE_LOG(logger, Logger::Error, "Solver::pressure_coefficient():  Panel " << panel << " not found on surface " << surface->id << ".");
     
     return 0.0;
 }
 
 /**
-   Computes the force caused by the pressure distribution on the given body.
+   Returns the force caused by the pressure distribution on the given body.  The loads of the body are integrated upon
+   the first query after every solution, and cached until the next solution.  If parameters.symmetry_plane or
+   parameters.cyclic_symmetry_sectors is set, this is the force on the meshed part of the body only.
    
    @param[in]   body   Reference body.
   
@@ -292,37 +726,22 @@ Solver::pressure_coefficient(const shared_ptr<Surface> &surface, int panel) cons
 Eigen::Vector3d
 Solver::force(const shared_ptr<Body> &body) const
 {
-    // Dynamic pressure:
-    double q = 0.5 * fluid_density * compute_reference_velocity_squared(body);
-        
-    // Total force on body:
     Vector3d F(0, 0, 0);
-    int offset = 0;
     
-    vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
-    for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
-        const shared_ptr<Body::SurfaceData> &d = *si;
-        
-        const shared_ptr<BodyData> &bd = surface_id_to_body.find(d->surface->id)->second;
-        if (body.get() == bd->body.get()) {        
-            for (int i = 0; i < d->surface->n_panels(); i++) {
-                const Vector3d &normal = d->surface->panel_normal(i);
-                double surface_area = d->surface->panel_surface_area(i);
-                F += q * surface_area * pressure_coefficients(offset + i) * normal;
-                
-                F += bd->boundary_layer->friction(d->surface, i);
-            }
-        }
+    for (int i = 0; i < body->n_surfaces(); i++) {
+        const shared_ptr<Surface> &surface = body->surface(i);
         
-        offset += d->surface->n_panels();
+        if (evaluate_loads(surface))
+            F += surface_forces[surface->id];
     }
-                    
-    // Done:
+    
     return F;      
 }
 
 /**
-   Computes the moment caused by the pressure distribution on the given body, relative to the given point.
+   Returns the moment caused by the pressure distribution on the given body, relative to the given point.  The
+   moment is obtained from the cached loads, see force().  If parameters.symmetry_plane or
+   parameters.cyclic_symmetry_sectors is set, this is the moment on the meshed part of the body only.
    
    @param[in]   body   Reference body.
    @param[in]   x      Reference point.
@@ -332,40 +751,151 @@ Solver::force(const shared_ptr<Body> &body) const
 Eigen::Vector3d
 Solver::moment(const shared_ptr<Body> &body, const Eigen::Vector3d &x) const
 {
-    // Dynamic pressure:
-    double q = 0.5 * fluid_density * compute_reference_velocity_squared(body);
-        
-    // Total moment on body:
     Vector3d M(0, 0, 0);
-    int offset = 0;
     
-    vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
-    for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
-        const shared_ptr<Body::SurfaceData> &d = *si;
+    for (int i = 0; i < body->n_surfaces(); i++)
+        M += moment(body->surface(i), x);
+    
+    return M;
+}
+
+/**
+   Returns the force caused by the pressure distribution on the given surface.  See force(const std::shared_ptr<Body> &).
+   
+   @param[in]   surface   Reference surface.
+  
+   @returns Force vector.
+*/
+Eigen::Vector3d
+Solver::force(const shared_ptr<Surface> &surface) const
+{
+    if (!evaluate_loads(surface)) {
+        VORTEXJE_LOG(logger, Logger::Error, "Solver::force():  Surface " << surface->id << " not found.");
+        
+        return Vector3d(0, 0, 0);
+    }
+    
+    return surface_forces[surface->id];
+}
+
+/**
+   Returns the moment caused by the pressure distribution on the given surface, relative to the given point.  See
+   moment(const std::shared_ptr<Body> &, const Eigen::Vector3d &).
+   
+   @param[in]   surface   Reference surface.
+   @param[in]   x         Reference point.
+  
+   @returns Moment vector.
+*/
+Eigen::Vector3d
+Solver::moment(const shared_ptr<Surface> &surface, const Eigen::Vector3d &x) const
+{
+    if (!evaluate_loads(surface))
+        return Vector3d(0, 0, 0);
+    
+    // Shift the moment about the origin to the reference point:
+    return surface_moments[surface->id] - x.cross(surface_forces[surface->id]);
+}
+
+/**
+   Returns the forces and moments on the spanwise strips of the given lifting surface.  Strip j consists of the
+   chordwise columns j of the upper and lower panels.  The strip loads are summed from the cached panel forces, see
+   force().
+   
+   @param[in]   lifting_surface   Reference lifting surface.
+   @param[in]   x                 Reference point for the moments.
+   @param[out]  forces            Force on every strip, one per column.
+   @param[out]  moments           Moment on every strip, relative to x, one per column.
+*/
+void
+Solver::strip_loads(const shared_ptr<LiftingSurface> &lifting_surface, const Eigen::Vector3d &x, Matrix3Xd &forces, Matrix3Xd &moments) const
+{
+    int n_strips = lifting_surface->n_spanwise_panels();
+    
+    forces  = Matrix3Xd::Zero(3, n_strips);
+    moments = Matrix3Xd::Zero(3, n_strips);
+    
+    if (!evaluate_loads(lifting_surface)) {
+        VORTEXJE_LOG(logger, Logger::Error, "Solver::strip_loads():  Surface " << lifting_surface->id << " not found.");
         
-        const shared_ptr<BodyData> &bd = surface_id_to_body.find(d->surface->id)->second;
-        if (body.get() == bd->body.get()) { 
-            for (int i = 0; i < d->surface->n_panels(); i++) {                                    
-                const Vector3d &normal = d->surface->panel_normal(i);
-                double surface_area = d->surface->panel_surface_area(i);
-                Vector3d F = q * surface_area * pressure_coefficients(offset + i) * normal;
+        return;
+    }
+    
+    int offset = surface_id_to_offset[lifting_surface->id];
+    int j;
+    
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(dynamic, 1)
+        for (j = 0; j < n_strips; j++) {
+            for (int i = 0; i < lifting_surface->n_chordwise_panels(); i++) {
+                int panels[2] = { lifting_surface->upper_panels(i, j), lifting_surface->lower_panels(i, j) };
                 
-                F += bd->boundary_layer->friction(d->surface, i);
+                for (int k = 0; k < 2; k++) {
+                    const Vector3d &F = panel_forces.col(offset + panels[k]);
                     
-                Vector3d r = d->surface->panel_collocation_point(i, false) - x;
-                M += r.cross(F);
+                    Vector3d r = lifting_surface->panel_collocation_point(panels[k], false) - x;
+                    
+                    forces.col(j)  += F;
+                    moments.col(j) += r.cross(F);
+                }
             }
         }
-        
-        offset += d->surface->n_panels();
     }
-    
-    // Done:
-    return M;
 }
 
 /**
-   Traces a streamline, starting from the given starting point.
+   Computes the derivatives of the component of the force on the given body along the given direction, with respect
+   to the node positions of all non-wake surfaces, to the linear and rotational velocity of the body, and to the
+   freestream velocity.
+   
+   The derivatives are obtained from the discrete adjoint of the doublet system.  A single solve of the transposed
+   system gives the sensitivity of the force component to the residual of every panel equation, so that the cost
+   does not grow with the number of design variables.  If parameters.direct_linear_solver is set, the cached LU
+   factorization of the doublet system is reused.  The derivatives of the influence coefficients with respect to the
+   position of a node are evaluated by central differences of the influence kernels of the adjacent panels only, with
+   a step of parameters.sensitivity_perturbation times the panel diameter.  The nodes are displaced on private
+   copies of the surfaces and of the wakes, so that the shared geometry is never modified, and other solvers may
+   read it concurrently.
+   
+   The geometry of the wakes is held fixed, but for the trailing edge nodes, which follow the nodes of the lifting
+   surfaces, as in Body::morph_surface().  Sensitivities require a preceding steady solve, i.e., solve() with a
+   time step of zero, without wake convection, without N. Marcov's surface velocity formula, and with dummy boundary
+   layers only.  The matrices of influence coefficients must be stored densely, in double precision, on a single
+   process.
+   
+   @param[in]   body            Reference body.
+   @param[in]   direction       Direction of the force component.
+   @param[out]  sensitivities   Sensitivities of the force component.
+   
+   @returns true on success.
+*/
+bool
+Solver::force_sensitivities(const shared_ptr<Body> &body, const Eigen::Vector3d &direction, Sensitivities &sensitivities)
+{
+    return compute_sensitivities(body, direction, false, Vector3d(0, 0, 0), sensitivities);
+}
+
+/**
+   Computes the derivatives of the component of the moment on the given body about the given axis, relative to the
+   given point.  See force_sensitivities().
+   
+   @param[in]   body            Reference body.
+   @param[in]   x               Reference point.
+   @param[in]   axis            Axis of the moment component.
+   @param[out]  sensitivities   Sensitivities of the moment component.
+   
+   @returns true on success.
+*/
+bool
+Solver::moment_sensitivities(const shared_ptr<Body> &body, const Eigen::Vector3d &x, const Eigen::Vector3d &axis, Sensitivities &sensitivities)
+{
+    return compute_sensitivities(body, axis, true, x, sensitivities);
+}
+
+/**
+   Traces a streamline, starting from the given starting point.  Tracing ends at stagnation points, at the boundary
+   of the body, where the velocity reverses across a panel edge, or after as many points as there are panels.
    
    @param[in]   start   Starting point for streamline.
    
@@ -376,15 +906,95 @@ Solver::trace_streamline(const SurfacePanelPoint &start) const
 {
     vector<SurfacePanelPoint, Eigen::aligned_allocator<Solver::SurfacePanelPoint> > streamline;
     
-    SurfacePanelPoint cur(start.surface, start.panel, start.point);
+    evaluate_surface_velocities(start.surface);
+    
+    trace_streamline(start, NULL, streamline);
+    
+    // Done:
+    return streamline;
+}
+
+/**
+   Traces a streamline from every seed concurrently.  The inverse panel coordinate transformations are computed once
+   for all seeds, and the streamlines are returned in a single, flat container.  See trace_streamline().
+   
+   @param[in]   seeds         Starting points.
+   @param[out]  streamlines   Streamline of every seed, in order.
+*/
+void
+Solver::trace_streamlines(const vector<SurfacePanelPoint, Eigen::aligned_allocator<SurfacePanelPoint> > &seeds, Streamlines &streamlines) const
+{
+    int n_seeds = seeds.size();
+    int i;
+    
+    // The surface velocities are read concurrently, and must therefore be up to date:
+    for (i = 0; i < n_seeds; i++)
+        evaluate_surface_velocities(seeds[i].surface);
+    
+    // Invert the panel coordinate transformations of all non-wake panels:
+    vector<Transform<double, 3, Affine>, Eigen::aligned_allocator<Transform<double, 3, Affine> > > inverse_transformations(n_non_wake_panels);
+    
+    vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
+    for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+        const shared_ptr<Surface> &surface = (*si)->surface;
+        int offset = surface_id_to_offset[surface->id];
+        
+        #pragma omp parallel
+        {
+            #pragma omp for schedule(dynamic, 1)
+            for (i = 0; i < surface->n_panels(); i++)
+                inverse_transformations[offset + i] = surface->panel_coordinate_transformation(i).inverse();
+        }
+    }
+    
+    // Trace:
+    vector<vector<SurfacePanelPoint, Eigen::aligned_allocator<SurfacePanelPoint> > > traced(n_seeds);
+    
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(dynamic, 1)
+        for (i = 0; i < n_seeds; i++)
+            trace_streamline(seeds[i], &inverse_transformations, traced[i]);
+    }
+    
+    // Concatenate:
+    streamlines.offsets.resize(n_seeds + 1);
+    streamlines.offsets[0] = 0;
+    for (i = 0; i < n_seeds; i++)
+        streamlines.offsets[i + 1] = streamlines.offsets[i] + traced[i].size();
+        
+    streamlines.points.clear();
+    streamlines.points.reserve(streamlines.offsets[n_seeds]);
+    for (i = 0; i < n_seeds; i++)
+        streamlines.points.insert(streamlines.points.end(), traced[i].begin(), traced[i].end());
+}
+
+/**
+   Traces a streamline, starting from the given starting point.  The surface velocities must be up to date.
+   
+   @param[in]   start                     Starting point for streamline.
+   @param[in]   inverse_transformations   Inverse coordinate transformations of all non-wake panels, or NULL.
+   @param[out]  streamline                A list of points tracing the streamline.
+*/
+void
+Solver::trace_streamline(const SurfacePanelPoint &start, const vector<Transform<double, 3, Affine>, Eigen::aligned_allocator<Transform<double, 3, Affine> > > *inverse_transformations,
+                         vector<SurfacePanelPoint, Eigen::aligned_allocator<SurfacePanelPoint> > &streamline) const
+{
+    streamline.clear();
+    
+    SurfacePanelPoint cur(start.surface, start.panel, start.point);
     
     Vector3d prev_intersection = start.point;
     int originating_edge = -1;
     
     // Trace until we hit the end of a surface, or until we hit a stagnation point:
-    while (true) {
+    while ((int) streamline.size() < n_non_wake_panels) {
         // Look up panel velocity:
-        Vector3d velocity = surface_velocity(cur.surface, cur.panel);
+        int index = compute_index(cur.surface, cur.panel);
+        if (index < 0)
+            break;
+            
+        Vector3d velocity = surface_velocities.row(index);
         
         // Stop following the streamline at stagnation points:
         if (velocity.norm() < Parameters::inversion_tolerance)
@@ -402,40 +1012,35 @@ Solver::trace_streamline(const SurfacePanelPoint &start) const
         // Intersect with one of the panel edges.
         int edge_id = -1;
         double t = numeric_limits<double>::max();
-        for (int i = 0; i < (int) cur.surface->panel_nodes[cur.panel].size(); i++) {
+        for (int i = 0; i < cur.surface->panel_node_counts[cur.panel]; i++) {
             // Do not try to intersect with the edge we are already on:
             if (i == originating_edge)
                 continue;
                 
             // Compute next node index:
             int next_idx;
-            if (i == (int) cur.surface->panel_nodes[cur.panel].size() - 1)
+            if (i == cur.surface->panel_node_counts[cur.panel] - 1)
                 next_idx = 0;
             else
                 next_idx = i + 1;
               
             // Retrieve nodes in panel-local coordinates:  
-            const Vector3d &node_a = cur.surface->panel_transformed_points[cur.panel][i];
-            const Vector3d &node_b = cur.surface->panel_transformed_points[cur.panel][next_idx];
+            Vector3d node_a = cur.surface->panel_transformed_point(cur.panel, i);
+            Vector3d node_b = cur.surface->panel_transformed_point(cur.panel, next_idx);
             
             // Compute edge:
             Vector3d edge = node_b - node_a;
             
-            // Find intersection, if any:
-            Matrix2d A;
-            Vector2d b;
-            for (int j = 0; j < 2; j++) {
-                A(j, 0) = transformed_velocity(j);
-                A(j, 1) = -edge(j);
-                b(j)    = -transformed_point(j) + node_a(j);
-            }
-            
-            ColPivHouseholderQR<Matrix2d> solver(A);
-            solver.setThreshold(Parameters::inversion_tolerance);
-            if (!solver.isInvertible())
+            // Find intersection, if any, by solving t v - s e = a - p for the velocity and edge coefficients using
+            // Cramer's rule:
+            double det = edge(0) * transformed_velocity(1) - transformed_velocity(0) * edge(1);
+            if (fabs(det) <= Parameters::inversion_tolerance * transformed_velocity.head<2>().norm() * edge.head<2>().norm())
                 continue;
             
-            Vector2d x = solver.solve(b);
+            Vector2d b = node_a.head<2>() - transformed_point.head<2>();
+            
+            Vector2d x((edge(0) * b(1) - b(0) * edge(1)) / det,
+                       (transformed_velocity(0) * b(1) - transformed_velocity(1) * b(0)) / det);
   
             // Only accept positive quadrant:
             if (x(0) < 0 || x(1) < 0)
@@ -459,7 +1064,12 @@ Solver::trace_streamline(const SurfacePanelPoint &start) const
         
         // Compute intersection vector:
         Vector3d transformed_intersection = transformed_point + t * transformed_velocity;
-        Vector3d intersection = transformation.inverse() * transformed_intersection;
+        
+        Vector3d intersection;
+        if (inverse_transformations)
+            intersection = (*inverse_transformations)[index] * transformed_intersection;
+        else
+            intersection = transformation.inverse() * transformed_intersection;
         
         // Compute mean between intersection points:
         Vector3d mean_point = 0.5 * (intersection + prev_intersection);
@@ -470,18 +1080,24 @@ Solver::trace_streamline(const SurfacePanelPoint &start) const
         streamline.push_back(n);
         
         // Find neighbor across edge:
-        const shared_ptr<BodyData> &bd = surface_id_to_body.find(cur.surface->id)->second;
-        vector<Body::SurfacePanelEdge> neighbors = bd->body->panel_neighbors(cur.surface, cur.panel, edge_id);
+        const shared_ptr<BodyData> &bd = surface_id_to_body[cur.surface->id];
+        const Body::PanelNeighbor *neighbor = bd->body->panel_neighbor(bd->body->surface_index(cur.surface.get()), cur.panel, edge_id);
         
         // No neighbor?
-        if (neighbors.size() == 0)
+        if (neighbor == NULL)
+            break;
+            
+        const shared_ptr<Surface> &neighbor_surface = bd->body->surface(neighbor->surface);
+        
+        int neighbor_index = compute_index(neighbor_surface, neighbor->panel);
+        if (neighbor_index < 0)
             break;
             
         // Verify the direction of the neighboring velocity vector:
-        Vector3d neighbor_velocity = surface_velocity(neighbors[0].surface, neighbors[0].panel);
+        Vector3d neighbor_velocity = surface_velocities.row(neighbor_index);
         
         const Vector3d &normal          = cur.surface->panel_normal(cur.panel);
-        const Vector3d &neighbor_normal = neighbors[0].surface->panel_normal(neighbors[0].panel);
+        const Vector3d &neighbor_normal = neighbor_surface->panel_normal(neighbor->panel);
         
         Quaterniond unfold = Quaterniond::FromTwoVectors(neighbor_normal, normal);
         Vector3d unfolded_neighbor_velocity = unfold * neighbor_velocity;
@@ -492,15 +1108,31 @@ Solver::trace_streamline(const SurfacePanelPoint &start) const
         }
             
         // Proceed to neighboring panel:
-        cur.surface = neighbors[0].surface;
-        cur.panel   = neighbors[0].panel;
+        cur.surface = neighbor_surface;
+        cur.panel   = neighbor->panel;
         cur.point   = intersection;
         
-        originating_edge = neighbors[0].edge;
+        originating_edge = neighbor->edge;
+    }
+}
+
+/**
+   Copies the parameters and the logger of this solver into all wakes, so that wake emission, truncation, and
+   coarsening follow the settings of this solver.
+*/
+void
+Solver::configure_wakes()
+{
+    vector<shared_ptr<BodyData> >::iterator bdi;
+    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+        shared_ptr<BodyData> bd = *bdi;
+        
+        vector<shared_ptr<Body::LiftingSurfaceData> >::iterator lsi;
+        for (lsi = bd->body->lifting_surfaces.begin(); lsi != bd->body->lifting_surfaces.end(); lsi++) {
+            (*lsi)->wake->parameters = parameters;
+            (*lsi)->wake->logger     = logger;
+        }
     }
-    
-    // Done:
-    return streamline;
 }
 
 /**
@@ -511,6 +1143,8 @@ Solver::trace_streamline(const SurfacePanelPoint &start) const
 void
 Solver::initialize_wakes(double dt)
 {
+    configure_wakes();
+    
     // Add initial wake layers:
     vector<shared_ptr<BodyData> >::iterator bdi;
     for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
@@ -522,7 +1156,7 @@ Solver::initialize_wakes(double dt)
             
             d->wake->add_layer();
             for (int i = 0; i < d->lifting_surface->n_spanwise_nodes(); i++) {
-                if (Parameters::convect_wake) {
+                if (parameters.convect_wake) {
                     // Convect wake nodes that coincide with the trailing edge.
                     d->wake->nodes[i] += compute_trailing_edge_vortex_displacement(bd->body, d->lifting_surface, i, dt);
                     
@@ -530,7 +1164,7 @@ Solver::initialize_wakes(double dt)
                     // Initialize static wake->
                     Vector3d body_apparent_velocity = bd->body->velocity - freestream_velocity;
                     
-                    d->wake->nodes[i] -= Parameters::static_wake_length * body_apparent_velocity / body_apparent_velocity.norm();
+                    d->wake->nodes[i] -= parameters.static_wake_length * body_apparent_velocity / body_apparent_velocity.norm();
                 }
             }
             
@@ -558,228 +1192,395 @@ Solver::solve(double dt, bool propagate)
     
     int boundary_layer_iteration = 0;
     
+    Profiler::Timer solve_timer(profiler, "solve");
+    
+    profiler->set("panels", n_non_wake_panels);
+    
+    last_solve_dt = dt;
+    
+    // The images of the geometry are only meaningful if the freestream shares their symmetry:
+    if (parameters.symmetry_plane && freestream_velocity(1) != 0.0)
+        VORTEXJE_LOG(logger, Logger::Warning, "Solver: The freestream velocity is not parallel to the symmetry plane.");
+    if (parameters.cyclic_symmetry_sectors > 1 && (freestream_velocity(0) != 0.0 || freestream_velocity(1) != 0.0))
+        VORTEXJE_LOG(logger, Logger::Warning, "Solver: The freestream velocity is not parallel to the cyclic symmetry axis.");
+    
+    // Rebuild the panel adjacency tables, in case panels were stitched since the last solve:
+    Profiler::Timer geometry_timer(profiler, "geometry");
+    
+    vector<shared_ptr<BodyData> >::iterator bdi;
+    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++)
+        (*bdi)->body->compute_adjacency();
+        
+    geometry_timer.stop();
+    
+    // Populate the matrices of influence coefficients.  These depend on the geometry only, and are therefore
+    // computed outside of the boundary layer iteration.
+    Profiler::Timer assembly_timer(profiler, "assembly");
+    
+    compute_influence_coefficients();
+    
+    // Add the influence of the new wake panels:
+    VORTEXJE_LOG(logger, Logger::Info, "Solver: Computing influence coefficients of new wake panels.");
+    
+    MatrixXd wake_influence_coefficients;
+    vector<int> wake_upper_indices, wake_lower_indices;
+    
+    compute_wake_influence_coefficients(wake_influence_coefficients, wake_upper_indices, wake_lower_indices);
+    
+    int n_wake_columns = wake_influence_coefficients.cols();
+    
+    profiler->set("new_wake_panels", n_wake_columns);
+    
+    // In distributed mode, every process holds a block of rows of the dense matrices, and the doublet system is
+    // solved iteratively:
+    bool distributed = (Distributed::size() > 1);
+    
+    int n_local_rows = row_end - row_begin;
+    
+    // The system matrix is the matrix of doublet influence coefficients, with the influence of every new wake panel
+    // added to the column of its upper trailing edge panel, and subtracted from the column of its lower trailing
+    // edge panel.  That is, A = D + W V^T, with V = [e_upper - e_lower].
+    MatrixXd A;
+    MatrixXf A_single;
+    
+    bool single_precision = use_single_precision();
+    
+    MatrixXd wake_correction;
+    PartialPivLU<MatrixXd> wake_capacitance_lu;
+    
+    VectorXd inverse_diagonal;
+    
+    if (compressed_doublet_influence_coefficients) {
+        // Matrix-free; nothing to assemble.
+        
+    } else if (parameters.direct_linear_solver && !distributed) {
+        // Factorize D only if it changed since the previous call.  The rank-n_wake_columns update is handled
+        // using the Sherman-Morrison-Woodbury formula:
+        //   A^-1 b = D^-1 b - Z (I + V^T Z)^-1 V^T D^-1 b,   with Z = D^-1 W.
+        factorize_doublet_influence_coefficients();
+            
+        compute_wake_correction(wake_influence_coefficients, wake_upper_indices, wake_lower_indices, wake_correction, wake_capacitance_lu);
+        
+    } else if (single_precision) {
+        A_single = single_precision_doublet_influence_coefficients;
+        
+        for (int k = 0; k < n_wake_columns; k++) {
+            A_single.col(wake_upper_indices[k]) += wake_influence_coefficients.col(k).cast<float>();
+            A_single.col(wake_lower_indices[k]) -= wake_influence_coefficients.col(k).cast<float>();
+        }
+        
+    } else {
+        A = doublet_influence_coefficients;
+        
+        for (int k = 0; k < n_wake_columns; k++) {
+            A.col(wake_upper_indices[k]) += wake_influence_coefficients.col(k).segment(row_begin, n_local_rows);
+            A.col(wake_lower_indices[k]) -= wake_influence_coefficients.col(k).segment(row_begin, n_local_rows);
+        }
+        
+        // Scale the local rows by the inverse of their diagonal entries.  This Jacobi preconditioning is applied to
+        // the right hand side as well, below:
+        if (distributed) {
+            inverse_diagonal.resize(n_local_rows);
+            for (int i = 0; i < n_local_rows; i++)
+                inverse_diagonal(i) = 1.0 / A(i, row_begin + i);
+                
+            A = inverse_diagonal.asDiagonal() * A;
+        }
+    }
+    
+    assembly_timer.stop();
+    
+    // The wake is frozen during the boundary layer iteration, and so is the velocity it induces on the bodies:
+    if (parameters.convect_wake) {
+        Profiler::Timer timer(profiler, "wake_induced_velocities");
+        
+        compute_wake_induced_velocities();
+    }
+    
+    // Relaxation of the update of the source distribution.  The residual of the previous iteration adapts the
+    // relaxation factor;  with Anderson acceleration, the differences of the most recent residuals and updates are
+    // kept instead:
+    double relaxation_factor = parameters.boundary_layer_relaxation_factor;
+    
+    VectorXd previous_source_residual, previous_source_update;
+    double source_residual_norm = 0.0;
+    
+    vector<VectorXd> residual_differences, update_differences;
+    
     while (true) {
         // Copy state:
         previous_source_coefficients  = source_coefficients;
         previous_doublet_coefficients = doublet_coefficients;
         
         // Compute new source distribution:
-        cout << "Solver: Computing source distribution with wake influence." << endl;
+        VORTEXJE_LOG(logger, Logger::Info, "Solver: Computing source distribution with wake influence.");
         
-        offset = 0;
+        Profiler::Timer source_timer(profiler, "source_coefficients");
         
-        vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
-        for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
-            const shared_ptr<Body::SurfaceData> &d = *si;
-            int i;
+        compute_source_coefficients(true);
+        
+        // Relax the update of the source distribution.  On the first iteration, the boundary layers stem from the
+        // previous call to solve(), and the update also contains the change of the kinematics;  it is taken as is.
+        if (boundary_layer_iteration > 0) {
+            VectorXd source_residual = source_coefficients - previous_source_coefficients;
             
-            const shared_ptr<BodyData> &bd = surface_id_to_body.find(d->surface->id)->second;
+            source_residual_norm = source_residual.norm();
             
-            #pragma omp parallel
-            {
-                #pragma omp for schedule(dynamic, 1)
-                for (i = 0; i < d->surface->n_panels(); i++)
-                    source_coefficients(offset + i) = compute_source_coefficient(bd->body, d->surface, i, bd->boundary_layer, true);
-            }
+            VectorXd source_update = source_coefficients;
             
-            offset += d->surface->n_panels();
-        }
-      
-        // Populate the matrices of influence coefficients:
-        cout << "Solver: Computing matrices of influence coefficients." << endl;
-        
-        MatrixXd A(n_non_wake_panels, n_non_wake_panels);
-        MatrixXd source_influence_coefficients(n_non_wake_panels, n_non_wake_panels);
-        
-        int offset_row = 0, offset_col = 0;
-        
-        vector<shared_ptr<Body::SurfaceData> >::const_iterator si_row;
-        for (si_row = non_wake_surfaces.begin(); si_row != non_wake_surfaces.end(); si_row++) {
-            const shared_ptr<Body::SurfaceData> &d_row = *si_row;
-
-            offset_col = 0;
-     
-            // Influence coefficients between all non-wake surfaces:
-            vector<shared_ptr<Body::SurfaceData> >::const_iterator si_col;
-            for (si_col = non_wake_surfaces.begin(); si_col != non_wake_surfaces.end(); si_col++) {
-                shared_ptr<Body::SurfaceData> d_col = *si_col;
-                int i, j;
-                
-                #pragma omp parallel private(j) 
-                {
-                    #pragma omp for schedule(dynamic, 1)
-                    for (i = 0; i < d_row->surface->n_panels(); i++) {
-                        for (j = 0; j < d_col->surface->n_panels(); j++) {
-                            d_col->surface->source_and_doublet_influence(d_row->surface, i, j,
-                                                                         source_influence_coefficients(offset_row + i, offset_col + j), 
-                                                                         A(offset_row + i, offset_col + j));
-                        }
+            if (parameters.boundary_layer_anderson_depth > 0) {
+                // Anderson acceleration:  combine the most recent updates such that the linearized residual is
+                // minimized in the least-squares sense.
+                if (previous_source_residual.size() == source_residual.size()) {
+                    residual_differences.push_back(source_residual - previous_source_residual);
+                    update_differences.push_back(source_update - previous_source_update);
+                    
+                    if ((int) residual_differences.size() > parameters.boundary_layer_anderson_depth) {
+                        residual_differences.erase(residual_differences.begin());
+                        update_differences.erase(update_differences.begin());
                     }
                 }
                 
-                offset_col = offset_col + d_col->surface->n_panels();
-            }
-            
-            // The influence of the new wake panels:
-            int i, j, lifting_surface_offset, wake_panel_offset, pa, pb;
-            vector<shared_ptr<BodyData> >::const_iterator bdi;
-            vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
-            vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
-            shared_ptr<BodyData> bd;
-            shared_ptr<Body::LiftingSurfaceData> d;
-            
-            #pragma omp parallel private(bdi, si, lsi, lifting_surface_offset, j, wake_panel_offset, pa, pb, bd, d)
-            {
-                #pragma omp for schedule(dynamic, 1)
-                for (i = 0; i < d_row->surface->n_panels(); i++) {
-                    lifting_surface_offset = 0;      
+                int m = residual_differences.size();
+                
+                if (relaxation_factor != 1.0)
+                    source_coefficients = previous_source_coefficients + relaxation_factor * source_residual;
                     
-                    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
-                        bd = *bdi;
+                if (m > 0) {
+                    MatrixXd F(source_residual.size(), m);
+                    for (int j = 0; j < m; j++)
+                        F.col(j) = residual_differences[j];
                         
-                        for (si = bd->body->non_lifting_surfaces.begin(); si != bd->body->non_lifting_surfaces.end(); si++)
-                            lifting_surface_offset += (*si)->surface->n_panels();
-                                      
-                        for (lsi = bd->body->lifting_surfaces.begin(); lsi != bd->body->lifting_surfaces.end(); lsi++) {
-                            d = *lsi;
-                            
-                            wake_panel_offset = d->wake->n_panels() - d->lifting_surface->n_spanwise_panels();
-                            for (j = 0; j < d->lifting_surface->n_spanwise_panels(); j++) {  
-                                pa = d->lifting_surface->trailing_edge_upper_panel(j);
-                                pb = d->lifting_surface->trailing_edge_lower_panel(j);
-                                
-                                // Account for the influence of the new wake panels.  The doublet strength of these panels
-                                // is set according to the Kutta condition.
-                                A(offset_row + i, lifting_surface_offset + pa) += d->wake->doublet_influence(d_row->surface, i, wake_panel_offset + j);
-                                A(offset_row + i, lifting_surface_offset + pb) -= d->wake->doublet_influence(d_row->surface, i, wake_panel_offset + j);
-                            }
-                            
-                            lifting_surface_offset += d->lifting_surface->n_panels();
-                        }
+                    VectorXd gamma = F.colPivHouseholderQr().solve(source_residual);
+                    
+                    for (int j = 0; j < m; j++) {
+                        VectorXd state_difference = update_differences[j] - residual_differences[j];
+                        
+                        source_coefficients -= gamma(j) * (state_difference + relaxation_factor * residual_differences[j]);
                     }
                 }
-            }
                 
-            offset_row = offset_row + d_row->surface->n_panels();
+            } else {
+                // Aitken delta-squared update of the relaxation factor:
+                if (parameters.boundary_layer_aitken_acceleration && previous_source_residual.size() == source_residual.size()) {
+                    VectorXd delta = source_residual - previous_source_residual;
+                    
+                    double delta_norm_squared = delta.squaredNorm();
+                    if (delta_norm_squared > 0.0)
+                        relaxation_factor = -relaxation_factor * previous_source_residual.dot(delta) / delta_norm_squared;
+                        
+                    // Keep the factor within sensible bounds, so that a single poor estimate cannot stall or
+                    // destabilize the iteration:
+                    relaxation_factor = min(max(relaxation_factor, 0.1), 2.0);
+                }
+                
+                if (relaxation_factor != 1.0)
+                    source_coefficients = previous_source_coefficients + relaxation_factor * source_residual;
+            }
+            
+            previous_source_update = source_update;
+            previous_source_residual = source_residual;
+            
+            VORTEXJE_LOG(logger, Logger::Debug, "Solver: Boundary layer iteration " << boundary_layer_iteration << " has source residual " << source_residual_norm
+                         << " and relaxation factor " << relaxation_factor << ".");
+            
+            profiler->set("boundary_layer_relaxation_factor", relaxation_factor);
         }
         
+        source_timer.stop();
+      
         // Compute new doublet distribution:
-        cout << "Solver: Computing doublet distribution." << endl;
+        VORTEXJE_LOG(logger, Logger::Info, "Solver: Computing doublet distribution.");
         
-        VectorXd b = source_influence_coefficients * source_coefficients;
+        Profiler::Timer linear_solve_timer(profiler, "linear_solve");
         
-        BiCGSTAB<MatrixXd, DiagonalPreconditioner<double> > solver(A);
-        solver.setMaxIterations(Parameters::linear_solver_max_iterations);
-        solver.setTolerance(Parameters::linear_solver_tolerance);
-
-        doublet_coefficients = solver.solveWithGuess(b, previous_doublet_coefficients);
+        VectorXd b;
+        if (compressed_source_influence_coefficients)
+            b = (*compressed_source_influence_coefficients) * source_coefficients;
+        else {
+            // The local rows of S sigma, from the stored matrix or directly from the source influence kernels:
+            VectorXd local_b;
+            if (!parameters.store_source_influence_coefficients)
+                compute_source_influence(local_b);
+            else if (single_precision)
+                local_b = (single_precision_source_influence_coefficients * source_coefficients.cast<float>()).cast<double>();
+            else
+                local_b = source_influence_coefficients * source_coefficients;
+                
+            if (distributed) {
+                b.resize(n_non_wake_panels);
+                b.segment(row_begin, n_local_rows) = inverse_diagonal.asDiagonal() * local_b;
+                
+                Distributed::allgather(b, row_begin, row_end);
+                
+            } else
+                b = local_b;
+        }
         
-        if (solver.info() != Success) {
-            cerr << "Solver: Computing doublet distribution failed (" << solver.iterations();
-            cerr << " iterations with estimated error=" << solver.error() << ")." << endl;
-           
-            return false;
+        if (distributed) {
+            DoubletSystemOperator A_distributed(A, row_begin, row_end);
+            
+            BiCGSTAB<DoubletSystemOperator, IdentityPreconditioner> solver(A_distributed);
+            solver.setMaxIterations(parameters.linear_solver_max_iterations);
+            solver.setTolerance(parameters.linear_solver_tolerance);
+
+            VectorXd x = solver.solveWithGuess(b, previous_doublet_coefficients);
+            
+            if (solver.info() != Success) {
+                VORTEXJE_LOG(logger, Logger::Error, "Solver: Computing doublet distribution failed (" << solver.iterations()
+                             << " iterations with estimated error=" << solver.error() << ").");
+               
+                return false;
+            }
+            
+            doublet_coefficients = x;
+            
+            VORTEXJE_LOG(logger, Logger::Info, "Solver: Done computing doublet distribution in " << solver.iterations() << " iterations with estimated error " << solver.error() << ".");
+            
+            profiler->increment("linear_solver_iterations", solver.iterations());
+            profiler->set("linear_solver_error", solver.error());
+            
+        } else if (compressed_doublet_influence_coefficients) {
+            DoubletSystemOperator A_compressed(*compressed_doublet_influence_coefficients, wake_influence_coefficients, wake_upper_indices, wake_lower_indices);
+            
+            BiCGSTAB<DoubletSystemOperator, IdentityPreconditioner> solver(A_compressed);
+            solver.setMaxIterations(parameters.linear_solver_max_iterations);
+            solver.setTolerance(parameters.linear_solver_tolerance);
+
+            VectorXd x = solver.solveWithGuess(b, previous_doublet_coefficients);
+            
+            if (solver.info() != Success) {
+                VORTEXJE_LOG(logger, Logger::Error, "Solver: Computing doublet distribution failed (" << solver.iterations()
+                             << " iterations with estimated error=" << solver.error() << ").");
+               
+                return false;
+            }
+            
+            doublet_coefficients = x;
+            
+            VORTEXJE_LOG(logger, Logger::Info, "Solver: Done computing doublet distribution in " << solver.iterations() << " iterations with estimated error " << solver.error() << ".");
+            
+            profiler->increment("linear_solver_iterations", solver.iterations());
+            profiler->set("linear_solver_error", solver.error());
+            
+        } else if (single_precision) {
+            if (!solve_single_precision(A_single, b, wake_influence_coefficients, wake_upper_indices, wake_lower_indices, previous_doublet_coefficients))
+                return false;
+                
+        } else if (parameters.direct_linear_solver) {
+            VectorXd y = doublet_influence_coefficients_lu.solve(b);
+            
+            doublet_coefficients = apply_wake_correction(y, wake_upper_indices, wake_lower_indices, wake_correction, wake_capacitance_lu);
+            
+            if (!doublet_coefficients.allFinite()) {
+                VORTEXJE_LOG(logger, Logger::Error, "Solver: Computing doublet distribution failed (singular matrix).");
+                
+                return false;
+            }
+            
+            VORTEXJE_LOG(logger, Logger::Info, "Solver: Done computing doublet distribution using LU factorization.");
+            
+        } else {
+            bool block_jacobi = (parameters.linear_solver_block_size > 0);
+            if (block_jacobi)
+                compute_preconditioner(A);
+                
+            VectorXd guess = compute_recycled_guess(A, b, previous_doublet_coefficients);
+            
+            VectorXd x;
+            bool success;
+            int iterations;
+            double error;
+            if (parameters.linear_solver_gmres_restart > 0) {
+                if (block_jacobi)
+                    success = iterative_solve<GMRES<MatrixXd, BlockJacobiPreconditioner> >(A, b, guess, parameters, preconditioner_offsets, preconditioner_blocks,
+                                                                                            x, iterations, error);
+                else
+                    success = iterative_solve<GMRES<MatrixXd, DiagonalPreconditioner<double> > >(A, b, guess, parameters, preconditioner_offsets, preconditioner_blocks,
+                                                                                                  x, iterations, error);
+            } else {
+                if (block_jacobi)
+                    success = iterative_solve<BiCGSTAB<MatrixXd, BlockJacobiPreconditioner> >(A, b, guess, parameters, preconditioner_offsets, preconditioner_blocks,
+                                                                                               x, iterations, error);
+                else
+                    success = iterative_solve<BiCGSTAB<MatrixXd, DiagonalPreconditioner<double> > >(A, b, guess, parameters, preconditioner_offsets, preconditioner_blocks,
+                                                                                                     x, iterations, error);
+            }
+            
+            if (!success) {
+                VORTEXJE_LOG(logger, Logger::Error, "Solver: Computing doublet distribution failed (" << iterations
+                             << " iterations with estimated error=" << error << ").");
+               
+                return false;
+            }
+            
+            doublet_coefficients = x;
+            
+            VORTEXJE_LOG(logger, Logger::Info, "Solver: Done computing doublet distribution in " << iterations << " iterations with estimated error " << error << ".");
+            
+            profiler->increment("linear_solver_iterations", iterations);
+            profiler->set("linear_solver_error", error);
+            
+            // Rebuild the preconditioner lazily, once the matrix has drifted too far from the one it was built for:
+            if (block_jacobi) {
+                if (preconditioner_iterations < 0)
+                    preconditioner_iterations = iterations;
+                else if (iterations > 2 * max(preconditioner_iterations, 1))
+                    preconditioner_valid = false;
+            }
+            
+            // Keep the most recent solutions for the initial guess of the next solve:
+            if (parameters.linear_solver_recycled_solutions > 0) {
+                recycled_solutions.push_back(doublet_coefficients);
+                
+                while ((int) recycled_solutions.size() > parameters.linear_solver_recycled_solutions)
+                    recycled_solutions.erase(recycled_solutions.begin());
+            }
         }
         
-        cout << "Solver: Done computing doublet distribution in " << solver.iterations() << " iterations with estimated error " << solver.error() << "." << endl;
+        linear_solve_timer.stop();
 
         // Check for convergence from second iteration onwards.
         // (On the first iteration, the value of previous_doublet_coefficients originates from the previous call to solve().
         bool converged = false;
         if (boundary_layer_iteration > 0) {
-            if (((source_coefficients  - previous_source_coefficients ).norm() < Parameters::boundary_layer_iteration_tolerance) &&
-                ((doublet_coefficients - previous_doublet_coefficients).norm() < Parameters::boundary_layer_iteration_tolerance)) {
+            // The unrelaxed update of the source distribution measures the convergence of the boundary layers:
+            if ((source_residual_norm < parameters.boundary_layer_iteration_tolerance) &&
+                ((doublet_coefficients - previous_doublet_coefficients).norm() < parameters.boundary_layer_iteration_tolerance)) {
                 converged = true;
             }
         }
         
         // Set new wake panel doublet coefficients:
-        cout << "Solver: Updating wake doublet distribution." << endl;
-        
-        offset = 0;
+        VORTEXJE_LOG(logger, Logger::Info, "Solver: Updating wake doublet distribution.");
         
-        vector<shared_ptr<BodyData> >::iterator bdi;
-        for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
-            shared_ptr<BodyData> bd = *bdi;
-            
-            vector<shared_ptr<Body::SurfaceData> >::iterator si;
-            for (si = bd->body->non_lifting_surfaces.begin(); si != bd->body->non_lifting_surfaces.end(); si++)
-                offset += (*si)->surface->n_panels();
-            
-            vector<shared_ptr<Body::LiftingSurfaceData> >::iterator lsi;
-            for (lsi = bd->body->lifting_surfaces.begin(); lsi != bd->body->lifting_surfaces.end(); lsi++) {
-                shared_ptr<Body::LiftingSurfaceData> d = *lsi;
-                         
-                // Set panel doublet coefficient:
-                for (int i = 0; i < d->lifting_surface->n_spanwise_panels(); i++) {
-                    double doublet_coefficient_top    = doublet_coefficients(offset + d->lifting_surface->trailing_edge_upper_panel(i));
-                    double doublet_coefficient_bottom = doublet_coefficients(offset + d->lifting_surface->trailing_edge_lower_panel(i));
-                    
-                    // Use the trailing-edge Kutta condition to compute the doublet coefficients of the new wake panels.
-                    double doublet_coefficient = doublet_coefficient_top - doublet_coefficient_bottom;
-                    
-                    int idx = d->wake->n_panels() - d->lifting_surface->n_spanwise_panels() + i;
-                    d->wake->doublet_coefficients[idx] = doublet_coefficient;
-                }
-                
-                // Update offset:
-                offset += d->lifting_surface->n_panels();
-            }
-        }
+        update_wake_doublet_coefficients();
         
         // Compute surface velocity distribution:
-        cout << "Solver: Computing surface velocity distribution." << endl;
+        VORTEXJE_LOG(logger, Logger::Info, "Solver: Computing surface velocity distribution.");
         
-        offset = 0;
-
-        for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
-            shared_ptr<BodyData> bd = *bdi;
-            
-            vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
-            for (si = bd->body->non_lifting_surfaces.begin(); si != bd->body->non_lifting_surfaces.end(); si++) {
-                const shared_ptr<Body::SurfaceData> &d = *si;
-                int i;
-                
-                #pragma omp parallel
-                {
-                    #pragma omp for schedule(dynamic, 1)
-                    for (i = 0; i < d->surface->n_panels(); i++)
-                        surface_velocities.row(offset + i) = compute_surface_velocity(bd->body, d->surface, i);
-                }
-                
-                offset += d->surface->n_panels();   
-            }
-            
-            vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
-            for (lsi = bd->body->lifting_surfaces.begin(); lsi != bd->body->lifting_surfaces.end(); lsi++) {
-                const shared_ptr<Body::LiftingSurfaceData> &d = *lsi;
-                int i;
-                
-                #pragma omp parallel
-                {
-                    #pragma omp for schedule(dynamic, 1)
-                    for (i = 0; i < d->surface->n_panels(); i++)
-                        surface_velocities.row(offset + i) = compute_surface_velocity(bd->body, d->surface, i);
-                }  
-                
-                offset += d->surface->n_panels();                           
-            }
-        }
+        Profiler::Timer surface_velocity_timer(profiler, "surface_velocities");
+        
+        compute_surface_velocities();
+        
+        surface_velocity_timer.stop();
 
         // If we converged, then this is the time to break out of the loop.
         if (converged) {
-            cout << "Solver: Boundary layer iteration converged in " << boundary_layer_iteration << " steps." << endl;
+            VORTEXJE_LOG(logger, Logger::Info, "Solver: Boundary layer iteration converged in " << boundary_layer_iteration << " steps.");
             
             break;
         }
         
-        if (boundary_layer_iteration > Parameters::max_boundary_layer_iterations) {
-            cout << "Solver: Maximum number of boundary layer iterations ranged.  Aborting iteration." << endl;
+        if (boundary_layer_iteration > parameters.max_boundary_layer_iterations) {
+            VORTEXJE_LOG(logger, Logger::Info, "Solver: Maximum number of boundary layer iterations ranged.  Aborting iteration.");
             
             break;
         }
         
         // Recompute the boundary layers.
+        Profiler::Timer boundary_layer_timer(profiler, "boundary_layer");
+        
         offset = 0;
         
         bool have_boundary_layer = false;
@@ -804,7 +1605,7 @@ Solver::solve(double dt, bool propagate)
             }
             
             // Recompute boundary layer:
-            if (typeid(*bd->boundary_layer.get()) != typeid(DummyBoundaryLayer)) {
+            if (!bd->boundary_layer->inviscid()) {
                 have_boundary_layer = true;
                 
                 if (!bd->boundary_layer->recalculate(surface_velocities.block(offset, 0, body_n_panels, 3)))
@@ -820,79 +1621,300 @@ Solver::solve(double dt, bool propagate)
         
         // Increase iteration counter:
         boundary_layer_iteration++;
+        
+        profiler->increment("boundary_layer_iterations");
     }
 
-    if (Parameters::convect_wake) {
+    if (parameters.convect_wake) {
         // Recompute source distribution without wake influence:
-        cout << "Solver: Recomputing source distribution without wake influence." << endl;
+        VORTEXJE_LOG(logger, Logger::Info, "Solver: Recomputing source distribution without wake influence.");
         
-        offset = 0;
+        Profiler::Timer timer(profiler, "source_coefficients");
         
-        vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
-        for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
-            const shared_ptr<Body::SurfaceData> &d = *si;
-            int i;
-            
-            const shared_ptr<BodyData> &bd = surface_id_to_body.find(d->surface->id)->second;
-            
-            #pragma omp parallel
-            {
-                #pragma omp for schedule(dynamic, 1)
-                for (i = 0; i < d->surface->n_panels(); i++)
-                    source_coefficients(offset + i) = compute_source_coefficient(bd->body, d->surface, i, bd->boundary_layer, false);
-            }
-            
-            offset += d->surface->n_panels();
-        }
+        compute_source_coefficients(false);
     }
 
     // Compute pressure distribution:
-    cout << "Solver: Computing pressure distribution." << endl;
+    VORTEXJE_LOG(logger, Logger::Info, "Solver: Computing pressure distribution.");
     
-    offset = 0;
-
-    vector<shared_ptr<Body::SurfaceData> >::const_iterator si;   
-    for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
-        const shared_ptr<Body::SurfaceData> &d = *si;
-        int i;
-        
-        const shared_ptr<BodyData> &bd = surface_id_to_body.find(d->surface->id)->second;
-        double v_ref_squared = compute_reference_velocity_squared(bd->body);
+    Profiler::Timer pressure_timer(profiler, "pressures");
+    
+    compute_pressure_coefficients(dt);
+    
+    pressure_timer.stop();
+    
+    // Propagate solution forward in time, if requested.
+    if (propagate)
+        this->propagate();
         
-        double dphidt;
+    // Record the monitors:
+    vector<shared_ptr<Monitor> >::iterator mi;
+    for (mi = monitors.begin(); mi != monitors.end(); mi++)
+        (*mi)->record(dt);
+    
+    // Done:
+    return true;
+}
+
+/**
+   Propagates solution forward in time.  Relevant in unsteady mode only.
+*/
+void
+Solver::propagate()
+{
+    // The time derivatives of the potentials of the next time step require the current potentials of all panels:
+    if (parameters.unsteady_bernoulli) {
+        vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
+        for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++)
+            evaluate_surface_velocity_potentials((*si)->surface);
+    }
+    
+    // Store previous values of the surface velocity potentials:
+    previous_surface_velocity_potentials = surface_velocity_potentials;
+}
+
+/**
+   Solves the steady flow problem for a list of operating points, on the current geometry.  This is meant for the
+   computation of polars and other parameter sweeps.
+   
+   The matrices of influence coefficients are computed and factorized once, and the doublet distributions of all
+   cases are obtained from a single solve with multiple right hand sides.  Static wakes are re-positioned for every
+   case, while convected wakes are kept as they are.  If a boundary layer model is present, or if the direct dense
+   solver or the stored source influence coefficients are not in use, the cases are solved one by one using solve()
+   instead.
+   
+   The wakes must have been initialized.  Upon return, the solution, the freestream velocity, and the body velocities
+   correspond to the last case.
+   
+   @param[in]   cases     List of operating points.
+   @param[out]  results   Pressure distribution, forces, and moments of every case.
+   
+   @returns true on success.
+*/
+bool
+Solver::sweep(const vector<SweepCase> &cases, vector<SweepResult> &results)
+{
+    results.clear();
+    
+    if (cases.size() == 0)
+        return true;
+    
+    // Do all cases share a factorization of the system matrix?
+    bool have_boundary_layer = false;
+    
+    vector<shared_ptr<BodyData> >::iterator bdi;
+    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+        if (!(*bdi)->boundary_layer->inviscid())
+            have_boundary_layer = true;
+    }
+    
+    bool block_solve = parameters.direct_linear_solver && Distributed::size() == 1 &&
+                       parameters.hierarchical_matrix_tolerance <= 0 && parameters.store_source_influence_coefficients &&
+                       !have_boundary_layer;
+    
+    if (!block_solve) {
+        for (int c = 0; c < (int) cases.size(); c++) {
+            VORTEXJE_LOG(logger, Logger::Info, "Solver: Solving sweep case " << c + 1 << " of " << cases.size() << ".");
             
-        #pragma omp parallel private(dphidt)
-        {
-            #pragma omp for schedule(dynamic, 1)
-            for (i = 0; i < d->surface->n_panels(); i++) {
-                // Velocity potential:
-                surface_velocity_potentials(offset + i) = compute_surface_velocity_potential(d->surface, offset, i);
+            apply_sweep_case(cases[c]);
+            
+            if (!solve(0.0, false))
+                return false;
                 
-                // Pressure coefficient:
-                dphidt = compute_surface_velocity_potential_time_derivative(offset, i, dt);
-                pressure_coefficients(offset + i) = compute_pressure_coefficient(surface_velocities.row(offset + i), dphidt, v_ref_squared);
-            }
+            results.push_back(SweepResult());
+            store_sweep_result(results.back());
         }
         
-        offset += d->surface->n_panels();      
+        return true;
     }
     
-    // Propagate solution forward in time, if requested.
-    if (propagate)
-        this->propagate();
+    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++)
+        (*bdi)->body->compute_adjacency();
+    
+    compute_influence_coefficients();
+    
+    factorize_doublet_influence_coefficients();
+    
+    // The wake is frozen, and so is the velocity it induces on the bodies:
+    if (parameters.convect_wake)
+        compute_wake_induced_velocities();
+    
+    // Collect the source distributions of all cases.  Static wakes point in a different direction for every case,
+    // and therefore need a correction of their own:
+    int n_cases = cases.size();
+    int n_wake_corrections = parameters.convect_wake ? 1 : n_cases;
+    
+    MatrixXd sources(n_non_wake_panels, n_cases);
+    
+    vector<MatrixXd> wake_corrections(n_wake_corrections);
+    vector<PartialPivLU<MatrixXd> > wake_capacitance_lus(n_wake_corrections);
+    vector<int> wake_upper_indices, wake_lower_indices;
+    
+    VORTEXJE_LOG(logger, Logger::Info, "Solver: Computing source distributions of " << n_cases << " sweep cases.");
+    
+    for (int c = 0; c < n_cases; c++) {
+        apply_sweep_case(cases[c]);
+        
+        compute_source_coefficients(true);
+        
+        sources.col(c) = source_coefficients;
+        
+        if (c < n_wake_corrections) {
+            MatrixXd wake_influence_coefficients;
+            compute_wake_influence_coefficients(wake_influence_coefficients, wake_upper_indices, wake_lower_indices);
+        
+            compute_wake_correction(wake_influence_coefficients, wake_upper_indices, wake_lower_indices,
+                                    wake_corrections[c], wake_capacitance_lus[c]);
+        }
+    }
+    
+    // Solve for all right hand sides at once:
+    VORTEXJE_LOG(logger, Logger::Info, "Solver: Computing doublet distributions of " << n_cases << " sweep cases.");
+    
+    MatrixXd doublets = doublet_influence_coefficients_lu.solve(source_influence_coefficients * sources);
+    
+    // Post-process every case.  The cases are steady:
+    last_solve_dt = 0.0;
+    
+    for (int c = 0; c < n_cases; c++) {
+        VORTEXJE_LOG(logger, Logger::Info, "Solver: Computing pressure distribution of sweep case " << c + 1 << " of " << n_cases << ".");
+        
+        apply_sweep_case(cases[c]);
+        
+        source_coefficients = sources.col(c);
+        
+        int w = min(c, n_wake_corrections - 1);
+        doublet_coefficients = apply_wake_correction(doublets.col(c), wake_upper_indices, wake_lower_indices,
+                                                     wake_corrections[w], wake_capacitance_lus[w]);
+        
+        if (!doublet_coefficients.allFinite()) {
+            VORTEXJE_LOG(logger, Logger::Error, "Solver: Computing doublet distribution failed (singular matrix).");
+            
+            return false;
+        }
+        
+        update_wake_doublet_coefficients();
+        
+        compute_surface_velocities();
+        
+        if (parameters.convect_wake)
+            compute_source_coefficients(false);
+        
+        compute_pressure_coefficients(0.0);
+        
+        results.push_back(SweepResult());
+        store_sweep_result(results.back());
+    }
     
-    // Done:
     return true;
 }
 
 /**
-   Propagates solution forward in time.  Relevant in unsteady mode only.
+   Sets the freestream velocity and the body velocities of a sweep case, and re-positions static wakes accordingly.
+   
+   @param[in]   sweep_case   Operating point.
 */
 void
-Solver::propagate()
+Solver::apply_sweep_case(const SweepCase &sweep_case)
 {
-    // Store previous values of the surface velocity potentials:
-    previous_surface_velocity_potentials = surface_velocity_potentials;
+    set_freestream_velocity(sweep_case.freestream_velocity);
+    
+    for (int i = 0; i < (int) bodies.size(); i++) {
+        if (i < (int) sweep_case.body_velocities.size())
+            bodies[i]->body->set_velocity(sweep_case.body_velocities[i]);
+        if (i < (int) sweep_case.body_rotational_velocities.size())
+            bodies[i]->body->set_rotational_velocity(sweep_case.body_rotational_velocities[i]);
+    }
+    
+    if (!parameters.convect_wake)
+        update_wakes();
+}
+
+/**
+   Stores the pressure distribution, and the forces and moments on all bodies, of the current solution.
+   
+   @param[out]  result   Sweep result.
+*/
+void
+Solver::store_sweep_result(SweepResult &result) const
+{
+    evaluate_pending_outputs();
+    
+    result.pressure_coefficients = pressure_coefficients;
+    
+    result.forces.clear();
+    result.moments.clear();
+    
+    vector<shared_ptr<BodyData> >::const_iterator bdi;
+    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+        const shared_ptr<Body> &body = (*bdi)->body;
+        
+        result.forces.push_back(force(body));
+        result.moments.push_back(moment(body, body->position));
+    }
+}
+
+/**
+   Marks the surface velocities, the surface velocity potentials, and the pressure coefficients of all surfaces of the
+   given body as required, so that solve() evaluates them.  This enables the selection of outputs:  upon the first
+   call to require_outputs() after construction, or after require_all_outputs(), solve() only evaluates the outputs
+   of the selected bodies and surfaces, as well as the surface velocities of bodies with a boundary layer.  All other
+   outputs are evaluated upon first query, from the solution and geometry at the time of the query.  update_wakes()
+   and set_freestream_velocity() evaluate all pending outputs before changing the state, but bodies moved by the
+   caller are not detected:  pending outputs must therefore be queried before the bodies are moved.  The selection
+   remains in effect for all subsequent calls to solve().
+   
+   @param[in]   body   Body whose outputs are required.
+*/
+void
+Solver::require_outputs(const shared_ptr<Body> &body)
+{
+    for (int i = 0; i < body->n_surfaces(); i++)
+        require_outputs(body->surface(i));
+}
+
+/**
+   Marks the surface velocities, the surface velocity potentials, and the pressure coefficients of the given surface as
+   required, so that solve() evaluates them.  The surface velocities are evaluated for the entire owning body.  See
+   require_outputs(const std::shared_ptr<Body> &).
+   
+   @param[in]   surface   Surface whose outputs are required.
+*/
+void
+Solver::require_outputs(const shared_ptr<Surface> &surface)
+{
+    if (all_outputs_required) {
+        all_outputs_required = false;
+        
+        required_outputs.assign(required_outputs.size(), false);
+    }
+    
+    if (surface->id >= (int) required_outputs.size())
+        required_outputs.resize(surface->id + 1, false);
+        
+    required_outputs[surface->id] = true;
+}
+
+/**
+   Clears the selection of outputs, so that solve() only evaluates the doublet distribution and the wake doublet
+   coefficients, as well as the surface velocities of bodies with a boundary layer.  All other outputs are evaluated
+   upon first query.  See require_outputs(const std::shared_ptr<Body> &).
+*/
+void
+Solver::require_no_outputs()
+{
+    all_outputs_required = false;
+    
+    required_outputs.assign(required_outputs.size(), false);
+}
+
+/**
+   Marks the outputs of all surfaces as required, so that solve() evaluates them.  This is the default.
+*/
+void
+Solver::require_all_outputs()
+{
+    all_outputs_required = true;
 }
 
 /**
@@ -903,272 +1925,3156 @@ Solver::propagate()
 void
 Solver::update_wakes(double dt)
 {
-    // Do we convect wake panels?
-    if (Parameters::convect_wake) {
-        cout << "Solver: Convecting wakes." << endl;
+    // Pending outputs refer to the wakes of the last solve:
+    evaluate_pending_outputs();
+    
+    Profiler::Timer update_timer(profiler, "update_wakes");
+    
+    configure_wakes();
+    
+    // Do we convect wake panels?
+    if (parameters.convect_wake) {
+        VORTEXJE_LOG(logger, Logger::Info, "Solver: Convecting wakes.");
+        
+        // Collect the wake nodes and vortex particles of all wakes.  The trailing edge nodes are displaced separately
+        // below.  The velocities of the far wake are only re-evaluated every far_wake_update_interval steps, or if
+        // the velocities of the last evaluation are unavailable:
+        bool far_wake_update = (parameters.far_wake_update_interval <= 1 || n_wake_updates % parameters.far_wake_update_interval == 0);
+        
+        n_wake_updates++;
+        
+        int n_points = 0;
+        
+        vector<shared_ptr<BodyData> >::const_iterator bdi;
+        for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+            vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
+            for (lsi = (*bdi)->body->lifting_surfaces.begin(); lsi != (*bdi)->body->lifting_surfaces.end(); lsi++)
+                n_points += (*lsi)->wake->n_nodes() + (*lsi)->wake->n_particles();
+        }
+        
+        Matrix3Xd points(3, n_points);
+        Matrix3Xd held_velocities = Matrix3Xd::Zero(3, n_points);
+        
+        vector<int> evaluated_points;
+        
+        int offset = 0;
+        
+        for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+            vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
+            for (lsi = (*bdi)->body->lifting_surfaces.begin(); lsi != (*bdi)->body->lifting_surfaces.end(); lsi++) {
+                const shared_ptr<Body::LiftingSurfaceData> &d = *lsi;
+                
+                int n_trailing_edge_nodes = d->lifting_surface->n_spanwise_nodes();
+                int n_near_wake_nodes     = (max(parameters.far_wake_age, 0) + 1) * n_trailing_edge_nodes;
+                
+                bool update = far_wake_update || (int) d->wake->node_velocities.size() != d->wake->n_nodes() ||
+                                                 (int) d->wake->particle_velocities.size() != d->wake->n_particles();
+                
+                for (int i = 0; i < d->wake->n_nodes(); i++, offset++) {
+                    points.col(offset) = d->wake->nodes[i];
+                    
+                    if (i >= d->wake->n_nodes() - n_trailing_edge_nodes)
+                        continue;
+                        
+                    if (update || i >= d->wake->n_nodes() - n_near_wake_nodes)
+                        evaluated_points.push_back(offset);
+                    else
+                        held_velocities.col(offset) = d->wake->node_velocities[i];
+                }
+                
+                for (int i = 0; i < d->wake->n_particles(); i++, offset++) {
+                    points.col(offset) = d->wake->particle_positions[i];
+                    
+                    if (update)
+                        evaluated_points.push_back(offset);
+                    else
+                        held_velocities.col(offset) = d->wake->particle_velocities[i];
+                }
+            }
+        }
+        
+        // Runge-Kutta stages.  Every stage after the first evaluates the velocities with the wakes displaced along the
+        // velocities of the previous stage:
+        Profiler::Timer convection_timer(profiler, "wake_convection");
+        
+        vector<double> stage_offsets, stage_weights;
+        if (parameters.wake_integration_order == 4) {
+            stage_offsets.push_back(0.0); stage_weights.push_back(1.0 / 6.0);
+            stage_offsets.push_back(0.5); stage_weights.push_back(1.0 / 3.0);
+            stage_offsets.push_back(0.5); stage_weights.push_back(1.0 / 3.0);
+            stage_offsets.push_back(1.0); stage_weights.push_back(1.0 / 6.0);
+            
+        } else if (parameters.wake_integration_order == 2) {
+            stage_offsets.push_back(0.0); stage_weights.push_back(0.5);
+            stage_offsets.push_back(1.0); stage_weights.push_back(0.5);
+            
+        } else {
+            stage_offsets.push_back(0.0); stage_weights.push_back(1.0);
+        }
+        
+        Matrix3Xd stage_velocities = held_velocities;
+        Matrix3Xd point_velocities = Matrix3Xd::Zero(3, n_points);
+        
+        for (int stage = 0; stage < (int) stage_offsets.size(); stage++) {
+            Matrix3Xd stage_points = points;
+            if (stage > 0) {
+                stage_points += stage_offsets[stage] * dt * stage_velocities;
+                
+                set_wake_positions(stage_points);
+            }
+                
+            compute_wake_convection_velocities(stage_points, evaluated_points, stage_velocities);
+            
+            point_velocities += stage_weights[stage] * stage_velocities;
+        }
+        
+        // Restore the wakes to their original state:
+        if (stage_offsets.size() > 1)
+            set_wake_positions(points);
+        
+        convection_timer.stop();
+        
+        // Add new wake panels at trailing edges, and convect all vertices.  Every wake is updated by a chain of
+        // tasks:  the displacements of its nodes and particles, in chunks, followed by its internal update.  The chains
+        // of different wakes are independent, so that the geometry of one wake is rebuilt while the nodes of the next
+        // are still being convected.  Within a chain, the tasks are ordered by their dependences on the wake nodes.
+        // As the phases overlap, the timer covers the convection of the nodes as well:
+        Profiler::Timer geometry_timer(profiler, "wake_geometry");
+        
+        #pragma omp parallel
+        {
+            #pragma omp single
+            {
+                offset = 0;
+                
+                for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+                    shared_ptr<BodyData> bd = *bdi;
+                    
+                    vector<shared_ptr<Body::LiftingSurfaceData> >::iterator lsi;
+                    for (lsi = bd->body->lifting_surfaces.begin(); lsi != bd->body->lifting_surfaces.end(); lsi++) {
+                        shared_ptr<Body::LiftingSurfaceData> d = *lsi;
+                        
+                        // Offsets of the local wake velocities:
+                        int node_offset     = offset;
+                        int particle_offset = offset + d->wake->n_nodes();
+                        
+                        offset += d->wake->n_nodes() + d->wake->n_particles();
+                        
+                        // Remember the velocities, for reuse in the far wake:
+                        d->wake->node_velocities.resize(d->wake->n_nodes());
+                        for (int i = 0; i < d->wake->n_nodes(); i++)
+                            d->wake->node_velocities[i] = point_velocities.col(node_offset + i);
+                            
+                        d->wake->particle_velocities.resize(d->wake->n_particles());
+                        for (int i = 0; i < d->wake->n_particles(); i++)
+                            d->wake->particle_velocities[i] = point_velocities.col(particle_offset + i);
+                        
+                        // Convect wake nodes that coincide with the trailing edge:
+                        #pragma omp task firstprivate(bd, d) depend(in: d->wake->nodes)
+                        {
+                            for (int i = 0; i < d->lifting_surface->n_spanwise_nodes(); i++) {
+                                d->wake->nodes[d->wake->n_nodes() - d->lifting_surface->n_spanwise_nodes() + i]
+                                    += compute_trailing_edge_vortex_displacement(bd->body, d->lifting_surface, i, dt);
+                            }
+                        }
+                        
+                        // Convect all other wake nodes according to the local wake velocity:
+                        int n_convected_nodes = d->wake->n_nodes() - d->lifting_surface->n_spanwise_nodes();
+                        
+                        for (int first = 0; first < n_convected_nodes; first += TASK_PANEL_CHUNK_SIZE) {
+                            #pragma omp task firstprivate(d, node_offset, n_convected_nodes, first) depend(in: d->wake->nodes)
+                            {
+                                int last = min(first + TASK_PANEL_CHUNK_SIZE, n_convected_nodes);
+                                for (int i = first; i < last; i++)
+                                    d->wake->nodes[i] += point_velocities.col(node_offset + i) * dt;
+                            }
+                        }
+                        
+                        // Convect vortex particles:
+                        #pragma omp task firstprivate(d, particle_offset) depend(in: d->wake->nodes)
+                        {
+                            for (int i = 0; i < d->wake->n_particles(); i++)
+                                d->wake->particle_positions[i] += point_velocities.col(particle_offset + i) * dt;
+                        }
+                            
+                        // Run internal wake update, once all nodes and particles of this wake have been displaced:
+                        #pragma omp task firstprivate(d) depend(inout: d->wake->nodes)
+                        {
+                            d->wake->update_properties(dt);
+                            
+                            // Add new vertices:
+                            // (This call also updates the geometry)
+                            d->wake->add_layer();
+                            
+                            // Drop and merge old wake panels:
+                            d->wake->coarsen();
+                        }
+                    }
+                }
+            }
+        }
+        
+    } else {
+        VORTEXJE_LOG(logger, Logger::Info, "Solver: Re-positioning wakes.");
+        
+        // No wake convection.  Re-position wake.  The wakes are independent, and are re-positioned by one task each:
+        Profiler::Timer geometry_timer(profiler, "wake_geometry");
+        
+        #pragma omp parallel
+        {
+            #pragma omp single
+            {
+                vector<shared_ptr<BodyData> >::iterator bdi;
+                for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+                    shared_ptr<BodyData> bd = *bdi;
+                    
+                    Vector3d body_apparent_velocity = bd->body->velocity - freestream_velocity;
+                    
+                    vector<shared_ptr<Body::LiftingSurfaceData> >::iterator lsi;
+                    for (lsi = bd->body->lifting_surfaces.begin(); lsi != bd->body->lifting_surfaces.end(); lsi++) {
+                        shared_ptr<Body::LiftingSurfaceData> d = *lsi;
+                        
+                        #pragma omp task firstprivate(d, body_apparent_velocity)
+                        {
+                            for (int i = 0; i < d->lifting_surface->n_spanwise_nodes(); i++) {
+                                // Connect wake to trailing edge nodes:
+                                d->wake->nodes[d->lifting_surface->n_spanwise_nodes() + i] = d->lifting_surface->nodes[d->lifting_surface->trailing_edge_node(i)];
+                                
+                                // Point wake in direction of body kinematic velocity:
+                                d->wake->nodes[i] = d->lifting_surface->nodes[d->lifting_surface->trailing_edge_node(i)]
+                                                 - parameters.static_wake_length * body_apparent_velocity / body_apparent_velocity.norm();
+                            }
+                            
+                            // Need to update geometry:
+                            d->wake->compute_geometry();
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+   Moves the wake nodes and vortex particles of all wakes to the given positions, and recomputes the wake geometry.
+   
+   @param[in]   points   Positions of the wake nodes and vortex particles, in the order of update_wakes().
+*/
+void
+Solver::set_wake_positions(const Matrix3Xd &points)
+{
+    // The wakes are independent, and are moved by one task each:
+    #pragma omp parallel
+    {
+        #pragma omp single
+        {
+            int offset = 0;
+            
+            vector<shared_ptr<BodyData> >::const_iterator bdi;
+            for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+                vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
+                for (lsi = (*bdi)->body->lifting_surfaces.begin(); lsi != (*bdi)->body->lifting_surfaces.end(); lsi++) {
+                    shared_ptr<Body::LiftingSurfaceData> d = *lsi;
+                    
+                    #pragma omp task firstprivate(d, offset)
+                    {
+                        int point = offset;
+                        
+                        for (int i = 0; i < d->wake->n_nodes(); i++)
+                            d->wake->nodes[i] = points.col(point++);
+                        for (int i = 0; i < d->wake->n_particles(); i++)
+                            d->wake->particle_positions[i] = points.col(point++);
+                            
+                        d->wake->compute_geometry();
+                    }
+                    
+                    offset += d->wake->n_nodes() + d->wake->n_particles();
+                }
+            }
+        }
+    }
+}
+
+/**
+   Computes the velocity at the given subset of a set of points.  In distributed mode, the points are partitioned over
+   the processes.
+   
+   @param[in]       points             Points, one per column.
+   @param[in]       evaluated_points   Indices of the points at which the velocity is evaluated.
+   @param[in,out]   velocities         Velocities, one per column.  Only the columns of the evaluated points are set.
+*/
+void
+Solver::compute_wake_convection_velocities(const Matrix3Xd &points, const vector<int> &evaluated_points, Matrix3Xd &velocities) const
+{
+    int n_points = evaluated_points.size();
+    
+    int begin, end;
+    Distributed::partition(n_points, begin, end);
+    
+    Matrix3Xd local_points(3, end - begin);
+    for (int i = begin; i < end; i++)
+        local_points.col(i - begin) = points.col(evaluated_points[i]);
+        
+    Matrix3Xd point_velocities(3, n_points);
+    point_velocities.middleCols(begin, end - begin) = velocity(local_points);
+    
+    Distributed::allgather(point_velocities, begin, end);
+    
+    for (int i = 0; i < n_points; i++)
+        velocities.col(evaluated_points[i]) = point_velocities.col(i);
+        
+    profiler->increment("wake_velocity_evaluations", end - begin);
+}
+
+/**
+   Logs source and doublet distributions, as well as the pressure coefficients, into files in the logging folder
+   tagged with the specified step number.  This also closes the current step of the profiler.
+   
+   @param[in]   step_number   Step number used to name the output files.
+   @param[in]   writer        SurfaceWriter object to use.
+*/
+void
+Solver::log(int step_number, SurfaceWriter &writer) const
+{   
+    Profiler::Timer log_timer(profiler, "log");
+    
+    // In distributed mode, the replicated results are logged by the first process only:
+    if (Distributed::rank() == 0) {
+        if (writer.multiple_surfaces()) {
+            // Log all surfaces and wakes into a single file, if supported by the writer:
+            log_single_file(step_number, writer);
+            
+        } else {
+            // Log coefficients:
+            LogSnapshot snapshot;
+            log_snapshot(step_number, writer, false, snapshot);
+            
+            write_log_snapshot(snapshot, writer);
+        }
+    }
+    
+    log_timer.stop();
+    
+    // Close the current step of the profiler:
+    profiler->end_step(step_number);
+}
+
+/**
+   Takes a snapshot of the source and doublet distributions, as well as of the pressure coefficients, for logging.
+   
+   @param[in]   step_number     Step number used to name the output files.
+   @param[in]   writer          SurfaceWriter object that will be used to write the snapshot.
+   @param[in]   copy_geometry   Whether to copy the geometry of the surfaces and wakes, so that the snapshot remains
+                                valid after the geometry changes.
+   @param[out]  snapshot        Snapshot.
+*/
+void
+Solver::log_snapshot(int step_number, const SurfaceWriter &writer, bool copy_geometry, LogSnapshot &snapshot) const
+{
+    snapshot = LogSnapshot();
+    
+    evaluate_pending_outputs();
+    
+    // If all surfaces are written into a single file, every surface carries the same data vectors:
+    bool single_file = writer.multiple_surfaces();
+    if (single_file) {
+        stringstream ss;
+        ss << log_folder << "/step_" << step_number << writer.file_extension();
+        
+        snapshot.filenames.push_back(ss.str());
+    }
+    
+    int offset = 0;
+    int save_node_offset = 0;
+    int save_panel_offset = 0;
+    int idx = 0;
+    
+    vector<shared_ptr<BodyData> >::const_iterator bdi;
+    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+        const shared_ptr<BodyData> &bd = *bdi;
+        
+        // Iterate non-lifting and lifting surfaces:
+        int n_non_lifting_surfaces = bd->body->non_lifting_surfaces.size();
+        
+        vector<shared_ptr<Body::SurfaceData> > surfaces(bd->body->non_lifting_surfaces.begin(), bd->body->non_lifting_surfaces.end());
+        surfaces.insert(surfaces.end(), bd->body->lifting_surfaces.begin(), bd->body->lifting_surfaces.end());
+        
+        for (int k = 0; k < (int) surfaces.size(); k++) {
+            const shared_ptr<Body::SurfaceData> &d = surfaces[k];
+            
+            // Log surface coefficients:
+            MatrixXd surface_doublet_coefficients(d->surface->n_panels(), 1);
+            MatrixXd surface_source_coefficients(d->surface->n_panels(), 1);
+            MatrixXd surface_pressure_coefficients(d->surface->n_panels(), 1);
+            MatrixXd surface_velocity_vectors(d->surface->n_panels(), 3);
+            for (int i = 0; i < d->surface->n_panels(); i++) {
+                surface_doublet_coefficients(i, 0)  = doublet_coefficients(offset + i);
+                surface_source_coefficients(i, 0)   = source_coefficients(offset + i);
+                surface_pressure_coefficients(i, 0) = pressure_coefficients(offset + i);
+                surface_velocity_vectors.row(i)     = surface_velocities.row(offset + i);
+            }
+            
+            offset += d->surface->n_panels();
+            
+            vector<string> view_names;
+            vector<MatrixXd, Eigen::aligned_allocator<MatrixXd> > view_data;
+            
+            view_names.push_back(VIEW_NAME_DOUBLET_DISTRIBUTION);
+            view_data.push_back(surface_doublet_coefficients);
+            
+            view_names.push_back(VIEW_NAME_SOURCE_DISTRIBUTION);
+            view_data.push_back(surface_source_coefficients);
+            
+            view_names.push_back(VIEW_NAME_PRESSURE_DISTRIBUTION);
+            view_data.push_back(surface_pressure_coefficients);
+            
+            view_names.push_back(VIEW_NAME_VELOCITY_DISTRIBUTION);
+            view_data.push_back(surface_velocity_vectors);
+            
+            if (copy_geometry)
+                snapshot.surfaces.push_back(shared_ptr<Surface>(new Surface(*d->surface)));
+            else
+                snapshot.surfaces.push_back(d->surface);
+                
+            if (!single_file) {
+                stringstream ss;
+                if (k < n_non_lifting_surfaces) {
+                    idx = k;
+                    ss << log_folder << "/" << bd->body->id << "/non_lifting_surface_" << idx << "/step_" << step_number << writer.file_extension();
+                } else {
+                    idx = k - n_non_lifting_surfaces;
+                    ss << log_folder << "/" << bd->body->id << "/lifting_surface_" << idx << "/step_" << step_number << writer.file_extension();
+                }
+                
+                snapshot.filenames.push_back(ss.str());
+            }
+            
+            snapshot.node_offsets.push_back(save_node_offset);
+            snapshot.panel_offsets.push_back(save_panel_offset);
+            snapshot.view_names.push_back(view_names);
+            snapshot.view_data.push_back(view_data);
+            
+            save_node_offset += d->surface->n_nodes();
+            save_panel_offset += d->surface->n_panels();
+            
+            if (k < n_non_lifting_surfaces)
+                continue;
+            
+            // Log wake surface and coefficients:
+            const shared_ptr<Wake> &wake = bd->body->lifting_surfaces[k - n_non_lifting_surfaces]->wake;
+            
+            MatrixXd wake_doublet_coefficients(wake->doublet_coefficients.size(), 1);
+            for (int i = 0; i < (int) wake->doublet_coefficients.size(); i++)
+                wake_doublet_coefficients(i, 0) = wake->doublet_coefficients[i];
+                
+            view_names.clear();
+            view_data.clear();
+            
+            view_names.push_back(VIEW_NAME_DOUBLET_DISTRIBUTION);
+            view_data.push_back(wake_doublet_coefficients);
+            
+            if (single_file) {
+                // Wakes carry no source, pressure, or velocity data:
+                view_names.push_back(VIEW_NAME_SOURCE_DISTRIBUTION);
+                view_data.push_back(MatrixXd::Zero(wake->n_panels(), 1));
+                
+                view_names.push_back(VIEW_NAME_PRESSURE_DISTRIBUTION);
+                view_data.push_back(MatrixXd::Zero(wake->n_panels(), 1));
+                
+                view_names.push_back(VIEW_NAME_VELOCITY_DISTRIBUTION);
+                view_data.push_back(MatrixXd::Zero(wake->n_panels(), 3));
+                
+            } else {
+                stringstream ssw;
+                ssw << log_folder << "/" << bd->body->id << "/wake_" << idx << "/step_" << step_number << writer.file_extension();
+                
+                snapshot.filenames.push_back(ssw.str());
+            }
+            
+            if (copy_geometry)
+                snapshot.surfaces.push_back(shared_ptr<Surface>(new Surface(*wake)));
+            else
+                snapshot.surfaces.push_back(wake);
+                
+            snapshot.node_offsets.push_back(0);
+            snapshot.panel_offsets.push_back(save_panel_offset);
+            snapshot.view_names.push_back(view_names);
+            snapshot.view_data.push_back(view_data);
+            
+            save_node_offset += wake->n_nodes();
+            save_panel_offset += wake->n_panels();
+        }
+    }
+}
+
+/**
+   Writes a snapshot taken by log_snapshot().  This does not access the solver, and may therefore be called from a
+   different thread.
+   
+   @param[in]   snapshot   Snapshot to write.
+   @param[in]   writer     SurfaceWriter object to use.  This must be the writer for which the snapshot was taken.
+*/
+void
+Solver::write_log_snapshot(const LogSnapshot &snapshot, SurfaceWriter &writer)
+{
+    if (snapshot.surfaces.size() > 0 && snapshot.filenames.size() == 1 && writer.multiple_surfaces()) {
+        // All surfaces into a single file:
+        vector<vector<SurfaceWriter::DataView> > view_data(snapshot.surfaces.size());
+        for (int i = 0; i < (int) snapshot.surfaces.size(); i++) {
+            for (int k = 0; k < (int) snapshot.view_data[i].size(); k++) {
+                const MatrixXd &data = snapshot.view_data[i][k];
+                
+                view_data[i].push_back(SurfaceWriter::DataView(data.data(), data.rows(), data.cols(), OuterStride<>(data.rows())));
+            }
+        }
+        
+        writer.write(snapshot.surfaces, snapshot.filenames[0], snapshot.view_names[0], view_data);
+        
+    } else {
+        // One file per surface:
+        for (int i = 0; i < (int) snapshot.surfaces.size(); i++)
+            writer.write(snapshot.surfaces[i], snapshot.filenames[i], snapshot.node_offsets[i], snapshot.panel_offsets[i],
+                         snapshot.view_names[i], snapshot.view_data[i]);
+    }
+}
+ 
+/**
+   Saves the state of this solver into a binary checkpoint file.  The checkpoint contains the body kinematics, the
+   node positions of all surfaces, the wakes, the solution vectors, and the number of wake updates, so that a
+   restarted simulation refreshes the far wake velocities at the same steps.  It does not contain the topology of the
+   bodies, nor the solver settings.
+   
+   @param[in]   filename   Destination filename.
+   
+   @returns true on success.
+*/
+bool
+Solver::save_checkpoint(const std::string &filename) const
+{
+    // In distributed mode, the replicated state is saved by the first process only:
+    if (Distributed::rank() > 0)
+        return true;
+        
+    VORTEXJE_LOG(logger, Logger::Info, "Solver: Saving checkpoint to " << filename << ".");
+    
+    evaluate_pending_outputs();
+    
+    CheckpointWriter writer(filename);
+    
+    // Layout:
+    writer.write((int64_t) bodies.size());
+    writer.write((int64_t) n_non_wake_panels);
+    
+    vector<shared_ptr<BodyData> >::const_iterator bdi;
+    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+        const shared_ptr<Body> &body = (*bdi)->body;
+        
+        writer.write((int64_t) body->non_lifting_surfaces.size());
+        writer.write((int64_t) body->lifting_surfaces.size());
+    }
+    
+    // Bodies:
+    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+        const shared_ptr<Body> &body = (*bdi)->body;
+        
+        // Kinematics:
+        writer.write(body->position.data(), 3);
+        writer.write(body->velocity.data(), 3);
+        writer.write(body->attitude.coeffs().data(), 4);
+        writer.write(body->rotational_velocity.data(), 3);
+        
+        // Surfaces:
+        vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
+        for (si = body->non_lifting_surfaces.begin(); si != body->non_lifting_surfaces.end(); si++)
+            writer.write((*si)->surface->nodes);
+            
+        // Lifting surfaces and wakes:
+        vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
+        for (lsi = body->lifting_surfaces.begin(); lsi != body->lifting_surfaces.end(); lsi++) {
+            writer.write((*lsi)->lifting_surface->nodes);
+            
+            (*lsi)->wake->write_checkpoint(writer);
+        }
+    }
+    
+    // Solution:
+    writer.write(source_coefficients.data(), source_coefficients.size());
+    writer.write(doublet_coefficients.data(), doublet_coefficients.size());
+    writer.write(surface_velocity_potentials.data(), surface_velocity_potentials.size());
+    writer.write(surface_velocities.data(), surface_velocities.size());
+    writer.write(pressure_coefficients.data(), pressure_coefficients.size());
+    writer.write(previous_surface_velocity_potentials.data(), previous_surface_velocity_potentials.size());
+    
+    // Number of wake updates, which sets the steps at which the far wake velocities are refreshed:
+    writer.write((int64_t) n_wake_updates);
+    
+    if (!writer.good()) {
+        VORTEXJE_LOG(logger, Logger::Error, "Solver: Unable to save checkpoint to " << filename << ".");
+        
+        return false;
+    }
+    
+    return true;
+}
+
+/**
+   Restores the state of this solver from a checkpoint file written by save_checkpoint().  The solver must have been
+   set up with the same bodies, surfaces, and wake types as the solver that saved the checkpoint.  The complete file
+   is read and validated before any state is restored, so that the solver is left unchanged if loading fails.
+   
+   @param[in]   filename   Source filename.
+   
+   @returns true on success.
+*/
+bool
+Solver::load_checkpoint(const std::string &filename)
+{
+    VORTEXJE_LOG(logger, Logger::Info, "Solver: Loading checkpoint from " << filename << ".");
+    
+    CheckpointReader reader(filename);
+    
+    bool valid = reader.good();
+    
+    // Layout:
+    int64_t n_bodies, n_panels;
+    valid = valid && reader.read(n_bodies) && n_bodies == (int64_t) bodies.size();
+    valid = valid && reader.read(n_panels) && n_panels == n_non_wake_panels;
+    
+    vector<shared_ptr<BodyData> >::const_iterator bdi;
+    for (bdi = bodies.begin(); valid && bdi != bodies.end(); bdi++) {
+        const shared_ptr<Body> &body = (*bdi)->body;
+        
+        int64_t n_non_lifting_surfaces, n_lifting_surfaces;
+        valid = valid && reader.read(n_non_lifting_surfaces) && n_non_lifting_surfaces == (int64_t) body->non_lifting_surfaces.size();
+        valid = valid && reader.read(n_lifting_surfaces) && n_lifting_surfaces == (int64_t) body->lifting_surfaces.size();
+    }
+    
+    // Bodies.  Everything is read into local copies first, and restored only once the complete file has been
+    // validated:
+    vector<vector<double> > kinematics;
+    
+    vector<shared_ptr<Surface> > surfaces;
+    vector<vector<Vector3d, Eigen::aligned_allocator<Vector3d> > > surface_nodes;
+    
+    vector<shared_ptr<Wake> > wakes;
+    vector<shared_ptr<Wake::CheckpointState> > wake_states;
+    
+    for (bdi = bodies.begin(); valid && bdi != bodies.end(); bdi++) {
+        const shared_ptr<Body> &body = (*bdi)->body;
+        
+        // Kinematics, i.e., position, velocity, attitude, and rotational velocity:
+        vector<double> body_kinematics(13);
+        valid = valid && reader.read(body_kinematics.data(), 3);
+        valid = valid && reader.read(body_kinematics.data() + 3, 3);
+        valid = valid && reader.read(body_kinematics.data() + 6, 4);
+        valid = valid && reader.read(body_kinematics.data() + 10, 3);
+        
+        kinematics.push_back(body_kinematics);
+        
+        // Surfaces, followed by the lifting surfaces and their wakes:
+        vector<shared_ptr<Surface> > body_surfaces;
+        
+        vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
+        for (si = body->non_lifting_surfaces.begin(); si != body->non_lifting_surfaces.end(); si++)
+            body_surfaces.push_back((*si)->surface);
+            
+        vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
+        for (lsi = body->lifting_surfaces.begin(); lsi != body->lifting_surfaces.end(); lsi++)
+            body_surfaces.push_back((*lsi)->lifting_surface);
+            
+        for (int i = 0; valid && i < (int) body_surfaces.size(); i++) {
+            const shared_ptr<Surface> &surface = body_surfaces[i];
+            
+            vector<Vector3d, Eigen::aligned_allocator<Vector3d> > nodes;
+            
+            valid = valid && reader.read(nodes) && nodes.size() == surface->nodes.size();
+            if (!valid)
+                break;
+                
+            surfaces.push_back(surface);
+            surface_nodes.push_back(nodes);
+            
+            // Wake:
+            int lifting_surface = i - (int) body->non_lifting_surfaces.size();
+            if (lifting_surface >= 0) {
+                const shared_ptr<Wake> &wake = body->lifting_surfaces[lifting_surface]->wake;
+                
+                shared_ptr<Wake::CheckpointState> wake_state = wake->read_checkpoint(reader);
+                
+                valid = valid && wake_state;
+                
+                wakes.push_back(wake);
+                wake_states.push_back(wake_state);
+            }
+        }
+    }
+    
+    // Solution:
+    VectorXd new_source_coefficients(source_coefficients.size());
+    VectorXd new_doublet_coefficients(doublet_coefficients.size());
+    VectorXd new_surface_velocity_potentials(surface_velocity_potentials.size());
+    MatrixXd new_surface_velocities(surface_velocities.rows(), surface_velocities.cols());
+    VectorXd new_pressure_coefficients(pressure_coefficients.size());
+    VectorXd new_previous_surface_velocity_potentials(previous_surface_velocity_potentials.size());
+    
+    valid = valid && reader.read(new_source_coefficients.data(), new_source_coefficients.size());
+    valid = valid && reader.read(new_doublet_coefficients.data(), new_doublet_coefficients.size());
+    valid = valid && reader.read(new_surface_velocity_potentials.data(), new_surface_velocity_potentials.size());
+    valid = valid && reader.read(new_surface_velocities.data(), new_surface_velocities.size());
+    valid = valid && reader.read(new_pressure_coefficients.data(), new_pressure_coefficients.size());
+    valid = valid && reader.read(new_previous_surface_velocity_potentials.data(), new_previous_surface_velocity_potentials.size());
+    
+    int64_t wake_updates;
+    valid = valid && reader.read(wake_updates) && wake_updates >= 0;
+    
+    if (!valid) {
+        VORTEXJE_LOG(logger, Logger::Error, "Solver: Unable to load checkpoint from " << filename << ".");
+        
+        return false;
+    }
+    
+    // Restore the bodies.  The surfaces are not transformed, as their node positions are restored:
+    int i = 0;
+    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++, i++) {
+        const shared_ptr<Body> &body = (*bdi)->body;
+        
+        body->position            = Map<Vector3d>(kinematics[i].data());
+        body->velocity            = Map<Vector3d>(kinematics[i].data() + 3);
+        body->attitude.coeffs()   = Map<Vector4d>(kinematics[i].data() + 6);
+        body->rotational_velocity = Map<Vector3d>(kinematics[i].data() + 10);
+    }
+    
+    for (i = 0; i < (int) surfaces.size(); i++) {
+        surfaces[i]->nodes.swap(surface_nodes[i]);
+        
+        surfaces[i]->compute_geometry();
+    }
+    
+    for (i = 0; i < (int) wakes.size(); i++)
+        wakes[i]->restore_checkpoint(*wake_states[i]);
+        
+    // Restore the solution:
+    source_coefficients.swap(new_source_coefficients);
+    doublet_coefficients.swap(new_doublet_coefficients);
+    surface_velocity_potentials.swap(new_surface_velocity_potentials);
+    surface_velocities.swap(new_surface_velocities);
+    pressure_coefficients.swap(new_pressure_coefficients);
+    previous_surface_velocity_potentials.swap(new_previous_surface_velocity_potentials);
+    
+    // The checkpoint holds the outputs of all surfaces:
+    surface_velocities_pending.assign(surface_velocities_pending.size(), false);
+    surface_velocity_potentials_pending.assign(surface_velocity_potentials_pending.size(), false);
+    pressure_coefficients_pending.assign(pressure_coefficients_pending.size(), false);
+    
+    loads_valid.assign(loads_valid.size(), false);
+    
+    n_wake_updates = wake_updates;
+    
+    return true;
+}
+
+/**
+   Logs source and doublet distributions, as well as the pressure coefficients, of all surfaces and wakes into a
+   single file in the logging folder tagged with the specified step number.  The data is passed to the writer as
+   views of the coefficient vectors of this solver.  Wakes carry no source, pressure, or velocity data; these are
+   written as zeros.
+   
+   @param[in]   step_number   Step number used to name the output file.
+   @param[in]   writer        SurfaceWriter object to use.
+*/
+void
+Solver::log_single_file(int step_number, SurfaceWriter &writer) const
+{
+    evaluate_pending_outputs();
+    
+    vector<string> view_names;
+    view_names.push_back(VIEW_NAME_DOUBLET_DISTRIBUTION);
+    view_names.push_back(VIEW_NAME_SOURCE_DISTRIBUTION);
+    view_names.push_back(VIEW_NAME_PRESSURE_DISTRIBUTION);
+    view_names.push_back(VIEW_NAME_VELOCITY_DISTRIBUTION);
+    
+    vector<shared_ptr<Surface> > surfaces;
+    vector<vector<SurfaceWriter::DataView> > view_data;
+    
+    // Zero data for the wakes:
+    int max_wake_panels = 0;
+    
+    vector<shared_ptr<BodyData> >::const_iterator bdi;
+    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+        vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
+        for (lsi = (*bdi)->body->lifting_surfaces.begin(); lsi != (*bdi)->body->lifting_surfaces.end(); lsi++)
+            max_wake_panels = max(max_wake_panels, (int) (*lsi)->wake->doublet_coefficients.size());
+    }
+    
+    MatrixXd zeros = MatrixXd::Zero(max_wake_panels, 3);
+    
+    // Non-wake surfaces.  These are stored contiguously in the coefficient vectors:
+    int n_rows = doublet_coefficients.size();
+    int offset = 0;
+    
+    vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
+    for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+        const shared_ptr<Body::SurfaceData> &d = *si;
+        
+        int n = d->surface->n_panels();
+        
+        vector<SurfaceWriter::DataView> views;
+        views.push_back(SurfaceWriter::DataView(doublet_coefficients.data() + offset, n, 1, OuterStride<>(n_rows)));
+        views.push_back(SurfaceWriter::DataView(source_coefficients.data() + offset, n, 1, OuterStride<>(n_rows)));
+        views.push_back(SurfaceWriter::DataView(pressure_coefficients.data() + offset, n, 1, OuterStride<>(n_rows)));
+        views.push_back(SurfaceWriter::DataView(surface_velocities.data() + offset, n, 3, OuterStride<>(n_rows)));
+        
+        surfaces.push_back(d->surface);
+        view_data.push_back(views);
+        
+        offset += n;
+    }
+    
+    // Wakes:
+    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+        vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
+        for (lsi = (*bdi)->body->lifting_surfaces.begin(); lsi != (*bdi)->body->lifting_surfaces.end(); lsi++) {
+            const shared_ptr<Body::LiftingSurfaceData> &d = *lsi;
+            
+            int n = d->wake->doublet_coefficients.size();
+            
+            vector<SurfaceWriter::DataView> views;
+            views.push_back(SurfaceWriter::DataView(d->wake->doublet_coefficients.data(), n, 1, OuterStride<>(n)));
+            views.push_back(SurfaceWriter::DataView(zeros.data(), n, 1, OuterStride<>(max_wake_panels)));
+            views.push_back(SurfaceWriter::DataView(zeros.data(), n, 1, OuterStride<>(max_wake_panels)));
+            views.push_back(SurfaceWriter::DataView(zeros.data(), n, 3, OuterStride<>(max_wake_panels)));
+            
+            surfaces.push_back(d->wake);
+            view_data.push_back(views);
+        }
+    }
+    
+    stringstream ss;
+    ss << log_folder << "/step_" << step_number << writer.file_extension();
+    
+    writer.write(surfaces, ss.str(), view_names, view_data);
+}
+
+/**
+   Returns the transformations to the images of the meshed geometry, excluding the identity.  These are the rotations
+   about the z-axis by multiples of 2 pi / parameters.cyclic_symmetry_sectors, and, if parameters.symmetry_plane is
+   set, their compositions with the reflection about the plane y = 0.
+   
+   Every transformation T is orthogonal, and the images form a group.  Therefore, the potential induced by the images
+   of a panel at a point x is the sum of the potentials induced by the panel itself at the points T x, and the
+   velocity the sum of T^T v(T x).  In particular, the images of a cyclically symmetric rotor yield the block-circulant
+   influence matrix of the full rotor, reduced to the mode in which all blades carry the same singularity distribution.
+   
+   @returns Image transformations.
+*/
+vector<Matrix3d>
+Solver::image_transformations() const
+{
+    vector<Matrix3d> transformations;
+    
+    Matrix3d reflection = Vector3d(1, -1, 1).asDiagonal();
+    
+    int n_sectors = max(parameters.cyclic_symmetry_sectors, 1);
+    for (int k = 0; k < n_sectors; k++) {
+        Matrix3d rotation = AngleAxisd(2 * pi * k / n_sectors, Vector3d::UnitZ()).toRotationMatrix();
+        
+        if (k > 0)
+            transformations.push_back(rotation);
+        if (parameters.symmetry_plane)
+            transformations.push_back(reflection * rotation);
+    }
+    
+    return transformations;
+}
+
+/**
+   Checks whether the cached block of influence coefficients between two surfaces is valid for the current geometry.
+   This is the case if the panel geometry of neither surface was recomputed, and if both surfaces have undergone the
+   same rigid motion since the block was computed.
+   
+   @param[in]   row_surface   Index of the surface containing the collocation points.
+   @param[in]   col_surface   Index of the surface containing the influencing panels.
+   
+   @returns true if the cached block of influence coefficients may be reused.
+*/
+bool
+Solver::influence_coefficients_block_valid(int row_surface, int col_surface) const
+{
+    if (influence_coefficients_geometry_revisions.size() != non_wake_surfaces.size())
+        return false;
+        
+    const shared_ptr<Surface> &surface_row = non_wake_surfaces[row_surface]->surface;
+    const shared_ptr<Surface> &surface_col = non_wake_surfaces[col_surface]->surface;
+    
+    if (surface_row->geometry_revision != influence_coefficients_geometry_revisions[row_surface] ||
+        surface_col->geometry_revision != influence_coefficients_geometry_revisions[col_surface])
+        return false;
+        
+    if (row_surface == col_surface)
+        return true;
+        
+    // Rigid motion of both surfaces since the block was computed:
+    Transform<double, 3, Affine> motion_row = surface_row->accumulated_transformation * influence_coefficients_transformations[row_surface].inverse();
+    Transform<double, 3, Affine> motion_col = surface_col->accumulated_transformation * influence_coefficients_transformations[col_surface].inverse();
+    
+    return motion_row.isApprox(motion_col, parameters.relative_motion_tolerance);
+}
+
+/**
+   Computes the matrices of source and doublet influence coefficients between all non-wake panels.  Only those blocks
+   are recomputed for which the pair of surfaces has moved relative to each other, or for which the panel geometry
+   was recomputed.  All other blocks are kept from the previous call.
+   
+   If parameters.hierarchical_matrix_tolerance is positive, hierarchical matrix approximations are computed
+   instead.  These are recomputed as a whole whenever any block is invalid.
+*/
+void
+Solver::compute_influence_coefficients()
+{
+    int n_surfaces = non_wake_surfaces.size();
+    
+    // Collect the blocks that need to be recomputed:
+    vector<pair<int, int> > blocks;
+    
+    for (int k = 0; k < n_surfaces; k++) {
+        for (int l = 0; l < n_surfaces; l++) {
+            if (!influence_coefficients_block_valid(k, l))
+                blocks.push_back(make_pair(k, l));
+        }
+    }
+    
+    // Check whether the matrices are stored in the requested representation.  In distributed mode, every process
+    // stores a block of rows of the dense matrices:
+    bool compressed = (parameters.hierarchical_matrix_tolerance > 0 && Distributed::size() == 1);
+    
+    Distributed::partition(n_non_wake_panels, row_begin, row_end);
+    
+    bool single_precision = use_single_precision();
+    
+    // The source influence coefficients are only stored if requested:
+    int n_source_rows = parameters.store_source_influence_coefficients ? row_end - row_begin : 0;
+    int n_source_cols = parameters.store_source_influence_coefficients ? n_non_wake_panels : 0;
+    
+    bool representation_valid;
+    if (influence_coefficients_symmetry_plane != parameters.symmetry_plane ||
+        influence_coefficients_cyclic_symmetry_sectors != parameters.cyclic_symmetry_sectors)
+        representation_valid = false;
+    else if (compressed)
+        representation_valid = (bool) compressed_doublet_influence_coefficients;
+    else if (single_precision)
+        representation_valid = (single_precision_doublet_influence_coefficients.rows() == n_non_wake_panels &&
+                                single_precision_doublet_influence_coefficients.cols() == n_non_wake_panels &&
+                                single_precision_source_influence_coefficients.rows() == n_source_rows &&
+                                single_precision_source_influence_coefficients.cols() == n_source_cols);
+    else
+        representation_valid = (doublet_influence_coefficients.rows() == row_end - row_begin && doublet_influence_coefficients.cols() == n_non_wake_panels &&
+                                source_influence_coefficients.rows() == n_source_rows && source_influence_coefficients.cols() == n_source_cols);
+    
+    if (blocks.size() == 0 && representation_valid) {
+        VORTEXJE_LOG(logger, Logger::Info, "Solver: Reusing matrices of influence coefficients.");
+            
+        return;
+    }
+    
+    doublet_influence_coefficients_factorized = false;
+    preconditioner_valid                      = false;
+    
+    influence_coefficients_symmetry_plane          = parameters.symmetry_plane;
+    influence_coefficients_cyclic_symmetry_sectors = parameters.cyclic_symmetry_sectors;
+    
+    if (compressed) {
+        compute_compressed_influence_coefficients();
+        
+    } else {
+        compressed_source_influence_coefficients.reset();
+        compressed_doublet_influence_coefficients.reset();
+        
+        if (!representation_valid) {
+            // Only one of the dense representations is kept:
+            if (single_precision) {
+                single_precision_source_influence_coefficients.resize(n_source_rows, n_source_cols);
+                single_precision_doublet_influence_coefficients.resize(n_non_wake_panels, n_non_wake_panels);
+                
+                source_influence_coefficients.resize(0, 0);
+                doublet_influence_coefficients.resize(0, 0);
+                
+            } else {
+                source_influence_coefficients.resize(n_source_rows, n_source_cols);
+                doublet_influence_coefficients.resize(row_end - row_begin, n_non_wake_panels);
+                
+                single_precision_source_influence_coefficients.resize(0, 0);
+                single_precision_doublet_influence_coefficients.resize(0, 0);
+            }
+            
+            // All blocks need to be computed:
+            blocks.clear();
+            for (int k = 0; k < n_surfaces; k++)
+                for (int l = 0; l < n_surfaces; l++)
+                    blocks.push_back(make_pair(k, l));
+        }
+        
+        // Complete dense matrices may be read from the cache instead:
+        string cache_filename;
+        if ((int) blocks.size() == n_surfaces * n_surfaces && !single_precision && Distributed::size() == 1 &&
+            !parameters.influence_coefficient_cache_folder.empty())
+            cache_filename = influence_coefficient_cache_filename();
+            
+        if (!cache_filename.empty() && read_influence_coefficient_cache(cache_filename)) {
+            profiler->increment("influence_coefficient_cache_hits");
+            
+        } else {
+            compute_influence_coefficient_blocks(blocks);
+            
+            if (!cache_filename.empty())
+                write_influence_coefficient_cache(cache_filename);
+        }
+    }
+    
+    // Remember the geometry for which the matrices were computed.  The blocks that were kept are valid for the new
+    // transformations as well, since the pairs of surfaces involved have not moved relative to each other.
+    influence_coefficients_geometry_revisions.clear();
+    influence_coefficients_transformations.clear();
+    
+    vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
+    for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+        influence_coefficients_geometry_revisions.push_back((*si)->surface->geometry_revision);
+        influence_coefficients_transformations.push_back((*si)->surface->accumulated_transformation);
+    }
+}
+
+/**
+   Returns the name of the cache file of the matrices of influence coefficients for the current geometry.  The name
+   contains a 64-bit FNV-1a hash of the nodes and panels of all non-wake surfaces, of the surface types, and of the
+   parameters that affect the influence kernels.
+   
+   @returns Cache filename.
+*/
+string
+Solver::influence_coefficient_cache_filename() const
+{
+    uint64_t hash = 14695981039346656037ULL;
+    
+    fnv1a_hash(hash, &INFLUENCE_COEFFICIENT_CACHE_VERSION, sizeof(INFLUENCE_COEFFICIENT_CACHE_VERSION));
+    
+    // Kernel settings:
+    fnv1a_hash(hash, &Parameters::collocation_point_delta, sizeof(double));
+    fnv1a_hash(hash, &Parameters::far_field_distance_factor, sizeof(double));
+    fnv1a_hash(hash, &Parameters::inversion_tolerance, sizeof(double));
+    
+    int64_t settings[4] = { parameters.symmetry_plane, parameters.cyclic_symmetry_sectors,
+                            parameters.store_source_influence_coefficients, parameters.use_accelerator };
+    fnv1a_hash(hash, settings, sizeof(settings));
+    
+    // Geometry:
+    vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
+    for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+        const shared_ptr<Surface> &surface = (*si)->surface;
+        
+        string type = typeid(*surface.get()).name();
+        fnv1a_hash(hash, type.data(), type.size());
+        
+        int64_t n_nodes = surface->n_nodes();
+        fnv1a_hash(hash, &n_nodes, sizeof(n_nodes));
+        
+        for (int i = 0; i < surface->n_nodes(); i++)
+            fnv1a_hash(hash, surface->nodes[i].data(), 3 * sizeof(double));
+            
+        int64_t n_panels = surface->n_panels();
+        fnv1a_hash(hash, &n_panels, sizeof(n_panels));
+        
+        for (int i = 0; i < surface->n_panels(); i++) {
+            int64_t n_panel_nodes = surface->panel_nodes[i].size();
+            fnv1a_hash(hash, &n_panel_nodes, sizeof(n_panel_nodes));
+            fnv1a_hash(hash, surface->panel_nodes[i].data(), n_panel_nodes * sizeof(int));
+        }
+    }
+    
+    stringstream ss;
+    ss << parameters.influence_coefficient_cache_folder << "/influence-coefficients-" << hex << setw(16) << setfill('0') << hash << ".bin";
+    
+    return ss.str();
+}
+
+/**
+   Reads the dense matrices of influence coefficients from the given cache file, if it exists and matches the current
+   layout.
+   
+   @param[in]   filename   Cache filename, see influence_coefficient_cache_filename().
+   
+   @returns true if the matrices were read.
+*/
+bool
+Solver::read_influence_coefficient_cache(const string &filename)
+{
+    CheckpointReader reader(filename);
+    if (!reader.good())
+        return false;
+        
+    int64_t version, n_panels, store_sources;
+    if (!reader.read(version) || version != INFLUENCE_COEFFICIENT_CACHE_VERSION ||
+        !reader.read(n_panels) || n_panels != n_non_wake_panels ||
+        !reader.read(store_sources) || store_sources != parameters.store_source_influence_coefficients) {
+        VORTEXJE_LOG(logger, Logger::Warning, "Solver: Ignoring incompatible influence coefficient cache file " << filename << ".");
+        
+        return false;
+    }
+    
+    VORTEXJE_LOG(logger, Logger::Info, "Solver: Reading matrices of influence coefficients from " << filename << ".");
+    
+    if (!reader.read(doublet_influence_coefficients.data(), doublet_influence_coefficients.size()) ||
+        !reader.read(source_influence_coefficients.data(), source_influence_coefficients.size())) {
+        VORTEXJE_LOG(logger, Logger::Warning, "Solver: Influence coefficient cache file " << filename << " is truncated.");
+        
+        return false;
+    }
+    
+    return true;
+}
+
+/**
+   Writes the dense matrices of influence coefficients to the given cache file.  The file is written under a
+   temporary name first, so that concurrent solvers never read a partially written file.
+   
+   @param[in]   filename   Cache filename, see influence_coefficient_cache_filename().
+*/
+void
+Solver::write_influence_coefficient_cache(const string &filename) const
+{
+    mkdir_helper(parameters.influence_coefficient_cache_folder, logger);
+    
+    VORTEXJE_LOG(logger, Logger::Info, "Solver: Writing matrices of influence coefficients to " << filename << ".");
+    
+    // The temporary name is unique to this writer, so that concurrent writers never rename each other's partial files:
+    stringstream ss;
+    ss << filename << "." << getpid() << "." << temporary_file_counter++ << ".tmp";
+    
+    string temporary_filename = ss.str();
+    
+    {
+        CheckpointWriter writer(temporary_filename);
+        
+        writer.write(INFLUENCE_COEFFICIENT_CACHE_VERSION);
+        writer.write((int64_t) n_non_wake_panels);
+        writer.write((int64_t) parameters.store_source_influence_coefficients);
+        
+        writer.write(doublet_influence_coefficients.data(), doublet_influence_coefficients.size());
+        writer.write(source_influence_coefficients.data(), source_influence_coefficients.size());
+        
+        if (!writer.good()) {
+            VORTEXJE_LOG(logger, Logger::Warning, "Solver: Unable to write influence coefficient cache file " << filename << ".");
+            
+            remove(temporary_filename.c_str());
+            
+            return;
+        }
+    }
+    
+    if (rename(temporary_filename.c_str(), filename.c_str()) != 0) {
+        VORTEXJE_LOG(logger, Logger::Warning, "Solver: Unable to write influence coefficient cache file " << filename << ".");
+        
+        remove(temporary_filename.c_str());
+    }
+}
+
+/**
+   Computes the given blocks of the dense matrices of source and doublet influence coefficients.  The influence of
+   every panel includes that of its images, see image_transformations().
+   
+   @param[in]   blocks   List of (row surface, column surface) index pairs.
+*/
+void
+Solver::compute_influence_coefficient_blocks(const vector<pair<int, int> > &blocks)
+{
+    bool single_precision = use_single_precision();
+    bool store_sources    = parameters.store_source_influence_coefficients;
+    
+    vector<Matrix3d> images = image_transformations();
+    
+    VORTEXJE_LOG(logger, Logger::Info, "Solver: Computing matrices of influence coefficients (" << blocks.size() << " of " << non_wake_surfaces.size() * non_wake_surfaces.size() << " blocks).");
+    
+    // Offsets of the surfaces in the global panel numbering:
+    vector<int> offsets;
+    
+    int offset = 0;
+    
+    vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
+    for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+        offsets.push_back(offset);
+        
+        offset += (*si)->surface->n_panels();
+    }
+    
+    // Use the accelerator backend, if requested:
+    shared_ptr<Accelerator> accelerator;
+    if (parameters.use_accelerator) {
+        accelerator = shared_ptr<Accelerator>(new Accelerator());
+        
+        for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++)
+            accelerator->add_surface((*si)->surface);
+            
+        accelerator->upload();
+    }
+    
+    // Influence coefficients between pairs of non-wake surfaces, on the accelerator backend:
+    if (accelerator) {
+        vector<pair<int, int> >::const_iterator bi;
+        for (bi = blocks.begin(); bi != blocks.end(); bi++) {
+            const shared_ptr<Body::SurfaceData> &d_row = non_wake_surfaces[bi->first];
+            const shared_ptr<Body::SurfaceData> &d_col = non_wake_surfaces[bi->second];
+            
+            int offset_col = offsets[bi->second];
+            
+            // Rows of the row surface owned by this process, and their position in the local matrices:
+            int first_row = max(offsets[bi->first], row_begin);
+            int last_row  = min(offsets[bi->first] + d_row->surface->n_panels(), row_end);
+            if (first_row >= last_row)
+                continue;
+            
+            int first_row_panel = first_row - offsets[bi->first];
+            int offset_row      = first_row - row_begin;
+            
+            int n_rows = last_row - first_row;
+            
+            // Collocation points of the row surface, one per column, so that each panel of the column surface is
+            // evaluated against all of them at once:
+            Matrix3Xd collocation_points(3, n_rows);
+            for (int i = 0; i < n_rows; i++)
+                collocation_points.col(i) = d_row->surface->panel_collocation_point(first_row_panel + i, true);
+            
+            // The images of the column surface panels are evaluated on the transformed collocation points:
+            int n_images = images.size();
+            
+            vector<Matrix3Xd> image_collocation_points;
+            for (int k = 0; k < n_images; k++)
+                image_collocation_points.push_back(images[k] * collocation_points);
+            
+            profiler->increment("influence_coefficient_evaluations", (1.0 + n_images) * n_rows * d_col->surface->n_panels());
+            
+            int n_cols = d_col->surface->n_panels();
+            
+            MatrixXd block_source_influence_coefficients, block_doublet_influence_coefficients;
+            accelerator->influence_coefficients(collocation_points, offset_col, n_cols,
+                                                block_source_influence_coefficients, block_doublet_influence_coefficients);
+            
+            // Doublet panels are evaluated on their own collocation points from the inside:
+            if (d_row == d_col) {
+                for (int i = 0; i < n_rows; i++)
+                    block_doublet_influence_coefficients(i, first_row_panel + i) = -0.5;
+            }
+            
+            for (int k = 0; k < n_images; k++) {
+                MatrixXd image_source_influence_coefficients, image_doublet_influence_coefficients;
+                accelerator->influence_coefficients(image_collocation_points[k], offset_col, n_cols,
+                                                    image_source_influence_coefficients, image_doublet_influence_coefficients);
+            
+                block_source_influence_coefficients  += image_source_influence_coefficients;
+                block_doublet_influence_coefficients += image_doublet_influence_coefficients;
+            }
+            
+            if (single_precision) {
+                if (store_sources)
+                    single_precision_source_influence_coefficients.block(offset_row, offset_col, n_rows, n_cols) = block_source_influence_coefficients.cast<float>();
+                single_precision_doublet_influence_coefficients.block(offset_row, offset_col, n_rows, n_cols) = block_doublet_influence_coefficients.cast<float>();
+            
+            } else {
+                if (store_sources)
+                    source_influence_coefficients.block(offset_row, offset_col, n_rows, n_cols) = block_source_influence_coefficients;
+                doublet_influence_coefficients.block(offset_row, offset_col, n_rows, n_cols) = block_doublet_influence_coefficients;
+            }
+        }
+            
+        return;
+    }
+    
+    // Rows owned by this process of every row surface, and their collocation points.  The collocation points are
+    // preloaded in tiles of ASSEMBLY_ROW_TILE_SIZE rows, so that each tile stays in cache while it is evaluated against
+    // the panels of a column tile:
+    int n_surfaces = non_wake_surfaces.size();
+    int n_images   = images.size();
+    
+    vector<int> first_rows(n_surfaces), offset_rows(n_surfaces), n_rows(n_surfaces);
+    vector<vector<vector<Matrix3Xd> > > row_tiles(n_surfaces);
+    
+    vector<bool> row_surface_used(n_surfaces, false);
+    
+    vector<pair<int, int> >::const_iterator bi;
+    for (bi = blocks.begin(); bi != blocks.end(); bi++)
+        row_surface_used[bi->first] = true;
+        
+    for (int k = 0; k < n_surfaces; k++) {
+        const shared_ptr<Surface> &surface = non_wake_surfaces[k]->surface;
+        
+        int first_row = max(offsets[k], row_begin);
+        int last_row  = min(offsets[k] + surface->n_panels(), row_end);
+        
+        first_rows[k]  = first_row - offsets[k];
+        offset_rows[k] = first_row - row_begin;
+        n_rows[k]      = max(last_row - first_row, 0);
+        
+        if (!row_surface_used[k])
+            continue;
+            
+        // The images of the column surface panels are evaluated on the transformed collocation points:
+        row_tiles[k].resize(1 + n_images);
+        
+        for (int i = 0; i < n_rows[k]; i += ASSEMBLY_ROW_TILE_SIZE) {
+            int n_tile_rows = min(ASSEMBLY_ROW_TILE_SIZE, n_rows[k] - i);
+            
+            Matrix3Xd tile(3, n_tile_rows);
+            for (int l = 0; l < n_tile_rows; l++)
+                tile.col(l) = surface->panel_collocation_point(first_rows[k] + i + l, true);
+                
+            row_tiles[k][0].push_back(tile);
+            for (int m = 0; m < n_images; m++)
+                row_tiles[k][1 + m].push_back(images[m] * tile);
+        }
+    }
+    
+    for (bi = blocks.begin(); bi != blocks.end(); bi++)
+        profiler->increment("influence_coefficient_evaluations", (1.0 + n_images) * n_rows[bi->first] * non_wake_surfaces[bi->second]->surface->n_panels());
+        
+    // Assemble all blocks at once, by tiles of ASSEMBLY_COLUMN_TILE_SIZE columns.  Every column tile is always assigned
+    // to the same thread, so that the memory of the matrices is first touched, and later updated, by the thread that
+    // owns it:
+    int n_column_tiles = (n_non_wake_panels + ASSEMBLY_COLUMN_TILE_SIZE - 1) / ASSEMBLY_COLUMN_TILE_SIZE;
+    
+    int c;
+    #pragma omp parallel
+    {
+        VectorXd tile_source_influence(ASSEMBLY_ROW_TILE_SIZE), tile_doublet_influence(ASSEMBLY_ROW_TILE_SIZE);
+        VectorXd image_source_influence(n_images > 0 ? ASSEMBLY_ROW_TILE_SIZE : 0), image_doublet_influence(n_images > 0 ? ASSEMBLY_ROW_TILE_SIZE : 0);
+        
+        #pragma omp for schedule(static, 1)
+        for (c = 0; c < n_column_tiles; c++) {
+            int first_col = c * ASSEMBLY_COLUMN_TILE_SIZE;
+            int last_col  = min(first_col + ASSEMBLY_COLUMN_TILE_SIZE, n_non_wake_panels);
+            
+            vector<pair<int, int> >::const_iterator bi;
+            for (bi = blocks.begin(); bi != blocks.end(); bi++) {
+                const shared_ptr<Surface> &row_surface = non_wake_surfaces[bi->first]->surface;
+                const shared_ptr<Surface> &col_surface = non_wake_surfaces[bi->second]->surface;
+                
+                int offset_col = offsets[bi->second];
+                
+                int col_begin = max(first_col, offset_col);
+                int col_end   = min(last_col, offset_col + col_surface->n_panels());
+                if (col_begin >= col_end)
+                    continue;
+                    
+                const vector<vector<Matrix3Xd> > &tiles = row_tiles[bi->first];
+                
+                for (int t = 0; t < (int) tiles[0].size(); t++) {
+                    int first_tile_row = t * ASSEMBLY_ROW_TILE_SIZE;
+                    int n_tile_rows    = tiles[0][t].cols();
+                    
+                    // Position of the tile in the local matrices, and its first panel on the row surface:
+                    int offset_row       = offset_rows[bi->first] + first_tile_row;
+                    int first_tile_panel = first_rows[bi->first] + first_tile_row;
+                    
+                    for (int col = col_begin; col < col_end; col++) {
+                        int j = col - offset_col;
+                        
+                        col_surface->source_and_doublet_influence(tiles[0][t], j, tile_source_influence.head(n_tile_rows),
+                                                                  tile_doublet_influence.head(n_tile_rows));
+                                                                  
+                        // Doublet panels are evaluated on their own collocation points from the inside:
+                        if (row_surface == col_surface && j >= first_tile_panel && j < first_tile_panel + n_tile_rows)
+                            tile_doublet_influence(j - first_tile_panel) = -0.5;
+                            
+                        for (int m = 0; m < n_images; m++) {
+                            col_surface->source_and_doublet_influence(tiles[1 + m][t], j, image_source_influence.head(n_tile_rows),
+                                                                      image_doublet_influence.head(n_tile_rows));
+                                                                      
+                            tile_source_influence.head(n_tile_rows)  += image_source_influence.head(n_tile_rows);
+                            tile_doublet_influence.head(n_tile_rows) += image_doublet_influence.head(n_tile_rows);
+                        }
+                        
+                        // Write contiguous column segments:
+                        if (single_precision) {
+                            // The kernels are evaluated in double precision, and the results rounded:
+                            if (store_sources)
+                                single_precision_source_influence_coefficients.col(col).segment(offset_row, n_tile_rows) = tile_source_influence.head(n_tile_rows).cast<float>();
+                            single_precision_doublet_influence_coefficients.col(col).segment(offset_row, n_tile_rows) = tile_doublet_influence.head(n_tile_rows).cast<float>();
+                            
+                        } else {
+                            // Without stored source influence coefficients, these are discarded:
+                            if (store_sources)
+                                source_influence_coefficients.col(col).segment(offset_row, n_tile_rows) = tile_source_influence.head(n_tile_rows);
+                            doublet_influence_coefficients.col(col).segment(offset_row, n_tile_rows) = tile_doublet_influence.head(n_tile_rows);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+   Computes hierarchical matrix approximations of the matrices of source and doublet influence coefficients.  The
+   dense matrices are released.
+*/
+void
+Solver::compute_compressed_influence_coefficients()
+{
+    VORTEXJE_LOG(logger, Logger::Info, "Solver: Computing hierarchical matrices of influence coefficients.");
+    
+    source_influence_coefficients.resize(0, 0);
+    doublet_influence_coefficients.resize(0, 0);
+    
+    single_precision_source_influence_coefficients.resize(0, 0);
+    single_precision_doublet_influence_coefficients.resize(0, 0);
+    
+    // Map global panel indices to surfaces and panels:
+    vector<Vector3d, Eigen::aligned_allocator<Vector3d> > points;
+    vector<shared_ptr<Surface> > panel_surfaces;
+    vector<int> panels;
+    
+    vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
+    for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+        const shared_ptr<Surface> &surface = (*si)->surface;
+        
+        for (int i = 0; i < surface->n_panels(); i++) {
+            points.push_back(surface->panel_collocation_point(i, false));
+            panel_surfaces.push_back(surface);
+            panels.push_back(i);
+        }
+    }
+    
+    // Compute.  The images of the panels are evaluated on the transformed collocation points:
+    vector<Matrix3d> images = image_transformations();
+    
+    HierarchicalMatrix::EntryFunction source_entry = [&](int i, int j) {
+        double value = panel_surfaces[j]->source_influence(panel_surfaces[i], panels[i], panels[j]);
+        for (int k = 0; k < (int) images.size(); k++)
+            value += panel_surfaces[j]->source_influence(images[k] * panel_surfaces[i]->panel_collocation_point(panels[i], true), panels[j]);
+            
+        return value;
+    };
+    
+    HierarchicalMatrix::EntryFunction doublet_entry = [&](int i, int j) {
+        double value = panel_surfaces[j]->doublet_influence(panel_surfaces[i], panels[i], panels[j]);
+        for (int k = 0; k < (int) images.size(); k++)
+            value += panel_surfaces[j]->doublet_influence(images[k] * panel_surfaces[i]->panel_collocation_point(panels[i], true), panels[j]);
+            
+        return value;
+    };
+    
+    compressed_source_influence_coefficients = make_shared<HierarchicalMatrix>(points);
+    compressed_source_influence_coefficients->compute(source_entry, parameters.hierarchical_matrix_tolerance);
+    
+    compressed_doublet_influence_coefficients = make_shared<HierarchicalMatrix>(points);
+    compressed_doublet_influence_coefficients->compute(doublet_entry, parameters.hierarchical_matrix_tolerance);
+    
+    VORTEXJE_LOG(logger, Logger::Info, "Solver: Done computing hierarchical matrices with compression ratios " << compressed_source_influence_coefficients->compression_ratio()
+                 << " and " << compressed_doublet_influence_coefficients->compression_ratio() << ".");
+}
+
+/**
+   Computes the influence of the newest row of wake panels on all non-wake panels.  The doublet strength of these
+   panels is set according to the Kutta condition, and hence their influence is attributed to the trailing edge panels.
+   
+   @param[out]   wake_influence_coefficients   Doublet influence coefficients, one column per new wake panel.
+   @param[out]   upper_indices                 Global index of the upper trailing edge panel of every new wake panel.
+   @param[out]   lower_indices                 Global index of the lower trailing edge panel of every new wake panel.
+*/
+void
+Solver::compute_wake_influence_coefficients(MatrixXd &wake_influence_coefficients, vector<int> &upper_indices, vector<int> &lower_indices) const
+{
+    // Collect the new wake panels.  The trailing edge panels they are attributed to are listed in the same order, by
+    // add_body():
+    vector<shared_ptr<Body::LiftingSurfaceData> > wake_panel_surfaces;
+    vector<int> wake_panels;
+    
+    vector<shared_ptr<BodyData> >::const_iterator bdi;
+    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+        const shared_ptr<BodyData> &bd = *bdi;
+        
+        vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
+        for (lsi = bd->body->lifting_surfaces.begin(); lsi != bd->body->lifting_surfaces.end(); lsi++) {
+            const shared_ptr<Body::LiftingSurfaceData> &d = *lsi;
+            
+            int wake_panel_offset = d->wake->n_panels() - d->lifting_surface->n_spanwise_panels();
+            for (int j = 0; j < d->lifting_surface->n_spanwise_panels(); j++) {
+                wake_panel_surfaces.push_back(d);
+                wake_panels.push_back(wake_panel_offset + j);
+            }
+        }
+    }
+    
+    upper_indices = trailing_edge_upper_indices;
+    lower_indices = trailing_edge_lower_indices;
+    
+    // Compute influence coefficients:
+    wake_influence_coefficients.resize(n_non_wake_panels, wake_panels.size());
+    
+    vector<Matrix3d> images = image_transformations();
+    
+    // The rows of all surfaces are split into tasks, so that no thread waits at a barrier after every surface:
+    #pragma omp parallel
+    {
+        #pragma omp single
+        {
+            int offset_row = 0;
+            
+            vector<shared_ptr<Body::SurfaceData> >::const_iterator si_row;
+            for (si_row = non_wake_surfaces.begin(); si_row != non_wake_surfaces.end(); si_row++) {
+                shared_ptr<Body::SurfaceData> d_row = *si_row;
+                
+                for (int first = 0; first < d_row->surface->n_panels(); first += TASK_PANEL_CHUNK_SIZE) {
+                    #pragma omp task firstprivate(d_row, offset_row, first)
+                    {
+                        int last = min(first + TASK_PANEL_CHUNK_SIZE, d_row->surface->n_panels());
+                        for (int i = first; i < last; i++) {
+                            for (int k = 0; k < (int) wake_panels.size(); k++)
+                                wake_influence_coefficients(offset_row + i, k) = wake_panel_surfaces[k]->wake->doublet_influence(d_row->surface, i, wake_panels[k]);
+                                
+                            // Images of the new wake panels:
+                            for (int l = 0; l < (int) images.size(); l++) {
+                                Vector3d x = images[l] * d_row->surface->panel_collocation_point(i, true);
+                                
+                                for (int k = 0; k < (int) wake_panels.size(); k++)
+                                    wake_influence_coefficients(offset_row + i, k) += wake_panel_surfaces[k]->wake->doublet_influence(x, wake_panels[k]);
+                            }
+                        }
+                    }
+                }
+                
+                offset_row = offset_row + d_row->surface->n_panels();
+            }
+        }
+    }
+    
+    profiler->increment("influence_coefficient_evaluations", (1.0 + images.size()) * n_non_wake_panels * wake_panels.size());
+}
+
+/**
+   Computes the velocity induced by the old wake panels, i.e., those wake panels which already have a doublet strength
+   assigned to them, and by the wake vortex particles, on the (below-surface) collocation points of all non-wake
+   panels.  The images of the wakes are included, see image_transformations().
+*/
+void
+Solver::compute_wake_induced_velocities()
+{
+    VORTEXJE_LOG(logger, Logger::Info, "Solver: Computing wake-induced velocities.");
+    
+    // Collocation points of the rows owned by this process.  The images of the wakes are evaluated on the
+    // transformed collocation points, in the same pass:
+    vector<Matrix3d> images = image_transformations();
+    
+    int n_rows = row_end - row_begin;
+    
+    Matrix3Xd collocation_points(3, (1 + images.size()) * n_rows);
+    
+    int offset = 0;
+    
+    vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
+    for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+        const shared_ptr<Body::SurfaceData> &d = *si;
+        
+        for (int i = 0; i < d->surface->n_panels(); i++) {
+            // In distributed mode, only the rows owned by this process are computed:
+            if (offset + i < row_begin || offset + i >= row_end)
+                continue;
+                
+            collocation_points.col(offset + i - row_begin) = d->surface->panel_collocation_point(i, true);
+        }
+            
+        offset += d->surface->n_panels();
+    }
+    
+    for (int k = 0; k < (int) images.size(); k++)
+        collocation_points.middleCols((1 + k) * n_rows, n_rows) = images[k] * collocation_points.leftCols(n_rows);
+    
+    Matrix3Xd velocities;
+    compute_wake_induced_velocities(collocation_points, velocities);
+    
+    for (int k = 0; k < (int) images.size(); k++)
+        velocities.leftCols(n_rows) += images[k].transpose() * velocities.middleCols((1 + k) * n_rows, n_rows);
+        
+    wake_induced_velocities.setZero(n_non_wake_panels, 3);
+    wake_induced_velocities.middleRows(row_begin, n_rows) = velocities.leftCols(n_rows).transpose();
+    
+    if (Distributed::size() > 1) {
+        Matrix3Xd velocities = wake_induced_velocities.transpose();
+        
+        Distributed::allgather(velocities, row_begin, row_end);
+        
+        wake_induced_velocities = velocities.transpose();
+    }
+}
+
+/**
+   Computes the velocity induced by the old wake panels, and by the wake vortex particles, at a set of points.
+   
+   @param[in]   x            Points at which the velocity is evaluated, one per column.
+   @param[out]  velocities   Wake-induced velocities, one per column.
+*/
+void
+Solver::compute_wake_induced_velocities(const Matrix3Xd &x, Matrix3Xd &velocities) const
+{
+    int n_points = x.cols();
+    
+    // Use the accelerator backend for the old wake panels, if requested:
+    if (parameters.use_accelerator) {
+        VectorXd accelerator_doublet_coefficients, accelerator_source_coefficients;
+        shared_ptr<Accelerator> accelerator = build_accelerator(false, false, accelerator_doublet_coefficients, accelerator_source_coefficients);
+        
+        accelerator->velocities(x, accelerator_doublet_coefficients, accelerator_source_coefficients, velocities);
+        
+    } else
+        velocities.setZero(3, n_points);
+    
+    // Vortex particles of the far wakes.  Use a treecode, if requested:
+    shared_ptr<Treecode> particle_treecode;
+    if (parameters.treecode_opening_angle > 0) {
+        particle_treecode = shared_ptr<Treecode>(new Treecode(parameters.treecode_opening_angle));
+        
+        vector<shared_ptr<BodyData> >::const_iterator bdi;
+        for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+            const shared_ptr<BodyData> &bd = *bdi;
+            
+            vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
+            for (lsi = bd->body->lifting_surfaces.begin(); lsi != bd->body->lifting_surfaces.end(); lsi++) {
+                const shared_ptr<Body::LiftingSurfaceData> &d = *lsi;
+                
+                for (int k = 0; k < d->wake->n_particles(); k++)
+                    particle_treecode->add_particle(d->wake, k);
+            }
+        }
+        
+        particle_treecode->build();
+    }
+    
+    int i;
+    
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(dynamic, 1)
+        for (i = 0; i < n_points; i++) {
+            Vector3d velocity(0, 0, 0);
+            
+            vector<shared_ptr<BodyData> >::const_iterator bdi;
+            for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+                const shared_ptr<BodyData> &bd = *bdi;
+                
+                vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
+                for (lsi = bd->body->lifting_surfaces.begin(); lsi != bd->body->lifting_surfaces.end(); lsi++) {
+                    const shared_ptr<Body::LiftingSurfaceData> &d = *lsi;
+                    
+                    // Use doublet panel - vortex ring equivalence.  Wakes handled by the accelerator are skipped.
+                    if (!parameters.use_accelerator || typeid(*d->wake.get()) != typeid(Wake)) {
+                        for (int k = 0; k < d->wake->n_panels() - d->lifting_surface->n_spanwise_panels(); k++)
+                            velocity += d->wake->vortex_ring_unit_velocity(x.col(i), k) * d->wake->doublet_coefficients[k];
+                    }
+                        
+                    if (!particle_treecode) {
+                        for (int k = 0; k < d->wake->n_particles(); k++)
+                            velocity += d->wake->particle_velocity(x.col(i), k);
+                    }
+                }
+            }
+            
+            if (particle_treecode)
+                velocity += particle_treecode->velocity(x.col(i));
+            
+            velocities.col(i) += velocity;
+        }
+    }
+}
+
+/**
+   Computes the LU factorization of the matrix of doublet influence coefficients, unless it is still valid.
+*/
+void
+Solver::factorize_doublet_influence_coefficients()
+{
+    if (!doublet_influence_coefficients_factorized) {
+        VORTEXJE_LOG(logger, Logger::Info, "Solver: Computing LU factorization of doublet influence coefficient matrix.");
+        
+        doublet_influence_coefficients_lu.compute(doublet_influence_coefficients);
+        
+        doublet_influence_coefficients_factorized = true;
+        
+    } else
+        VORTEXJE_LOG(logger, Logger::Info, "Solver: Reusing LU factorization of doublet influence coefficient matrix.");
+}
+
+/**
+   Computes the LU factorizations of the diagonal blocks of the block-Jacobi preconditioner, unless they are still
+   valid.  The blocks follow the surface boundaries, and surfaces with more than linear_solver_block_size panels are
+   split into consecutive ranges of panels.
+   
+   @param[in]   A   Assembled doublet system matrix.
+*/
+void
+Solver::compute_preconditioner(const MatrixXd &A)
+{
+    if (preconditioner_valid && preconditioner_block_size == parameters.linear_solver_block_size &&
+        preconditioner_offsets.size() > 0 && preconditioner_offsets.back() == A.rows()) {
+        VORTEXJE_LOG(logger, Logger::Info, "Solver: Reusing block-Jacobi preconditioner.");
+        
+        return;
+    }
+    
+    VORTEXJE_LOG(logger, Logger::Info, "Solver: Computing block-Jacobi preconditioner.");
+    
+    preconditioner_offsets.clear();
+    preconditioner_offsets.push_back(0);
+    
+    int offset = 0;
+    
+    vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
+    for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+        const shared_ptr<Body::SurfaceData> &d = *si;
+        
+        int n_blocks = (d->surface->n_panels() + parameters.linear_solver_block_size - 1) / parameters.linear_solver_block_size;
+        
+        // Split evenly, rather than leaving a small remainder block:
+        for (int i = 1; i <= n_blocks; i++)
+            preconditioner_offsets.push_back(offset + (int) ((long) i * d->surface->n_panels() / n_blocks));
+            
+        offset += d->surface->n_panels();
+    }
+    
+    int n_blocks = preconditioner_offsets.size() - 1;
+    
+    preconditioner_blocks.resize(n_blocks);
+    
+    int i;
+    
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(dynamic, 1)
+        for (i = 0; i < n_blocks; i++) {
+            int n = preconditioner_offsets[i + 1] - preconditioner_offsets[i];
+            
+            preconditioner_blocks[i].compute(A.block(preconditioner_offsets[i], preconditioner_offsets[i], n, n));
+        }
+    }
+    
+    preconditioner_valid      = true;
+    preconditioner_block_size = parameters.linear_solver_block_size;
+    preconditioner_iterations = -1;
+}
+
+/**
+   Computes the initial guess for the iterative solution of the doublet system.  This is the combination of the most
+   recent doublet distributions, and the given fallback guess, with the smallest residual.
+   
+   @param[in]   A          Assembled doublet system matrix.
+   @param[in]   b          Right-hand side.
+   @param[in]   fallback   Initial guess to use if no recycled doublet distributions are available.
+   
+   @returns Initial guess.
+*/
+VectorXd
+Solver::compute_recycled_guess(const MatrixXd &A, const VectorXd &b, const VectorXd &fallback) const
+{
+    if (parameters.linear_solver_recycled_solutions <= 0)
+        return fallback;
+        
+    vector<VectorXd> basis;
+    
+    vector<VectorXd>::const_iterator it;
+    for (it = recycled_solutions.begin(); it != recycled_solutions.end(); it++) {
+        if (it->size() == b.size())
+            basis.push_back(*it);
+    }
+    
+    // The fallback guess is usually the most recent solution itself:
+    if (fallback.size() == b.size() && (basis.size() == 0 || basis.back() != fallback))
+        basis.push_back(fallback);
+        
+    if (basis.size() == 0)
+        return fallback;
+        
+    MatrixXd X(b.size(), basis.size());
+    for (int i = 0; i < (int) basis.size(); i++)
+        X.col(i) = basis[i];
+    
+    // Minimize the residual over the span of the basis.  The column-pivoting QR decomposition handles the nearly
+    // linearly dependent solutions of successive time steps:
+    MatrixXd AX = A * X;
+    
+    ColPivHouseholderQR<MatrixXd> qr(AX);
+    qr.setThreshold(1e-12);
+    
+    VectorXd c = qr.solve(b);
+    if (!c.allFinite())
+        return fallback;
+        
+    return X * c;
+}
+
+/**
+   Returns whether the dense matrices of influence coefficients are stored in single precision.
+   
+   @returns true if the single precision representation is in use.
+*/
+bool
+Solver::use_single_precision() const
+{
+    return (parameters.single_precision_influence_coefficients && !parameters.direct_linear_solver &&
+            parameters.hierarchical_matrix_tolerance <= 0 && Distributed::size() == 1);
+}
+
+/**
+   Computes the right-hand side of the doublet system, S sigma, for the current source distribution, without storing
+   the matrix of source influence coefficients.  Only the rows owned by this process are computed.
+   
+   @param[out]  b   Rows row_begin to row_end of S sigma.
+*/
+void
+Solver::compute_source_influence(VectorXd &b) const
+{
+    b = VectorXd::Zero(row_end - row_begin);
+    
+    vector<Matrix3d> images = image_transformations();
+    
+    int offset_row = 0;
+    
+    vector<shared_ptr<Body::SurfaceData> >::const_iterator si_row;
+    for (si_row = non_wake_surfaces.begin(); si_row != non_wake_surfaces.end(); si_row++) {
+        const shared_ptr<Body::SurfaceData> &d_row = *si_row;
+        
+        // Rows of the row surface owned by this process:
+        int first_row = max(offset_row, row_begin);
+        int last_row  = min(offset_row + d_row->surface->n_panels(), row_end);
+        
+        int first_row_panel = first_row - offset_row;
+        
+        offset_row += d_row->surface->n_panels();
+        
+        if (first_row >= last_row)
+            continue;
+            
+        int n_rows = last_row - first_row;
+        
+        profiler->increment("influence_coefficient_evaluations", (1.0 + images.size()) * n_rows * n_non_wake_panels);
+        
+        // The rows are split into tiles, each of which sums all columns in order, so that the result does not depend
+        // on the number of threads or on the scheduling:
+        int n_tiles = (n_rows + POINT_TILE_SIZE - 1) / POINT_TILE_SIZE;
+        int t;
+        
+        #pragma omp parallel
+        {
+            #pragma omp for schedule(dynamic, 1)
+            for (t = 0; t < n_tiles; t++) {
+                int first_tile_row = t * POINT_TILE_SIZE;
+                int n_tile_rows    = min(POINT_TILE_SIZE, n_rows - first_tile_row);
+                
+                Matrix3Xd collocation_points(3, n_tile_rows);
+                for (int i = 0; i < n_tile_rows; i++)
+                    collocation_points.col(i) = d_row->surface->panel_collocation_point(first_row_panel + first_tile_row + i, true);
+                    
+                vector<Matrix3Xd> image_collocation_points;
+                for (int k = 0; k < (int) images.size(); k++)
+                    image_collocation_points.push_back(images[k] * collocation_points);
+                    
+                VectorXd column_source_influence(n_tile_rows), column_doublet_influence(n_tile_rows);
+                
+                VectorXd tile_b = VectorXd::Zero(n_tile_rows);
+                
+                int offset_col = 0;
+                
+                vector<shared_ptr<Body::SurfaceData> >::const_iterator si_col;
+                for (si_col = non_wake_surfaces.begin(); si_col != non_wake_surfaces.end(); si_col++) {
+                    const shared_ptr<Body::SurfaceData> &d_col = *si_col;
+                    
+                    for (int j = 0; j < d_col->surface->n_panels(); j++) {
+                        d_col->surface->source_and_doublet_influence(collocation_points, j, column_source_influence, column_doublet_influence);
+                        
+                        tile_b += column_source_influence * source_coefficients(offset_col + j);
+                        
+                        for (int k = 0; k < (int) images.size(); k++) {
+                            d_col->surface->source_and_doublet_influence(image_collocation_points[k], j, column_source_influence, column_doublet_influence);
+                            
+                            tile_b += column_source_influence * source_coefficients(offset_col + j);
+                        }
+                    }
+                    
+                    offset_col += d_col->surface->n_panels();
+                }
+                
+                b.segment(first_row - row_begin + first_tile_row, n_tile_rows) = tile_b;
+            }
+        }
+    }
+}
+
+/**
+   Computes the residual of the doublet system, r = S sigma - (D + W V^T) mu, for the current source and doublet
+   distributions.  The products with S and D are evaluated in double precision without storing the matrices, by
+   re-evaluating the influence kernels.
+   
+   @param[in]   wake_influence_coefficients   Influence coefficients of the new wake panels, W.
+   @param[in]   upper_indices                 Upper trailing edge panel of every new wake panel.
+   @param[in]   lower_indices                 Lower trailing edge panel of every new wake panel.
+   @param[out]  residual                      Residual.
+   @param[out]  rhs_norm                      Norm of the right-hand side, S sigma.
+*/
+void
+Solver::compute_doublet_system_residual(const MatrixXd &wake_influence_coefficients, const vector<int> &upper_indices, const vector<int> &lower_indices,
+                                        VectorXd &residual, double &rhs_norm) const
+{
+    VectorXd rhs = VectorXd::Zero(n_non_wake_panels);
+    VectorXd lhs = VectorXd::Zero(n_non_wake_panels);
+    
+    vector<Matrix3d> images = image_transformations();
+    
+    profiler->increment("influence_coefficient_evaluations", (1.0 + images.size()) * n_non_wake_panels * n_non_wake_panels);
+    
+    int offset_row = 0;
+    
+    vector<shared_ptr<Body::SurfaceData> >::const_iterator si_row;
+    for (si_row = non_wake_surfaces.begin(); si_row != non_wake_surfaces.end(); si_row++) {
+        const shared_ptr<Body::SurfaceData> &d_row = *si_row;
+        
+        int n_rows = d_row->surface->n_panels();
+        
+        // The rows are split into tiles, each of which sums all columns in order, so that the residual does not depend
+        // on the number of threads or on the scheduling:
+        int n_tiles = (n_rows + POINT_TILE_SIZE - 1) / POINT_TILE_SIZE;
+        int t;
+        
+        #pragma omp parallel
+        {
+            #pragma omp for schedule(dynamic, 1)
+            for (t = 0; t < n_tiles; t++) {
+                int first_tile_row = t * POINT_TILE_SIZE;
+                int n_tile_rows    = min(POINT_TILE_SIZE, n_rows - first_tile_row);
+                
+                Matrix3Xd collocation_points(3, n_tile_rows);
+                for (int i = 0; i < n_tile_rows; i++)
+                    collocation_points.col(i) = d_row->surface->panel_collocation_point(first_tile_row + i, true);
+                    
+                vector<Matrix3Xd> image_collocation_points;
+                for (int k = 0; k < (int) images.size(); k++)
+                    image_collocation_points.push_back(images[k] * collocation_points);
+                    
+                VectorXd column_source_influence(n_tile_rows), column_doublet_influence(n_tile_rows);
+                
+                VectorXd tile_rhs = VectorXd::Zero(n_tile_rows);
+                VectorXd tile_lhs = VectorXd::Zero(n_tile_rows);
+                
+                int offset_col = 0;
+                
+                vector<shared_ptr<Body::SurfaceData> >::const_iterator si_col;
+                for (si_col = non_wake_surfaces.begin(); si_col != non_wake_surfaces.end(); si_col++) {
+                    const shared_ptr<Body::SurfaceData> &d_col = *si_col;
+                    
+                    for (int j = 0; j < d_col->surface->n_panels(); j++) {
+                        d_col->surface->source_and_doublet_influence(collocation_points, j, column_source_influence, column_doublet_influence);
+                        
+                        // Doublet panels are evaluated on their own collocation points from the inside:
+                        if (d_row == d_col && j >= first_tile_row && j < first_tile_row + n_tile_rows)
+                            column_doublet_influence(j - first_tile_row) = -0.5;
+                            
+                        tile_rhs += column_source_influence  * source_coefficients(offset_col + j);
+                        tile_lhs += column_doublet_influence * doublet_coefficients(offset_col + j);
+                        
+                        for (int k = 0; k < (int) images.size(); k++) {
+                            d_col->surface->source_and_doublet_influence(image_collocation_points[k], j, column_source_influence, column_doublet_influence);
+                            
+                            tile_rhs += column_source_influence  * source_coefficients(offset_col + j);
+                            tile_lhs += column_doublet_influence * doublet_coefficients(offset_col + j);
+                        }
+                    }
+                    
+                    offset_col += d_col->surface->n_panels();
+                }
+                
+                rhs.segment(offset_row + first_tile_row, n_tile_rows) = tile_rhs;
+                lhs.segment(offset_row + first_tile_row, n_tile_rows) = tile_lhs;
+            }
+        }
+        
+        offset_row += n_rows;
+    }
+    
+    for (int k = 0; k < (int) wake_influence_coefficients.cols(); k++)
+        lhs += wake_influence_coefficients.col(k) * (doublet_coefficients(upper_indices[k]) - doublet_coefficients(lower_indices[k]));
+        
+    residual = rhs - lhs;
+    rhs_norm = rhs.norm();
+}
+
+/**
+   Solves the doublet system in single precision, using the single precision matrices of influence coefficients, and
+   refines the doublet distribution using residuals computed in double precision.  See
+   Parameters::iterative_refinement_steps.
+   
+   @param[in]   A_single                      Doublet system matrix, in single precision.
+   @param[in]   rhs                           Right-hand side.
+   @param[in]   wake_influence_coefficients   Influence coefficients of the new wake panels.
+   @param[in]   upper_indices                 Upper trailing edge panel of every new wake panel.
+   @param[in]   lower_indices                 Lower trailing edge panel of every new wake panel.
+   @param[in]   guess                         Initial guess.
+   
+   @returns true on success.
+*/
+bool
+Solver::solve_single_precision(const MatrixXf &A_single, const VectorXd &rhs, const MatrixXd &wake_influence_coefficients,
+                               const vector<int> &upper_indices, const vector<int> &lower_indices, const VectorXd &guess)
+{
+    // The single precision solves cannot attain tolerances near the double precision machine epsilon.  The
+    // refinement takes care of the remaining digits:
+    SolverParameters single_precision_parameters = parameters;
+    single_precision_parameters.linear_solver_tolerance = max(parameters.linear_solver_tolerance, 1e-5);
+    
+    vector<int> no_block_offsets;
+    vector<PartialPivLU<MatrixXd> > no_blocks;
+    
+    VectorXf b = rhs.cast<float>();
+    
+    VectorXf x;
+    int iterations;
+    double error;
+    bool success;
+    
+    VectorXf single_precision_guess = guess.cast<float>();
+    if (parameters.linear_solver_gmres_restart > 0)
+        success = iterative_solve<GMRES<MatrixXf, DiagonalPreconditioner<float> > >(A_single, b, single_precision_guess, single_precision_parameters, no_block_offsets, no_blocks,
+                                                                                      x, iterations, error);
+    else
+        success = iterative_solve<BiCGSTAB<MatrixXf, DiagonalPreconditioner<float> > >(A_single, b, single_precision_guess, single_precision_parameters, no_block_offsets, no_blocks,
+                                                                                         x, iterations, error);
+                                                                                         
+    if (!success && (parameters.iterative_refinement_steps == 0 || !x.allFinite())) {
+        VORTEXJE_LOG(logger, Logger::Error, "Solver: Computing doublet distribution failed (" << iterations
+                     << " iterations with estimated error=" << error << ").");
+                     
+        return false;
+    }
+    
+    doublet_coefficients = x.cast<double>();
+    
+    VORTEXJE_LOG(logger, Logger::Info, "Solver: Done computing doublet distribution in single precision in " << iterations << " iterations with estimated error " << error << ".");
+    
+    profiler->increment("linear_solver_iterations", iterations);
+    profiler->set("linear_solver_error", error);
+    
+    // Iterative refinement:
+    for (int step = 0; step < parameters.iterative_refinement_steps; step++) {
+        VectorXd residual;
+        double rhs_norm;
+        compute_doublet_system_residual(wake_influence_coefficients, upper_indices, lower_indices, residual, rhs_norm);
+        
+        double relative_residual = (rhs_norm > 0) ? residual.norm() / rhs_norm : residual.norm();
+        
+        profiler->set("linear_solver_error", relative_residual);
+        
+        if (relative_residual <= parameters.linear_solver_tolerance) {
+            VORTEXJE_LOG(logger, Logger::Info, "Solver: Refined doublet distribution to relative residual " << relative_residual << ".");
+            
+            return true;
+        }
+        
+        VectorXf correction;
+        VectorXf zero = VectorXf::Zero(n_non_wake_panels);
+        VectorXf single_precision_residual = residual.cast<float>();
+        if (parameters.linear_solver_gmres_restart > 0)
+            iterative_solve<GMRES<MatrixXf, DiagonalPreconditioner<float> > >(A_single, single_precision_residual, zero, single_precision_parameters, no_block_offsets, no_blocks,
+                                                                               correction, iterations, error);
+        else
+            iterative_solve<BiCGSTAB<MatrixXf, DiagonalPreconditioner<float> > >(A_single, single_precision_residual, zero, single_precision_parameters, no_block_offsets, no_blocks,
+                                                                                  correction, iterations, error);
+                                                                                  
+        if (!correction.allFinite()) {
+            VORTEXJE_LOG(logger, Logger::Error, "Solver: Iterative refinement of doublet distribution failed.");
+            
+            return false;
+        }
+        
+        doublet_coefficients += correction.cast<double>();
+        
+        VORTEXJE_LOG(logger, Logger::Info, "Solver: Refinement step " << step + 1 << " at relative residual " << relative_residual
+                     << " took " << iterations << " iterations.");
+        
+        profiler->increment("linear_solver_iterations", iterations);
+        profiler->increment("iterative_refinement_steps");
+    }
+    
+    return true;
+}
+
+/**
+   Prepares the correction for the influence of the new wake panels, A = D + W V^T, for use with the LU factorization
+   of D.  By the Sherman-Morrison-Woodbury formula,
+     A^-1 b = D^-1 b - Z (I + V^T Z)^-1 V^T D^-1 b,   with Z = D^-1 W.
+   
+   @param[in]   wake_influence_coefficients   Influence coefficients W of the new wake panels.
+   @param[in]   upper_indices                 Upper trailing edge panel of every new wake panel.
+   @param[in]   lower_indices                 Lower trailing edge panel of every new wake panel.
+   @param[out]  wake_correction               Z = D^-1 W.
+   @param[out]  wake_capacitance_lu           LU factorization of I + V^T Z.
+*/
+void
+Solver::compute_wake_correction(const MatrixXd &wake_influence_coefficients, const vector<int> &upper_indices, const vector<int> &lower_indices,
+                                MatrixXd &wake_correction, PartialPivLU<MatrixXd> &wake_capacitance_lu) const
+{
+    int n_wake_columns = wake_influence_coefficients.cols();
+    
+    wake_correction = doublet_influence_coefficients_lu.solve(wake_influence_coefficients);
+    
+    MatrixXd wake_capacitance = MatrixXd::Identity(n_wake_columns, n_wake_columns);
+    for (int k = 0; k < n_wake_columns; k++)
+        wake_capacitance.row(k) += wake_correction.row(upper_indices[k]) - wake_correction.row(lower_indices[k]);
+        
+    wake_capacitance_lu.compute(wake_capacitance);
+}
+
+/**
+   Applies the correction for the influence of the new wake panels to a solution of the uncorrected system, see
+   compute_wake_correction().
+   
+   @param[in]   y                     Solution D^-1 b of the uncorrected system.
+   @param[in]   upper_indices         Upper trailing edge panel of every new wake panel.
+   @param[in]   lower_indices         Lower trailing edge panel of every new wake panel.
+   @param[in]   wake_correction       Z = D^-1 W.
+   @param[in]   wake_capacitance_lu   LU factorization of I + V^T Z.
+   
+   @returns Solution A^-1 b of the corrected system.
+*/
+VectorXd
+Solver::apply_wake_correction(const VectorXd &y, const vector<int> &upper_indices, const vector<int> &lower_indices,
+                              const MatrixXd &wake_correction, const PartialPivLU<MatrixXd> &wake_capacitance_lu) const
+{
+    int n_wake_columns = wake_correction.cols();
+    
+    VectorXd Vty(n_wake_columns);
+    for (int k = 0; k < n_wake_columns; k++)
+        Vty(k) = y(upper_indices[k]) - y(lower_indices[k]);
+    
+    return y - wake_correction * wake_capacitance_lu.solve(Vty);
+}
+
+/**
+   Computes the source coefficients of all non-wake panels.
+   
+   @param[in]   include_wake_influence   If true, the velocity induced by the existing wake is included.
+*/
+void
+Solver::compute_source_coefficients(bool include_wake_influence)
+{
+    // Blowing velocities of all panels, in a single call per surface.  Inviscid boundary layers do not blow:
+    VectorXd blowing_velocities = VectorXd::Zero(n_non_wake_panels);
+    
+    int offset = 0;
+    
+    vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
+    for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+        const shared_ptr<Body::SurfaceData> &d = *si;
+        
+        const shared_ptr<BoundaryLayer> &boundary_layer = surface_id_to_body[d->surface->id]->boundary_layer;
+        if (!boundary_layer->inviscid())
+            boundary_layer->blowing_velocities(d->surface, blowing_velocities.segment(offset, d->surface->n_panels()));
+            
+        offset += d->surface->n_panels();
+    }
+    
+    // The panels of all surfaces are split into tasks, so that no thread waits at a barrier after every surface:
+    #pragma omp parallel
+    {
+        #pragma omp single
+        {
+            offset = 0;
+            
+            for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+                shared_ptr<Body::SurfaceData> d = *si;
+                shared_ptr<BodyData> bd         = surface_id_to_body[d->surface->id];
+                
+                for (int first = 0; first < d->surface->n_panels(); first += TASK_PANEL_CHUNK_SIZE) {
+                    #pragma omp task firstprivate(d, bd, offset, first)
+                    {
+                        int last = min(first + TASK_PANEL_CHUNK_SIZE, d->surface->n_panels());
+                        for (int i = first; i < last; i++)
+                            source_coefficients(offset + i) = compute_source_coefficient(bd->body, d->surface, i, blowing_velocities(offset + i), include_wake_influence);
+                    }
+                }
+                
+                offset += d->surface->n_panels();
+            }
+        }
+    }
+}
+
+/**
+   Sets the doublet coefficients of the new wake panels, using the trailing-edge Kutta condition.
+*/
+void
+Solver::update_wake_doublet_coefficients()
+{
+    int trailing_edge_index = 0;
+    
+    vector<shared_ptr<BodyData> >::iterator bdi;
+    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+        shared_ptr<BodyData> bd = *bdi;
+        
+        vector<shared_ptr<Body::LiftingSurfaceData> >::iterator lsi;
+        for (lsi = bd->body->lifting_surfaces.begin(); lsi != bd->body->lifting_surfaces.end(); lsi++) {
+            shared_ptr<Body::LiftingSurfaceData> d = *lsi;
+                     
+            // Set panel doublet coefficient:
+            for (int i = 0; i < d->lifting_surface->n_spanwise_panels(); i++) {
+                double doublet_coefficient_top    = doublet_coefficients(trailing_edge_upper_indices[trailing_edge_index]);
+                double doublet_coefficient_bottom = doublet_coefficients(trailing_edge_lower_indices[trailing_edge_index]);
+                
+                // Use the trailing-edge Kutta condition to compute the doublet coefficients of the new wake panels.
+                double doublet_coefficient = doublet_coefficient_top - doublet_coefficient_bottom;
+                
+                int idx = d->wake->n_panels() - d->lifting_surface->n_spanwise_panels() + i;
+                d->wake->doublet_coefficients[idx] = doublet_coefficient;
+                
+                trailing_edge_index++;
+            }
+        }
+    }
+}
+
+/**
+   Computes the surface velocity potentials and pressure coefficients of all non-wake panels, from the surface
+   velocities.
+   
+   @param[in]   dt   Time step size.
+*/
+void
+Solver::compute_pressure_coefficients(double dt)
+{
+    // The time derivatives of the potentials require the current potentials of all panels:
+    bool time_derivatives = (parameters.unsteady_bernoulli && dt > 0.0);
+    
+    // New pressure distribution, new loads:
+    loads_valid.assign(loads_valid.size(), false);
+    
+    int offset = 0;
+
+    vector<shared_ptr<Body::SurfaceData> >::const_iterator si;   
+    for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+        const shared_ptr<Body::SurfaceData> &d = *si;
+        int i;
+        
+        bool required = outputs_required(d->surface);
+        
+        // Velocity potentials:
+        if (required || time_derivatives)
+            compute_surface_velocity_potentials(d->surface);
+        else
+            surface_velocity_potentials_pending[d->surface->id] = true;
+        
+        // Velocity potential time derivatives:
+        #pragma omp parallel
+        {
+            #pragma omp for schedule(dynamic, 1)
+            for (i = 0; i < d->surface->n_panels(); i++)
+                surface_velocity_potential_time_derivatives(offset + i) = compute_surface_velocity_potential_time_derivative(offset, i, dt);
+        }
+        
+        // Pressure coefficients:
+        if (required)
+            compute_pressure_coefficients(d->surface);
+        else
+            pressure_coefficients_pending[d->surface->id] = true;
+        
+        offset += d->surface->n_panels();      
+    }
+}
+
+/**
+   Computes the pressure coefficients of the given surface, from its surface velocities and the time derivatives of
+   its velocity potentials.  The surface velocities are evaluated first, if pending.
+   
+   @param[in]   surface   Reference surface.
+*/
+void
+Solver::compute_pressure_coefficients(const shared_ptr<Surface> &surface) const
+{
+    evaluate_surface_velocities(surface);
+    
+    int offset = surface_id_to_offset[surface->id];
+    int i;
+    
+    const shared_ptr<BodyData> &bd = surface_id_to_body[surface->id];
+    double v_ref_squared = compute_reference_velocity_squared(bd->body);
+        
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(dynamic, 1)
+        for (i = 0; i < surface->n_panels(); i++)
+            pressure_coefficients(offset + i) = compute_pressure_coefficient(surface_velocities.row(offset + i),
+                                                                             surface_velocity_potential_time_derivatives(offset + i), v_ref_squared);
+    }
+    
+    pressure_coefficients_pending[surface->id] = false;
+}
+
+/**
+   Computes the surface velocity potentials of the given surface.
+   
+   @param[in]   surface   Reference surface.
+*/
+void
+Solver::compute_surface_velocity_potentials(const shared_ptr<Surface> &surface) const
+{
+    int offset = surface_id_to_offset[surface->id];
+    int i;
+    
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(dynamic, 1)
+        for (i = 0; i < surface->n_panels(); i++)
+            surface_velocity_potentials(offset + i) = compute_surface_velocity_potential(surface, offset, i);
+    }
+    
+    surface_velocity_potentials_pending[surface->id] = false;
+}
+
+/**
+   Returns whether the outputs of the given surface are evaluated by solve().  See require_outputs().
+   
+   @param[in]   surface   Reference surface.
+   
+   @returns true if the outputs of the surface are required.
+*/
+bool
+Solver::outputs_required(const shared_ptr<Surface> &surface) const
+{
+    if (all_outputs_required)
+        return true;
+        
+    return surface->id < (int) required_outputs.size() && required_outputs[surface->id];
+}
+
+/**
+   Evaluates the surface velocities of the body owning the given surface, if they are pending.
+   
+   @param[in]   surface   Reference surface.
+*/
+void
+Solver::evaluate_surface_velocities(const shared_ptr<Surface> &surface) const
+{
+    if (surface->id < (int) surface_velocities_pending.size() && surface_velocities_pending[surface->id]) {
+        Profiler::Timer timer(profiler, "surface_velocities");
+        
+        bool swap_source_coefficients = (parameters.marcov_surface_velocity && parameters.convect_wake);
+        if (swap_source_coefficients)
+            source_coefficients.swap(pending_surface_velocity_source_coefficients);
+            
+        compute_surface_velocities(surface_id_to_body[surface->id]);
+        
+        if (swap_source_coefficients)
+            source_coefficients.swap(pending_surface_velocity_source_coefficients);
+    }
+}
+
+/**
+   Evaluates the surface velocity potentials of the given surface, if they are pending.
+   
+   @param[in]   surface   Reference surface.
+*/
+void
+Solver::evaluate_surface_velocity_potentials(const shared_ptr<Surface> &surface) const
+{
+    if (surface->id < (int) surface_velocity_potentials_pending.size() && surface_velocity_potentials_pending[surface->id]) {
+        Profiler::Timer timer(profiler, "pressures");
+        
+        compute_surface_velocity_potentials(surface);
+    }
+}
+
+/**
+   Evaluates the pressure coefficients of the given surface, if they are pending.
+   
+   @param[in]   surface   Reference surface.
+*/
+void
+Solver::evaluate_pressure_coefficients(const shared_ptr<Surface> &surface) const
+{
+    if (surface->id < (int) pressure_coefficients_pending.size() && pressure_coefficients_pending[surface->id]) {
+        Profiler::Timer timer(profiler, "pressures");
+        
+        compute_pressure_coefficients(surface);
+    }
+}
+
+/**
+   Integrates the loads of the given surface, and of all other surfaces of its body, if they were not integrated since
+   the last solution.
+   
+   @param[in]   surface   Reference surface.
+   
+   @returns true if the surface is a non-wake surface of this solver.
+*/
+bool
+Solver::evaluate_loads(const shared_ptr<Surface> &surface) const
+{
+    if (surface->id >= (int) surface_id_to_offset.size() || surface_id_to_offset[surface->id] < 0)
+        return false;
+        
+    if (!loads_valid[surface->id]) {
+        Profiler::Timer timer(profiler, "loads");
+        
+        compute_loads(surface_id_to_body[surface->id]);
+    }
+    
+    return true;
+}
+
+/**
+   Integrates the forces on all panels of the given body, and the force and moment about the origin of every surface
+   of the body, in a single pass.
+   
+   @param[in]   bd   Body data.
+*/
+void
+Solver::compute_loads(const shared_ptr<BodyData> &bd) const
+{
+    const shared_ptr<Body> &body = bd->body;
+    
+    // Dynamic pressure:
+    double q = 0.5 * fluid_density * compute_reference_velocity_squared(body);
+    
+    bool friction = !bd->boundary_layer->inviscid();
+    
+    for (int k = 0; k < body->n_surfaces(); k++) {
+        const shared_ptr<Surface> &surface = body->surface(k);
+        
+        evaluate_pressure_coefficients(surface);
+        
+        int offset = surface_id_to_offset[surface->id];
+        int i;
+        
+        // Friction forces of all panels of the surface, in a single call:
+        Matrix3Xd friction_forces;
+        if (friction) {
+            friction_forces.resize(3, surface->n_panels());
+            
+            bd->boundary_layer->friction_forces(surface, friction_forces);
+        }
+        
+        #pragma omp parallel
+        {
+            #pragma omp for schedule(dynamic, 1)
+            for (i = 0; i < surface->n_panels(); i++) {
+                Vector3d panel_force = q * surface->panel_surface_area(i) * pressure_coefficients(offset + i) * surface->panel_normal(i);
+                
+                if (friction)
+                    panel_force += friction_forces.col(i);
+                
+                panel_forces.col(offset + i) = panel_force;
+            }
+        }
+        
+        // Sum the panel loads serially, in panel order, so that the loads do not depend on the number of threads or on
+        // the scheduling:
+        Vector3d F(0, 0, 0), M(0, 0, 0);
+        
+        for (i = 0; i < surface->n_panels(); i++) {
+            const Vector3d &panel_force = panel_forces.col(offset + i);
+            
+            F += panel_force;
+            M += surface->panel_collocation_point(i, false).cross(panel_force);
+        }
+        
+        surface_forces[surface->id]  = F;
+        surface_moments[surface->id] = M;
+        
+        loads_valid[surface->id] = true;
+    }
+}
+
+/**
+   Computes the sensitivities of a load component on the given body, see force_sensitivities().
+   
+   @param[in]   body            Reference body.
+   @param[in]   weight          Direction of the force component, or axis of the moment component.
+   @param[in]   moment          true for a moment component, false for a force component.
+   @param[in]   x               Reference point of the moment.
+   @param[out]  sensitivities   Sensitivities of the load component.
+   
+   @returns true on success.
+*/
+bool
+Solver::compute_sensitivities(const shared_ptr<Body> &body, const Vector3d &weight, bool moment, const Vector3d &x, Sensitivities &sensitivities)
+{
+    shared_ptr<BodyData> bd;
+    
+    bool dummy_boundary_layers = true;
+    
+    vector<shared_ptr<BodyData> >::const_iterator bdi;
+    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+        if ((*bdi)->body == body)
+            bd = *bdi;
+            
+        if (!(*bdi)->boundary_layer->inviscid())
+            dummy_boundary_layers = false;
+    }
+    
+    if (!bd || body->n_surfaces() == 0) {
+        VORTEXJE_LOG(logger, Logger::Error, "Solver: Body " << body->id << " not found.");
+        
+        return false;
+    }
+    
+    if (parameters.convect_wake || parameters.marcov_surface_velocity || !dummy_boundary_layers) {
+        VORTEXJE_LOG(logger, Logger::Error, "Solver: Sensitivities require a static wake, gradient-based surface velocities, and dummy boundary layers.");
+        
+        return false;
+    }
+    
+    if (compressed_doublet_influence_coefficients || compressed_source_influence_coefficients || use_single_precision() ||
+        !parameters.store_source_influence_coefficients || Distributed::size() > 1) {
+        VORTEXJE_LOG(logger, Logger::Error, "Solver: Sensitivities require dense, double precision matrices of influence coefficients on a single process.");
+        
+        return false;
+    }
+    
+    if (doublet_influence_coefficients.rows() != n_non_wake_panels || source_influence_coefficients.rows() != n_non_wake_panels) {
+        VORTEXJE_LOG(logger, Logger::Error, "Solver: Sensitivities require a preceding solve.");
+        
+        return false;
+    }
+    
+    if (last_solve_dt != 0.0) {
+        VORTEXJE_LOG(logger, Logger::Error, "Solver: Sensitivities require a preceding steady solve, with a time step of zero.");
+        
+        return false;
+    }
+    
+    VORTEXJE_LOG(logger, Logger::Info, "Solver: Computing sensitivities for body " << body->id << ".");
+    
+    Profiler::Timer timer(profiler, "sensitivities");
+    
+    for (int i = 0; i < body->n_surfaces(); i++)
+        evaluate_surface_velocities(body->surface(i));
+        
+    sensitivities.value = weight.dot(moment ? this->moment(body, x) : force(body));
+    
+    int body_offset = surface_id_to_offset[body->surface(0)->id];
+    
+    Matrix3d rotation;
+    if (!gradient_operator_valid(bd, rotation)) {
+        compute_gradient_operator(bd);
+        
+        rotation = Matrix3d::Identity();
+    }
+    
+    int n_body_panels = bd->gradient_operator.cols();
+    
+    // Derivatives of the load component with respect to the apparent velocity of every panel of the body, and with
+    // respect to the square of the reference velocity.  The load on a panel is 0.5 rho A (v_ref^2 - |v|^2) times the
+    // weighted normal component, and the surface velocity v is the tangential part of the disturbance velocity minus
+    // the apparent velocity:
+    Matrix3Xd apparent_velocity_derivatives(3, n_body_panels);
+    
+    double v_ref_squared_derivative = 0.0;
+    
+    for (int i = 0, k = 0; i < body->n_surfaces(); i++) {
+        const shared_ptr<Surface> &surface = body->surface(i);
+        
+        for (int j = 0; j < surface->n_panels(); j++, k++) {
+            Vector3d panel_weight = weight;
+            if (moment)
+                panel_weight = weight.cross(surface->panel_collocation_point(j, false) - x);
+                
+            double c = fluid_density * surface->panel_surface_area(j) * panel_weight.dot(surface->panel_normal(j));
+            
+            apparent_velocity_derivatives.col(k) = c * surface_velocities.row(body_offset + k).transpose();
+            
+            v_ref_squared_derivative += 0.5 * c;
+        }
+    }
+    
+    // The disturbance velocities are minus the doublet gradients, so that the derivatives with respect to the
+    // doublet coefficients follow from the transposed gradient operator:
+    VectorXd adjoint_rhs = VectorXd::Zero(n_non_wake_panels);
+    
+    Matrix3Xd rotated_derivatives = rotation.transpose() * apparent_velocity_derivatives;
+    
+    adjoint_rhs.segment(body_offset, n_body_panels) = bd->gradient_operator.transpose() * Map<VectorXd>(rotated_derivatives.data(), 3 * n_body_panels);
+    
+    // Solve the adjoint system A^T lambda = dJ/dmu, with A = D + W V^T as in solve():
+    MatrixXd wake_influence_coefficients;
+    vector<int> wake_upper_indices, wake_lower_indices;
+    
+    compute_wake_influence_coefficients(wake_influence_coefficients, wake_upper_indices, wake_lower_indices);
+    
+    int n_wake_columns = wake_influence_coefficients.cols();
+    
+    VectorXd adjoint;
+    
+    if (parameters.direct_linear_solver && doublet_influence_coefficients_factorized) {
+        // Reuse the factorization of D.  By the Sherman-Morrison-Woodbury formula,
+        //   A^-T g = D^-T g - Y (I + W^T Y)^-1 W^T D^-T g,   with Y = D^-T V.
+        adjoint = doublet_influence_coefficients_lu.transpose().solve(adjoint_rhs);
+        
+        if (n_wake_columns > 0) {
+            MatrixXd V = MatrixXd::Zero(n_non_wake_panels, n_wake_columns);
+            for (int k = 0; k < n_wake_columns; k++) {
+                V(wake_upper_indices[k], k) += 1.0;
+                V(wake_lower_indices[k], k) -= 1.0;
+            }
+            
+            MatrixXd Y = doublet_influence_coefficients_lu.transpose().solve(V);
+            
+            MatrixXd capacitance = MatrixXd::Identity(n_wake_columns, n_wake_columns) + wake_influence_coefficients.transpose() * Y;
+            
+            adjoint -= Y * capacitance.partialPivLu().solve(wake_influence_coefficients.transpose() * adjoint);
+        }
+        
+    } else {
+        MatrixXd At = doublet_influence_coefficients.transpose();
+        
+        for (int k = 0; k < n_wake_columns; k++) {
+            At.row(wake_upper_indices[k]) += wake_influence_coefficients.col(k).transpose();
+            At.row(wake_lower_indices[k]) -= wake_influence_coefficients.col(k).transpose();
+        }
+        
+        BiCGSTAB<MatrixXd, DiagonalPreconditioner<double> > solver(At);
+        solver.setMaxIterations(parameters.linear_solver_max_iterations);
+        solver.setTolerance(parameters.linear_solver_tolerance);
+        
+        adjoint = solver.solve(adjoint_rhs);
+        
+        if (solver.info() != Success) {
+            VORTEXJE_LOG(logger, Logger::Error, "Solver: Computing adjoint distribution failed (" << solver.iterations()
+                         << " iterations with estimated error=" << solver.error() << ").");
+            
+            return false;
+        }
+        
+        profiler->increment("linear_solver_iterations", solver.iterations());
+    }
+    
+    if (!adjoint.allFinite()) {
+        VORTEXJE_LOG(logger, Logger::Error, "Solver: Computing adjoint distribution failed (singular matrix).");
+        
+        return false;
+    }
+    
+    // Derivatives with respect to the kinematics.  The source coefficients are the normal components of the apparent
+    // velocities, and enter the residual of the doublet system as -S sigma:
+    VectorXd source_adjoint = source_influence_coefficients.transpose() * adjoint;
+    
+    sensitivities.velocity            = Vector3d(0, 0, 0);
+    sensitivities.rotational_velocity = Vector3d(0, 0, 0);
+    sensitivities.freestream_velocity = Vector3d(0, 0, 0);
+    
+    vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
+    for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+        const shared_ptr<Surface> &surface = (*si)->surface;
+        
+        int offset = surface_id_to_offset[surface->id];
+        
+        bool on_body = (surface_id_to_body[surface->id] == bd);
+        
+        for (int j = 0; j < surface->n_panels(); j++) {
+            Vector3d derivative = source_adjoint(offset + j) * surface->panel_normal(j);
+            if (on_body)
+                derivative += apparent_velocity_derivatives.col(offset - body_offset + j);
+                
+            sensitivities.freestream_velocity -= derivative;
+            
+            if (on_body) {
+                Vector3d r = surface->panel_collocation_point(j, false) - body->position;
+                
+                sensitivities.velocity            += derivative;
+                sensitivities.rotational_velocity += r.cross(derivative);
+            }
+        }
+    }
+    
+    Vector3d v_ref = body->velocity - freestream_velocity;
+    
+    sensitivities.velocity            += 2.0 * v_ref_squared_derivative * v_ref;
+    sensitivities.freestream_velocity -= 2.0 * v_ref_squared_derivative * v_ref;
+    
+    // Derivatives with respect to the node positions.  Only the geometry of the panels adjacent to a node depends on
+    // its position, and with it only their rows and columns of the doublet system.  The residual of the doublet
+    // system, weighted by the adjoint, is therefore differentiated by re-evaluating these rows and columns alone:
+    vector<Matrix3d> images = image_transformations();
+    
+    Matrix3Xd collocation_points(3, n_non_wake_panels);
+    for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+        const shared_ptr<Surface> &surface = (*si)->surface;
+        
+        int offset = surface_id_to_offset[surface->id];
+        
+        for (int j = 0; j < surface->n_panels(); j++)
+            collocation_points.col(offset + j) = surface->panel_collocation_point(j, true);
+    }
+    
+    vector<Matrix3Xd> image_collocation_points;
+    for (int l = 0; l < (int) images.size(); l++)
+        image_collocation_points.push_back(images[l] * collocation_points);
+        
+    // New wake panels, in the order of the columns of the wake influence coefficients, and their doublet coefficients
+    // as given by the Kutta condition:
+    vector<shared_ptr<Surface> > wakes;
+    vector<int> wake_panels;
+    
+    vector<int> wake_column_offsets(surface_id_to_offset.size(), -1);
+    
+    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+        vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
+        for (lsi = (*bdi)->body->lifting_surfaces.begin(); lsi != (*bdi)->body->lifting_surfaces.end(); lsi++) {
+            const shared_ptr<Body::LiftingSurfaceData> &d = *lsi;
+            
+            wake_column_offsets[d->surface->id] = wakes.size();
+            
+            int wake_panel_offset = d->wake->n_panels() - d->lifting_surface->n_spanwise_panels();
+            for (int j = 0; j < d->lifting_surface->n_spanwise_panels(); j++) {
+                wakes.push_back(d->wake);
+                wake_panels.push_back(wake_panel_offset + j);
+            }
+        }
+    }
+    
+    VectorXd wake_doublet_coefficients(n_wake_columns);
+    for (int k = 0; k < n_wake_columns; k++)
+        wake_doublet_coefficients(k) = doublet_coefficients(wake_upper_indices[k]) - doublet_coefficients(wake_lower_indices[k]);
+        
+    // The adjoint with the entries of the rows being re-evaluated set to zero, so that the entries in the columns of
+    // the perturbed panels are not counted twice:
+    VectorXd masked_adjoint = adjoint;
+    
+    sensitivities.surfaces.clear();
+    sensitivities.node_gradients.clear();
+    
+    for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+        const shared_ptr<Surface> &surface = (*si)->surface;
+        
+        int offset = surface_id_to_offset[surface->id];
+        
+        // Index of the surface within the reference body, if it belongs to it:
+        int body_surface_index = -1;
+        for (int i = 0; i < body->n_surfaces(); i++) {
+            if (body->surface(i) == surface)
+                body_surface_index = i;
+        }
+        
+        // Trailing edge nodes, by node number:
+        shared_ptr<Body::LiftingSurfaceData> lifting_surface_data;
+        
+        const shared_ptr<Body> &surface_body = surface_id_to_body[surface->id]->body;
+        
+        vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
+        for (lsi = surface_body->lifting_surfaces.begin(); lsi != surface_body->lifting_surfaces.end(); lsi++) {
+            if ((*lsi)->surface == surface)
+                lifting_surface_data = *lsi;
+        }
+        
+        vector<int> trailing_edge_indices(surface->n_nodes(), -1);
+        if (lifting_surface_data) {
+            for (int m = 0; m < lifting_surface_data->lifting_surface->n_spanwise_nodes(); m++)
+                trailing_edge_indices[lifting_surface_data->lifting_surface->trailing_edge_node(m)] = m;
+        }
+        
+        // The nodes are displaced on private copies of the surface and of its wake, so that the shared geometry is
+        // left untouched for other solvers that may be reading it concurrently:
+        shared_ptr<Surface> perturbed_surface(new Surface(*surface));
+        
+        shared_ptr<Surface> perturbed_wake;
+        
+        vector<shared_ptr<Surface> > perturbed_wakes = wakes;
+        if (lifting_surface_data) {
+            perturbed_wake = shared_ptr<Surface>(new Surface(*lifting_surface_data->wake));
+            
+            for (int l = 0; l < lifting_surface_data->lifting_surface->n_spanwise_panels(); l++)
+                perturbed_wakes[wake_column_offsets[surface->id] + l] = perturbed_wake;
+        }
+        
+        Matrix3Xd node_gradients = Matrix3Xd::Zero(3, surface->n_nodes());
+        
+        for (int k = 0; k < surface->n_nodes(); k++) {
+            const vector<int> &panels = *surface->node_panel_neighbors[k];
+            if (panels.empty())
+                continue;
+                
+            // The static wake follows the trailing edge nodes, see Wake::displace_trailing_edge():
+            vector<int> wake_nodes, wake_columns;
+            
+            if (trailing_edge_indices[k] >= 0) {
+                const shared_ptr<LiftingSurface> &lifting_surface = lifting_surface_data->lifting_surface;
+                
+                const shared_ptr<Wake> &wake = lifting_surface_data->wake;
+                
+                int m = trailing_edge_indices[k];
+                
+                for (int l = m; l < wake->n_nodes(); l += lifting_surface->n_spanwise_nodes())
+                    wake_nodes.push_back(l);
+                    
+                for (int l = max(m - 1, 0); l <= min(m, lifting_surface->n_spanwise_panels() - 1); l++)
+                    wake_columns.push_back(wake_column_offsets[surface->id] + l);
+            }
+            
+            // Panels of the reference body whose surface velocity depends on the node, either directly or through the
+            // gradient operator:
+            vector<pair<int, int> > load_panels;
+            if (body_surface_index >= 0) {
+                for (int l = 0; l < (int) panels.size(); l++) {
+                    pair<int, int> panel(body_surface_index, panels[l]);
+                    if (find(load_panels.begin(), load_panels.end(), panel) == load_panels.end())
+                        load_panels.push_back(panel);
+                        
+                    int n_neighbors;
+                    const Body::PanelNeighbor *neighbors = body->panel_neighbors(body_surface_index, panels[l], n_neighbors);
+                    
+                    for (int n = 0; n < n_neighbors; n++) {
+                        pair<int, int> neighbor(neighbors[n].surface, neighbors[n].panel);
+                        if (find(load_panels.begin(), load_panels.end(), neighbor) == load_panels.end())
+                            load_panels.push_back(neighbor);
+                    }
+                }
+            }
+            
+            for (int l = 0; l < (int) panels.size(); l++)
+                masked_adjoint(offset + panels[l]) = 0.0;
+                
+            double h = parameters.sensitivity_perturbation * surface->panel_diameter(panels[0]);
+            
+            Vector3d node = surface->nodes[k];
+            
+            vector<Vector3d, Eigen::aligned_allocator<Vector3d> > original_wake_nodes;
+            for (int l = 0; l < (int) wake_nodes.size(); l++)
+                original_wake_nodes.push_back(lifting_surface_data->wake->nodes[wake_nodes[l]]);
+                
+            for (int c = 0; c < 3; c++) {
+                double values[2];
+                
+                // Displace forward, backward, and back to the original position.  The original geometry of the copies
+                // is thereby restored exactly:
+                for (int step = 0; step < 3; step++) {
+                    Vector3d displacement(0, 0, 0);
+                    if (step == 0)
+                        displacement(c) = h;
+                    else if (step == 1)
+                        displacement(c) = -h;
+                        
+                    perturbed_surface->nodes[k] = node + displacement;
+                    
+                    for (int l = 0; l < (int) panels.size(); l++) {
+                        perturbed_surface->compute_panel_geometry(panels[l]);
+                        
+                        collocation_points.col(offset + panels[l]) = perturbed_surface->panel_collocation_point(panels[l], true);
+                        for (int m = 0; m < (int) images.size(); m++)
+                            image_collocation_points[m].col(offset + panels[l]) = images[m] * collocation_points.col(offset + panels[l]);
+                    }
+                    
+                    for (int l = 0; l < (int) wake_nodes.size(); l++)
+                        perturbed_wake->nodes[wake_nodes[l]] = original_wake_nodes[l] + displacement;
+                        
+                    for (int l = 0; l < (int) wake_columns.size(); l++)
+                        perturbed_wake->compute_panel_geometry(wake_panels[wake_columns[l]]);
+                        
+                    if (step == 2)
+                        break;
+                        
+                    // Load component, minus the weighted residual of the doublet system:
+                    double value = -compute_local_adjoint_residual(adjoint, masked_adjoint, images, collocation_points, image_collocation_points,
+                                                                   perturbed_surface, panels, perturbed_wakes, wake_panels, wake_doublet_coefficients,
+                                                                   wake_columns);
+                    
+                    if (body_surface_index >= 0)
+                        value += compute_local_load(body, perturbed_surface, load_panels, weight, moment, x);
+                        
+                    values[step] = value;
+                }
+                
+                node_gradients(c, k) = (values[0] - values[1]) / (2.0 * h);
+            }
+            
+            for (int l = 0; l < (int) panels.size(); l++)
+                masked_adjoint(offset + panels[l]) = adjoint(offset + panels[l]);
+        }
+        
+        sensitivities.surfaces.push_back(surface);
+        sensitivities.node_gradients.push_back(node_gradients);
+    }
+    
+    return true;
+}
+
+/**
+   Computes the contribution of the given panel to a load component, see force_sensitivities().
+   
+   @param[in]   body                   Reference body.
+   @param[in]   surface                Reference surface.
+   @param[in]   panel                  Reference panel.
+   @param[in]   disturbance_velocity   Disturbance part of the surface velocity.
+   @param[in]   weight                 Direction of the force component, or axis of the moment component.
+   @param[in]   moment                 true for a moment component, false for a force component.
+   @param[in]   x                      Reference point of the moment.
+   
+   @returns Contribution to the load component.
+*/
+double
+Solver::compute_load_contribution(const shared_ptr<Body> &body, const shared_ptr<Surface> &surface, int panel, const Vector3d &disturbance_velocity,
+                                  const Vector3d &weight, bool moment, const Vector3d &x) const
+{
+    Vector3d surface_velocity = compute_surface_velocity(body, surface, panel, disturbance_velocity);
+    
+    Vector3d panel_weight = weight;
+    if (moment)
+        panel_weight = weight.cross(surface->panel_collocation_point(panel, false) - x);
+        
+    double pressure = 0.5 * fluid_density * (compute_reference_velocity_squared(body) - surface_velocity.squaredNorm());
+    
+    return pressure * surface->panel_surface_area(panel) * panel_weight.dot(surface->panel_normal(panel));
+}
+
+/**
+   Computes the sum of the contributions of the given panels to a load component, for the current doublet
+   distribution and the current geometry.  The doublet gradients are evaluated from the current geometry, rather than
+   from the stored gradient operator.
+   
+   @param[in]   body                Reference body.
+   @param[in]   perturbed_surface   Private copy of a surface of the body, with perturbed geometry, used in its place.
+   @param[in]   panels              Panels, as pairs of surface index within the body and panel number.
+   @param[in]   weight              Direction of the force component, or axis of the moment component.
+   @param[in]   moment              true for a moment component, false for a force component.
+   @param[in]   x                   Reference point of the moment.
+   
+   @returns Sum of the contributions.
+*/
+double
+Solver::compute_local_load(const shared_ptr<Body> &body, const shared_ptr<Surface> &perturbed_surface, const vector<pair<int, int> > &panels,
+                           const Vector3d &weight, bool moment, const Vector3d &x) const
+{
+    double load = 0.0;
+    
+    for (int l = 0; l < (int) panels.size(); l++) {
+        const shared_ptr<Surface> &surface = substitute_surface(body->surface(panels[l].first), perturbed_surface);
         
-        // Compute velocity values at wake nodes, with the wakes in their original state:
-        vector<vector<Vector3d, Eigen::aligned_allocator<Vector3d> >, Eigen::aligned_allocator<vector<Vector3d> > > wake_velocities;
+        int panel = panels[l].second;
         
-        vector<shared_ptr<BodyData> >::const_iterator bdi;
-        for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
-            const shared_ptr<BodyData> &bd = *bdi;
-                 
-            vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
-            for (lsi = bd->body->lifting_surfaces.begin(); lsi != bd->body->lifting_surfaces.end(); lsi++) {
-                const shared_ptr<Body::LiftingSurfaceData> &d = *lsi;
-                
-                vector<Vector3d, Eigen::aligned_allocator<Vector3d> > local_wake_velocities;
-                local_wake_velocities.resize(d->wake->n_nodes());
-                
-                int i;
-                
-                #pragma omp parallel
-                {
-                    #pragma omp for schedule(dynamic, 1)
-                    for (i = 0; i < d->wake->n_nodes(); i++)
-                        local_wake_velocities[i] = velocity(d->wake->nodes[i]);
-                }
-                
-                wake_velocities.push_back(local_wake_velocities);
-            }
-        }
+        int n_neighbors;
+        Matrix<double, 3, Dynamic> weights;
+        const Body::PanelNeighbor *neighbors = compute_gradient_weights(body, panels[l].first, panel, n_neighbors, weights, perturbed_surface);
         
-        // Add new wake panels at trailing edges, and convect all vertices:
-        int idx = 0;
+        double doublet_coefficient = doublet_coefficients(surface_id_to_offset[surface->id] + panel);
         
-        for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
-            shared_ptr<BodyData> bd = *bdi;
+        Vector3d doublet_gradient(0, 0, 0);
+        for (int k = 0; k < n_neighbors; k++) {
+            int neighbor_index = surface_id_to_offset[body->surface(neighbors[k].surface)->id] + neighbors[k].panel;
             
-            vector<shared_ptr<Body::LiftingSurfaceData> >::iterator lsi;
-            for (lsi = bd->body->lifting_surfaces.begin(); lsi != bd->body->lifting_surfaces.end(); lsi++) {
-                shared_ptr<Body::LiftingSurfaceData> d = *lsi;
-                
-                // Retrieve local wake velocities:
-                vector<Vector3d, Eigen::aligned_allocator<Vector3d> > &local_wake_velocities = wake_velocities[idx];
-                idx++;
-                
-                // Convect wake nodes that coincide with the trailing edge.
-                for (int i = 0; i < d->lifting_surface->n_spanwise_nodes(); i++) {                                                  
-                    d->wake->nodes[d->wake->n_nodes() - d->lifting_surface->n_spanwise_nodes() + i]
-                        += compute_trailing_edge_vortex_displacement(bd->body, d->lifting_surface, i, dt);
-                }                
-                
-                // Convect all other wake nodes according to the local wake velocity:
-                int i;
-                
-                #pragma omp parallel
-                {
-                    #pragma omp for schedule(dynamic, 1)
-                    for (i = 0; i < d->wake->n_nodes() - d->lifting_surface->n_spanwise_nodes(); i++)
-                        d->wake->nodes[i] += local_wake_velocities[i] * dt;
-                }
-                    
-                // Run internal wake update:
-                d->wake->update_properties(dt);
-
-                // Add new vertices:
-                // (This call also updates the geometry)
-                d->wake->add_layer();
-            }
+            doublet_gradient += weights.col(k) * (doublet_coefficients(neighbor_index) - doublet_coefficient);
         }
         
-    } else {
-        cout << "Solver: Re-positioning wakes." << endl;
-        
-        // No wake convection.  Re-position wake:
-        vector<shared_ptr<BodyData> >::iterator bdi;
-        for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
-            shared_ptr<BodyData> bd = *bdi;
-            
-            Vector3d body_apparent_velocity = bd->body->velocity - freestream_velocity;
-            
-            vector<shared_ptr<Body::LiftingSurfaceData> >::iterator lsi;
-            for (lsi = bd->body->lifting_surfaces.begin(); lsi != bd->body->lifting_surfaces.end(); lsi++) {
-                shared_ptr<Body::LiftingSurfaceData> d = *lsi;
-            
-                for (int i = 0; i < d->lifting_surface->n_spanwise_nodes(); i++) {
-                    // Connect wake to trailing edge nodes:                             
-                    d->wake->nodes[d->lifting_surface->n_spanwise_nodes() + i] = d->lifting_surface->nodes[d->lifting_surface->trailing_edge_node(i)];
-                    
-                    // Point wake in direction of body kinematic velocity:
-                    d->wake->nodes[i] = d->lifting_surface->nodes[d->lifting_surface->trailing_edge_node(i)]
-                                     - Parameters::static_wake_length * body_apparent_velocity / body_apparent_velocity.norm();
-                }
-                
-                // Need to update geometry:
-                d->wake->compute_geometry();
-            }
-        }
+        load += compute_load_contribution(body, surface, panel, -doublet_gradient, weight, moment, x);
     }
+    
+    return load;
 }
 
 /**
-   Logs source and doublet distributions, as well as the pressure coefficients, into files in the logging folder
-   tagged with the specified step number.
+   Computes the terms of the residual of the doublet system, weighted by the adjoint, that involve the given panels
+   of the given surface, or the given new wake panels.  These are the terms in the rows of the given panels, and the
+   terms in the columns of the given panels and wake panels, for the current geometry.  The residual is A mu - S sigma,
+   with the source coefficients of the given panels evaluated from their current geometry.
    
-   @param[in]   step_number   Step number used to name the output files.
-   @param[in]   writer        SurfaceWriter object to use.
+   @param[in]   adjoint                     Adjoint distribution.
+   @param[in]   masked_adjoint              Adjoint distribution, with the entries of the given panels set to zero.
+   @param[in]   images                      Image transformations, see image_transformations().
+   @param[in]   collocation_points          Below-surface collocation points of all non-wake panels.
+   @param[in]   image_collocation_points    Images of the collocation points.
+   @param[in]   surface                     Surface of the given panels, or a private copy of it, used in its place.
+   @param[in]   panels                      Panels.
+   @param[in]   wakes                       Wake of every new wake panel, or a private copy of it.
+   @param[in]   wake_panels                 Panel number of every new wake panel.
+   @param[in]   wake_doublet_coefficients   Doublet coefficient of every new wake panel.
+   @param[in]   wake_columns                New wake panels, by index into wake_panels.
+   
+   @returns The weighted residual terms.
 */
-void
-Solver::log(int step_number, SurfaceWriter &writer) const
-{   
-    // Log coefficients: 
-    int offset = 0;
-    int save_node_offset = 0;
-    int save_panel_offset = 0;
-    int idx;
+double
+Solver::compute_local_adjoint_residual(const VectorXd &adjoint, const VectorXd &masked_adjoint, const vector<Matrix3d> &images,
+                                       const Matrix3Xd &collocation_points, const vector<Matrix3Xd> &image_collocation_points,
+                                       const shared_ptr<Surface> &surface, const vector<int> &panels,
+                                       const vector<shared_ptr<Surface> > &wakes, const vector<int> &wake_panels,
+                                       const VectorXd &wake_doublet_coefficients, const vector<int> &wake_columns) const
+{
+    const shared_ptr<BodyData> &bd = surface_id_to_body[surface->id];
     
-    vector<shared_ptr<BodyData> >::const_iterator bdi;
-    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
-        const shared_ptr<BodyData> &bd = *bdi;
+    int offset = surface_id_to_offset[surface->id];
+    
+    int n_images = images.size();
+    
+    // Source coefficients of the given panels:
+    vector<double> panel_source_coefficients;
+    for (int l = 0; l < (int) panels.size(); l++)
+        panel_source_coefficients.push_back(compute_source_coefficient(bd->body, surface, panels[l], bd->boundary_layer->blowing_velocity(surface, panels[l]), false));
         
-        // Iterate non-lifting surfaces:
-        idx = 0;
+    double residual = 0.0;
+    
+    // Rows of the given panels:
+    for (int l = 0; l < (int) panels.size(); l++) {
+        const Vector3d &x = surface->panel_collocation_point(panels[l], true);
         
-        vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
-        for (si = bd->body->non_lifting_surfaces.begin(); si != bd->body->non_lifting_surfaces.end(); si++) {
-            const shared_ptr<Body::SurfaceData> &d = *si;
-            
-            // Log non-lifting surface coefficients:
-            MatrixXd non_lifting_surface_doublet_coefficients(d->surface->n_panels(), 1);
-            MatrixXd non_lifting_surface_source_coefficients(d->surface->n_panels(), 1);
-            MatrixXd non_lifting_surface_pressure_coefficients(d->surface->n_panels(), 1);
-            MatrixXd non_lifting_surface_velocity_vectors(d->surface->n_panels(), 3);
-            for (int i = 0; i < d->surface->n_panels(); i++) {
-                non_lifting_surface_doublet_coefficients(i, 0)  = doublet_coefficients(offset + i);
-                non_lifting_surface_source_coefficients(i, 0)   = source_coefficients(offset + i);
-                non_lifting_surface_pressure_coefficients(i, 0) = pressure_coefficients(offset + i);
-                non_lifting_surface_velocity_vectors.row(i)     = surface_velocities.row(offset + i);
-            }
-            
-            offset += d->surface->n_panels();
-            
-            vector<string> view_names;
-            vector<MatrixXd, Eigen::aligned_allocator<MatrixXd> > view_data;
-            
-            view_names.push_back(VIEW_NAME_DOUBLET_DISTRIBUTION);
-            view_data.push_back(non_lifting_surface_doublet_coefficients);
-            
-            view_names.push_back(VIEW_NAME_SOURCE_DISTRIBUTION);
-            view_data.push_back(non_lifting_surface_source_coefficients);
+        vector<Vector3d, Eigen::aligned_allocator<Vector3d> > image_x;
+        for (int m = 0; m < n_images; m++)
+            image_x.push_back(images[m] * x);
             
-            view_names.push_back(VIEW_NAME_PRESSURE_DISTRIBUTION);
-            view_data.push_back(non_lifting_surface_pressure_coefficients);
+        double row = 0.0;
+        
+        vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
+        for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+            const shared_ptr<Surface> &other = substitute_surface((*si)->surface, surface);
             
-            view_names.push_back(VIEW_NAME_VELOCITY_DISTRIBUTION);
-            view_data.push_back(non_lifting_surface_velocity_vectors);
+            int other_offset = surface_id_to_offset[other->id];
+            int j;
             
-            stringstream ss;
-            ss << log_folder << "/" << bd->body->id << "/non_lifting_surface_" << idx << "/step_" << step_number << writer.file_extension();
-
-            writer.write(d->surface, ss.str(), save_node_offset, save_panel_offset, view_names, view_data);
+            VectorXd row_terms(other->n_panels());
             
-            save_node_offset += d->surface->n_nodes();
-            save_panel_offset += d->surface->n_panels();
+            #pragma omp parallel
+            {
+                #pragma omp for schedule(dynamic, 1)
+                for (j = 0; j < other->n_panels(); j++) {
+                    double source_influence, doublet_influence;
+                    other->source_and_doublet_influence(x, j, source_influence, doublet_influence);
+                    
+                    // Doublet panels are evaluated on their own collocation points from the inside:
+                    if (other == surface && j == panels[l])
+                        doublet_influence = -0.5;
+                        
+                    for (int m = 0; m < n_images; m++) {
+                        double image_source_influence, image_doublet_influence;
+                        other->source_and_doublet_influence(image_x[m], j, image_source_influence, image_doublet_influence);
+                        
+                        source_influence  += image_source_influence;
+                        doublet_influence += image_doublet_influence;
+                    }
+                    
+                    double source_coefficient = source_coefficients(other_offset + j);
+                    if (other == surface) {
+                        for (int m = 0; m < (int) panels.size(); m++) {
+                            if (panels[m] == j)
+                                source_coefficient = panel_source_coefficients[m];
+                        }
+                    }
+                    
+                    row_terms(j) = doublet_influence * doublet_coefficients(other_offset + j) - source_influence * source_coefficient;
+                }
+            }
             
-            idx++;
-        }   
+            // Sum the terms serially, in panel order, so that the residual does not depend on the number of threads or
+            // on the scheduling:
+            for (j = 0; j < other->n_panels(); j++)
+                row += row_terms(j);
+        }
         
-        // Iterate lifting surfaces:
-        idx = 0;
+        for (int k = 0; k < (int) wake_panels.size(); k++) {
+            double wake_influence = wakes[k]->doublet_influence(x, wake_panels[k]);
+            for (int m = 0; m < n_images; m++)
+                wake_influence += wakes[k]->doublet_influence(image_x[m], wake_panels[k]);
+                
+            row += wake_influence * wake_doublet_coefficients(k);
+        }
         
-        vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
-        for (lsi = bd->body->lifting_surfaces.begin(); lsi != bd->body->lifting_surfaces.end(); lsi++) {
-            const shared_ptr<Body::LiftingSurfaceData> &d = *lsi;
+        residual += adjoint(offset + panels[l]) * row;
+    }
+    
+    // Columns of the given panels, in all other rows.  The rows are split into blocks, so that every column is
+    // evaluated concurrently:
+    const int block_size = 256;
+    
+    int n_blocks = (n_non_wake_panels + block_size - 1) / block_size;
+    int b;
+    
+    VectorXd block_terms(n_blocks * panels.size());
+    
+    #pragma omp parallel
+    {
+        VectorXd source_influence(block_size), doublet_influence(block_size);
+        VectorXd image_source_influence(n_images > 0 ? block_size : 0), image_doublet_influence(n_images > 0 ? block_size : 0);
+        
+        #pragma omp for schedule(dynamic, 1)
+        for (b = 0; b < n_blocks * (int) panels.size(); b++) {
+            int l        = b / n_blocks;
+            int first    = (b % n_blocks) * block_size;
+            int n_points = min(block_size, n_non_wake_panels - first);
             
-            // Log lifting surface coefficients:
-            MatrixXd lifting_surface_doublet_coefficients(d->lifting_surface->n_panels(), 1);
-            MatrixXd lifting_surface_source_coefficients(d->lifting_surface->n_panels(), 1);
-            MatrixXd lifting_surface_pressure_coefficients(d->lifting_surface->n_panels(), 1);
-            MatrixXd lifting_surface_velocity_vectors(d->surface->n_panels(), 3);
-            for (int i = 0; i < d->lifting_surface->n_panels(); i++) {
-                lifting_surface_doublet_coefficients(i, 0)  = doublet_coefficients(offset + i);
-                lifting_surface_source_coefficients(i, 0)   = source_coefficients(offset + i);
-                lifting_surface_pressure_coefficients(i, 0) = pressure_coefficients(offset + i);
-                lifting_surface_velocity_vectors.row(i)     = surface_velocities.row(offset + i);
+            surface->source_and_doublet_influence(collocation_points.middleCols(first, n_points), panels[l],
+                                                  source_influence.head(n_points), doublet_influence.head(n_points));
+                                                  
+            for (int m = 0; m < n_images; m++) {
+                surface->source_and_doublet_influence(image_collocation_points[m].middleCols(first, n_points), panels[l],
+                                                      image_source_influence.head(n_points), image_doublet_influence.head(n_points));
+                
+                source_influence.head(n_points)  += image_source_influence.head(n_points);
+                doublet_influence.head(n_points) += image_doublet_influence.head(n_points);
             }
             
-            offset += d->lifting_surface->n_panels();
-            
-            vector<string> view_names;
-            vector<MatrixXd, Eigen::aligned_allocator<MatrixXd> > view_data;
-            
-            view_names.push_back(VIEW_NAME_DOUBLET_DISTRIBUTION);
-            view_data.push_back(lifting_surface_doublet_coefficients);
-            
-            view_names.push_back(VIEW_NAME_SOURCE_DISTRIBUTION);
-            view_data.push_back(lifting_surface_source_coefficients);
-            
-            view_names.push_back(VIEW_NAME_PRESSURE_DISTRIBUTION);
-            view_data.push_back(lifting_surface_pressure_coefficients);
-            
-            view_names.push_back(VIEW_NAME_VELOCITY_DISTRIBUTION);
-            view_data.push_back(lifting_surface_velocity_vectors);
-            
-            stringstream ss;
-            ss << log_folder << "/" << bd->body->id << "/lifting_surface_" << idx << "/step_" << step_number << writer.file_extension();
-
-            writer.write(d->lifting_surface, ss.str(), save_node_offset, save_panel_offset, view_names, view_data);
-            
-            save_node_offset += d->lifting_surface->n_nodes();
-            save_panel_offset += d->lifting_surface->n_panels();
+            block_terms(b) = masked_adjoint.segment(first, n_points).dot(doublet_influence.head(n_points)) * doublet_coefficients(offset + panels[l])
+                           - masked_adjoint.segment(first, n_points).dot(source_influence.head(n_points)) * panel_source_coefficients[l];
+        }
+    }
     
-            // Log wake surface and coefficients:
-            MatrixXd wake_doublet_coefficients(d->wake->doublet_coefficients.size(), 1);
-            for (int i = 0; i < (int) d->wake->doublet_coefficients.size(); i++)
-                wake_doublet_coefficients(i, 0) = d->wake->doublet_coefficients[i];
-
-            view_names.clear();
-            view_data.clear();
-            
-            view_names.push_back(VIEW_NAME_DOUBLET_DISTRIBUTION);
-            view_data.push_back(wake_doublet_coefficients);
-            
-            stringstream ssw;
-            ssw << log_folder << "/" << bd->body->id << "/wake_" << idx << "/step_" << step_number << writer.file_extension();
-            
-            writer.write(d->wake, ssw.str(), 0, save_panel_offset, view_names, view_data);
-            
-            save_node_offset += d->wake->n_nodes();
-            save_panel_offset += d->wake->n_panels();
-            
-            idx++;
+    for (b = 0; b < n_blocks * (int) panels.size(); b++)
+        residual += block_terms(b);
+    
+    // Columns of the given new wake panels, in all other rows:
+    for (int l = 0; l < (int) wake_columns.size(); l++) {
+        int k = wake_columns[l];
+        int i;
+        
+        VectorXd column_terms = VectorXd::Zero(n_non_wake_panels);
+        
+        #pragma omp parallel
+        {
+            #pragma omp for schedule(dynamic, 1)
+            for (i = 0; i < n_non_wake_panels; i++) {
+                if (masked_adjoint(i) == 0.0)
+                    continue;
+                    
+                double wake_influence = wakes[k]->doublet_influence(collocation_points.col(i), wake_panels[k]);
+                for (int m = 0; m < n_images; m++)
+                    wake_influence += wakes[k]->doublet_influence(image_collocation_points[m].col(i), wake_panels[k]);
+                    
+                column_terms(i) = masked_adjoint(i) * wake_influence;
+            }
         }
+        
+        double column = 0.0;
+        for (i = 0; i < n_non_wake_panels; i++)
+            column += column_terms(i);
+        
+        residual += column * wake_doublet_coefficients(k);
     }
+    
+    return residual;
 }
- 
+
+/**
+   Evaluates all pending outputs.
+*/
+void
+Solver::evaluate_pending_outputs() const
+{
+    vector<shared_ptr<Body::SurfaceData> >::const_iterator si;   
+    for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+        const shared_ptr<Body::SurfaceData> &d = *si;
+        
+        evaluate_surface_velocity_potentials(d->surface);
+        evaluate_pressure_coefficients(d->surface);
+        evaluate_surface_velocities(d->surface);
+    }
+}
+
 // Compute source coefficient for given surface and panel:
 double
-Solver::compute_source_coefficient(const shared_ptr<Body> &body, const shared_ptr<Surface> &surface, int panel, const shared_ptr<BoundaryLayer> &boundary_layer, bool include_wake_influence) const
+Solver::compute_source_coefficient(const shared_ptr<Body> &body, const shared_ptr<Surface> &surface, int panel, double blowing_velocity, bool include_wake_influence) const
 {
     // Start with apparent velocity:
     Vector3d velocity = body->panel_kinematic_velocity(surface, panel) - freestream_velocity;
     
     // Wake contribution:
-    if (Parameters::convect_wake && include_wake_influence) {
-        vector<shared_ptr<BodyData> >::const_iterator bdi;
-        for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
-            const shared_ptr<BodyData> &bd = *bdi;
-            
-            vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
-            for (lsi = bd->body->lifting_surfaces.begin(); lsi != bd->body->lifting_surfaces.end(); lsi++) {
-                const shared_ptr<Body::LiftingSurfaceData> &d = *lsi;
-                
-                // Add influence of old wake panels.  That is, those wake panels which already have a doublet
-                // strength assigned to them.
-                for (int k = 0; k < d->wake->n_panels() - d->lifting_surface->n_spanwise_panels(); k++) {
-                    // Use doublet panel - vortex ring equivalence.
-                    velocity -= d->wake->vortex_ring_unit_velocity(surface, panel, k) * d->wake->doublet_coefficients[k];
-                }
-            }
-        }
-    }
+    if (parameters.convect_wake && include_wake_influence)
+        velocity -= wake_induced_velocities.row(compute_index(surface, panel)).transpose();
     
     // Take normal component, and subtract blowing velocity:
     const Vector3d &normal = surface->panel_normal(panel);
-    
-    double blowing_velocity = boundary_layer->blowing_velocity(surface, panel);
         
     return velocity.dot(normal) - blowing_velocity;
 }
@@ -1181,7 +5087,7 @@ Solver::compute_source_coefficient(const shared_ptr<Body> &body, const shared_pt
 double
 Solver::compute_surface_velocity_potential(const shared_ptr<Surface> &surface, int offset, int panel) const
 {
-    if (Parameters::marcov_surface_velocity) {
+    if (parameters.marcov_surface_velocity) {
         // Since we use N. Marcov's formula for surface velocity, we also compute the surface velocity
         // potential directly.
         return velocity_potential(surface->panel_collocation_point(panel, false));
@@ -1190,7 +5096,7 @@ Solver::compute_surface_velocity_potential(const shared_ptr<Surface> &surface, i
         double phi = -doublet_coefficients(offset + panel);
         
         // Add flow potential due to kinematic velocity:
-        const shared_ptr<BodyData> &bd = surface_id_to_body.find(surface->id)->second;
+        const shared_ptr<BodyData> &bd = surface_id_to_body[surface->id];
         Vector3d apparent_velocity = bd->body->panel_kinematic_velocity(surface, panel) - freestream_velocity;
         
         phi -= apparent_velocity.dot(surface->panel_collocation_point(panel, false));
@@ -1217,88 +5123,311 @@ Solver::compute_surface_velocity_potential_time_derivative(int offset, int panel
     
     // Evaluate the time-derivative of the potential in a body-fixed reference frame, as in
     //   J. P. Giesing, Nonlinear Two-Dimensional Unsteady Potential Flow with Lift, Journal of Aircraft, 1968.
-    if (Parameters::unsteady_bernoulli && dt > 0.0)
+    if (parameters.unsteady_bernoulli && dt > 0.0)
         dphidt = (surface_velocity_potentials(offset + panel) - previous_surface_velocity_potentials(offset + panel)) / dt;
     else
         dphidt = 0.0;
         
-    return dphidt;
+    return dphidt;
+}
+
+/**
+   Checks whether the gradient operator of the given body may be reused.  This is the case if the topology and the
+   panel geometry of the body have not changed, and if all of its surfaces have moved rigidly together since the
+   operator was computed.
+   
+   @param[in]   bd         Body data.
+   @param[out]  rotation   Rotation of the body since the operator was computed.
+   
+   @returns true if the gradient operator may be reused.
+*/
+bool
+Solver::gradient_operator_valid(const shared_ptr<BodyData> &bd, Matrix3d &rotation) const
+{
+    const shared_ptr<Body> &body = bd->body;
+    
+    if (bd->gradient_operator_adjacency_revision != body->adjacency_revision)
+        return false;
+        
+    if ((int) bd->gradient_operator_geometry_revisions.size() != body->n_surfaces())
+        return false;
+        
+    Transform<double, 3, Affine> motion = Transform<double, 3, Affine>::Identity();
+    
+    for (int i = 0; i < body->n_surfaces(); i++) {
+        const shared_ptr<Surface> &surface = body->surface(i);
+        
+        if (surface->geometry_revision != bd->gradient_operator_geometry_revisions[i])
+            return false;
+            
+        Transform<double, 3, Affine> surface_motion = surface->accumulated_transformation * bd->gradient_operator_transformations[i].inverse();
+        
+        if (i == 0)
+            motion = surface_motion;
+        else if (!surface_motion.isApprox(motion, parameters.relative_motion_tolerance))
+            return false;
+    }
+    
+    rotation = motion.linear();
+    
+    return true;
+}
+
+/**
+   Computes the on-body gradient operator of the given body.
+   
+   The gradient of a scalar field on a panel is computed by fitting a linear model to the values of the field on the
+   neighboring panels, in the panel coordinate system.  The least-squares solution is linear in these values, so that
+   its coefficients depend on the geometry only.  They are stored as the rows of a sparse matrix.
+   
+   @param[in]   bd   Body data.
+*/
+void
+Solver::compute_gradient_operator(const shared_ptr<BodyData> &bd) const
+{
+    const shared_ptr<Body> &body = bd->body;
+    
+    VORTEXJE_LOG(logger, Logger::Info, "Solver: Computing surface gradient operator for body " << body->id << ".");
+    
+    // Offsets of the surfaces in the body panel numbering:
+    vector<int> offsets;
+    
+    int n_panels = 0;
+    for (int i = 0; i < body->n_surfaces(); i++) {
+        offsets.push_back(n_panels);
+        
+        n_panels += body->surface(i)->n_panels();
+    }
+    
+    // Model coefficients, per panel:
+    vector<vector<Triplet<double> > > triplets(n_panels);
+    
+    for (int i = 0; i < body->n_surfaces(); i++) {
+        const shared_ptr<Surface> &surface = body->surface(i);
+        int j;
+        
+        #pragma omp parallel
+        {
+            #pragma omp for schedule(dynamic, 1)
+            for (j = 0; j < surface->n_panels(); j++) {
+                int n_neighbors;
+                Matrix<double, 3, Dynamic> weights;
+                const Body::PanelNeighbor *neighbors = compute_gradient_weights(body, i, j, n_neighbors, weights);
+                if (n_neighbors == 0)
+                    continue;
+                
+                vector<Triplet<double> > &panel_triplets = triplets[offsets[i] + j];
+                panel_triplets.reserve(3 * (n_neighbors + 1));
+                
+                for (int k = 0; k < n_neighbors; k++) {
+                    int neighbor_index = offsets[neighbors[k].surface] + neighbors[k].panel;
+                    
+                    for (int l = 0; l < 3; l++)
+                        panel_triplets.push_back(Triplet<double>(3 * (offsets[i] + j) + l, neighbor_index, weights(l, k)));
+                }
+                
+                Vector3d weight_sums = weights.rowwise().sum();
+                for (int l = 0; l < 3; l++)
+                    panel_triplets.push_back(Triplet<double>(3 * (offsets[i] + j) + l, offsets[i] + j, -weight_sums(l)));
+            }
+        }
+    }
+    
+    // Assemble:
+    vector<Triplet<double> > all_triplets;
+    
+    size_t n_triplets = 0;
+    for (int i = 0; i < n_panels; i++)
+        n_triplets += triplets[i].size();
+        
+    all_triplets.reserve(n_triplets);
+    for (int i = 0; i < n_panels; i++)
+        all_triplets.insert(all_triplets.end(), triplets[i].begin(), triplets[i].end());
+
+    bd->gradient_operator.resize(3 * n_panels, n_panels);
+    bd->gradient_operator.setFromTriplets(all_triplets.begin(), all_triplets.end());
+    
+    // Remember the geometry for which the operator was computed:
+    bd->gradient_operator_geometry_revisions.clear();
+    bd->gradient_operator_transformations.clear();
+    
+    for (int i = 0; i < body->n_surfaces(); i++) {
+        bd->gradient_operator_geometry_revisions.push_back(body->surface(i)->geometry_revision);
+        bd->gradient_operator_transformations.push_back(body->surface(i)->accumulated_transformation);
+    }
+    
+    bd->gradient_operator_adjacency_revision = body->adjacency_revision;
+}
+
+/**
+   Computes the coefficients of the on-body gradient of a scalar field on the given panel, see
+   compute_gradient_operator().  The gradient is the sum of the weights times the differences between the values on
+   the neighboring panels and the value on the panel itself.
+   
+   @param[in]   body                Body.
+   @param[in]   surface_index       Index of the surface of the panel within the body.
+   @param[in]   panel               Panel.
+   @param[out]  n_neighbors         Number of neighboring panels.
+   @param[out]  weights             Gradient weights, one column per neighboring panel.
+   @param[in]   perturbed_surface   Optional private copy of a surface of the body, used in its place.
+   
+   @returns The neighboring panels. 
+*/
+const Body::PanelNeighbor *
+Solver::compute_gradient_weights(const shared_ptr<Body> &body, int surface_index, int panel, int &n_neighbors, Matrix<double, 3, Dynamic> &weights,
+                                 const shared_ptr<Surface> &perturbed_surface) const
+{
+    // Retrieve panel neighbors.
+    const Body::PanelNeighbor *neighbors = body->panel_neighbors(surface_index, panel, n_neighbors);
+    if (n_neighbors == 0)
+        return neighbors;
+        
+    // Set up a transformation such that panel normal becomes unit Z vector:
+    const Transform<double, 3, Affine> &transformation = substitute_surface(body->surface(surface_index), perturbed_surface)->panel_coordinate_transformation(panel);
+    
+    // Set up model equations.  The model is centered on the panel:
+    MatrixXd A(n_neighbors, 2);
+    
+    for (int k = 0; k < n_neighbors; k++) {
+        const Body::PanelNeighbor &neighbor_panel = neighbors[k];
+        
+        // Add neighbor relative to panel:
+        Vector3d neighbor_vector_normalized =
+            transformation * substitute_surface(body->surface(neighbor_panel.surface), perturbed_surface)->panel_collocation_point(neighbor_panel.panel, false);
+    
+        A(k, 0) = neighbor_vector_normalized(0);
+        A(k, 1) = neighbor_vector_normalized(1);
+    }
+    
+    // Pseudo-inverse of the model equations:
+    JacobiSVD<MatrixXd> svd(A, ComputeThinU | ComputeThinV);
+    svd.setThreshold(Parameters::inversion_tolerance);
+    
+    MatrixXd pseudo_inverse = svd.solve(MatrixXd::Identity(n_neighbors, n_neighbors));
+    
+    // Transform gradient to global frame:
+    weights = transformation.linear().transpose().leftCols(2) * pseudo_inverse;
+    
+    return neighbors;
+}
+
+/**
+   Computes the surface velocities of the bodies whose outputs are required, and of the bodies with a boundary layer.
+   The surface velocities of all other bodies are marked for evaluation upon first query.  See require_outputs().
+*/
+void
+Solver::compute_surface_velocities()
+{
+    vector<shared_ptr<BodyData> >::iterator bdi;
+    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+        const shared_ptr<BodyData> &bd = *bdi;
+        const shared_ptr<Body> &body = bd->body;
+        
+        bool required = !bd->boundary_layer->inviscid();
+        for (int i = 0; i < body->n_surfaces(); i++)
+            required = required || outputs_required(body->surface(i));
+            
+        if (required)
+            compute_surface_velocities(bd);
+        else {
+            for (int i = 0; i < body->n_surfaces(); i++)
+                surface_velocities_pending[body->surface(i)->id] = true;
+                
+            // N. Marcov's formula evaluates the velocity induced by the current source distribution, which is
+            // recomputed without wake influence after the boundary layer iteration:
+            if (parameters.marcov_surface_velocity && parameters.convect_wake)
+                pending_surface_velocity_source_coefficients = source_coefficients;
+        }
+    }
 }
 
 /**
-   Computes the on-body gradient of a scalar field.
+   Computes the surface velocities of all panels of the given body.  The gradients of the doublet distribution are
+   obtained using the gradient operator, which is recomputed only if the geometry of the body has changed.
    
-   @param[in]   scalar_field   Scalar field, ordered by panel number.
-   @param[in]   surface        Surface to which the panel belongs.
-   @param[in]   panel          Panel on which the on-body gradient is evaluated.
-   
-   @returns On-body gradient vector.
+   @param[in]   bd   Body data.
 */
-Vector3d
-Solver::compute_scalar_field_gradient(const Eigen::VectorXd &scalar_field, const shared_ptr<Body> &body, const shared_ptr<Surface> &surface, int panel) const
+void
+Solver::compute_surface_velocities(const shared_ptr<BodyData> &bd) const
 {
-    // We compute the scalar field gradient by fitting a linear model.
-    
-    // Retrieve panel neighbors.
-    vector<Body::SurfacePanelEdge> neighbors = body->panel_neighbors(surface, panel);
-
-    // Set up a transformation such that panel normal becomes unit Z vector:
-    Transform<double, 3, Affine> transformation = surface->panel_coordinate_transformation(panel);
-    
-    // Set up model equations:
-    MatrixXd A(neighbors.size(), 2);
-    VectorXd b(neighbors.size());
-    
-    // The model is centered on panel:
-    double panel_value = scalar_field(compute_index(surface, panel));
-    
-    for (int i = 0; i < (int) neighbors.size(); i++) {
-        Body::SurfacePanelEdge neighbor_panel = neighbors[i];
+    const shared_ptr<Body> &body = bd->body;
+    if (body->n_surfaces() == 0)
+        return;
         
-        // Add neighbor relative to panel:
-        Vector3d neighbor_vector_normalized = transformation * neighbor_panel.surface->panel_collocation_point(neighbor_panel.panel, false);
-    
-        A(i, 0) = neighbor_vector_normalized(0);
-        A(i, 1) = neighbor_vector_normalized(1);
+    int offset = surface_id_to_offset[body->surface(0)->id];
     
-        b(i) = scalar_field(compute_index(neighbor_panel.surface, neighbor_panel.panel)) - panel_value;
+    Matrix3d rotation;
+    if (!gradient_operator_valid(bd, rotation)) {
+        compute_gradient_operator(bd);
+        
+        rotation = Matrix3d::Identity();
     }
     
-    // Solve model equations:
-    JacobiSVD<MatrixXd> svd(A, ComputeThinU | ComputeThinV);
-    svd.setThreshold(Parameters::inversion_tolerance);
+    int n_panels = bd->gradient_operator.cols();
     
-    VectorXd model_coefficients = svd.solve(b);
+    // Doublet gradients:
+    VectorXd doublet_gradients = bd->gradient_operator * doublet_coefficients.segment(offset, n_panels);
     
-    // Extract gradient in local frame:
-    Vector3d gradient_normalized = Vector3d(model_coefficients(0), model_coefficients(1), 0.0);
+    Map<Matrix3Xd> doublet_gradients_matrix(doublet_gradients.data(), 3, n_panels);
     
-    // Transform gradient to global frame:
-    return transformation.linear().transpose() * gradient_normalized;
+    // Disturbance part of the surface velocities:
+    Matrix3Xd disturbance_velocities;
+    if (parameters.marcov_surface_velocity) {
+        // Use N. Marcov's formula for surface velocity, see L. Dragoş, Mathematical Methods in Aerodynamics, Springer, 2003.
+        Matrix3Xd points(3, n_panels);
+        for (int i = 0, k = 0; i < body->n_surfaces(); i++)
+            for (int j = 0; j < body->surface(i)->n_panels(); j++, k++)
+                points.col(k) = body->surface(i)->panel_collocation_point(j, false);
+                
+        compute_disturbance_velocities(points, disturbance_velocities);
+        
+        disturbance_velocities -= 0.5 * rotation * doublet_gradients_matrix;
+        
+    } else
+        disturbance_velocities = -rotation * doublet_gradients_matrix;
+        
+    // The panels of all surfaces of the body are split into tasks, so that no thread waits at a barrier after every
+    // surface:
+    #pragma omp parallel
+    {
+        #pragma omp single
+        {
+            for (int i = 0, body_offset = 0; i < body->n_surfaces(); i++) {
+                shared_ptr<Surface> surface = body->surface(i);
+                
+                for (int first = 0; first < surface->n_panels(); first += TASK_PANEL_CHUNK_SIZE) {
+                    #pragma omp task firstprivate(surface, offset, body_offset, first)
+                    {
+                        int last = min(first + TASK_PANEL_CHUNK_SIZE, surface->n_panels());
+                        for (int j = first; j < last; j++)
+                            surface_velocities.row(offset + j) = compute_surface_velocity(body, surface, j, disturbance_velocities.col(body_offset + j));
+                    }
+                }
+                
+                offset      += surface->n_panels();
+                body_offset += surface->n_panels();
+            }
+        }
+    }
+    
+    for (int i = 0; i < body->n_surfaces(); i++)
+        surface_velocities_pending[body->surface(i)->id] = false;
 }
 
 /**
    Computes the surface velocity for the given panel.
    
-   @param[in]   surface   Reference surface.
-   @param[it]   offset    Doublet coefficien vector offset.
-   @param[in]   panel     Reference panel.
+   @param[in]   body                   Reference body.
+   @param[in]   surface                Reference surface.
+   @param[in]   panel                  Reference panel.
+   @param[in]   disturbance_velocity   Disturbance part of the surface velocity.
    
    @returns Surface velocity.
 */
 Eigen::Vector3d
-Solver::compute_surface_velocity(const shared_ptr<Body> &body, const shared_ptr<Surface> &surface, int panel) const
+Solver::compute_surface_velocity(const shared_ptr<Body> &body, const shared_ptr<Surface> &surface, int panel, const Vector3d &disturbance_velocity) const
 {
-    // Compute disturbance part of surface velocity.
-    Vector3d tangential_velocity;
-    if (Parameters::marcov_surface_velocity) {
-        const Vector3d &x = surface->panel_collocation_point(panel, false);
-        
-        // Use N. Marcov's formula for surface velocity, see L. Dragoş, Mathematical Methods in Aerodynamics, Springer, 2003.
-        Vector3d tangential_velocity = compute_disturbance_velocity(x);
-        tangential_velocity -= 0.5 * compute_scalar_field_gradient(doublet_coefficients, body, surface, panel);
-    } else
-        tangential_velocity = -compute_scalar_field_gradient(doublet_coefficients, body, surface, panel);
+    Vector3d tangential_velocity = disturbance_velocity;
 
     // Add flow due to kinematic velocity:
     Vector3d apparent_velocity = body->panel_kinematic_velocity(surface, panel) - freestream_velocity;
@@ -1344,7 +5473,8 @@ Solver::compute_pressure_coefficient(const Vector3d &surface_velocity, double dp
 }
 
 /**
-   Computes the disturbance velocity potential at the given point.
+   Computes the disturbance velocity potential at the given point.  The potential induced by the images of all panels
+   is included, see image_transformations().
    
    @param[in]   x   Reference point.
    
@@ -1352,6 +5482,25 @@ Solver::compute_pressure_coefficient(const Vector3d &surface_velocity, double dp
 */
 double
 Solver::compute_disturbance_velocity_potential(const Vector3d &x) const
+{
+    double phi = compute_disturbance_velocity_potential_without_images(x);
+    
+    vector<Matrix3d> images = image_transformations();
+    for (int k = 0; k < (int) images.size(); k++)
+        phi += compute_disturbance_velocity_potential_without_images(images[k] * x);
+        
+    return phi;
+}
+
+/**
+   Computes the disturbance velocity potential at the given point, induced by the meshed panels only.
+   
+   @param[in]   x   Reference point.
+   
+   @returns Disturbance velocity potential.
+*/
+double
+Solver::compute_disturbance_velocity_potential_without_images(const Vector3d &x) const
 {
     double phi = 0.0;
     
@@ -1393,7 +5542,8 @@ Solver::compute_disturbance_velocity_potential(const Vector3d &x) const
 }
 
 /**
-   Computes disturbance potential gradient at the given point.
+   Computes disturbance potential gradient at the given point.  The velocity induced by the images of all panels and
+   vortex particles is included, see image_transformations().
    
    @param[in]   x   Reference point.
    
@@ -1401,6 +5551,25 @@ Solver::compute_disturbance_velocity_potential(const Vector3d &x) const
 */ 
 Eigen::Vector3d
 Solver::compute_disturbance_velocity(const Eigen::Vector3d &x) const
+{
+    Vector3d gradient = compute_disturbance_velocity_without_images(x);
+    
+    vector<Matrix3d> images = image_transformations();
+    for (int k = 0; k < (int) images.size(); k++)
+        gradient += images[k].transpose() * compute_disturbance_velocity_without_images(images[k] * x);
+        
+    return gradient;
+}
+
+/**
+   Computes disturbance potential gradient at the given point, induced by the meshed panels and vortex particles only.
+   
+   @param[in]   x   Reference point.
+   
+   @returns Disturbance potential gradient.
+*/ 
+Eigen::Vector3d
+Solver::compute_disturbance_velocity_without_images(const Eigen::Vector3d &x) const
 {
     Vector3d gradient(0, 0, 0);
     
@@ -1432,6 +5601,9 @@ Solver::compute_disturbance_velocity(const Eigen::Vector3d &x) const
                 for (int i = 0; i < d->wake->n_panels(); i++)
                     gradient += d->wake->vortex_ring_unit_velocity(x, i) * d->wake->doublet_coefficients[i];
             }
+            
+            for (int i = 0; i < d->wake->n_particles(); i++)
+                gradient += d->wake->particle_velocity(x, i);
         }
     }
                
@@ -1439,6 +5611,371 @@ Solver::compute_disturbance_velocity(const Eigen::Vector3d &x) const
     return gradient;
 }
 
+/**
+   Builds a treecode containing all non-wake and wake panels, with their current singularity strengths, and all wake
+   vortex particles.  The velocity it computes equals the disturbance velocity, up to the accuracy set by
+   parameters.treecode_opening_angle.
+   
+   @returns Treecode.
+*/
+shared_ptr<Treecode>
+Solver::build_treecode() const
+{
+    shared_ptr<Treecode> treecode(new Treecode(parameters.treecode_opening_angle));
+    
+    // Add all non-wake surfaces:
+    int offset = 0;
+    
+    vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
+    for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+        const shared_ptr<Body::SurfaceData> &d = *si;
+
+        for (int i = 0; i < d->surface->n_panels(); i++)
+            treecode->add_panel(d->surface, i, doublet_coefficients(offset + i), source_coefficients(offset + i));
+        
+        offset += d->surface->n_panels();
+    }
+    
+    // Add wakes:
+    vector<shared_ptr<BodyData> >::const_iterator bdi;
+    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+        const shared_ptr<BodyData> &bd = *bdi;
+        
+        vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
+        for (lsi = bd->body->lifting_surfaces.begin(); lsi != bd->body->lifting_surfaces.end(); lsi++) {
+            const shared_ptr<Body::LiftingSurfaceData> &d = *lsi;
+            
+            if (d->wake->n_panels() >= d->lifting_surface->n_spanwise_panels()) {
+                for (int i = 0; i < d->wake->n_panels(); i++)
+                    treecode->add_panel(d->wake, i, d->wake->doublet_coefficients[i], 0.0);
+            }
+            
+            for (int i = 0; i < d->wake->n_particles(); i++)
+                treecode->add_particle(d->wake, i);
+        }
+    }
+    
+    treecode->build();
+    
+    return treecode;
+}
+
+/**
+   Builds an accelerator backend containing the non-wake panels and the wake panels, except for those of wakes that
+   override the panel influences, such as the RamasamyLeishmanWake.
+   
+   @param[in]   include_non_wake_surfaces   Whether to include the non-wake panels.
+   @param[in]   include_new_wake_panels     Whether to include the newest row of wake panels.
+   @param[out]  doublet_coefficients        Doublet panel, or vortex ring, strengths of the accelerator panels.
+   @param[out]  source_coefficients         Source panel strengths of the accelerator panels.
+   
+   @returns Accelerator.
+*/
+shared_ptr<Accelerator>
+Solver::build_accelerator(bool include_non_wake_surfaces, bool include_new_wake_panels, VectorXd &doublet_coefficients, VectorXd &source_coefficients) const
+{
+    shared_ptr<Accelerator> accelerator(new Accelerator());
+    
+    vector<double> doublets, sources;
+    
+    // Add all non-wake surfaces:
+    if (include_non_wake_surfaces) {
+        int offset = 0;
+        
+        vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
+        for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+            const shared_ptr<Body::SurfaceData> &d = *si;
+            
+            accelerator->add_surface(d->surface);
+            
+            for (int i = 0; i < d->surface->n_panels(); i++) {
+                doublets.push_back(this->doublet_coefficients(offset + i));
+                sources.push_back(this->source_coefficients(offset + i));
+            }
+            
+            offset += d->surface->n_panels();
+        }
+    }
+    
+    // Add wakes:
+    vector<shared_ptr<BodyData> >::const_iterator bdi;
+    for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+        const shared_ptr<BodyData> &bd = *bdi;
+        
+        vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
+        for (lsi = bd->body->lifting_surfaces.begin(); lsi != bd->body->lifting_surfaces.end(); lsi++) {
+            const shared_ptr<Body::LiftingSurfaceData> &d = *lsi;
+            
+            if (typeid(*d->wake.get()) != typeid(Wake))
+                continue;
+                
+            if (d->wake->n_panels() < d->lifting_surface->n_spanwise_panels())
+                continue;
+                
+            int n_panels = d->wake->n_panels();
+            if (!include_new_wake_panels)
+                n_panels -= d->lifting_surface->n_spanwise_panels();
+                
+            accelerator->add_surface(d->wake);
+            
+            for (int i = 0; i < d->wake->n_panels(); i++) {
+                if (i < n_panels)
+                    doublets.push_back(d->wake->doublet_coefficients[i]);
+                else
+                    doublets.push_back(0.0);
+                sources.push_back(0.0);
+            }
+        }
+    }
+    
+    accelerator->upload();
+    
+    doublet_coefficients = Map<VectorXd>(doublets.data(), doublets.size());
+    source_coefficients  = Map<VectorXd>(sources.data(), sources.size());
+    
+    return accelerator;
+}
+
+/**
+   Computes the disturbance velocity at a set of points.  The velocity induced by the images of all panels and vortex
+   particles is included, see image_transformations().  These are evaluated on the transformed points, together with
+   the points themselves.
+   
+   @param[in]   x            Points at which the velocity is evaluated, one per column.
+   @param[out]  velocities   Disturbance velocities, one per column.
+*/
+void
+Solver::compute_disturbance_velocities(const Eigen::Matrix3Xd &x, Eigen::Matrix3Xd &velocities) const
+{
+    vector<Matrix3d> images = image_transformations();
+    if (images.size() == 0) {
+        compute_disturbance_velocities_without_images(x, velocities);
+        
+        return;
+    }
+    
+    int n_points = x.cols();
+    
+    Matrix3Xd points(3, (1 + images.size()) * n_points);
+    points.leftCols(n_points) = x;
+    for (int k = 0; k < (int) images.size(); k++)
+        points.middleCols((1 + k) * n_points, n_points) = images[k] * x;
+    
+    Matrix3Xd point_velocities;
+    compute_disturbance_velocities_without_images(points, point_velocities);
+    
+    velocities = point_velocities.leftCols(n_points);
+    for (int k = 0; k < (int) images.size(); k++)
+        velocities += images[k].transpose() * point_velocities.middleCols((1 + k) * n_points, n_points);
+}
+
+/**
+   Computes the disturbance velocity at a set of points, induced by the meshed panels and vortex particles only.  If
+   requested, the treecode or the accelerator backend are used.  Otherwise, the points are evaluated in tiles, so that
+   the data of every panel is reused for all points of a tile while it is in cache.
+   
+   @param[in]   x            Points at which the velocity is evaluated, one per column.
+   @param[out]  velocities   Disturbance velocities, one per column.
+*/
+void
+Solver::compute_disturbance_velocities_without_images(const Eigen::Matrix3Xd &x, Eigen::Matrix3Xd &velocities) const
+{
+    int n_points = x.cols();
+    
+    velocities.resize(3, n_points);
+    
+    int i;
+    
+    // Use a treecode, if requested:
+    if (parameters.treecode_opening_angle > 0) {
+        shared_ptr<Treecode> treecode = build_treecode();
+        
+        #pragma omp parallel
+        {
+            #pragma omp for schedule(dynamic, 1)
+            for (i = 0; i < n_points; i++)
+                velocities.col(i) = treecode->velocity(x.col(i));
+        }
+        
+        return;
+    }
+    
+    // Use the accelerator backend, if requested.  Wakes that are not handled by the accelerator are evaluated in the
+    // tiles below:
+    bool accelerated = parameters.use_accelerator;
+    if (accelerated) {
+        VectorXd accelerator_doublet_coefficients, accelerator_source_coefficients;
+        shared_ptr<Accelerator> accelerator = build_accelerator(true, true, accelerator_doublet_coefficients, accelerator_source_coefficients);
+        
+        accelerator->velocities(x, accelerator_doublet_coefficients, accelerator_source_coefficients, velocities);
+        
+    } else
+        velocities.setZero();
+        
+    int n_tiles = (n_points + POINT_TILE_SIZE - 1) / POINT_TILE_SIZE;
+    
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(dynamic, 1)
+        for (i = 0; i < n_tiles; i++) {
+            int first_point = i * POINT_TILE_SIZE;
+            int last_point  = min(first_point + POINT_TILE_SIZE, n_points);
+            
+            Matrix3Xd tile_points = x.middleCols(first_point, last_point - first_point);
+            Matrix3Xd tile_velocities(3, last_point - first_point);
+            
+            // Iterate all non-wake surfaces:
+            if (!accelerated) {
+                int offset = 0;
+                
+                vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
+                for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+                    const shared_ptr<Body::SurfaceData> &d = *si;
+                    
+                    for (int j = 0; j < d->surface->n_panels(); j++) {
+                        double doublet_coefficient = doublet_coefficients(offset + j);
+                        double source_coefficient  = source_coefficients(offset + j);
+                        
+                        for (int k = first_point; k < last_point; k++) {
+                            velocities.col(k) += d->surface->vortex_ring_unit_velocity(x.col(k), j) * doublet_coefficient;
+                            velocities.col(k) += d->surface->source_unit_velocity(x.col(k), j) * source_coefficient;
+                        }
+                    }
+                    
+                    offset += d->surface->n_panels();
+                }
+            }
+            
+            // Iterate wakes:
+            vector<shared_ptr<BodyData> >::const_iterator bdi;
+            for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+                const shared_ptr<BodyData> &bd = *bdi;
+                
+                vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
+                for (lsi = bd->body->lifting_surfaces.begin(); lsi != bd->body->lifting_surfaces.end(); lsi++) {
+                    const shared_ptr<Body::LiftingSurfaceData> &d = *lsi;
+                    
+                    if ((!accelerated || typeid(*d->wake.get()) != typeid(Wake)) && d->wake->n_panels() >= d->lifting_surface->n_spanwise_panels()) {
+                        // Evaluate the vortex rings for the entire tile at once:
+                        for (int j = 0; j < d->wake->n_panels(); j++) {
+                            d->wake->vortex_ring_unit_velocity(tile_points, j, tile_velocities);
+                            
+                            velocities.middleCols(first_point, last_point - first_point) += tile_velocities * d->wake->doublet_coefficients[j];
+                        }
+                    }
+                    
+                    for (int j = 0; j < d->wake->n_particles(); j++) {
+                        for (int k = first_point; k < last_point; k++)
+                            velocities.col(k) += d->wake->particle_velocity(x.col(k), j);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+   Computes the disturbance velocity potential at a set of points.  The potential induced by the images of all panels
+   is included, see image_transformations().
+   
+   @param[in]   x     Points at which the velocity potential is evaluated, one per column.
+   @param[out]  phi   Disturbance velocity potentials, one per point.
+*/
+void
+Solver::compute_disturbance_velocity_potentials(const Eigen::Matrix3Xd &x, Eigen::VectorXd &phi) const
+{
+    vector<Matrix3d> images = image_transformations();
+    if (images.size() == 0) {
+        compute_disturbance_velocity_potentials_without_images(x, phi);
+        
+        return;
+    }
+    
+    int n_points = x.cols();
+    
+    Matrix3Xd points(3, (1 + images.size()) * n_points);
+    points.leftCols(n_points) = x;
+    for (int k = 0; k < (int) images.size(); k++)
+        points.middleCols((1 + k) * n_points, n_points) = images[k] * x;
+    
+    VectorXd point_phi;
+    compute_disturbance_velocity_potentials_without_images(points, point_phi);
+    
+    phi = point_phi.head(n_points);
+    for (int k = 0; k < (int) images.size(); k++)
+        phi += point_phi.segment((1 + k) * n_points, n_points);
+}
+
+/**
+   Computes the disturbance velocity potential at a set of points, induced by the meshed panels only.  The points are
+   evaluated in tiles, using the batched panel influence kernels.
+   
+   @param[in]   x     Points at which the velocity potential is evaluated, one per column.
+   @param[out]  phi   Disturbance velocity potentials, one per point.
+*/
+void
+Solver::compute_disturbance_velocity_potentials_without_images(const Eigen::Matrix3Xd &x, Eigen::VectorXd &phi) const
+{
+    int n_points = x.cols();
+    
+    phi.resize(n_points);
+    
+    int n_tiles = (n_points + POINT_TILE_SIZE - 1) / POINT_TILE_SIZE;
+    
+    int i;
+    
+    #pragma omp parallel
+    {
+        VectorXd source_influence(POINT_TILE_SIZE), doublet_influence(POINT_TILE_SIZE);
+        
+        #pragma omp for schedule(dynamic, 1)
+        for (i = 0; i < n_tiles; i++) {
+            int first_point = i * POINT_TILE_SIZE;
+            int n_tile_points = min(POINT_TILE_SIZE, n_points - first_point);
+            
+            Matrix3Xd tile = x.middleCols(first_point, n_tile_points);
+            
+            VectorXd tile_phi = VectorXd::Zero(n_tile_points);
+            
+            // Iterate all non-wake surfaces:
+            int offset = 0;
+            
+            vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
+            for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
+                const shared_ptr<Body::SurfaceData> &d = *si;
+                
+                for (int j = 0; j < d->surface->n_panels(); j++) {
+                    d->surface->source_and_doublet_influence(tile, j, source_influence.head(n_tile_points), doublet_influence.head(n_tile_points));
+                    
+                    tile_phi += doublet_influence.head(n_tile_points) * doublet_coefficients(offset + j);
+                    tile_phi += source_influence.head(n_tile_points) * source_coefficients(offset + j);
+                }
+                
+                offset += d->surface->n_panels();
+            }
+            
+            // Iterate wakes:
+            vector<shared_ptr<BodyData> >::const_iterator bdi;
+            for (bdi = bodies.begin(); bdi != bodies.end(); bdi++) {
+                const shared_ptr<BodyData> &bd = *bdi;
+                
+                vector<shared_ptr<Body::LiftingSurfaceData> >::const_iterator lsi;
+                for (lsi = bd->body->lifting_surfaces.begin(); lsi != bd->body->lifting_surfaces.end(); lsi++) {
+                    const shared_ptr<Body::LiftingSurfaceData> &d = *lsi;
+                    
+                    for (int j = 0; j < d->wake->n_panels(); j++) {
+                        d->wake->source_and_doublet_influence(tile, j, source_influence.head(n_tile_points), doublet_influence.head(n_tile_points));
+                        
+                        tile_phi += doublet_influence.head(n_tile_points) * d->wake->doublet_coefficients[j];
+                    }
+                }
+            }
+            
+            phi.segment(first_point, n_tile_points) = tile_phi;
+        }
+    }
+}
+
 /**
    Computes the vector by which the first wake vortex is offset from the trailing edge.
    
@@ -1455,12 +5992,12 @@ Solver::compute_trailing_edge_vortex_displacement(const shared_ptr<Body> &body,
     Vector3d apparent_velocity = body->node_kinematic_velocity(lifting_surface, lifting_surface->trailing_edge_node(index)) - freestream_velocity;
                     
     Vector3d wake_velocity;
-    if (Parameters::wake_emission_follow_bisector)
+    if (parameters.wake_emission_follow_bisector)
         wake_velocity = apparent_velocity.norm() * lifting_surface->trailing_edge_bisector(index);
     else
         wake_velocity = -apparent_velocity;
     
-    return Parameters::wake_emission_distance_factor * wake_velocity * dt;   
+    return parameters.wake_emission_distance_factor * wake_velocity * dt;   
 }
 
 /**
@@ -1474,16 +6011,12 @@ Solver::compute_trailing_edge_vortex_displacement(const shared_ptr<Body> &body,
 int
 Solver::compute_index(const shared_ptr<Surface> &surface, int panel) const
 {
-    int offset = 0;
-    vector<shared_ptr<Body::SurfaceData> >::const_iterator si;
-    for (si = non_wake_surfaces.begin(); si != non_wake_surfaces.end(); si++) {
-        const shared_ptr<Body::SurfaceData> &d = *si;
-        
-        if (surface.get() == d->surface.get())
-            return offset + panel;
+    if (surface->id >= (int) surface_id_to_offset.size())
+        return -1;
         
-        offset += d->surface->n_panels();
-    }
+    int offset = surface_id_to_offset[surface->id];
+    if (offset < 0)
+        return -1;
     
-    return -1;
+    return offset + panel;
 }
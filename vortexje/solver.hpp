@@ -15,14 +15,24 @@
 
 #include <Eigen/Core>
 #include <Eigen/StdVector>
+#include <Eigen/LU>
+#include <Eigen/Sparse>
 
 #include <vortexje/body.hpp>
+#include <vortexje/parameters.hpp>
+#include <vortexje/profiler.hpp>
+#include <vortexje/logger.hpp>
 #include <vortexje/surface-writer.hpp>
 #include <vortexje/boundary-layer.hpp>
+#include <vortexje/treecode.hpp>
+#include <vortexje/hierarchical-matrix.hpp>
+#include <vortexje/accelerator.hpp>
 
 namespace Vortexje
 {
 
+class Monitor;
+
 /**
    Class for solution of the panel method equations, and their propagation in time.
    
@@ -51,7 +61,7 @@ public:
            @param[in]   boundary_layer   Boundary layer model.
         */
         BodyData(std::shared_ptr<Body> body, std::shared_ptr<BoundaryLayer> boundary_layer) :
-            body(body), boundary_layer(boundary_layer) {}
+            body(body), boundary_layer(boundary_layer), gradient_operator_adjacency_revision(-1) {}
         
         /**
            Associated body object.
@@ -62,6 +72,28 @@ public:
            Associated boundary layer model.
         */
         std::shared_ptr<BoundaryLayer> boundary_layer;
+        
+        /**
+           Sparse on-body gradient operator.  Maps the values of a scalar field on the panels of the body to the
+           three components of the gradient of the field on every panel, in the orientation of the body at the time
+           the operator was computed.
+        */
+        Eigen::SparseMatrix<double, Eigen::RowMajor> gradient_operator;
+        
+        /**
+           Geometry revisions of the surfaces of the body at the time the gradient operator was computed.
+        */
+        std::vector<int> gradient_operator_geometry_revisions;
+        
+        /**
+           Accumulated transformations of the surfaces of the body at the time the gradient operator was computed.
+        */
+        std::vector<Eigen::Transform<double, 3, Eigen::Affine>, Eigen::aligned_allocator<Eigen::Transform<double, 3, Eigen::Affine> > > gradient_operator_transformations;
+        
+        /**
+           Adjacency revision of the body at the time the gradient operator was computed.
+        */
+        int gradient_operator_adjacency_revision;
     };
 
     /**
@@ -73,6 +105,8 @@ public:
     
     void add_body(std::shared_ptr<Body> body, std::shared_ptr<BoundaryLayer> boundary_layer);
     
+    void add_monitor(const std::shared_ptr<Monitor> &monitor);
+    
     /**
        Freestream velocity.
     */
@@ -87,6 +121,23 @@ public:
     
     void set_fluid_density(double value);
     
+    /**
+       Parameters of this solver.  These are initialized from the static defaults in Parameters upon construction.
+    */
+    SolverParameters parameters;
+    
+    /**
+       Phase timers and performance counters of this solver.  A step is closed by every call to log().  The profiler
+       may be shared with a SurfaceLoader, so that the loading of meshes is recorded as well.
+    */
+    std::shared_ptr<Profiler> profiler;
+    
+    /**
+       Logger receiving the diagnostic messages of this solver, and of its wakes.  Initialized to
+       Logger::default_logger().
+    */
+    std::shared_ptr<Logger> logger;
+    
     void initialize_wakes(double dt = 0.0);
     
     void update_wakes(double dt = 0.0);
@@ -95,9 +146,76 @@ public:
     
     void propagate();
     
+    /**
+       Operating point of a sweep:  a freestream velocity, and optionally, the kinematic velocities of the bodies.
+       
+       @brief Sweep case.
+    */
+    class SweepCase {
+    public:
+        /**
+           Constructs a SweepCase object.
+           
+           @param[in]   freestream_velocity   Freestream velocity.
+        */
+        SweepCase(const Eigen::Vector3d &freestream_velocity) : freestream_velocity(freestream_velocity) {}
+        
+        /**
+           Freestream velocity.
+        */
+        Eigen::Vector3d freestream_velocity;
+        
+        /**
+           Linear velocity of every body, in the order in which the bodies were added.  Bodies without an entry keep
+           their current velocity.
+        */
+        std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > body_velocities;
+        
+        /**
+           Rotational velocity of every body, in the order in which the bodies were added.  Bodies without an entry
+           keep their current rotational velocity.
+        */
+        std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > body_rotational_velocities;
+    };
+    
+    /**
+       Solution of a sweep case.
+       
+       @brief Sweep result.
+    */
+    class SweepResult {
+    public:
+        /**
+           Pressure coefficients of all non-wake panels, in the order in which the bodies and surfaces were added.
+        */
+        Eigen::VectorXd pressure_coefficients;
+        
+        /**
+           Force on every body.
+        */
+        std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > forces;
+        
+        /**
+           Moment on every body, relative to the body position.
+        */
+        std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > moments;
+    };
+    
+    bool sweep(const std::vector<SweepCase> &cases, std::vector<SweepResult> &results);
+    
+    void require_outputs(const std::shared_ptr<Body> &body);
+    
+    void require_outputs(const std::shared_ptr<Surface> &surface);
+    
+    void require_no_outputs();
+    
+    void require_all_outputs();
+    
     double velocity_potential(const Eigen::Vector3d &x) const;
+    Eigen::VectorXd velocity_potential(const Eigen::Matrix3Xd &x) const;
     
     Eigen::Vector3d velocity(const Eigen::Vector3d &x) const;
+    Eigen::Matrix3Xd velocity(const Eigen::Matrix3Xd &x) const;
     
     double surface_velocity_potential(const std::shared_ptr<Surface> &surface, int panel) const;
     
@@ -108,6 +226,58 @@ public:
     Eigen::Vector3d force(const std::shared_ptr<Body> &body) const;
     Eigen::Vector3d moment(const std::shared_ptr<Body> &body, const Eigen::Vector3d &x) const;
     
+    Eigen::Vector3d force(const std::shared_ptr<Surface> &surface) const;
+    Eigen::Vector3d moment(const std::shared_ptr<Surface> &surface, const Eigen::Vector3d &x) const;
+    
+    void strip_loads(const std::shared_ptr<LiftingSurface> &lifting_surface, const Eigen::Vector3d &x,
+                     Eigen::Matrix3Xd &forces, Eigen::Matrix3Xd &moments) const;
+    
+    /**
+       Derivatives of a component of the force or moment on a body with respect to the node positions of all
+       surfaces, and with respect to the kinematics of the body.  See force_sensitivities().
+       
+       @brief Load sensitivities.
+    */
+    class Sensitivities {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        
+        /**
+           Value of the load component.
+        */
+        double value;
+        
+        /**
+           Non-wake surfaces of the solver, in the order of node_gradients.
+        */
+        std::vector<std::shared_ptr<Surface> > surfaces;
+        
+        /**
+           Derivatives with respect to the node positions.  Column k of node_gradients[i] is the gradient with respect
+           to surfaces[i]->nodes[k].
+        */
+        std::vector<Eigen::Matrix3Xd> node_gradients;
+        
+        /**
+           Derivative with respect to the linear velocity of the body.
+        */
+        Eigen::Vector3d velocity;
+        
+        /**
+           Derivative with respect to the rotational velocity of the body.
+        */
+        Eigen::Vector3d rotational_velocity;
+        
+        /**
+           Derivative with respect to the freestream velocity.
+        */
+        Eigen::Vector3d freestream_velocity;
+    };
+    
+    bool force_sensitivities(const std::shared_ptr<Body> &body, const Eigen::Vector3d &direction, Sensitivities &sensitivities);
+    
+    bool moment_sensitivities(const std::shared_ptr<Body> &body, const Eigen::Vector3d &x, const Eigen::Vector3d &axis, Sensitivities &sensitivities);
+    
     /**
        Data structure bundling a Surface, a panel ID, and a point on the panel.
        
@@ -145,33 +315,269 @@ public:
     
     std::vector<SurfacePanelPoint, Eigen::aligned_allocator<SurfacePanelPoint> > trace_streamline(const SurfacePanelPoint &start) const;
     
+    /**
+       Set of streamlines, stored in a single, flat array of points.
+       
+       @brief Streamline set.
+    */
+    class Streamlines {
+    public:
+        /**
+           Index of the first point of every streamline, followed by the total number of points.  The points of
+           streamline i are points[offsets[i]] up to, but excluding, points[offsets[i + 1]].
+        */
+        std::vector<int> offsets;
+        
+        /**
+           Points of all streamlines.
+        */
+        std::vector<SurfacePanelPoint, Eigen::aligned_allocator<SurfacePanelPoint> > points;
+        
+        /**
+           Returns the number of streamlines.
+           
+           @returns Number of streamlines.
+        */
+        int n_streamlines() const { return offsets.empty() ? 0 : (int) offsets.size() - 1; }
+    };
+    
+    void trace_streamlines(const std::vector<SurfacePanelPoint, Eigen::aligned_allocator<SurfacePanelPoint> > &seeds, Streamlines &streamlines) const;
+    
     void log(int step_number, SurfaceWriter &writer) const;
+    
+    /**
+       Snapshot of the data written by log(), consisting of one entry per surface or wake.  The snapshot may be
+       written after the solver has moved on to subsequent time steps, see AsyncLogger.
+       
+       @brief Snapshot of the logged solver state.
+    */
+    class LogSnapshot {
+    public:
+        /**
+           Surfaces to write.  These are either the surfaces of the solver, or copies of their geometry.
+        */
+        std::vector<std::shared_ptr<Surface> > surfaces;
+        
+        /**
+           Destination filename of every surface.  If the writer supports multiple surfaces, there is a single
+           filename for all surfaces.
+        */
+        std::vector<std::string> filenames;
+        
+        /**
+           Node numbering offset of every surface.
+        */
+        std::vector<int> node_offsets;
+        
+        /**
+           Panel numbering offset of every surface.
+        */
+        std::vector<int> panel_offsets;
+        
+        /**
+           Names of the data vectors of every surface.
+        */
+        std::vector<std::vector<std::string> > view_names;
+        
+        /**
+           Data vectors of every surface.
+        */
+        std::vector<std::vector<Eigen::MatrixXd, Eigen::aligned_allocator<Eigen::MatrixXd> > > view_data;
+    };
+    
+    void log_snapshot(int step_number, const SurfaceWriter &writer, bool copy_geometry, LogSnapshot &snapshot) const;
+    
+    static void write_log_snapshot(const LogSnapshot &snapshot, SurfaceWriter &writer);
+    
+    bool save_checkpoint(const std::string &filename) const;
+    
+    bool load_checkpoint(const std::string &filename);
 
 private:
     std::string log_folder;
     
+    std::vector<std::shared_ptr<Monitor> > monitors;
+    
     std::vector<std::shared_ptr<Body::SurfaceData> > non_wake_surfaces;
     int n_non_wake_panels;
     
-    std::map<int, std::shared_ptr<BodyData> > surface_id_to_body;
+    // Rows of the matrices of influence coefficients owned by this process, in distributed mode:
+    int row_begin;
+    int row_end;
     
-    Eigen::VectorXd source_coefficients;   
+    // Lookup tables indexed by surface ID, and global trailing edge panel indices.  These are built by add_body().
+    std::vector<std::shared_ptr<BodyData> > surface_id_to_body;
+    std::vector<int> surface_id_to_offset;
+    
+    std::vector<int> trailing_edge_upper_indices;
+    std::vector<int> trailing_edge_lower_indices;
+    
+    // The source distribution is swapped for the one of the boundary layer iteration while pending surface velocities
+    // are evaluated using N. Marcov's formula:
+    mutable Eigen::VectorXd source_coefficients;   
     Eigen::VectorXd doublet_coefficients;
         
-    Eigen::VectorXd surface_velocity_potentials;
-    Eigen::MatrixXd surface_velocities;
-    Eigen::VectorXd pressure_coefficients;  
+    // Post-processing outputs.  These are evaluated by solve() for the surfaces whose outputs are required, and upon
+    // first query for all other surfaces; see require_outputs():
+    mutable Eigen::VectorXd surface_velocity_potentials;
+    mutable Eigen::MatrixXd surface_velocities;
+    mutable Eigen::VectorXd pressure_coefficients;  
+    
+    Eigen::VectorXd surface_velocity_potential_time_derivatives;
     
     Eigen::VectorXd previous_surface_velocity_potentials; 
+    
+    // Surfaces whose outputs are evaluated by solve(), indexed by surface ID:
+    bool all_outputs_required;
+    std::vector<bool> required_outputs;
+    
+    mutable Eigen::VectorXd pending_surface_velocity_source_coefficients;
+    
+    // Outputs awaiting evaluation, indexed by surface ID:
+    mutable std::vector<bool> surface_velocities_pending;
+    mutable std::vector<bool> surface_velocity_potentials_pending;
+    mutable std::vector<bool> pressure_coefficients_pending;
+    
+    // Integrated loads, computed upon first query after every solution.  The forces of all panels are kept, and the
+    // force and moment about the origin of every surface, indexed by surface ID:
+    mutable Eigen::Matrix3Xd panel_forces;
+    mutable std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > surface_forces;
+    mutable std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > surface_moments;
+    mutable std::vector<bool> loads_valid;
+    
+    Eigen::MatrixXd wake_induced_velocities;
+    
+    Eigen::MatrixXd source_influence_coefficients;
+    Eigen::MatrixXd doublet_influence_coefficients;
+    
+    std::vector<int> influence_coefficients_geometry_revisions;
+    std::vector<Eigen::Transform<double, 3, Eigen::Affine>, Eigen::aligned_allocator<Eigen::Transform<double, 3, Eigen::Affine> > > influence_coefficients_transformations;
+    bool influence_coefficients_symmetry_plane;
+    int influence_coefficients_cyclic_symmetry_sectors;
+    
+    std::shared_ptr<HierarchicalMatrix> compressed_source_influence_coefficients;
+    std::shared_ptr<HierarchicalMatrix> compressed_doublet_influence_coefficients;
+    
+    Eigen::MatrixXf single_precision_source_influence_coefficients;
+    Eigen::MatrixXf single_precision_doublet_influence_coefficients;
+    
+    Eigen::PartialPivLU<Eigen::MatrixXd> doublet_influence_coefficients_lu;
+    bool doublet_influence_coefficients_factorized;
+    
+    std::vector<int> preconditioner_offsets;
+    std::vector<Eigen::PartialPivLU<Eigen::MatrixXd> > preconditioner_blocks;
+    bool preconditioner_valid;
+    int preconditioner_block_size;
+    int preconditioner_iterations;
+    
+    std::vector<Eigen::VectorXd> recycled_solutions;
+    
+    int n_wake_updates;
+    
+    // Time step of the last solve.  The pressure coefficients contain the time derivative of the velocity potential
+    // unless this is zero:
+    double last_solve_dt;
+    
+    void register_surface(const std::shared_ptr<Surface> &surface, const std::shared_ptr<BodyData> &bd, int offset);
+    
+    void configure_wakes();
+    
+    void set_wake_positions(const Eigen::Matrix3Xd &points);
+    
+    void compute_wake_convection_velocities(const Eigen::Matrix3Xd &points, const std::vector<int> &evaluated_points, Eigen::Matrix3Xd &velocities) const;
+    
+    void log_single_file(int step_number, SurfaceWriter &writer) const;
+    
+    void trace_streamline(const SurfacePanelPoint &start,
+                          const std::vector<Eigen::Transform<double, 3, Eigen::Affine>, Eigen::aligned_allocator<Eigen::Transform<double, 3, Eigen::Affine> > > *inverse_transformations,
+                          std::vector<SurfacePanelPoint, Eigen::aligned_allocator<SurfacePanelPoint> > &streamline) const;
+    
+    std::vector<Eigen::Matrix3d> image_transformations() const;
+    
+    bool influence_coefficients_block_valid(int row_surface, int col_surface) const;
+    
+    void compute_influence_coefficients();
+    
+    std::string influence_coefficient_cache_filename() const;
+    
+    bool read_influence_coefficient_cache(const std::string &filename);
+    
+    void write_influence_coefficient_cache(const std::string &filename) const;
+    
+    void compute_influence_coefficient_blocks(const std::vector<std::pair<int, int> > &blocks);
+    
+    void compute_compressed_influence_coefficients();
+    
+    void compute_wake_influence_coefficients(Eigen::MatrixXd &wake_influence_coefficients,
+                                             std::vector<int> &upper_indices, std::vector<int> &lower_indices) const;
                                           
+    void compute_wake_induced_velocities();
+    
+    void compute_wake_induced_velocities(const Eigen::Matrix3Xd &x, Eigen::Matrix3Xd &velocities) const;
+    
+    void factorize_doublet_influence_coefficients();
+    
+    void compute_preconditioner(const Eigen::MatrixXd &A);
+    
+    bool use_single_precision() const;
+    
+    void compute_source_influence(Eigen::VectorXd &b) const;
+    
+    void compute_doublet_system_residual(const Eigen::MatrixXd &wake_influence_coefficients, const std::vector<int> &upper_indices, const std::vector<int> &lower_indices,
+                                         Eigen::VectorXd &residual, double &rhs_norm) const;
+                                         
+    bool solve_single_precision(const Eigen::MatrixXf &A_single, const Eigen::VectorXd &rhs, const Eigen::MatrixXd &wake_influence_coefficients,
+                                const std::vector<int> &upper_indices, const std::vector<int> &lower_indices, const Eigen::VectorXd &guess);
+    
+    Eigen::VectorXd compute_recycled_guess(const Eigen::MatrixXd &A, const Eigen::VectorXd &b, const Eigen::VectorXd &fallback) const;
+    
+    void compute_wake_correction(const Eigen::MatrixXd &wake_influence_coefficients, const std::vector<int> &upper_indices, const std::vector<int> &lower_indices,
+                                 Eigen::MatrixXd &wake_correction, Eigen::PartialPivLU<Eigen::MatrixXd> &wake_capacitance_lu) const;
+    
+    Eigen::VectorXd apply_wake_correction(const Eigen::VectorXd &y, const std::vector<int> &upper_indices, const std::vector<int> &lower_indices,
+                                          const Eigen::MatrixXd &wake_correction, const Eigen::PartialPivLU<Eigen::MatrixXd> &wake_capacitance_lu) const;
+    
+    void apply_sweep_case(const SweepCase &sweep_case);
+    
+    void store_sweep_result(SweepResult &result) const;
+    
+    void compute_source_coefficients(bool include_wake_influence);
+    
+    void update_wake_doublet_coefficients();
+    
+    void compute_pressure_coefficients(double dt);
+    
+    void compute_pressure_coefficients(const std::shared_ptr<Surface> &surface) const;
+    
+    void compute_surface_velocity_potentials(const std::shared_ptr<Surface> &surface) const;
+    
+    bool outputs_required(const std::shared_ptr<Surface> &surface) const;
+    
+    void evaluate_surface_velocities(const std::shared_ptr<Surface> &surface) const;
+    
+    void evaluate_surface_velocity_potentials(const std::shared_ptr<Surface> &surface) const;
+    
+    void evaluate_pressure_coefficients(const std::shared_ptr<Surface> &surface) const;
+    
+    void evaluate_pending_outputs() const;
+    
+    bool evaluate_loads(const std::shared_ptr<Surface> &surface) const;
+    
+    void compute_loads(const std::shared_ptr<BodyData> &bd) const;
+    
     double compute_source_coefficient(const std::shared_ptr<Body> &body, const std::shared_ptr<Surface> &surface, int panel,
-                                      const std::shared_ptr<BoundaryLayer> &boundary_layer, bool include_wake_influence) const;
+                                      double blowing_velocity, bool include_wake_influence) const;
     
     double compute_surface_velocity_potential(const std::shared_ptr<Surface> &surface, int offset, int panel) const;
     
     double compute_surface_velocity_potential_time_derivative(int offset, int panel, double dt) const;
     
-    Eigen::Vector3d compute_surface_velocity(const std::shared_ptr<Body> &body, const std::shared_ptr<Surface> &surface, int panel) const;
+    void compute_surface_velocities();
+    
+    void compute_surface_velocities(const std::shared_ptr<BodyData> &bd) const;
+    
+    Eigen::Vector3d compute_surface_velocity(const std::shared_ptr<Body> &body, const std::shared_ptr<Surface> &surface, int panel,
+                                             const Eigen::Vector3d &disturbance_velocity) const;
     
     double compute_reference_velocity_squared(const std::shared_ptr<Body> &body) const;
 
@@ -179,11 +585,51 @@ private:
     
     Eigen::Vector3d compute_disturbance_velocity(const Eigen::Vector3d &x) const;
     
+    Eigen::Vector3d compute_disturbance_velocity_without_images(const Eigen::Vector3d &x) const;
+    
     double compute_disturbance_velocity_potential(const Eigen::Vector3d &x) const;
     
+    double compute_disturbance_velocity_potential_without_images(const Eigen::Vector3d &x) const;
+    
+    std::shared_ptr<Treecode> build_treecode() const;
+    
+    std::shared_ptr<Accelerator> build_accelerator(bool include_non_wake_surfaces, bool include_new_wake_panels,
+                                                   Eigen::VectorXd &doublet_coefficients, Eigen::VectorXd &source_coefficients) const;
+    
+    void compute_disturbance_velocities(const Eigen::Matrix3Xd &x, Eigen::Matrix3Xd &velocities) const;
+    
+    void compute_disturbance_velocities_without_images(const Eigen::Matrix3Xd &x, Eigen::Matrix3Xd &velocities) const;
+    
+    void compute_disturbance_velocity_potentials(const Eigen::Matrix3Xd &x, Eigen::VectorXd &phi) const;
+    
+    void compute_disturbance_velocity_potentials_without_images(const Eigen::Matrix3Xd &x, Eigen::VectorXd &phi) const;
+    
     Eigen::Vector3d compute_trailing_edge_vortex_displacement(const std::shared_ptr<Body> &body, const std::shared_ptr<LiftingSurface> &lifting_surface, int index, double dt) const;
 
-    Eigen::Vector3d compute_scalar_field_gradient(const Eigen::VectorXd &scalar_field, const std::shared_ptr<Body> &body, const std::shared_ptr<Surface> &surface, int panel) const;
+    bool gradient_operator_valid(const std::shared_ptr<BodyData> &bd, Eigen::Matrix3d &rotation) const;
+    
+    void compute_gradient_operator(const std::shared_ptr<BodyData> &bd) const;
+    
+    const Body::PanelNeighbor *compute_gradient_weights(const std::shared_ptr<Body> &body, int surface_index, int panel, int &n_neighbors,
+                                                        Eigen::Matrix<double, 3, Eigen::Dynamic> &weights,
+                                                        const std::shared_ptr<Surface> &perturbed_surface = std::shared_ptr<Surface>()) const;
+    
+    bool compute_sensitivities(const std::shared_ptr<Body> &body, const Eigen::Vector3d &weight, bool moment, const Eigen::Vector3d &x,
+                               Sensitivities &sensitivities);
+    
+    double compute_load_contribution(const std::shared_ptr<Body> &body, const std::shared_ptr<Surface> &surface, int panel,
+                                     const Eigen::Vector3d &disturbance_velocity, const Eigen::Vector3d &weight, bool moment, const Eigen::Vector3d &x) const;
+    
+    double compute_local_load(const std::shared_ptr<Body> &body, const std::shared_ptr<Surface> &perturbed_surface,
+                              const std::vector<std::pair<int, int> > &panels,
+                              const Eigen::Vector3d &weight, bool moment, const Eigen::Vector3d &x) const;
+    
+    double compute_local_adjoint_residual(const Eigen::VectorXd &adjoint, const Eigen::VectorXd &masked_adjoint,
+                                          const std::vector<Eigen::Matrix3d> &images, const Eigen::Matrix3Xd &collocation_points,
+                                          const std::vector<Eigen::Matrix3Xd> &image_collocation_points,
+                                          const std::shared_ptr<Surface> &surface, const std::vector<int> &panels,
+                                          const std::vector<std::shared_ptr<Surface> > &wakes, const std::vector<int> &wake_panels,
+                                          const Eigen::VectorXd &wake_doublet_coefficients, const std::vector<int> &wake_columns) const;
     
     int compute_index(const std::shared_ptr<Surface> &surface, int panel) const;
 };
@@ -171,7 +171,7 @@ SurfaceBuilder::create_panels_between_shapes(const vector<int> &first_nodes, con
             
         default:
             // Unknown panel type:
-            cerr << "SurfaceBuilder::create_panels_between_shapes: Cannot create panel with " << unique_nodes.size() << " vertices." << endl;
+            VORTEXJE_LOG(surface.logger, Logger::Error, "SurfaceBuilder::create_panels_between_shapes: Cannot create panel with " << unique_nodes.size() << " vertices.");
             exit(1);
         }
         
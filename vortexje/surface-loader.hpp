@@ -12,6 +12,7 @@
 #include <string>
 
 #include <vortexje/surface.hpp>
+#include <vortexje/profiler.hpp>
 
 namespace Vortexje
 {
@@ -45,6 +46,11 @@ public:
        @returns true on success.
     */
     virtual bool load(std::shared_ptr<Surface> surface, const std::string &filename) = 0;
+    
+    /**
+       Optional profiler, to which the time spent loading, and the numbers of loaded nodes and panels, are added.
+    */
+    std::shared_ptr<Profiler> profiler;
 };
 
 };
@@ -0,0 +1,249 @@
+//
+// Vortexje -- Cached surface loader.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include <vortexje/surface-loaders/cached-surface-loader.hpp>
+#include <vortexje/checkpoint.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+// Cache file extension, and cache layout version:
+#define CACHE_EXTENSION ".vjmesh"
+#define CACHE_VERSION   1
+
+// Counter used to name temporary cache files uniquely within this process:
+static atomic<int> temporary_file_counter(0);
+
+/**
+   Constructs a CachedSurfaceLoader.
+   
+   @param[in]   loader   Loader used to parse source files that have not been cached yet.
+*/
+CachedSurfaceLoader::CachedSurfaceLoader(SurfaceLoader &loader) : loader(loader)
+{
+}
+
+/**
+   Returns the file extension of the wrapped loader.
+   
+   @returns The file extension.
+*/
+const char *
+CachedSurfaceLoader::file_extension() const
+{
+    return loader.file_extension();
+}
+
+/**
+   Loads a surface from the cache, if it is valid, or from the source file otherwise.  In the latter case, the
+   cache is written.
+
+   @param[in]   surface    Surface to load to.
+   @param[in]   filename   Filename pointing to the source file to load.
+   
+   @returns true on success.
+*/
+bool
+CachedSurfaceLoader::load(shared_ptr<Surface> surface, const string &filename)
+{
+    Profiler::Timer timer(profiler, "load_cached_mesh");
+    
+    struct stat source_stat;
+    if (stat(filename.c_str(), &source_stat) < 0) {
+        VORTEXJE_LOG(surface->logger, Logger::Error, "Surface " << surface->id << ": Unable to open " << filename << ".");
+        
+        return false;
+    }
+    
+    int64_t source_size = source_stat.st_size;
+    int64_t source_time = source_stat.st_mtime;
+    
+    string cache_filename = filename + CACHE_EXTENSION;
+    
+    if (load_cache(surface, cache_filename, source_size, source_time)) {
+        if (profiler)
+            profiler->increment("mesh_cache_hits");
+            
+        return true;
+    }
+        
+    // Parse source file:
+    if (!loader.load(surface, filename))
+        return false;
+        
+    save_cache(surface, cache_filename, source_size, source_time);
+    
+    if (profiler)
+        profiler->increment("mesh_cache_misses");
+    
+    return true;
+}
+
+// Loads the surface from the cache, if it was written for the given version of the source file.
+bool
+CachedSurfaceLoader::load_cache(shared_ptr<Surface> surface, const string &cache_filename, int64_t source_size, int64_t source_time)
+{
+    CheckpointReader reader(cache_filename);
+    if (!reader.good())
+        return false;
+        
+    int64_t version, size, time;
+    if (!reader.read(version) || version != CACHE_VERSION ||
+        !reader.read(size) || size != source_size ||
+        !reader.read(time) || time != source_time)
+        return false;
+        
+    vector<Vector3d, Eigen::aligned_allocator<Vector3d> > nodes;
+    vector<int> panel_node_counts, panel_node_list;
+    vector<int> neighbor_offsets, neighbor_edges, neighbor_panels, neighbor_panel_edges;
+    
+    if (!reader.read(nodes) || !reader.read(panel_node_counts) || !reader.read(panel_node_list) ||
+        !reader.read(neighbor_offsets) || !reader.read(neighbor_edges) || !reader.read(neighbor_panels) || !reader.read(neighbor_panel_edges))
+        return false;
+        
+    int n_panels = panel_node_counts.size();
+    int n_nodes  = nodes.size();
+    
+    if ((int) neighbor_offsets.size() != n_panels + 1 || neighbor_offsets[0] != 0 || neighbor_offsets[n_panels] != (int) neighbor_edges.size() ||
+        neighbor_edges.size() != neighbor_panels.size() || neighbor_edges.size() != neighbor_panel_edges.size())
+        return false;
+        
+    // Build and validate the data structures before touching the surface, so that a corrupt cache leaves the surface
+    // untouched for the wrapped loader:
+    vector<shared_ptr<vector<int> > > node_panel_neighbors;
+    node_panel_neighbors.reserve(n_nodes);
+    for (int i = 0; i < n_nodes; i++)
+        node_panel_neighbors.push_back(make_shared<vector<int> >());
+        
+    // Panels:
+    vector<vector<int> > panel_nodes;
+    panel_nodes.reserve(n_panels);
+    
+    int offset = 0;
+    for (int i = 0; i < n_panels; i++) {
+        if (panel_node_counts[i] < 3 || panel_node_counts[i] > Surface::max_panel_nodes ||
+            offset + panel_node_counts[i] > (int) panel_node_list.size())
+            return false;
+            
+        vector<int> single_panel_nodes(panel_node_list.begin() + offset, panel_node_list.begin() + offset + panel_node_counts[i]);
+        for (int j = 0; j < (int) single_panel_nodes.size(); j++) {
+            if (single_panel_nodes[j] < 0 || single_panel_nodes[j] >= n_nodes)
+                return false;
+                
+            node_panel_neighbors[single_panel_nodes[j]]->push_back(i);
+        }
+        
+        panel_nodes.push_back(single_panel_nodes);
+        
+        offset += panel_node_counts[i];
+    }
+    
+    // Topology:
+    vector<map<int, pair<int, int> > > panel_neighbors;
+    panel_neighbors.reserve(n_panels);
+    
+    for (int i = 0; i < n_panels; i++) {
+        if (neighbor_offsets[i] > neighbor_offsets[i + 1])
+            return false;
+            
+        map<int, pair<int, int> > single_panel_neighbors;
+        for (int j = neighbor_offsets[i]; j < neighbor_offsets[i + 1]; j++) {
+            if (neighbor_edges[j] < 0 || neighbor_edges[j] >= panel_node_counts[i] ||
+                neighbor_panels[j] < 0 || neighbor_panels[j] >= n_panels ||
+                neighbor_panel_edges[j] < 0 || neighbor_panel_edges[j] >= panel_node_counts[neighbor_panels[j]])
+                return false;
+                
+            single_panel_neighbors[neighbor_edges[j]] = make_pair(neighbor_panels[j], neighbor_panel_edges[j]);
+        }
+        
+        panel_neighbors.push_back(single_panel_neighbors);
+    }
+    
+    VORTEXJE_LOG(surface->logger, Logger::Info, "Surface " << surface->id << ": Loading from cache " << cache_filename << ".");
+    
+    surface->nodes.swap(nodes);
+    surface->node_panel_neighbors.swap(node_panel_neighbors);
+    surface->panel_nodes.swap(panel_nodes);
+    surface->panel_neighbors.swap(panel_neighbors);
+    
+    // Compute panel geometry:
+    surface->compute_geometry();
+    
+    return true;
+}
+
+// Saves the nodes, panels, and topology of the surface into the cache.
+bool
+CachedSurfaceLoader::save_cache(shared_ptr<Surface> surface, const string &cache_filename, int64_t source_size, int64_t source_time)
+{
+    // Write to a temporary file, which is renamed once complete, so that readers never see a partial cache.  The name
+    // is unique to this writer, so that concurrent writers never rename each other's partial files:
+    stringstream ss;
+    ss << cache_filename << "." << getpid() << "." << temporary_file_counter++ << ".tmp";
+    
+    string temporary_filename = ss.str();
+    
+    {
+        CheckpointWriter writer(temporary_filename);
+        
+        writer.write((int64_t) CACHE_VERSION);
+        writer.write(source_size);
+        writer.write(source_time);
+        
+        writer.write(surface->nodes);
+        
+        vector<int> panel_node_counts, panel_node_list;
+        for (int i = 0; i < surface->n_panels(); i++) {
+            panel_node_counts.push_back(surface->panel_nodes[i].size());
+            panel_node_list.insert(panel_node_list.end(), surface->panel_nodes[i].begin(), surface->panel_nodes[i].end());
+        }
+        
+        writer.write(panel_node_counts);
+        writer.write(panel_node_list);
+        
+        // The compact neighbor tables are kept up to date with the panel neighbor maps:
+        writer.write(surface->panel_neighbor_offsets);
+        writer.write(surface->panel_neighbor_edges);
+        writer.write(surface->panel_neighbor_panels);
+        writer.write(surface->panel_neighbor_panel_edges);
+        
+        if (!writer.good()) {
+            VORTEXJE_LOG(surface->logger, Logger::Error, "Surface " << surface->id << ": Unable to write cache " << cache_filename << ".");
+            
+            remove(temporary_filename.c_str());
+            
+            return false;
+        }
+    }
+    
+    if (rename(temporary_filename.c_str(), cache_filename.c_str()) != 0) {
+        VORTEXJE_LOG(surface->logger, Logger::Error, "Surface " << surface->id << ": Unable to write cache " << cache_filename << ".");
+        
+        remove(temporary_filename.c_str());
+        
+        return false;
+    }
+    
+    return true;
+}
@@ -0,0 +1,52 @@
+//
+// Vortexje -- Cached surface loader.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#ifndef __CACHED_SURFACE_LOADER_HPP__
+#define __CACHED_SURFACE_LOADER_HPP__
+
+#include <string>
+
+#include <vortexje/surface-loader.hpp>
+
+namespace Vortexje
+{
+
+/**
+   Surface loader that keeps a binary cache of every loaded mesh, next to the source file.
+   
+   The first time a mesh is loaded, it is parsed using the wrapped loader, after which its nodes, panels, and
+   topology are stored in a cache file with the same name as the source file, with the extension ".vjmesh" appended.
+   Subsequent loads of the same, unmodified source file read the cache instead.  The cache uses the record format of
+   CheckpointWriter.  The panel geometry is recomputed upon loading from cache.
+   
+   The cache is keyed by the size and the modification time of the source file.  As the modification time may have a
+   resolution of one second, a source file that is rewritten with the same size within the same second as the cache
+   was written may go unnoticed.
+   
+   @brief Cached surface loader.
+*/
+class CachedSurfaceLoader : public SurfaceLoader
+{
+public:
+    CachedSurfaceLoader(SurfaceLoader &loader);
+    
+    const char *file_extension() const;
+    
+    bool load(std::shared_ptr<Surface> surface, const std::string &filename);
+    
+private:
+    SurfaceLoader &loader;
+    
+    bool load_cache(std::shared_ptr<Surface> surface, const std::string &cache_filename, int64_t source_size, int64_t source_time);
+    
+    bool save_cache(std::shared_ptr<Surface> surface, const std::string &cache_filename, int64_t source_size, int64_t source_time);
+};
+
+};
+
+#endif // __CACHED_SURFACE_LOADER_HPP__
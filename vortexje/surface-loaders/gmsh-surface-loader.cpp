@@ -9,6 +9,7 @@
 #include <cmath>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 
 #include <vortexje/surface-loaders/gmsh-surface-loader.hpp>
 
@@ -27,8 +28,71 @@ GmshSurfaceLoader::file_extension() const
     return ".msh";
 }
 
+// Returns the number of nodes of a Gmsh element type, or -1 if the type is not known.
+static int
+element_type_n_nodes(int type)
+{
+    switch (type) {
+    case 1:  return 2;  // 2-node line.
+    case 2:  return 3;  // 3-node triangle.
+    case 3:  return 4;  // 4-node quadrangle.
+    case 4:  return 4;  // 4-node tetrahedron.
+    case 5:  return 8;  // 8-node hexahedron.
+    case 6:  return 6;  // 6-node prism.
+    case 7:  return 5;  // 5-node pyramid.
+    case 8:  return 3;  // 3-node second order line.
+    case 9:  return 6;  // 6-node second order triangle.
+    case 10: return 9;  // 9-node second order quadrangle.
+    case 11: return 10; // 10-node second order tetrahedron.
+    case 15: return 1;  // 1-node point.
+    case 16: return 8;  // 8-node second order quadrangle.
+    default: return -1;
+    }
+}
+
+// Reads a single value from an MSH 4.1 section, in either binary or ASCII representation.
+template <class T>
+static bool
+read_value(ifstream &f, bool binary, T &value)
+{
+    if (binary)
+        f.read((char *) &value, sizeof(T));
+    else
+        f >> value;
+        
+    return f.good();
+}
+
+// Skips the remainder of a section, up to and including the given end marker.  The stream must be positioned at the
+// start of a line.  In binary sections, the marker is searched for byte by byte.
+static bool
+skip_section(ifstream &f, const string &end_marker)
+{
+    string marker = "\n" + end_marker;
+    
+    // The current position counts as the start of a line:
+    size_t matched = 1;
+    char c;
+    while (f.get(c)) {
+        if (c == marker[matched]) {
+            matched++;
+            if (matched == marker.size())
+                break;
+        } else
+            matched = (c == marker[0]) ? 1 : 0;
+    }
+    
+    string line;
+    getline(f, line);
+    
+    return !f.fail();
+}
+
 /**
-   Loads and parses the contents of a Gmsh MSH file into a surface->
+   Loads and parses the contents of a Gmsh MSH file into a surface.  Both the MSH 2.2 ASCII format, and the MSH 4.1
+   ASCII and binary formats are supported.  Only triangles and quadrangles are read.  Elements of types that are
+   unknown to the loader, such as elements of third or higher order, are skipped in ASCII files, but make the loading
+   of a binary MSH 4.1 file fail.  The surface is left unchanged if the file cannot be parsed.
 
    @param[in]   surface    Surface to load to.
    @param[in]   filename   Filename pointing to the Gmsh MSH file to load.
@@ -38,12 +102,72 @@ GmshSurfaceLoader::file_extension() const
 bool
 GmshSurfaceLoader::load(shared_ptr<Surface> surface, const string &filename)
 {
-    cout << "Surface " << surface->id << ": Loading from " << filename << "." << endl;
+    VORTEXJE_LOG(surface->logger, Logger::Info, "Surface " << surface->id << ": Loading from " << filename << ".");
+    
+    Profiler::Timer timer(profiler, "load_mesh");
     
-    // Load surface from gmsh MSH file:
+    // Determine the format of the gmsh MSH file:
     ifstream f;
-    f.open(filename.c_str());
+    f.open(filename.c_str(), ios::in | ios::binary);
+    
+    string line, version;
+    int file_type = -1, data_size = -1;
+    
+    getline(f, line);
+    if (line == "$MeshFormat") {
+        getline(f, line);
+        
+        istringstream tokens(line);
+        tokens >> version >> file_type >> data_size;
+    }
     
+    // Parse into a local mesh first, so that a malformed file leaves the surface untouched:
+    Mesh mesh;
+    
+    bool success;
+    if (version == "2.2" && file_type == 0 && data_size == 8) {
+        success = load_msh2(surface, f, mesh);
+        
+    } else if (version == "4.1" && (file_type == 0 || file_type == 1) && data_size == 8) {
+        success = load_msh4(surface, f, file_type == 1, mesh);
+        
+    } else {
+        VORTEXJE_LOG(surface->logger, Logger::Error, "Surface " << surface->id << ": Unknown data format in " << filename << ".");
+        
+        success = false;
+    }
+    
+    f.close();
+    
+    if (!success) {
+        VORTEXJE_LOG(surface->logger, Logger::Error, "Surface " << surface->id << ": Unable to parse " << filename << ".");
+        
+        return false;
+    }
+    
+    surface->nodes.swap(mesh.nodes);
+    surface->node_panel_neighbors.swap(mesh.node_panel_neighbors);
+    surface->panel_nodes.swap(mesh.panel_nodes);
+            
+    // Compute surface topology:
+    surface->compute_topology();
+    
+    // Compute panel geometry:
+    surface->compute_geometry();
+    
+    if (profiler) {
+        profiler->increment("loaded_nodes", surface->n_nodes());
+        profiler->increment("loaded_panels", surface->n_panels());
+    }
+    
+    // Done:
+    return true;
+}
+
+// Parses the sections of an MSH 2.2 ASCII file, following the $MeshFormat header line.
+bool
+GmshSurfaceLoader::load_msh2(shared_ptr<Surface> surface, ifstream &f, Mesh &mesh)
+{
     bool in_nodes = false, in_elements = false;
     int current_panel = 0;
     while (f.good()) {
@@ -51,24 +175,7 @@ GmshSurfaceLoader::load(shared_ptr<Surface> surface, const string &filename)
         getline(f, line);
         
         if (line[0] == '$') {
-            if        (line == "$MeshFormat"   ) {
-                getline(f, line);
-                
-                istringstream tokens(line);
-                
-                string version;
-                int file_type, data_size;
-                tokens >> version >> file_type >> data_size;
-                
-                if (version != "2.2" || file_type != 0 || data_size != 8) {
-                    cerr << "Surface " << surface->id << ": Unknown data format in " << filename << "." << endl;
-                    
-                    f.close();
-                    
-                    return false;
-                }
-                
-                getline(f, line);
+            if        (line == "$EndMeshFormat") {
                 
             } else if (line == "$Nodes"        ) {
                 getline(f, line);
@@ -95,10 +202,10 @@ GmshSurfaceLoader::load(shared_ptr<Surface> surface, const string &filename)
             double x, y, z;
             tokens >> node_number >> x >> y >> z;
             
-            surface->nodes.push_back(Vector3d(x, y, z));            
+            mesh.nodes.push_back(Vector3d(x, y, z));            
             
             shared_ptr<vector<int> > neighbor_list = make_shared<vector<int> >();
-            surface->node_panel_neighbors.push_back(neighbor_list);
+            mesh.node_panel_neighbors.push_back(neighbor_list);
             
         } else if (in_elements) {
             istringstream tokens(line);
@@ -127,25 +234,178 @@ GmshSurfaceLoader::load(shared_ptr<Surface> surface, const string &filename)
                 int node;
                 tokens >> node;
                 
+                if (node < 1 || node > (int) mesh.nodes.size())
+                    return false;
+                    
                 single_panel_nodes.push_back(node - 1);
                 
-                surface->node_panel_neighbors[node - 1]->push_back(current_panel);
+                mesh.node_panel_neighbors[node - 1]->push_back(current_panel);
             }
 
-            surface->panel_nodes.push_back(single_panel_nodes);
+            mesh.panel_nodes.push_back(single_panel_nodes);
             
             current_panel++;
         }  
     }
     
-    f.close();
+    return true;
+}
+
+// Parses the sections of an MSH 4.1 file, following the $MeshFormat header line.  Node tags need not be contiguous.
+bool
+GmshSurfaceLoader::load_msh4(shared_ptr<Surface> surface, ifstream &f, bool binary, Mesh &mesh)
+{
+    // The binary header contains the integer 1, to detect the byte order:
+    if (binary) {
+        int one;
+        f.read((char *) &one, sizeof(one));
+        if (!f.good() || one != 1)
+            return false;
+    }
     
-    // Compute surface topology:
-    surface->compute_topology();
+    if (!skip_section(f, "$EndMeshFormat"))
+        return false;
+        
+    // Node tag to node number map:
+    vector<int> node_numbers;
     
-    // Compute panel geometry:
-    surface->compute_geometry();
+    int current_panel = 0;
+    
+    string line;
+    while (getline(f, line)) {
+        if (line.size() > 0 && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+            
+        if (line.size() == 0)
+            continue;
+            
+        if (line == "$Nodes") {
+            size_t n_blocks, n_nodes, min_tag, max_tag;
+            if (!read_value(f, binary, n_blocks) || !read_value(f, binary, n_nodes) ||
+                !read_value(f, binary, min_tag) || !read_value(f, binary, max_tag))
+                return false;
+                
+            node_numbers.assign(max_tag + 1, -1);
+            
+            mesh.nodes.reserve(n_nodes);
+            mesh.node_panel_neighbors.reserve(n_nodes);
+            
+            for (size_t i = 0; i < n_blocks; i++) {
+                int entity_dimension, entity_tag, parametric;
+                size_t n_block_nodes;
+                if (!read_value(f, binary, entity_dimension) || !read_value(f, binary, entity_tag) ||
+                    !read_value(f, binary, parametric) || !read_value(f, binary, n_block_nodes))
+                    return false;
+                    
+                if (entity_dimension < 0 || entity_dimension > 3)
+                    return false;
+                    
+                vector<size_t> tags(n_block_nodes);
+                for (size_t j = 0; j < n_block_nodes; j++) {
+                    if (!read_value(f, binary, tags[j]) || tags[j] > max_tag)
+                        return false;
+                }
+                
+                // Parametric nodes carry one parametric coordinate per dimension of their entity:
+                int n_coordinates = 3 + (parametric ? entity_dimension : 0);
+                
+                for (size_t j = 0; j < n_block_nodes; j++) {
+                    double coordinates[6];
+                    for (int k = 0; k < n_coordinates; k++) {
+                        if (!read_value(f, binary, coordinates[k]))
+                            return false;
+                    }
+                        
+                    node_numbers[tags[j]] = mesh.nodes.size();
+                    
+                    mesh.nodes.push_back(Vector3d(coordinates[0], coordinates[1], coordinates[2]));
+                    
+                    shared_ptr<vector<int> > neighbor_list = make_shared<vector<int> >();
+                    mesh.node_panel_neighbors.push_back(neighbor_list);
+                }
+            }
+            
+            if (!skip_section(f, "$EndNodes"))
+                return false;
+                
+        } else if (line == "$Elements") {
+            size_t n_blocks, n_elements, min_tag, max_tag;
+            if (!read_value(f, binary, n_blocks) || !read_value(f, binary, n_elements) ||
+                !read_value(f, binary, min_tag) || !read_value(f, binary, max_tag))
+                return false;
+                
+            mesh.panel_nodes.reserve(n_elements);
+            
+            for (size_t i = 0; i < n_blocks; i++) {
+                int entity_dimension, entity_tag, element_type;
+                size_t n_block_elements;
+                if (!read_value(f, binary, entity_dimension) || !read_value(f, binary, entity_tag) ||
+                    !read_value(f, binary, element_type) || !read_value(f, binary, n_block_elements))
+                    return false;
+                    
+                if (entity_dimension < 0 || entity_dimension > 3)
+                    return false;
+                    
+                int n_element_nodes = element_type_n_nodes(element_type);
+                if (n_element_nodes < 0) {
+                    // The size of the elements of an unknown type is not known, so that they can only be skipped in
+                    // ASCII files, where every element is on a line of its own:
+                    if (binary) {
+                        VORTEXJE_LOG(surface->logger, Logger::Error, "Surface " << surface->id << ": Unsupported element type " << element_type << " in binary MSH file.");
+                        
+                        return false;
+                    }
+                    
+                    getline(f, line);
+                    
+                    for (size_t j = 0; j < n_block_elements; j++) {
+                        if (!getline(f, line))
+                            return false;
+                    }
+                    
+                    continue;
+                }
+                    
+                // Only read triangles and quadrangles:
+                bool panel = (element_type == 2 || element_type == 3);
+                
+                vector<size_t> tags(1 + n_element_nodes);
+                for (size_t j = 0; j < n_block_elements; j++) {
+                    for (int k = 0; k < 1 + n_element_nodes; k++) {
+                        if (!read_value(f, binary, tags[k]))
+                            return false;
+                    }
+                    
+                    if (!panel)
+                        continue;
+                        
+                    vector<int> single_panel_nodes;
+                    for (int k = 0; k < n_element_nodes; k++) {
+                        if (tags[1 + k] >= node_numbers.size() || node_numbers[tags[1 + k]] < 0)
+                            return false;
+                            
+                        int node = node_numbers[tags[1 + k]];
+                        
+                        single_panel_nodes.push_back(node);
+                        
+                        mesh.node_panel_neighbors[node]->push_back(current_panel);
+                    }
+                    
+                    mesh.panel_nodes.push_back(single_panel_nodes);
+                    
+                    current_panel++;
+                }
+            }
+            
+            if (!skip_section(f, "$EndElements"))
+                return false;
+                
+        } else if (line[0] == '$') {
+            // Skip all other sections:
+            if (!skip_section(f, "$End" + line.substr(1)))
+                return false;
+        }
+    }
     
-    // Done:
     return true;
 }
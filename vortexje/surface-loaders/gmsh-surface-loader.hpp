@@ -10,6 +10,7 @@
 #define __GMSH_SURFACE_LOADER_HPP__
 
 #include <string>
+#include <fstream>
 
 #include <vortexje/surface-loader.hpp>
 
@@ -27,6 +28,19 @@ public:
     const char *file_extension() const;
     
     bool load(std::shared_ptr<Surface> surface, const std::string &filename);
+    
+private:
+    // Nodes and panels parsed from a file, before they are stored in the surface:
+    class Mesh {
+    public:
+        std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > nodes;
+        std::vector<std::shared_ptr<std::vector<int> > > node_panel_neighbors;
+        std::vector<std::vector<int> > panel_nodes;
+    };
+    
+    bool load_msh2(std::shared_ptr<Surface> surface, std::ifstream &f, Mesh &mesh);
+    
+    bool load_msh4(std::shared_ptr<Surface> surface, std::ifstream &f, bool binary, Mesh &mesh);
 };
 
 };
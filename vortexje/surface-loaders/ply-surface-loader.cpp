@@ -70,7 +70,9 @@ face_cb(p_ply_argument argument)
 bool
 PLYSurfaceLoader::load(shared_ptr<Surface> surface, const string &filename)
 {
-    cout << "Surface " << surface->id << ": Loading from " << filename << "." << endl;
+    VORTEXJE_LOG(surface->logger, Logger::Info, "Surface " << surface->id << ": Loading from " << filename << ".");
+    
+    Profiler::Timer timer(profiler, "load_mesh");
     
     this->surface = surface;
     
@@ -102,6 +104,11 @@ PLYSurfaceLoader::load(shared_ptr<Surface> surface, const string &filename)
     // Compute panel geometry:
     surface->compute_geometry();
     
+    if (profiler) {
+        profiler->increment("loaded_nodes", surface->n_nodes());
+        profiler->increment("loaded_panels", surface->n_panels());
+    }
+    
     // Done:
     return true;
 }
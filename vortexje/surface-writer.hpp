@@ -11,6 +11,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <vortexje/surface.hpp>
 
@@ -25,6 +26,13 @@ namespace Vortexje
 class SurfaceWriter
 {
 public:
+    /**
+       Non-owning view of a data vector associating numerical values to each panel of a surface.  The rows correspond
+       to panels, and the columns to components.  Views allow data to be written straight from the solver's global
+       coefficient vectors, without intermediate copies.
+    */
+    typedef Eigen::Map<const Eigen::MatrixXd, 0, Eigen::OuterStride<> > DataView;
+    
     /**
        Destructor.
     */
@@ -57,6 +65,27 @@ public:
     virtual bool write(const std::shared_ptr<Surface> &surface, const std::string &filename,
                        int node_offset, int panel_offset,
                        const std::vector<std::string> &view_names, const std::vector<Eigen::MatrixXd, Eigen::aligned_allocator<Eigen::MatrixXd> > &view_data) = 0;
+                       
+    /**
+       Returns whether this SurfaceWriter can save multiple surfaces into a single file.
+       
+       @returns true if multiple surfaces can be saved into a single file.
+    */
+    virtual bool multiple_surfaces() const { return false; }
+    
+    /**
+       Saves the given surfaces to a single file, including data vectors associating numerical values to each panel.
+       This is only supported if multiple_surfaces() returns true.
+      
+       @param[in]   surfaces     Surfaces to write.
+       @param[in]   filename     Destination filename.
+       @param[in]   view_names   List of names of data vectors to be stored.
+       @param[in]   view_data    For every surface, list of data vectors to be stored.
+       
+       @returns true on success.
+    */
+    virtual bool write(const std::vector<std::shared_ptr<Surface> > &surfaces, const std::string &filename,
+                       const std::vector<std::string> &view_names, const std::vector<std::vector<DataView> > &view_data) { return false; }
 };
 
 };
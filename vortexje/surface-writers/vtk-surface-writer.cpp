@@ -44,7 +44,7 @@ VTKSurfaceWriter::write(const shared_ptr<Surface> &surface, const string &filena
                         int node_offset, int panel_offset,
                         const std::vector<std::string> &view_names, const vector<MatrixXd, Eigen::aligned_allocator<MatrixXd> > &view_data)
 {
-    cout << "Surface " << surface->id << ": Saving to " << filename << "." << endl;
+    VORTEXJE_LOG(surface->logger, Logger::Info, "Surface " << surface->id << ": Saving to " << filename << ".");
     
     // Save surface to VTK file:
     ofstream f;
@@ -98,7 +98,7 @@ VTKSurfaceWriter::write(const shared_ptr<Surface> &surface, const string &filena
             cell_type = 9;
             break;
         default:
-            cerr << "Surface " << surface->id << ": Unknown polygon at panel " << i << "." << endl;
+            VORTEXJE_LOG(surface->logger, Logger::Error, "Surface " << surface->id << ": Unknown polygon at panel " << i << ".");
             continue;
         }
         
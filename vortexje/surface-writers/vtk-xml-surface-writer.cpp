@@ -0,0 +1,239 @@
+//
+// Vortexje -- VTK XML unstructured grid surface writer.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <stdint.h>
+
+#include <vortexje/surface-writers/vtk-xml-surface-writer.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+// Number of rows of a data array that are converted and written at once:
+#define CHUNK_SIZE 4096
+
+// VTK cell types:
+#define VTK_TRIANGLE 5
+#define VTK_QUAD     9
+
+// Writes the size prefix of an appended data array:
+static void
+write_size(ofstream &f, uint64_t n_bytes)
+{
+    f.write((const char *) &n_bytes, sizeof(n_bytes));
+}
+
+// Writes a data view as an interleaved appended data array, in chunks of rows:
+static void
+write_view(ofstream &f, const SurfaceWriter::DataView &view)
+{
+    write_size(f, (uint64_t) view.size() * sizeof(double));
+    
+    vector<double> buffer(min((int) view.rows(), CHUNK_SIZE) * view.cols());
+    
+    for (int first_row = 0; first_row < view.rows(); first_row += CHUNK_SIZE) {
+        int n_rows = min((int) view.rows() - first_row, CHUNK_SIZE);
+        
+        for (int i = 0; i < n_rows; i++)
+            for (int j = 0; j < view.cols(); j++)
+                buffer[i * view.cols() + j] = view(first_row + i, j);
+                
+        f.write((const char *) &buffer[0], n_rows * view.cols() * sizeof(double));
+    }
+}
+
+/**
+   Returns the VTK XML unstructured grid file extension (".vtu").
+   
+   @returns The VTK XML unstructured grid file extension (".vtu").
+*/
+const char *
+VTKXMLSurfaceWriter::file_extension() const
+{
+    return ".vtu";
+}
+
+/**
+   Saves the given surface to a VTK XML file, including data vectors associating numerical values to each panel.
+  
+   @param[in]   surface        Surface to write.
+   @param[in]   filename       Destination filename.
+   @param[in]   node_offset    Node numbering offset in output file.
+   @param[in]   panel_offset   Panel numbering offset in output file.
+   @param[in]   view_names     List of names of data vectors to be stored.
+   @param[in]   view_data      List of data vectors to be stored.
+   
+   @returns true on success.
+*/
+bool
+VTKXMLSurfaceWriter::write(const shared_ptr<Surface> &surface, const string &filename, 
+                           int node_offset, int panel_offset,
+                           const std::vector<std::string> &view_names, const vector<MatrixXd, Eigen::aligned_allocator<MatrixXd> > &view_data)
+{
+    vector<shared_ptr<Surface> > surfaces;
+    surfaces.push_back(surface);
+    
+    vector<vector<DataView> > views(1);
+    for (int k = 0; k < (int) view_data.size(); k++)
+        views[0].push_back(DataView(view_data[k].data(), view_data[k].rows(), view_data[k].cols(), OuterStride<>(view_data[k].rows())));
+        
+    return write(surfaces, filename, view_names, views);
+}
+
+/**
+   Returns true, as multiple surfaces can be saved into a single VTK XML file.
+   
+   @returns true.
+*/
+bool
+VTKXMLSurfaceWriter::multiple_surfaces() const
+{
+    return true;
+}
+
+/**
+   Saves the given surfaces to a single VTK XML file, one piece per surface, including data vectors associating
+   numerical values to each panel.  Every surface must provide the same list of data vectors.
+  
+   @param[in]   surfaces     Surfaces to write.
+   @param[in]   filename     Destination filename.
+   @param[in]   view_names   List of names of data vectors to be stored.
+   @param[in]   view_data    For every surface, list of data vectors to be stored.
+   
+   @returns true on success.
+*/
+bool
+VTKXMLSurfaceWriter::write(const vector<shared_ptr<Surface> > &surfaces, const string &filename,
+                           const vector<string> &view_names, const vector<vector<DataView> > &view_data)
+{
+    shared_ptr<Logger> logger = surfaces.empty() ? Logger::default_logger() : surfaces[0]->logger;
+    
+    VORTEXJE_LOG(logger, Logger::Info, "VTKXMLSurfaceWriter: Saving " << surfaces.size() << " surfaces to " << filename << ".");
+    
+    // Determine the byte order of this machine:
+    const uint16_t byte_order_probe = 1;
+    const char *byte_order;
+    if (*((const uint8_t *) &byte_order_probe) == 1)
+        byte_order = "LittleEndian";
+    else
+        byte_order = "BigEndian";
+    
+    // Save surfaces to VTK XML file:
+    ofstream f;
+    f.open(filename.c_str(), ios::out | ios::binary);
+    
+    f << "<?xml version=\"1.0\"?>" << endl;
+    f << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"" << byte_order << "\" header_type=\"UInt64\">" << endl;
+    f << "  <UnstructuredGrid>" << endl;
+    
+    // Headers of all pieces.  The appended data arrays are stored in the order in which they are declared:
+    uint64_t offset = 0;
+    
+    for (int s = 0; s < (int) surfaces.size(); s++) {
+        const shared_ptr<Surface> &surface = surfaces[s];
+        
+        uint64_t size = 0;
+        for (int i = 0; i < surface->n_panels(); i++)
+            size += surface->panel_nodes[i].size();
+            
+        f << "    <Piece NumberOfPoints=\"" << surface->n_nodes() << "\" NumberOfCells=\"" << surface->n_panels() << "\">" << endl;
+        
+        f << "      <Points>" << endl;
+        f << "        <DataArray type=\"Float64\" NumberOfComponents=\"3\" format=\"appended\" offset=\"" << offset << "\"/>" << endl;
+        f << "      </Points>" << endl;
+        offset += sizeof(uint64_t) + 3 * surface->n_nodes() * sizeof(double);
+        
+        f << "      <Cells>" << endl;
+        f << "        <DataArray type=\"Int32\" Name=\"connectivity\" format=\"appended\" offset=\"" << offset << "\"/>" << endl;
+        offset += sizeof(uint64_t) + size * sizeof(int32_t);
+        f << "        <DataArray type=\"Int32\" Name=\"offsets\" format=\"appended\" offset=\"" << offset << "\"/>" << endl;
+        offset += sizeof(uint64_t) + surface->n_panels() * sizeof(int32_t);
+        f << "        <DataArray type=\"UInt8\" Name=\"types\" format=\"appended\" offset=\"" << offset << "\"/>" << endl;
+        offset += sizeof(uint64_t) + surface->n_panels() * sizeof(uint8_t);
+        f << "      </Cells>" << endl;
+        
+        f << "      <CellData>" << endl;
+        for (int k = 0; k < (int) view_names.size(); k++) {
+            const DataView &view = view_data[s][k];
+            
+            f << "        <DataArray type=\"Float64\" Name=\"" << view_names[k] << "\" NumberOfComponents=\"" << view.cols() << "\" format=\"appended\" offset=\"" << offset << "\"/>" << endl;
+            offset += sizeof(uint64_t) + view.size() * sizeof(double);
+        }
+        f << "      </CellData>" << endl;
+        
+        f << "    </Piece>" << endl;
+    }
+    
+    f << "  </UnstructuredGrid>" << endl;
+    f << "  <AppendedData encoding=\"raw\">" << endl;
+    f << "   _";
+    
+    // Appended data of all pieces:
+    for (int s = 0; s < (int) surfaces.size(); s++) {
+        const shared_ptr<Surface> &surface = surfaces[s];
+        
+        // Points:
+        write_size(f, (uint64_t) 3 * surface->n_nodes() * sizeof(double));
+        
+        for (int i = 0; i < surface->n_nodes(); i++)
+            f.write((const char *) surface->nodes[i].data(), 3 * sizeof(double));
+            
+        // Cells:
+        vector<int32_t>  connectivity;
+        vector<int32_t>  offsets(surface->n_panels());
+        vector<uint8_t>  types(surface->n_panels());
+        
+        for (int i = 0; i < surface->n_panels(); i++) {
+            for (int j = 0; j < (int) surface->panel_nodes[i].size(); j++)
+                connectivity.push_back(surface->panel_nodes[i][j]);
+                
+            offsets[i] = connectivity.size();
+            
+            switch (surface->panel_nodes[i].size()) {
+            case 3:
+                types[i] = VTK_TRIANGLE;
+                break;
+            case 4:
+                types[i] = VTK_QUAD;
+                break;
+            default:
+                VORTEXJE_LOG(surface->logger, Logger::Error, "Surface " << surface->id << ": Unknown polygon at panel " << i << ".");
+                types[i] = 0;
+                break;
+            }
+        }
+        
+        write_size(f, (uint64_t) connectivity.size() * sizeof(int32_t));
+        if (connectivity.size() > 0)
+            f.write((const char *) &connectivity[0], connectivity.size() * sizeof(int32_t));
+            
+        write_size(f, (uint64_t) offsets.size() * sizeof(int32_t));
+        if (offsets.size() > 0)
+            f.write((const char *) &offsets[0], offsets.size() * sizeof(int32_t));
+            
+        write_size(f, (uint64_t) types.size() * sizeof(uint8_t));
+        if (types.size() > 0)
+            f.write((const char *) &types[0], types.size() * sizeof(uint8_t));
+            
+        // Cell data:
+        for (int k = 0; k < (int) view_names.size(); k++)
+            write_view(f, view_data[s][k]);
+    }
+    
+    f << endl;
+    f << "  </AppendedData>" << endl;
+    f << "</VTKFile>" << endl;
+    
+    f.close();
+    
+    // Done:
+    return !f.fail();
+}
@@ -0,0 +1,42 @@
+//
+// Vortexje -- VTK XML unstructured grid surface writer.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#ifndef __VTK_XML_SURFACE_WRITER_HPP__
+#define __VTK_XML_SURFACE_WRITER_HPP__
+
+#include <string>
+
+#include <vortexje/surface-writer.hpp>
+
+namespace Vortexje
+{
+
+/**
+   VTK XML unstructured grid (.vtu) surface file writer.  All data is stored as raw binary appended data.  Multiple
+   surfaces may be saved into a single file, one piece per surface.
+   
+   @brief VTK XML surface writer.
+*/
+class VTKXMLSurfaceWriter : public SurfaceWriter
+{
+public:
+    const char *file_extension() const;
+       
+    bool write(const std::shared_ptr<Surface> &surface, const std::string &filename,
+               int node_offset, int panel_offset,
+               const std::vector<std::string> &view_names, const std::vector<Eigen::MatrixXd, Eigen::aligned_allocator<Eigen::MatrixXd> > &view_data);
+               
+    bool multiple_surfaces() const;
+               
+    bool write(const std::vector<std::shared_ptr<Surface> > &surfaces, const std::string &filename,
+               const std::vector<std::string> &view_names, const std::vector<std::vector<DataView> > &view_data);
+};
+
+};
+
+#endif // __VTK_XML_SURFACE_WRITER_HPP__
@@ -12,6 +12,8 @@
 #include <limits>
 #include <cmath>
 #include <algorithm>
+#include <unordered_map>
+#include <atomic>
 
 #include <Eigen/Geometry>
 
@@ -22,13 +24,35 @@ using namespace std;
 using namespace Eigen;
 using namespace Vortexje;
 
-// Static counter to give every surface a unique ID.
-static int id_counter = 0;
+// Static counter to give every surface a unique ID.  Surfaces may be constructed concurrently by multiple threads:
+static atomic<int> id_counter(0);
 
 // Avoid having to divide by 4 pi all the time:
 static const double pi = 3.141592653589793238462643383279502884;
 static const double one_over_4pi = 1.0 / (4 * pi);
 
+// Vertices of a panel with N vertices, in the panel coordinate system, in fixed-size storage.  The influence kernels
+// below are instantiated for triangles and quadrangles, and selected once per panel.  As N is a compile-time constant,
+// their loops over the edges are unrolled, and the wrap-around of the last edge is resolved at compile time:
+template <int N>
+class PanelVertices
+{
+public:
+    PanelVertices(const Surface &surface, int panel)
+    {
+        for (int i = 0; i < N; i++)
+            nodes[i] = surface.panel_transformed_point(panel, i);
+    }
+    
+    const Vector3d &node_a(int edge) const { return nodes[edge]; }
+    const Vector3d &node_b(int edge) const { return nodes[(edge + 1) % N]; }
+    
+private:
+    Vector3d nodes[N];
+};
+
+const int Surface::max_panel_nodes;
+
 /**
    Constructs an empty surface.
 */
@@ -36,6 +60,14 @@ Surface::Surface()
 {
     // Set ID:
     id = ++id_counter;
+    
+    // Log to the default logger:
+    logger = Logger::default_logger();
+    
+    // No geometry yet:
+    geometry_revision = 0;
+    
+    accumulated_transformation = Transform<double, 3, Affine>::Identity();
 }
 
 /**
@@ -108,69 +140,134 @@ Surface::add_quadrangle(int node_a, int node_b, int node_c, int node_d)
     return panel_id;
 }
 
+// Edge of a panel, keyed by its pair of topological node numbers, smallest first:
+class PanelEdge
+{
+public:
+    int other_node;
+    int panel;
+    int edge;
+    
+    bool operator<(const PanelEdge &other) const
+    {
+        if (other_node != other.other_node)
+            return other_node < other.other_node;
+        return panel < other.panel;
+    }
+};
+
 /**
    Computes neighboring panels of panels, based on existing node-panel data structures.
+   
+   Nodes that share their node_panel_neighbors list are topologically identical.  All panel edges are bucketed by the
+   smallest of their two topological node numbers, after which the edges in each bucket are matched in parallel.
+   The work is linear in the number of edges, for bounded node valence.
 */
 void
 Surface::compute_topology()
-{   
-    // Compute panel neighbors:
-    for (int i = 0; i < (int) panel_nodes.size(); i++) {
-        map<int, pair<int, int> > single_panel_neighbors;
-        
-        // Every node gives rise to one edge, which gives rise to at most one neighbor.
-        for (int j = 0; j < (int) panel_nodes[i].size(); j++) {          
-            // Compute index for next node.
-            int next_j;
-            if (j == (int) panel_nodes[i].size() - 1)
-                next_j = 0;
-            else
-                next_j = j + 1;
-                
-            int node      = panel_nodes[i][j];
-            int next_node = panel_nodes[i][next_j];
+{
+    // Topological node numbers.  A node takes the number of the first node that shares its neighbor list:
+    vector<int> topological_nodes(n_nodes());
+    
+    unordered_map<const vector<int> *, int> first_nodes;
+    first_nodes.reserve(n_nodes());
+    for (int i = 0; i < n_nodes(); i++)
+        topological_nodes[i] = first_nodes.insert(make_pair(node_panel_neighbors[i].get(), i)).first->second;
+    
+    // Count the panel edges per bucket:
+    vector<int> edge_offsets(n_panels() + 1);
+    vector<int> bucket_offsets(n_nodes() + 1, 0);
+    
+    edge_offsets[0] = 0;
+    for (int i = 0; i < n_panels(); i++) {
+        int n_panel_nodes = panel_nodes[i].size();
+        
+        edge_offsets[i + 1] = edge_offsets[i] + n_panel_nodes;
+        
+        for (int j = 0; j < n_panel_nodes; j++) {
+            int node      = topological_nodes[panel_nodes[i][j]];
+            int next_node = topological_nodes[panel_nodes[i][(j + 1) % n_panel_nodes]];
             
-            for (int k = 0; k < (int) node_panel_neighbors[node]->size(); k++) {
-                int potential_neighbor = (*node_panel_neighbors[node])[k];
-                if (potential_neighbor == i)
-                    continue;
-                
-                // Is this neighbor shared with the next node?   
-                if (find(node_panel_neighbors[next_node]->begin(),
-                         node_panel_neighbors[next_node]->end(),
-                         potential_neighbor) != node_panel_neighbors[next_node]->end()) {
-                    // Yes: Establish neighbor relationship.
-                    int potential_neighbor_edge = -1;
-                    for (int l = 0; l < (int) panel_nodes[potential_neighbor].size(); l++) {
-                        int next_l;
-                        if (l == (int) panel_nodes[potential_neighbor].size() - 1)
-                            next_l = 0;
-                        else
-                            next_l = l + 1;
-                            
-                        int potential_neighbor_node      = panel_nodes[potential_neighbor][l];
-                        int potential_neighbor_next_node = panel_nodes[potential_neighbor][next_l];
+            bucket_offsets[min(node, next_node) + 1]++;
+        }
+    }
+    
+    for (int i = 0; i < n_nodes(); i++)
+        bucket_offsets[i + 1] += bucket_offsets[i];
+        
+    // Fill the buckets:
+    vector<PanelEdge> buckets(bucket_offsets[n_nodes()]);
+    vector<int> bucket_sizes(n_nodes(), 0);
+    
+    for (int i = 0; i < n_panels(); i++) {
+        int n_panel_nodes = panel_nodes[i].size();
+        
+        for (int j = 0; j < n_panel_nodes; j++) {
+            int node      = topological_nodes[panel_nodes[i][j]];
+            int next_node = topological_nodes[panel_nodes[i][(j + 1) % n_panel_nodes]];
+            
+            int bucket = min(node, next_node);
+            
+            PanelEdge &panel_edge = buckets[bucket_offsets[bucket] + bucket_sizes[bucket]++];
+            panel_edge.other_node = max(node, next_node);
+            panel_edge.panel      = i;
+            panel_edge.edge       = j;
+        }
+    }
+    
+    // Match the edges that share both nodes.  Every panel edge is touched by exactly one bucket.  If more than two
+    // panels share an edge, the last one in panel order is taken as the neighbor.
+    vector<int> edge_neighbor_panels(edge_offsets[n_panels()], -1);
+    vector<int> edge_neighbor_edges(edge_offsets[n_panels()], -1);
+    
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(dynamic, 1)
+        for (int i = 0; i < n_nodes(); i++) {
+            vector<PanelEdge>::iterator begin = buckets.begin() + bucket_offsets[i];
+            vector<PanelEdge>::iterator end   = buckets.begin() + bucket_offsets[i + 1];
+            
+            sort(begin, end);
+            
+            vector<PanelEdge>::iterator run_begin = begin;
+            while (run_begin != end) {
+                vector<PanelEdge>::iterator run_end = run_begin;
+                while (run_end != end && run_end->other_node == run_begin->other_node)
+                    run_end++;
+                    
+                vector<PanelEdge>::iterator it, jt;
+                for (it = run_begin; it != run_end; it++) {
+                    for (jt = run_begin; jt != run_end; jt++) {
+                        if (jt->panel == it->panel)
+                            continue;
                             
-                        if (find(node_panel_neighbors[potential_neighbor_node]->begin(),
-                                 node_panel_neighbors[potential_neighbor_node]->end(),
-                                 i) != node_panel_neighbors[potential_neighbor_node]->end() &&
-                            find(node_panel_neighbors[potential_neighbor_next_node]->begin(),
-                                 node_panel_neighbors[potential_neighbor_next_node]->end(),
-                                 i) != node_panel_neighbors[potential_neighbor_next_node]->end()) {
-                            potential_neighbor_edge = l;
-                            break;
-                        }
+                        edge_neighbor_panels[edge_offsets[it->panel] + it->edge] = jt->panel;
+                        edge_neighbor_edges[edge_offsets[it->panel] + it->edge]  = jt->edge;
                     }
-                    
-                    assert(potential_neighbor_edge >= 0);
-                    
-                    single_panel_neighbors[j] = make_pair(potential_neighbor, potential_neighbor_edge);
                 }
+                
+                run_begin = run_end;
+            }
+        }
+    }
+    
+    // Store the neighbors:
+    panel_neighbors.resize(n_panels());
+    
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(dynamic, 1)
+        for (int i = 0; i < n_panels(); i++) {
+            panel_neighbors[i].clear();
+            
+            for (int j = edge_offsets[i]; j < edge_offsets[i + 1]; j++) {
+                if (edge_neighbor_panels[j] >= 0)
+                    panel_neighbors[i][j - edge_offsets[i]] = make_pair(edge_neighbor_panels[j], edge_neighbor_edges[j]);
             }
         }
-        
-        panel_neighbors.push_back(single_panel_neighbors);
     }
+    
+    compute_panel_tables(0);
 }
 
 /**
@@ -200,150 +297,323 @@ Surface::cut_panels(int panel_a, int panel_b)
             else    
                 it++;
         }
-    }  
+        
+        // Remove the entries from the compact copy, without rebuilding it:
+        if (panel_ids[0] + 1 < (int) panel_neighbor_offsets.size()) {
+            int n_removed = 0;
+            for (int j = panel_neighbor_offsets[panel_ids[0]]; j < panel_neighbor_offsets[panel_ids[0] + 1]; j++) {
+                if (panel_neighbor_panels[j] == panel_ids[1]) {
+                    n_removed++;
+                } else if (n_removed > 0) {
+                    panel_neighbor_edges[j - n_removed]       = panel_neighbor_edges[j];
+                    panel_neighbor_panels[j - n_removed]      = panel_neighbor_panels[j];
+                    panel_neighbor_panel_edges[j - n_removed] = panel_neighbor_panel_edges[j];
+                }
+            }
+            
+            if (n_removed > 0) {
+                int first = panel_neighbor_offsets[panel_ids[0] + 1] - n_removed;
+                int last  = panel_neighbor_offsets[panel_ids[0] + 1];
+                
+                panel_neighbor_edges.erase(panel_neighbor_edges.begin() + first, panel_neighbor_edges.begin() + last);
+                panel_neighbor_panels.erase(panel_neighbor_panels.begin() + first, panel_neighbor_panels.begin() + last);
+                panel_neighbor_panel_edges.erase(panel_neighbor_panel_edges.begin() + first, panel_neighbor_panel_edges.begin() + last);
+                
+                for (int j = panel_ids[0] + 1; j < (int) panel_neighbor_offsets.size(); j++)
+                    panel_neighbor_offsets[j] -= n_removed;
+            }
+        }
+    }
 }
 
 /**
-   Computes the normals, collocation points, surface areas, and diameters of all panels.
+   Builds the compact copies of the panel-node and panel-panel data structures, for the panels starting at the given
+   panel.  The entries of all preceding panels are kept.
+   
+   @param[in]   first_panel   First panel to build the entries for.
 */
 void
-Surface::compute_geometry()
+Surface::compute_panel_tables(int first_panel)
 {
-    // Normals:
-    cout << "Surface " << id << ": Generating panel normals." << endl;
-        
-    panel_normals.clear();
-    panel_normals.reserve(n_panels());
+    panel_node_counts.resize(n_panels());
+    panel_node_table.resize(max_panel_nodes * n_panels());
     
-    for (int i = 0; i < n_panels(); i++) {
-        vector<int> &single_panel_nodes = panel_nodes[i];
+    for (int i = first_panel; i < n_panels(); i++) {
+        const vector<int> &single_panel_nodes = panel_nodes[i];
         
-        Vector3d normal;
-        if (single_panel_nodes.size() == 3) {
-            Vector3d AB = nodes[single_panel_nodes[1]] - nodes[single_panel_nodes[0]];
-            Vector3d AC = nodes[single_panel_nodes[2]] - nodes[single_panel_nodes[0]];
-            
-            normal = AB.cross(AC);
-            
-        } else { // 4 sides
-            Vector3d AC = nodes[single_panel_nodes[2]] - nodes[single_panel_nodes[0]];
-            Vector3d BD = nodes[single_panel_nodes[3]] - nodes[single_panel_nodes[1]];
-            
-            normal = AC.cross(BD);
+        assert((int) single_panel_nodes.size() <= max_panel_nodes);
+        
+        panel_node_counts[i] = single_panel_nodes.size();
+        
+        for (int j = 0; j < max_panel_nodes; j++) {
+            if (j < (int) single_panel_nodes.size())
+                panel_node_table[max_panel_nodes * i + j] = single_panel_nodes[j];
+            else
+                panel_node_table[max_panel_nodes * i + j] = single_panel_nodes[0];
         }
-
-        normal.normalize();
-
-        panel_normals.push_back(normal);
     }
     
-    // Collocation points: 
-    cout << "Surface " << id << ": Generating panel collocation points." << endl;
+    if (first_panel == 0 || first_panel >= (int) panel_neighbor_offsets.size()) {
+        panel_neighbor_offsets.clear();
+        panel_neighbor_edges.clear();
+        panel_neighbor_panels.clear();
+        panel_neighbor_panel_edges.clear();
+        
+        first_panel = 0;
+        
+    } else {
+        int n_entries = panel_neighbor_offsets[first_panel];
+        
+        panel_neighbor_offsets.resize(first_panel);
+        panel_neighbor_edges.resize(n_entries);
+        panel_neighbor_panels.resize(n_entries);
+        panel_neighbor_panel_edges.resize(n_entries);
+    }
     
-    panel_collocation_points[0].clear();
-    panel_collocation_points[0].reserve(n_panels());
+    panel_neighbor_offsets.reserve(n_panels() + 1);
     
-    panel_collocation_points[1].clear();
-    panel_collocation_points[1].reserve(n_panels());
-
-    for (int i = 0; i < n_panels(); i++) {
-        vector<int> &single_panel_nodes = panel_nodes[i];
+    for (int i = first_panel; i < n_panels(); i++) {
+        panel_neighbor_offsets.push_back(panel_neighbor_edges.size());
         
-        Vector3d collocation_point(0, 0, 0);
-        for (int j = 0; j < (int) single_panel_nodes.size(); j++)
-            collocation_point = collocation_point + nodes[single_panel_nodes[j]];
-
-        collocation_point = collocation_point / single_panel_nodes.size();
-            
-        panel_collocation_points[0].push_back(collocation_point);
+        if (i >= (int) panel_neighbors.size())
+            continue;
         
-        Vector3d below_surface_collocation_point = collocation_point + Parameters::collocation_point_delta * panel_normal(i);
-        panel_collocation_points[1].push_back(below_surface_collocation_point);
+        map<int, pair<int, int> >::const_iterator it;
+        for (it = panel_neighbors[i].begin(); it != panel_neighbors[i].end(); it++) {
+            panel_neighbor_edges.push_back(it->first);
+            panel_neighbor_panels.push_back(it->second.first);
+            panel_neighbor_panel_edges.push_back(it->second.second);
+        }
     }
     
-    // Coordinate transformations:
-    cout << "Surface " << id << ": Generating panel coordinate transformations." << endl;
-        
-    panel_coordinate_transformations.clear();
-    panel_coordinate_transformations.reserve(n_panels());
+    panel_neighbor_offsets.push_back(panel_neighbor_edges.size());
+}
+
+/**
+   Computes the normals, collocation points, surface areas, and diameters of all panels.
+*/
+void
+Surface::compute_geometry()
+{
+    compute_geometry(0);
+}
+
+/**
+   Computes the normals, collocation points, surface areas, and diameters of the panels starting at the given panel.
+   The geometry of all preceding panels is kept, and their nodes must not have moved since it was last computed.
+   Use this to update the geometry of a surface of which only the last panels changed, or to which panels were
+   appended.
+   
+   @param[in]   first_panel   First panel to compute the geometry of.
+*/
+void
+Surface::compute_geometry(int first_panel)
+{
+    // Only report full updates:
+    if (first_panel == 0)
+        VORTEXJE_LOG(logger, Logger::Debug, "Surface " << id << ": Generating panel geometry.");
     
-    panel_transformed_points.clear();
-    panel_transformed_points.reserve(n_panels());
+    // Compact panel storage:
+    compute_panel_tables(first_panel);
     
-    for (int i = 0; i < n_panels(); i++) {
-        vector<int> &single_panel_nodes = panel_nodes[i];
+    panel_normals.resize(n_panels());
+    
+    panel_collocation_points[0].resize(n_panels());
+    panel_collocation_points[1].resize(n_panels());
+    
+    panel_coordinate_transformations.resize(n_panels());
+    
+    for (int k = 0; k < 3; k++)
+        panel_transformed_points[k].conservativeResize(max_panel_nodes, n_panels());
         
+    panel_surface_areas.resize(n_panels());
+    
+    panel_diameters.resize(n_panels());
+    
+    panel_centroids.resize(n_panels());
+    
+    panel_second_moments.resize(n_panels());
+    
+    for (int i = first_panel; i < n_panels(); i++)
+        compute_panel_geometry(i);
+    
+    // Mark geometry as changed:
+    geometry_revision++;
+    
+    accumulated_transformation = Transform<double, 3, Affine>::Identity();
+}
+
+/**
+   Recomputes the normal, collocation points, coordinate transformation, surface area, diameter, and far-field
+   moments of a single panel, after its nodes were moved.  
+   
+   Unlike compute_geometry(), this does not increment the geometry revision.  It is therefore only meant for
+   temporary perturbations of the geometry which are undone before the next solve, such as those used to
+   differentiate the influence kernels with respect to the node positions.
+   
+   @param[in]   panel   Panel to compute the geometry of.
+*/
+void
+Surface::compute_panel_geometry(int panel)
+{
+    if (panel_node_counts[panel] == 3)
+        compute_panel_geometry<3>(panel);
+    else
+        compute_panel_geometry<4>(panel);
+}
+
+/**
+   Computes the geometry of a single panel with N vertices.  See compute_panel_geometry(int).
+   
+   @param[in]   panel   Panel to compute the geometry of.
+*/
+template <int N>
+void
+Surface::compute_panel_geometry(int panel)
+{
+    int i = panel;
+    
+    const int *single_panel_nodes = &panel_node_table[max_panel_nodes * i];
+    
+    // Normal and surface area, from the cross product of the sides of a triangle, or of the diagonals of a
+    // quadrangle:
+    Vector3d area_vector;
+    if (N == 3) {
         Vector3d AB = nodes[single_panel_nodes[1]] - nodes[single_panel_nodes[0]];
-        AB.normalize();
+        Vector3d AC = nodes[single_panel_nodes[2]] - nodes[single_panel_nodes[0]];
         
-        const Vector3d &normal = panel_normal(i);
+        area_vector = AB.cross(AC);
         
-        Matrix3d rotation;
-        rotation.row(0) = AB;
-        rotation.row(1) = normal.cross(AB).normalized(); // Should be normalized already.
-        rotation.row(2) = normal;
+    } else { // 4 sides
+        Vector3d AC = nodes[single_panel_nodes[2]] - nodes[single_panel_nodes[0]];
+        Vector3d BD = nodes[single_panel_nodes[3]] - nodes[single_panel_nodes[1]];
         
-        Transform<double, 3, Affine> transformation = rotation * Translation<double, 3>(-panel_collocation_point(i, false));
+        area_vector = AC.cross(BD);
+    }
+    
+    Vector3d normal = area_vector.normalized();
+
+    panel_normals[i] = normal;
+    
+    // Collocation points:
+    Vector3d collocation_point(0, 0, 0);
+    for (int j = 0; j < N; j++)
+        collocation_point = collocation_point + nodes[single_panel_nodes[j]];
 
-        panel_coordinate_transformations.push_back(transformation);
+    collocation_point = collocation_point / N;
         
-        // Create transformed points.
-        vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > single_panel_transformed_points;
-        single_panel_transformed_points.reserve(single_panel_nodes.size());
-        for (int j = 0; j < (int) single_panel_nodes.size(); j++)
-            single_panel_transformed_points.push_back(transformation * nodes[single_panel_nodes[j]]);
-        panel_transformed_points.push_back(single_panel_transformed_points);
+    panel_collocation_points[0][i] = collocation_point;
+    
+    Vector3d below_surface_collocation_point = collocation_point + Parameters::collocation_point_delta * panel_normal(i);
+    panel_collocation_points[1][i] = below_surface_collocation_point;
+    
+    // Coordinate transformation:
+    Vector3d AB = nodes[single_panel_nodes[1]] - nodes[single_panel_nodes[0]];
+    AB.normalize();
+    
+    Matrix3d rotation;
+    rotation.row(0) = AB;
+    rotation.row(1) = normal.cross(AB).normalized(); // Should be normalized already.
+    rotation.row(2) = normal;
+    
+    Transform<double, 3, Affine> transformation = rotation * Translation<double, 3>(-panel_collocation_point(i, false));
+
+    panel_coordinate_transformations[i] = transformation;
+    
+    // Create transformed points.
+    for (int j = 0; j < max_panel_nodes; j++) {
+        Vector3d transformed_point = transformation * nodes[single_panel_nodes[j]];
+        
+        for (int k = 0; k < 3; k++)
+            panel_transformed_points[k](j, i) = transformed_point(k);
     }
     
-    // Surface areas:
-    cout << "Surface " << id << ": Generating panel surface area cache." << endl;
+    // Surface area:
+    panel_surface_areas[i] = 0.5 * area_vector.norm();
     
-    panel_surface_areas.clear();
-    panel_surface_areas.reserve(n_panels());
+    // Diameter:
+    double diameter = numeric_limits<double>::min();
     
-    for (int i = 0; i < n_panels(); i++) {
-        vector<int> &single_panel_nodes = panel_nodes[i];
+    for (int j = 0; j < N; j++) {
+        const Vector3d &a = nodes[single_panel_nodes[j]];
         
-        double surface_area = 0.0;
-        if (single_panel_nodes.size() == 3) {
-            Vector3d AB = nodes[single_panel_nodes[1]] - nodes[single_panel_nodes[0]];
-            Vector3d AC = nodes[single_panel_nodes[2]] - nodes[single_panel_nodes[0]];
+        for (int k = 0; k < j; k++) {
+            const Vector3d &b = nodes[single_panel_nodes[k]];
             
-            surface_area = 0.5 * AB.cross(AC).norm();
-            
-        } else { // 4 sides
-            Vector3d AC = nodes[single_panel_nodes[2]] - nodes[single_panel_nodes[0]];
-            Vector3d BD = nodes[single_panel_nodes[3]] - nodes[single_panel_nodes[1]];
-            
-            surface_area = 0.5 * AC.cross(BD).norm();
+            double diameter_candidate = (b - a).norm();
+            if (diameter_candidate > diameter)
+                diameter = diameter_candidate;
         }
-        
-        panel_surface_areas.push_back(surface_area);
     }
     
-    // Diameters:
-    cout << "Surface " << id << ": Generating panel diameter cache." << endl;
+    panel_diameters[i] = diameter;
     
-    panel_diameters.clear();
-    panel_diameters.reserve(n_panels());
+    // Centroid and second area moments, for far-field approximations.  Polygon moments about the panel coordinate
+    // origin:
+    PanelVertices<N> vertices(*this, i);
     
-    for (int i = 0; i < n_panels(); i++) {
-        double diameter = numeric_limits<double>::min();
+    double A = 0.0, S_x = 0.0, S_y = 0.0, I_xx = 0.0, I_xy = 0.0, I_yy = 0.0;
+    
+    for (int j = 0; j < N; j++) {
+        const Vector3d &a = vertices.node_a(j);
+        const Vector3d &b = vertices.node_b(j);
         
-        for (int j = 0; j < (int) panel_nodes[i].size(); j++) {
-            Vector3d a = nodes[panel_nodes[i][j]];
-            
-            for (int k = 0; k < j; k++) {
-                Vector3d b = nodes[panel_nodes[i][k]];
-                
-                double diameter_candidate = (b - a).norm();
-                if (diameter_candidate > diameter)
-                    diameter = diameter_candidate;
-            }
-        }
+        double c = a(0) * b(1) - b(0) * a(1);
         
-        panel_diameters.push_back(diameter);
+        A    += c;
+        S_x  += (a(0) + b(0)) * c;
+        S_y  += (a(1) + b(1)) * c;
+        I_xx += (a(0) * a(0) + a(0) * b(0) + b(0) * b(0)) * c;
+        I_xy += (a(0) * b(1) + 2 * a(0) * a(1) + 2 * b(0) * b(1) + b(0) * a(1)) * c;
+        I_yy += (a(1) * a(1) + a(1) * b(1) + b(1) * b(1)) * c;
     }
+    
+    A    /= 2.0;
+    S_x  /= 6.0;
+    S_y  /= 6.0;
+    I_xx /= 12.0;
+    I_xy /= 24.0;
+    I_yy /= 12.0;
+    
+    if (fabs(A) < Parameters::inversion_tolerance) {
+        panel_centroids[i]      = Vector3d(0, 0, 0);
+        panel_second_moments[i] = Vector3d(0, 0, 0);
+        
+        return;
+    }
+    
+    Vector3d centroid(S_x / A, S_y / A, 0.0);
+    panel_centroids[i] = centroid;
+    
+    // Shift to the centroid:
+    panel_second_moments[i] = Vector3d(I_xx - A * centroid(0) * centroid(0),
+                                       I_xy - A * centroid(0) * centroid(1),
+                                       I_yy - A * centroid(1) * centroid(1));
+}
+
+/**
+   Replaces the positions of all nodes, and recomputes the panel geometry.  The topology is kept, so that a surface
+   can be morphed into a new shape with identical connectivity without rebuilding it.  Since the geometry revision
+   is incremented, solvers recompute the influence coefficients of this surface upon the next solve.
+   
+   @param[in]   nodes   New node positions, one per node.
+   
+   @returns true on success, or false if the number of nodes does not match.
+*/
+bool
+Surface::set_nodes(const vector<Vector3d, Eigen::aligned_allocator<Vector3d> > &nodes)
+{
+    if (nodes.size() != this->nodes.size()) {
+        VORTEXJE_LOG(logger, Logger::Error, "Surface " << id << ": Expected " << this->nodes.size() << " node positions, got " << nodes.size() << ".");
+        
+        return false;
+    }
+    
+    this->nodes = nodes;
+    
+    compute_geometry();
+    
+    return true;
 }
 
 /**
@@ -407,10 +677,12 @@ Surface::transform(const Eigen::Transform<double, 3, Eigen::Affine> &transformat
             panel_collocation_points[j][i] = transformation * panel_collocation_points[j][i];
     
     for (int i = 0; i < n_panels(); i++)
-        panel_normals[i] = transformation * panel_normals[i];
+        panel_normals[i] = transformation.linear() * panel_normals[i];
         
     for (int i = 0; i < n_panels(); i++)
         panel_coordinate_transformations[i] = panel_coordinate_transformations[i] * transformation.inverse();
+        
+    accumulated_transformation = transformation * accumulated_transformation;
 }
 
 /**
@@ -430,6 +702,8 @@ Surface::translate(const Eigen::Vector3d &translation)
             
     for (int i = 0; i < n_panels(); i++)
         panel_coordinate_transformations[i] = panel_coordinate_transformations[i] * Translation<double, 3>(-translation);
+        
+    accumulated_transformation = Translation<double, 3>(translation) * accumulated_transformation;
 }
 
 /**
@@ -472,6 +746,45 @@ Surface::panel_coordinate_transformation(int panel) const
     return panel_coordinate_transformations[panel];
 }
 
+/**
+   Returns a vertex of the given panel, in the panel coordinate system.
+   
+   @param[in]   panel   Panel number.
+   @param[in]   node    Vertex number within the panel.
+   
+   @returns Vertex point.
+*/
+Vector3d
+Surface::panel_transformed_point(int panel, int node) const
+{
+    return Vector3d(panel_transformed_points[0](node, panel),
+                    panel_transformed_points[1](node, panel),
+                    panel_transformed_points[2](node, panel));
+}
+
+/**
+   Returns the neighbor of the given panel across the given edge, if any.
+   
+   @param[in]   panel           Panel number.
+   @param[in]   edge            Edge number.
+   @param[out]  neighbor_edge   Edge number of the neighboring panel.
+   
+   @returns Neighboring panel number, or -1 if there is none.
+*/
+int
+Surface::panel_neighbor(int panel, int edge, int &neighbor_edge) const
+{
+    for (int i = panel_neighbor_offsets[panel]; i < panel_neighbor_offsets[panel + 1]; i++) {
+        if (panel_neighbor_edges[i] == edge) {
+            neighbor_edge = panel_neighbor_panel_edges[i];
+            
+            return panel_neighbor_panels[i];
+        }
+    }
+    
+    return -1;
+}
+
 /**
    Returns the surface area of the given panel.
    
@@ -498,6 +811,81 @@ Surface::panel_diameter(int panel) const
     return panel_diameters[panel];
 }
 
+/**
+   Returns the centroid of the given panel, in panel coordinates.
+   
+   @param[in]   panel   Panel of which the centroid is returned.
+   
+   @returns Panel centroid.
+*/
+const Vector3d &
+Surface::panel_centroid(int panel) const
+{
+    return panel_centroids[panel];
+}
+
+/**
+   Returns the second area moment of the given panel, about its centroid in panel coordinates.
+   
+   @param[in]   panel   Panel of which the second area moment is returned.
+   
+   @returns Second area moment (J_xx, J_xy, J_yy).
+*/
+const Vector3d &
+Surface::panel_second_moment(int panel) const
+{
+    return panel_second_moments[panel];
+}
+
+/**
+   Checks whether a point is far enough away from a panel for the far-field approximations to apply, as set by
+   Parameters::far_field_distance_factor.
+   
+   @param[in]   x_normalized   Point, in panel coordinates.
+   @param[in]   this_panel     Panel number.
+   @param[out]  r              Vector from the panel centroid to the point, in panel coordinates.
+   
+   @returns true if the far-field approximations apply.
+*/
+bool
+Surface::far_field(const Eigen::Vector3d &x_normalized, int this_panel, Eigen::Vector3d &r) const
+{
+    if (Parameters::far_field_distance_factor <= 0)
+        return false;
+        
+    r = x_normalized - panel_centroids[this_panel];
+    
+    double threshold = Parameters::far_field_distance_factor * panel_diameters[this_panel];
+    
+    return r.squaredNorm() > threshold * threshold;
+}
+
+// Far-field potential of a unit source panel, expanded about the panel centroid up to the quadrupole term:
+static double
+far_field_source_influence(const Vector3d &r, double area, const Vector3d &J)
+{
+    double r_sqnorm = r.squaredNorm();
+    double r_norm   = sqrt(r_sqnorm);
+    
+    double rJr     = r(0) * r(0) * J(0) + 2 * r(0) * r(1) * J(1) + r(1) * r(1) * J(2);
+    double J_trace = J(0) + J(2);
+    
+    return one_over_4pi * (area / r_norm + (3 * rJr - r_sqnorm * J_trace) / (2 * r_sqnorm * r_sqnorm * r_norm));
+}
+
+// Far-field potential of a unit doublet panel, expanded about the panel centroid up to the quadrupole term:
+static double
+far_field_doublet_influence(const Vector3d &r, double area, const Vector3d &J)
+{
+    double r_sqnorm = r.squaredNorm();
+    double r_norm   = sqrt(r_sqnorm);
+    
+    double rJr     = r(0) * r(0) * J(0) + 2 * r(0) * r(1) * J(1) + r(1) * r(1) * J(2);
+    double J_trace = J(0) + J(2);
+    
+    return -one_over_4pi * r(2) / (r_sqnorm * r_norm) * (area + 15 * rJr / (2 * r_sqnorm * r_sqnorm) - 3 * J_trace / (2 * r_sqnorm));
+}
+
 // Simultaneously compute influence of source and doublet panel edges on given point.
 static void
 source_and_doublet_edge_influence(const Vector3d &x, const Vector3d &node_a, const Vector3d &node_b, double *source_edge_influence, double *doublet_edge_influence)
@@ -537,11 +925,37 @@ source_and_doublet_edge_influence(const Vector3d &x, const Vector3d &node_a, con
         delta_theta = atan2(u - v, 1 + u * v);
     
     if (source_edge_influence != NULL)
-        *source_edge_influence  = ((x(0) - node_a(0)) * (node_b(1) - node_a(1)) - (x(1) - node_a(1)) * (node_b(0) - node_a(0))) / d * log((r1 + r2 + d) / (r1 + r2 - d)) - fabs(z) * delta_theta; 
+        *source_edge_influence  = ((x(0) - node_a(0)) * (node_b(1) - node_a(1)) - (x(1) - node_a(1)) * (node_b(0) - node_a(0))) / d * log((r1 + r2 + d) / (r1 + r2 - d)) - z * delta_theta; 
     if (doublet_edge_influence != NULL)
         *doublet_edge_influence = delta_theta;
 }
 
+// Sum the influences of the edges of a panel on a given point, according to Hess.  Either output may be NULL:
+template <int N>
+static void
+panel_source_and_doublet_influence(const Vector3d &x, const PanelVertices<N> &vertices, double *source_influence, double *doublet_influence)
+{
+    double source_sum = 0.0, doublet_sum = 0.0;
+    
+    for (int i = 0; i < N; i++) {
+        double source_edge_influence, doublet_edge_influence;
+        
+        source_and_doublet_edge_influence(x, vertices.node_a(i), vertices.node_b(i),
+                                          source_influence != NULL ? &source_edge_influence : NULL,
+                                          doublet_influence != NULL ? &doublet_edge_influence : NULL);
+        
+        if (source_influence != NULL)
+            source_sum += source_edge_influence;
+        if (doublet_influence != NULL)
+            doublet_sum += doublet_edge_influence;
+    }
+    
+    if (source_influence != NULL)
+        *source_influence  = -one_over_4pi * source_sum;
+    if (doublet_influence != NULL)
+        *doublet_influence =  one_over_4pi * doublet_sum;
+}
+
 /**
    Simultaneously computes the potential influences induced by source and doublet panels of unit strength.  
    
@@ -558,30 +972,133 @@ Surface::source_and_doublet_influence(const Eigen::Vector3d &x, int this_panel,
     
     Vector3d x_normalized = transformation * x;
     
+    // Far-field approximation:
+    Vector3d r;
+    if (far_field(x_normalized, this_panel, r)) {
+        source_influence  = far_field_source_influence(r, panel_surface_areas[this_panel], panel_second_moments[this_panel]);
+        doublet_influence = far_field_doublet_influence(r, panel_surface_areas[this_panel], panel_second_moments[this_panel]);
+        
+        return;
+    }
+    
     // Compute influence coefficient according to Hess:
-    source_influence  = 0.0;
-    doublet_influence = 0.0;
+    if (panel_node_counts[this_panel] == 3)
+        panel_source_and_doublet_influence(x_normalized, PanelVertices<3>(*this, this_panel), &source_influence, &doublet_influence);
+    else
+        panel_source_and_doublet_influence(x_normalized, PanelVertices<4>(*this, this_panel), &source_influence, &doublet_influence);
+}
+
+// Maximum number of points evaluated in one batch:
+#define BATCH_SIZE 64
+
+typedef Array<double, Dynamic, 1, ColMajor, BATCH_SIZE, 1> BatchArray;
+
+// Simultaneously compute influence of source and doublet panel edges on a batch of points, and add it to the given
+// arrays.  The points are stored as separate coordinate arrays, so that the arithmetic vectorizes.
+static void
+source_and_doublet_edge_influence(const BatchArray &x, const BatchArray &y, const BatchArray &z, const Vector3d &node_a, const Vector3d &node_b,
+                                  BatchArray &source_influence, BatchArray &doublet_influence)
+{
+    double d = sqrt((node_b(0) - node_a(0)) * (node_b(0) - node_a(0)) + (node_b(1) - node_a(1)) * (node_b(1) - node_a(1)));
+
+    if (d < Parameters::inversion_tolerance)
+        return;
+        
+    double m = (node_b(1) - node_a(1)) / (node_b(0) - node_a(0));
+    
+    BatchArray dx_a = x - node_a(0);
+    BatchArray dy_a = y - node_a(1);
+    BatchArray dx_b = x - node_b(0);
+    BatchArray dy_b = y - node_b(1);
+    
+    BatchArray e1 = dx_a.square() + z.square();
+    BatchArray e2 = dx_b.square() + z.square();
     
-    for (int i = 0; i < (int) panel_nodes[this_panel].size(); i++) {
-        int next_idx;
-        if (i == (int) panel_nodes[this_panel].size() - 1)
-            next_idx = 0;
+    BatchArray r1 = (e1 + dy_a.square()).sqrt();
+    BatchArray r2 = (e2 + dy_b.square()).sqrt();
+    
+    // IEEE-754 floating point division by zero results in +/- inf, and atan(inf) = pi / 2.
+    BatchArray u = (m * e1 - dx_a * dy_a) / (z * r1);
+    BatchArray v = (m * e2 - dx_b * dy_b) / (z * r2);
+    
+    BatchArray delta_theta(x.size());
+    for (int i = 0; i < x.size(); i++) {
+        if (u(i) == v(i))
+            delta_theta(i) = 0.0;
         else
-            next_idx = i + 1;
+            delta_theta(i) = atan2(u(i) - v(i), 1 + u(i) * v(i));
+    }
+    
+    source_influence  += (dx_a * (node_b(1) - node_a(1)) - dy_a * (node_b(0) - node_a(0))) / d * ((r1 + r2 + d) / (r1 + r2 - d)).log() - z * delta_theta;
+    doublet_influence += delta_theta;
+}
+
+// Sum the influences of the edges of a panel on a batch of points, according to Hess:
+template <int N>
+static void
+panel_source_and_doublet_influence(const BatchArray &x, const BatchArray &y, const BatchArray &z, const PanelVertices<N> &vertices,
+                                  BatchArray &source_influence, BatchArray &doublet_influence)
+{
+    for (int i = 0; i < N; i++)
+        source_and_doublet_edge_influence(x, y, z, vertices.node_a(i), vertices.node_b(i), source_influence, doublet_influence);
+}
+
+/**
+   Simultaneously computes the potential influences induced by source and doublet panels of unit strength, for a
+   batch of points.
+   
+   @param[in]   x                   Points at which the influence coefficients are evaluated, one per column.
+   @param[in]   this_panel          Panel on which the doublet panel is located.
+   @param[out]  source_influence    Source influence values, one per point.
+   @param[out]  doublet_influence   Doublet influence values, one per point.
+*/
+void
+Surface::source_and_doublet_influence(const Eigen::Matrix3Xd &x, int this_panel, Ref<VectorXd> source_influence, Ref<VectorXd> doublet_influence) const
+{
+    // Transform such that panel normal becomes unit Z vector:    
+    const Transform<double, 3, Affine> &transformation = panel_coordinate_transformation(this_panel);
+    
+    for (int offset = 0; offset < x.cols(); offset += BATCH_SIZE) {
+        int n = min((int) x.cols() - offset, BATCH_SIZE);
+        
+        Matrix<double, 3, Dynamic, ColMajor, 3, BATCH_SIZE> x_normalized = (transformation.linear() * x.middleCols(offset, n)).colwise() + transformation.translation();
+        
+        // Use the far-field approximations if they apply to the entire batch:
+        if (Parameters::far_field_distance_factor > 0) {
+            bool far = true;
+            for (int i = 0; i < n && far; i++) {
+                Vector3d r;
+                far = far_field(x_normalized.col(i), this_panel, r);
+            }
             
-        const Vector3d &node_a = panel_transformed_points[this_panel][i];
-        const Vector3d &node_b = panel_transformed_points[this_panel][next_idx];
+            if (far) {
+                for (int i = 0; i < n; i++) {
+                    Vector3d r = x_normalized.col(i) - panel_centroids[this_panel];
+                    
+                    source_influence(offset + i)  = far_field_source_influence(r, panel_surface_areas[this_panel], panel_second_moments[this_panel]);
+                    doublet_influence(offset + i) = far_field_doublet_influence(r, panel_surface_areas[this_panel], panel_second_moments[this_panel]);
+                }
+                
+                continue;
+            }
+        }
         
-        double source_edge_influence, doublet_edge_influence;
+        // Compute influence coefficients according to Hess:
+        BatchArray x_0 = x_normalized.row(0).transpose().array();
+        BatchArray x_1 = x_normalized.row(1).transpose().array();
+        BatchArray x_2 = x_normalized.row(2).transpose().array();
         
-        source_and_doublet_edge_influence(x_normalized, node_a, node_b, &source_edge_influence, &doublet_edge_influence);
+        BatchArray batch_source_influence  = BatchArray::Zero(n);
+        BatchArray batch_doublet_influence = BatchArray::Zero(n);
         
-        source_influence  += source_edge_influence;
-        doublet_influence += doublet_edge_influence;
-    }   
-    
-    source_influence  *= -one_over_4pi;
-    doublet_influence *=  one_over_4pi;
+        if (panel_node_counts[this_panel] == 3)
+            panel_source_and_doublet_influence(x_0, x_1, x_2, PanelVertices<3>(*this, this_panel), batch_source_influence, batch_doublet_influence);
+        else
+            panel_source_and_doublet_influence(x_0, x_1, x_2, PanelVertices<4>(*this, this_panel), batch_source_influence, batch_doublet_influence);
+        
+        source_influence.segment(offset, n)  = -one_over_4pi * batch_source_influence.matrix();
+        doublet_influence.segment(offset, n) =  one_over_4pi * batch_doublet_influence.matrix();
+    }
 }
 
 /**
@@ -600,25 +1117,19 @@ Surface::source_influence(const Eigen::Vector3d &x, int this_panel) const
     
     Vector3d x_normalized = transformation * x;
     
+    // Far-field approximation:
+    Vector3d r;
+    if (far_field(x_normalized, this_panel, r))
+        return far_field_source_influence(r, panel_surface_areas[this_panel], panel_second_moments[this_panel]);
+    
     // Compute influence coefficient according to Hess:
-    double influence = 0.0;
-    for (int i = 0; i < (int) panel_nodes[this_panel].size(); i++) {
-        int next_idx;
-        if (i == (int) panel_nodes[this_panel].size() - 1)
-            next_idx = 0;
-        else
-            next_idx = i + 1;
-            
-        const Vector3d &node_a = panel_transformed_points[this_panel][i];
-        const Vector3d &node_b = panel_transformed_points[this_panel][next_idx];
-        
-        double edge_influence;
-        source_and_doublet_edge_influence(x_normalized, node_a, node_b, &edge_influence, NULL);
-        
-        influence += edge_influence;
-    }   
+    double influence;
+    if (panel_node_counts[this_panel] == 3)
+        panel_source_and_doublet_influence(x_normalized, PanelVertices<3>(*this, this_panel), &influence, NULL);
+    else
+        panel_source_and_doublet_influence(x_normalized, PanelVertices<4>(*this, this_panel), &influence, NULL);
     
-    return -one_over_4pi * influence;
+    return influence;
 }
 
 /**
@@ -637,25 +1148,19 @@ Surface::doublet_influence(const Eigen::Vector3d &x, int this_panel) const
     
     Vector3d x_normalized = transformation * x;
     
+    // Far-field approximation:
+    Vector3d r;
+    if (far_field(x_normalized, this_panel, r))
+        return far_field_doublet_influence(r, panel_surface_areas[this_panel], panel_second_moments[this_panel]);
+    
     // Compute influence coefficient according to Hess:
-    double influence = 0.0;
-    for (int i = 0; i < (int) panel_nodes[this_panel].size(); i++) {
-        int next_idx;
-        if (i == (int) panel_nodes[this_panel].size() - 1)
-            next_idx = 0;
-        else
-            next_idx = i + 1;
-            
-        const Vector3d &node_a = panel_transformed_points[this_panel][i];
-        const Vector3d &node_b = panel_transformed_points[this_panel][next_idx];
-        
-        double edge_influence;
-        source_and_doublet_edge_influence(x_normalized, node_a, node_b, NULL, &edge_influence);
-        
-        influence += edge_influence;
-    }
+    double influence;
+    if (panel_node_counts[this_panel] == 3)
+        panel_source_and_doublet_influence(x_normalized, PanelVertices<3>(*this, this_panel), NULL, &influence);
+    else
+        panel_source_and_doublet_influence(x_normalized, PanelVertices<4>(*this, this_panel), NULL, &influence);
     
-    return one_over_4pi * influence;
+    return influence;
 }
 
 // Compute velocity induced by an edge of a source panel:
@@ -697,6 +1202,18 @@ source_edge_unit_velocity(const Vector3d &x, const Vector3d &node_a, const Vecto
                     delta_theta);
 }
 
+// Sum the velocities induced by the edges of a source panel, in the panel coordinate system:
+template <int N>
+static Vector3d
+panel_source_unit_velocity(const Vector3d &x, const PanelVertices<N> &vertices)
+{
+    Vector3d velocity(0, 0, 0);
+    for (int i = 0; i < N; i++)
+        velocity += source_edge_unit_velocity(x, vertices.node_a(i), vertices.node_b(i));
+        
+    return velocity;
+}
+
 /**
    Computes the velocity induced by a source panel of unit strength.  
    
@@ -713,20 +1230,20 @@ Surface::source_unit_velocity(const Eigen::Vector3d &x, int this_panel) const
     
     Vector3d x_normalized = transformation * x;
     
-    // Compute influence coefficient according to Hess:
-    Vector3d velocity(0, 0, 0);
-    for (int i = 0; i < (int) panel_nodes[this_panel].size(); i++) {
-        int next_idx;
-        if (i == (int) panel_nodes[this_panel].size() - 1)
-            next_idx = 0;
-        else
-            next_idx = i + 1;
-            
-        const Vector3d &node_a = panel_transformed_points[this_panel][i];
-        const Vector3d &node_b = panel_transformed_points[this_panel][next_idx];
+    // Far-field approximation, using a point source at the panel centroid:
+    Vector3d r;
+    if (far_field(x_normalized, this_panel, r)) {
+        double r_norm = r.norm();
         
-        velocity += source_edge_unit_velocity(x_normalized, node_a, node_b);
-    }   
+        return -one_over_4pi * panel_surface_areas[this_panel] * (transformation.linear().transpose() * r) / (r_norm * r_norm * r_norm);
+    }
+    
+    // Compute influence coefficient according to Hess:
+    Vector3d velocity;
+    if (panel_node_counts[this_panel] == 3)
+        velocity = panel_source_unit_velocity(x_normalized, PanelVertices<3>(*this, this_panel));
+    else
+        velocity = panel_source_unit_velocity(x_normalized, PanelVertices<4>(*this, this_panel));
     
     // Transform back:
     velocity = transformation.linear().transpose() * velocity;
@@ -735,28 +1252,17 @@ Surface::source_unit_velocity(const Eigen::Vector3d &x, int this_panel) const
     return one_over_4pi * velocity;
 }
 
-/**
-   Computes the velocity induced by a vortex ring of unit strength.
-   
-   @param[in]   x            Point at which the velocity is evaluated.
-   @param[in]   this_panel   Panel on which the vortex ring is located.
-   
-   @returns Velocity induced by the vortex ring.
-*/
-Vector3d
-Surface::vortex_ring_unit_velocity(const Eigen::Vector3d &x, int this_panel) const
-{    
+// Sum the velocities induced by the vortex filaments along the edges of a panel with N vertices, traversed opposite to
+// the panel node ordering:
+template <int N>
+static Vector3d
+panel_vortex_ring_unit_velocity(const Vector3d &x, const vector<Vector3d, Eigen::aligned_allocator<Vector3d> > &nodes, const int *single_panel_nodes)
+{
     Vector3d velocity(0, 0, 0);
     
-    for (int i = 0; i < (int) panel_nodes[this_panel].size(); i++) {
-        int previous_idx;
-        if (i == 0)
-            previous_idx = panel_nodes[this_panel].size() - 1;
-        else
-            previous_idx = i - 1;
-            
-        const Vector3d &node_a = nodes[panel_nodes[this_panel][previous_idx]];
-        const Vector3d &node_b = nodes[panel_nodes[this_panel][i]];
+    for (int i = 0; i < N; i++) {
+        const Vector3d &node_a = nodes[single_panel_nodes[(i + N - 1) % N]];
+        const Vector3d &node_b = nodes[single_panel_nodes[i]];
         
         Vector3d r_0 = node_b - node_a;
         Vector3d r_1 = node_a - x;
@@ -775,10 +1281,64 @@ Surface::vortex_ring_unit_velocity(const Eigen::Vector3d &x, int this_panel) con
 
         velocity += r_1xr_2 / r_1xr_2_sqnorm * r_0.dot(r_1 / r_1_norm - r_2 / r_2_norm);
     }
+    
+    return velocity;
+}
+
+/**
+   Computes the velocity induced by a vortex ring of unit strength.
+   
+   @param[in]   x            Point at which the velocity is evaluated.
+   @param[in]   this_panel   Panel on which the vortex ring is located.
+   
+   @returns Velocity induced by the vortex ring.
+*/
+Vector3d
+Surface::vortex_ring_unit_velocity(const Eigen::Vector3d &x, int this_panel) const
+{    
+    // Far-field approximation, using a point doublet at the panel centroid:
+    if (Parameters::far_field_distance_factor > 0) {
+        const Transform<double, 3, Affine> &transformation = panel_coordinate_transformation(this_panel);
+        
+        Vector3d r;
+        if (far_field(transformation * x, this_panel, r)) {
+            double r_sqnorm = r.squaredNorm();
+            double r_norm   = sqrt(r_sqnorm);
+            
+            // The vortex ring circulates opposite to the panel node ordering, i.e., its moment is -area times the normal.
+            double m = -panel_surface_areas[this_panel];
+            
+            Vector3d local_velocity = (3 * m * r(2) * r / r_sqnorm - Vector3d(0, 0, m)) / (r_sqnorm * r_norm);
+            
+            return one_over_4pi * (transformation.linear().transpose() * local_velocity);
+        }
+    }
+    
+    const int *single_panel_nodes = &panel_node_table[max_panel_nodes * this_panel];
+    
+    Vector3d velocity;
+    if (panel_node_counts[this_panel] == 3)
+        velocity = panel_vortex_ring_unit_velocity<3>(x, nodes, single_panel_nodes);
+    else
+        velocity = panel_vortex_ring_unit_velocity<4>(x, nodes, single_panel_nodes);
 
     return one_over_4pi * velocity;
 }
 
+/**
+   Computes the velocities induced by a vortex ring of unit strength, for a batch of points.
+   
+   @param[in]   x            Points at which the velocity is evaluated, one per column.
+   @param[in]   this_panel   Panel on which the vortex ring is located.
+   @param[out]  velocities   Velocities induced by the vortex ring, one per column.
+*/
+void
+Surface::vortex_ring_unit_velocity(const Eigen::Matrix3Xd &x, int this_panel, Ref<Matrix3Xd> velocities) const
+{
+    for (int i = 0; i < x.cols(); i++)
+        velocities.col(i) = Surface::vortex_ring_unit_velocity(x.col(i), this_panel);
+}
+
 /**
    Computes the potential influence induced by a doublet panel of unit strength.  If the influence
    has been computed before, the cached influence coefficient is returned.  If not, the coefficient
@@ -19,6 +19,7 @@
 #include <Eigen/StdVector>
 
 #include <vortexje/parameters.hpp>
+#include <vortexje/logger.hpp>
 
 namespace Vortexje
 {
@@ -37,6 +38,11 @@ public:
     */
     int id;
     
+    /**
+       Logger receiving the diagnostic messages of this surface.  Initialized to Logger::default_logger().
+    */
+    std::shared_ptr<Logger> logger;
+    
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
     
     Surface();
@@ -48,6 +54,10 @@ public:
     
     void compute_topology();
     void compute_geometry();
+    void compute_geometry(int first_panel);
+    void compute_panel_geometry(int panel);
+    
+    bool set_nodes(const std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > &nodes);
     
     void cut_panels(int panel_a, int panel_b);
     
@@ -75,9 +85,61 @@ public:
     std::vector<std::map<int, std::pair<int, int> > > panel_neighbors;
     
     /**
-       Panel number to comprising vertex points (in the panel coordinate system) map.
+       Maximum number of vertices per panel.
+    */
+    static const int max_panel_nodes = 4;
+    
+    /**
+       Panel number to number of comprising vertices map.  Compact copy of panel_nodes, for fast traversal.
+    */
+    std::vector<int> panel_node_counts;
+    
+    /**
+       Panel number to comprising vertex numbers map, with a fixed stride of max_panel_nodes.  Compact copy of
+       panel_nodes, for fast traversal.  Unused entries repeat the first vertex.
+    */
+    std::vector<int> panel_node_table;
+    
+    /**
+       Panel number to offset in the panel_neighbor_* arrays map, in compressed sparse row format.  Compact copy of
+       panel_neighbors, for fast traversal.  Contains n_panels() + 1 entries.
+    */
+    std::vector<int> panel_neighbor_offsets;
+    
+    /**
+       Edge numbers of the panel_neighbors entries.
+    */
+    std::vector<int> panel_neighbor_edges;
+    
+    /**
+       Neighboring panel numbers of the panel_neighbors entries.
+    */
+    std::vector<int> panel_neighbor_panels;
+    
+    /**
+       Neighboring panel edge numbers of the panel_neighbors entries.
     */
-    std::vector<std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > > panel_transformed_points;
+    std::vector<int> panel_neighbor_panel_edges;
+    
+    /**
+       Panel number to comprising vertex points (in the panel coordinate system) map, one coordinate per matrix, and
+       one panel per column.  Unused entries repeat the first vertex.
+    */
+    Eigen::Matrix<double, max_panel_nodes, Eigen::Dynamic> panel_transformed_points[3];
+    
+    Eigen::Vector3d panel_transformed_point(int panel, int node) const;
+    
+    int panel_neighbor(int panel, int edge, int &neighbor_edge) const;
+    
+    /**
+       Number of times the panel geometry of this surface has been (re)computed.
+    */
+    int geometry_revision;
+    
+    /**
+       Rigid transformation applied to this surface since its panel geometry was last computed.
+    */
+    Eigen::Transform<double, 3, Eigen::Affine> accumulated_transformation;
     
     void rotate(const Eigen::Vector3d &axis, double angle);
     virtual void transform(const Eigen::Matrix3d &transformation);
@@ -94,13 +156,20 @@ public:
     
     double panel_diameter(int panel) const;
     
+    const Eigen::Vector3d &panel_centroid(int panel) const;
+    
+    const Eigen::Vector3d &panel_second_moment(int panel) const;
+    
     virtual void source_and_doublet_influence(const Eigen::Vector3d &x, int this_panel, double &source_influence, double &doublet_influence) const;
+    virtual void source_and_doublet_influence(const Eigen::Matrix3Xd &x, int this_panel,
+                                              Eigen::Ref<Eigen::VectorXd> source_influence, Eigen::Ref<Eigen::VectorXd> doublet_influence) const;
     
     double source_influence(const Eigen::Vector3d &x, int this_panel) const;
     double doublet_influence(const Eigen::Vector3d &x, int this_panel) const;
     
     virtual Eigen::Vector3d source_unit_velocity(const Eigen::Vector3d &x, int this_panel) const;
     virtual Eigen::Vector3d vortex_ring_unit_velocity(const Eigen::Vector3d &x, int this_panel) const;
+    virtual void vortex_ring_unit_velocity(const Eigen::Matrix3Xd &x, int this_panel, Eigen::Ref<Eigen::Matrix3Xd> velocities) const;
     
     double doublet_influence(const std::shared_ptr<Surface> &other, int other_panel, int this_panel) const;
     double source_influence(const std::shared_ptr<Surface> &other, int other_panel, int this_panel) const;
@@ -135,6 +204,23 @@ protected:
        Panel number to diameter map.
     */
     std::vector<double> panel_diameters;
+    
+    /**
+       Panel number to centroid map, in panel coordinates.
+    */
+    std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > panel_centroids;
+    
+    /**
+       Panel number to second area moment map, about the centroid in panel coordinates.  The components are
+       (J_xx, J_xy, J_yy).
+    */
+    std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > panel_second_moments;
+    
+    void compute_panel_tables(int first_panel);
+    
+    template <int N> void compute_panel_geometry(int panel);
+    
+    bool far_field(const Eigen::Vector3d &x_normalized, int this_panel, Eigen::Vector3d &r) const;
 };
 
 };
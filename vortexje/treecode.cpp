@@ -0,0 +1,308 @@
+//
+// Vortexje -- Treecode for the evaluation of panel-induced velocities.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#include <algorithm>
+
+#include <vortexje/treecode.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace Vortexje;
+
+// Maximum depth of the tree traversal stack:
+#define MAX_STACK_SIZE 128
+
+// Avoid having to divide by 4 pi all the time:
+static const double pi = 3.141592653589793238462643383279502884;
+static const double one_over_4pi = 1.0 / (4 * pi);
+
+// Comparison of element centers along a coordinate axis:
+class ElementCenterComparator
+{
+public:
+    ElementCenterComparator(int axis) : axis(axis) {}
+
+    template <class T>
+    bool operator()(const T &a, const T &b) const
+    {
+        return a.center(axis) < b.center(axis);
+    }
+
+private:
+    int axis;
+};
+
+/**
+   Constructs an empty Treecode.
+
+   @param[in]   opening_angle   Ratio of cluster radius to distance below which a cluster is evaluated using its
+                                far-field expansion.
+   @param[in]   leaf_size       Maximum number of panels per leaf of the tree.
+*/
+Treecode::Treecode(double opening_angle, int leaf_size) : opening_angle(opening_angle), leaf_size(leaf_size)
+{
+}
+
+/**
+   Adds a panel to this treecode.  The surface must outlive the treecode, and its geometry must not change between
+   the calls to build() and velocity().
+
+   @param[in]   surface               Surface on which the panel is located.
+   @param[in]   panel                 Panel number.
+   @param[in]   doublet_coefficient   Strength of the doublet panel, or vortex ring.
+   @param[in]   source_coefficient    Strength of the source panel.
+*/
+void
+Treecode::add_panel(const shared_ptr<Surface> &surface, int panel, double doublet_coefficient, double source_coefficient)
+{
+    Element element;
+
+    element.surface = surface.get();
+    element.panel   = panel;
+    
+    element.particle_wake = NULL;
+    element.particle      = -1;
+
+    element.doublet_coefficient = doublet_coefficient;
+    element.source_coefficient  = source_coefficient;
+
+    const int *panel_nodes = &surface->panel_node_table[Surface::max_panel_nodes * panel];
+    int n_panel_nodes = surface->panel_node_counts[panel];
+
+    // Panel center and radius:
+    element.center = Vector3d(0, 0, 0);
+    for (int i = 0; i < n_panel_nodes; i++)
+        element.center += surface->nodes[panel_nodes[i]];
+    element.center /= (double) n_panel_nodes;
+
+    element.radius = 0.0;
+    for (int i = 0; i < n_panel_nodes; i++)
+        element.radius = max(element.radius, (surface->nodes[panel_nodes[i]] - element.center).norm());
+
+    // A vortex ring is equivalent to a point doublet with a moment equal to its vector area, in the far field.  The
+    // vortex rings of Surface::vortex_ring_unit_velocity() circulate opposite to the node ordering.
+    Vector3d vector_area(0, 0, 0);
+    for (int i = 0; i < n_panel_nodes; i++) {
+        int next_idx;
+        if (i == n_panel_nodes - 1)
+            next_idx = 0;
+        else
+            next_idx = i + 1;
+
+        vector_area += 0.5 * (surface->nodes[panel_nodes[i]] - element.center).cross(surface->nodes[panel_nodes[next_idx]] - element.center);
+    }
+
+    element.doublet_moment  = -doublet_coefficient * vector_area;
+
+    // A source panel is equivalent to a point source, in the far field.  The sign convention follows
+    // Surface::source_unit_velocity().
+    element.source_strength = -source_coefficient * vector_area.norm();
+    
+    element.vorticity = Vector3d(0, 0, 0);
+
+    elements.push_back(element);
+}
+
+/**
+   Adds a vortex particle to this treecode.  The wake must outlive the treecode, and its particles must not change
+   between the calls to build() and velocity().
+
+   @param[in]   wake       Wake containing the vortex particle.
+   @param[in]   particle   Vortex particle number.
+*/
+void
+Treecode::add_particle(const shared_ptr<Wake> &wake, int particle)
+{
+    Element element;
+    
+    element.surface = NULL;
+    element.panel   = -1;
+    
+    element.particle_wake = wake.get();
+    element.particle      = particle;
+    
+    element.doublet_coefficient = 0.0;
+    element.source_coefficient  = 0.0;
+    
+    element.center = wake->particle_positions[particle];
+    element.radius = wake->particle_core_radii[particle];
+    
+    element.doublet_moment  = Vector3d(0, 0, 0);
+    element.source_strength = 0.0;
+    
+    element.vorticity = wake->particle_strengths[particle];
+    
+    elements.push_back(element);
+}
+
+/**
+   Builds the tree.  This must be called after all panels were added, and before velocity() is called.
+*/
+void
+Treecode::build()
+{
+    nodes.clear();
+
+    if (elements.size() > 0)
+        build_node(0, elements.size());
+}
+
+// Recursively builds the tree for the given range of elements, and returns the index of the new node.
+int
+Treecode::build_node(int begin, int end)
+{
+    int index = nodes.size();
+    nodes.push_back(Node());
+
+    // Bounding box of the element centers:
+    Vector3d lower = elements[begin].center;
+    Vector3d upper = elements[begin].center;
+    for (int i = begin + 1; i < end; i++) {
+        lower = lower.cwiseMin(elements[i].center);
+        upper = upper.cwiseMax(elements[i].center);
+    }
+
+    // Cluster center, radius, and far-field expansion about the center.  The first order term of the source
+    // expansion has the form of a point doublet, and is therefore lumped with the doublet moment.  Likewise, the
+    // second order term of the source expansion is lumped with the first order term of the doublet expansion.
+    Vector3d center = 0.5 * (lower + upper);
+
+    double radius = 0.0;
+
+    double source_strength = 0.0;
+    Vector3d doublet_moment(0, 0, 0);
+    Matrix3d quadrupole_moment = Matrix3d::Zero();
+    
+    Vector3d vorticity(0, 0, 0);
+    Matrix3d vorticity_moment = Matrix3d::Zero();
+
+    for (int i = begin; i < end; i++) {
+        const Element &element = elements[i];
+
+        Vector3d offset = element.center - center;
+
+        radius = max(radius, offset.norm() + element.radius);
+
+        source_strength   += element.source_strength;
+        doublet_moment    += element.doublet_moment + element.source_strength * offset;
+        quadrupole_moment += (element.doublet_moment + 0.5 * element.source_strength * offset) * offset.transpose();
+        
+        vorticity        += element.vorticity;
+        vorticity_moment += element.vorticity * offset.transpose();
+    }
+
+    Node &node = nodes[index];
+
+    node.begin  = begin;
+    node.end    = end;
+    node.center = center;
+    node.radius = radius;
+
+    node.source_strength   = source_strength;
+    node.doublet_moment    = doublet_moment;
+    node.quadrupole_moment = quadrupole_moment;
+    
+    node.vorticity        = vorticity;
+    node.vorticity_moment = vorticity_moment;
+
+    node.children[0] = -1;
+    node.children[1] = -1;
+
+    // Split along the longest axis, at the median:
+    if (end - begin > leaf_size) {
+        int axis;
+        (upper - lower).maxCoeff(&axis);
+
+        int middle = (begin + end) / 2;
+
+        nth_element(elements.begin() + begin, elements.begin() + middle, elements.begin() + end, ElementCenterComparator(axis));
+
+        // Note that the node reference may be invalidated by the recursion.
+        int child_a = build_node(begin, middle);
+        int child_b = build_node(middle, end);
+
+        nodes[index].children[0] = child_a;
+        nodes[index].children[1] = child_b;
+    }
+
+    return index;
+}
+
+/**
+   Computes the velocity induced by all panels in this treecode.
+
+   @param[in]   x   Point at which the velocity is evaluated.
+
+   @returns Induced velocity.
+*/
+Vector3d
+Treecode::velocity(const Vector3d &x) const
+{
+    Vector3d velocity(0, 0, 0);
+
+    if (nodes.size() == 0)
+        return velocity;
+
+    int stack[MAX_STACK_SIZE];
+    int stack_size = 0;
+
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0) {
+        const Node &node = nodes[stack[--stack_size]];
+
+        Vector3d r = x - node.center;
+        double r_norm = r.norm();
+
+        if (node.radius < opening_angle * r_norm) {
+            // Far field:
+            double r_norm_3 = r_norm * r_norm * r_norm;
+            double r_norm_5 = r_norm_3 * r_norm * r_norm;
+            double r_norm_7 = r_norm_5 * r_norm * r_norm;
+            
+            const Matrix3d &Q = node.quadrupole_moment;
+            Vector3d Qr  = Q * r;
+            Vector3d QTr = Q.transpose() * r;
+
+            velocity += one_over_4pi * (node.source_strength * r / r_norm_3
+                                        + 3 * node.doublet_moment.dot(r) * r / r_norm_5 - node.doublet_moment / r_norm_3
+                                        - 3 * (Q.trace() * r + Qr + QTr) / r_norm_5 + 15 * r.dot(Qr) * r / r_norm_7);
+            
+            // Vortex particles.  The antisymmetric part of the vorticity moment gives rise to the sum of the cross
+            // products of the particle strengths and offsets:
+            const Matrix3d &M = node.vorticity_moment;
+            Vector3d w(M(1, 2) - M(2, 1), M(2, 0) - M(0, 2), M(0, 1) - M(1, 0));
+            
+            velocity += one_over_4pi * (node.vorticity.cross(r) / r_norm_3 + 3 * (M * r).cross(r) / r_norm_5 - w / r_norm_3);
+
+        } else if (node.children[0] < 0) {
+            // Near field, leaf:
+            for (int i = node.begin; i < node.end; i++) {
+                const Element &element = elements[i];
+                
+                if (element.particle_wake != NULL) {
+                    velocity += element.particle_wake->particle_velocity(x, element.particle);
+                    
+                    continue;
+                }
+
+                if (element.doublet_coefficient != 0.0)
+                    velocity += element.surface->vortex_ring_unit_velocity(x, element.panel) * element.doublet_coefficient;
+                if (element.source_coefficient != 0.0)
+                    velocity += element.surface->source_unit_velocity(x, element.panel) * element.source_coefficient;
+            }
+
+        } else {
+            // Near field, descend:
+            stack[stack_size++] = node.children[0];
+            stack[stack_size++] = node.children[1];
+        }
+    }
+
+    return velocity;
+}
@@ -0,0 +1,125 @@
+//
+// Vortexje -- Treecode for the evaluation of panel-induced velocities.
+//
+// Copyright (C) 2014 Baayen & Heinz GmbH.
+//
+// Authors: Jorn Baayen <jorn.baayen@baayen-heinz.com>
+//
+
+#ifndef __TREECODE_HPP__
+#define __TREECODE_HPP__
+
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+#include <vortexje/wake.hpp>
+
+namespace Vortexje
+{
+
+/**
+   Barnes-Hut treecode for the evaluation of the velocity induced by a large number of source and doublet panels, and
+   vortex particles.
+
+   The panels are organized in a binary tree of bounding boxes.  Clusters of panels that are sufficiently far away
+   from the evaluation point are replaced by a point source, a point doublet, and a quadrupole, located at the
+   cluster center.  Vortex particles contribute the first two moments of their vorticity.  All other panels and
+   particles are evaluated directly, using the (possibly desingularized) kernels of their surfaces.
+
+   @brief Barnes-Hut treecode.
+*/
+class Treecode
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    Treecode(double opening_angle, int leaf_size = 16);
+
+    /**
+       Ratio of cluster radius to distance below which a cluster is evaluated using its far-field expansion.
+    */
+    double opening_angle;
+
+    /**
+       Maximum number of panels per leaf of the tree.
+    */
+    int leaf_size;
+
+    void add_panel(const std::shared_ptr<Surface> &surface, int panel, double doublet_coefficient, double source_coefficient);
+    void add_particle(const std::shared_ptr<Wake> &wake, int particle);
+
+    void build();
+
+    Eigen::Vector3d velocity(const Eigen::Vector3d &x) const;
+
+    /**
+       Returns the number of panels in this treecode.
+
+       @returns Number of panels.
+    */
+    int n_panels() const { return (int) elements.size(); }
+
+private:
+    class Element {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        const Surface *surface;
+        int panel;
+        
+        const Wake *particle_wake;
+        int particle;
+
+        double doublet_coefficient;
+        double source_coefficient;
+
+        Eigen::Vector3d center;
+        double radius;
+
+        Eigen::Vector3d doublet_moment;
+        double source_strength;
+        Eigen::Vector3d vorticity;
+    };
+
+    class Node {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        Node() :
+            begin(0), end(0),
+            center(Eigen::Vector3d::Zero()), radius(0.0),
+            source_strength(0.0), doublet_moment(Eigen::Vector3d::Zero()), quadrupole_moment(Eigen::Matrix3d::Zero()),
+            vorticity(Eigen::Vector3d::Zero()), vorticity_moment(Eigen::Matrix3d::Zero())
+        {
+            children[0] = -1;
+            children[1] = -1;
+        }
+
+        int begin;
+        int end;
+
+        int children[2];
+
+        Eigen::Vector3d center;
+        double radius;
+
+        double source_strength;
+        Eigen::Vector3d doublet_moment;
+        Eigen::Matrix3d quadrupole_moment;
+        
+        Eigen::Vector3d vorticity;
+        Eigen::Matrix3d vorticity_moment;
+    };
+
+    std::vector<Element, Eigen::aligned_allocator<Element> > elements;
+    std::vector<Node, Eigen::aligned_allocator<Node> > nodes;
+
+    int build_node(int begin, int end);
+};
+
+};
+
+#endif // __TREECODE_HPP__
@@ -7,6 +7,9 @@
 //
 
 #include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <map>
 
 #include <vortexje/wake.hpp>
 
@@ -14,6 +17,13 @@ using namespace std;
 using namespace Eigen;
 using namespace Vortexje;
 
+// Avoid having to divide by 4 pi all the time:
+static const double pi = 3.141592653589793238462643383279502884;
+static const double one_over_4pi = 1.0 / (4 * pi);
+
+// Vortex filament strengths, by node pair:
+typedef map<pair<int, int>, Vector3d> FilamentMap;
+
 /**
    Constructs an empty wake.
    
@@ -21,6 +31,7 @@ using namespace Vortexje;
 */
 Wake::Wake(shared_ptr<LiftingSurface> lifting_surface): lifting_surface(lifting_surface)
 {
+    n_merged_rows = 0;
 }
 
 /**
@@ -36,6 +47,15 @@ Wake::add_layer()
     else
         first_layer = false;
         
+    // The number of rows of a truncated wake is bounded.  Allocate the storage for all of them at once, so that the
+    // containers are never reallocated:
+    if (first_layer && parameters.max_wake_rows > 0)
+        reserve_rows(parameters.max_wake_rows + 1);
+        
+    // The new nodes have not been convected yet:
+    if (node_velocities.size() == nodes.size())
+        node_velocities.resize(nodes.size() + lifting_surface->n_spanwise_nodes(), Vector3d(0, 0, 0));
+        
     // Add layer of nodes at trailing edge, and add panels if necessary:
     for (int k = 0; k < lifting_surface->n_spanwise_nodes(); k++) {
         Vector3d new_point = lifting_surface->nodes[lifting_surface->trailing_edge_node(k)];
@@ -69,6 +89,37 @@ Wake::add_layer()
     compute_geometry();
 }
 
+// Recomputes the geometry of the panels connected to the nodes starting at the given node.  If only the trailing
+// edge nodes moved, only the geometry of the row of panels attached to the trailing edge is recomputed.
+void
+Wake::update_trailing_edge_geometry(int first_node)
+{
+    if (first_node == n_nodes() - lifting_surface->n_spanwise_nodes())
+        compute_geometry(max(0, n_panels() - lifting_surface->n_spanwise_panels()));
+    else
+        compute_geometry();
+}
+
+/**
+   Reserves storage for the given number of rows of panels.
+   
+   @param[in]   n   Number of rows.
+*/
+void
+Wake::reserve_rows(int n)
+{
+    int n_spanwise_nodes  = lifting_surface->n_spanwise_nodes();
+    int n_spanwise_panels = lifting_surface->n_spanwise_panels();
+    
+    nodes.reserve((n + 1) * n_spanwise_nodes);
+    node_velocities.reserve((n + 1) * n_spanwise_nodes);
+    node_panel_neighbors.reserve((n + 1) * n_spanwise_nodes);
+    
+    panel_nodes.reserve(n * n_spanwise_panels);
+    panel_neighbors.reserve(n * n_spanwise_panels);
+    doublet_coefficients.reserve(n * n_spanwise_panels);
+}
+
 /**
    Translates the nodes of the trailing edge.
    
@@ -81,7 +132,7 @@ Wake::translate_trailing_edge(const Eigen::Vector3d &translation)
         return;
         
     int k0;
-    if (Parameters::convect_wake)
+    if (parameters.convect_wake)
         k0 = n_nodes() - lifting_surface->n_spanwise_nodes();
     else
         k0 = 0;
@@ -89,7 +140,7 @@ Wake::translate_trailing_edge(const Eigen::Vector3d &translation)
     for (int k = k0; k < n_nodes(); k++)                
         nodes[k] += translation;
         
-    compute_geometry();
+    update_trailing_edge_geometry(k0);
 }
 
 /**
@@ -104,7 +155,7 @@ Wake::transform_trailing_edge(const Eigen::Transform<double, 3, Eigen::Affine> &
         return;
         
     int k0;
-    if (Parameters::convect_wake)
+    if (parameters.convect_wake)
         k0 = n_nodes() - lifting_surface->n_spanwise_nodes();
     else
         k0 = 0;
@@ -112,7 +163,33 @@ Wake::transform_trailing_edge(const Eigen::Transform<double, 3, Eigen::Affine> &
     for (int k = k0; k < n_nodes(); k++)                
         nodes[k] = transformation * nodes[k];
         
-    compute_geometry();
+    update_trailing_edge_geometry(k0);
+}
+
+/**
+   Displaces the nodes of the trailing edge individually, e.g., after the lifting surface was morphed.  Without wake
+   convection, the entire static wake follows the trailing edge.
+   
+   @param[in]   displacements   Displacement of every trailing edge node.
+*/
+void
+Wake::displace_trailing_edge(const vector<Vector3d, Eigen::aligned_allocator<Vector3d> > &displacements)
+{
+    int n_spanwise_nodes = lifting_surface->n_spanwise_nodes();
+    
+    if (n_nodes() < n_spanwise_nodes)
+        return;
+        
+    int k0;
+    if (parameters.convect_wake)
+        k0 = n_nodes() - n_spanwise_nodes;
+    else
+        k0 = 0;
+        
+    for (int k = k0; k < n_nodes(); k++)                
+        nodes[k] += displacements[k % n_spanwise_nodes];
+        
+    update_trailing_edge_geometry(k0);
 }
 
 /**
@@ -124,3 +201,402 @@ void
 Wake::update_properties(double dt)
 {
 }
+
+/**
+   Returns the number of spanwise rows of panels in this wake.  Row 0 is the oldest row, and the last row is attached
+   to the trailing edge.
+   
+   @returns Number of rows.
+*/
+int
+Wake::n_rows() const
+{
+    return n_panels() / lifting_surface->n_spanwise_panels();
+}
+
+// Re-establishes the panel-node relationship of all panels, after rows have been deleted or merged.  The nodes are
+// organized in spanwise layers, one layer per row boundary.
+void
+Wake::renumber_panel_nodes()
+{
+    int n_spanwise_nodes  = lifting_surface->n_spanwise_nodes();
+    int n_spanwise_panels = lifting_surface->n_spanwise_panels();
+    
+    for (int row = 0; row < n_rows(); row++) {
+        for (int k = 0; k < n_spanwise_panels; k++) {
+            int node = (row + 1) * n_spanwise_nodes + k + 1;
+            
+            vector<int> &vertices = panel_nodes[row * n_spanwise_panels + k];
+            vertices[0] = node - 1;
+            vertices[1] = node - 1 - n_spanwise_nodes;
+            vertices[2] = node - n_spanwise_nodes;
+            vertices[3] = node;
+        }
+    }
+}
+
+/**
+   Deletes the given number of oldest rows of wake panels.
+   
+   @param[in]   n   Number of rows to delete.
+*/
+void
+Wake::delete_rows(int n)
+{
+    int n_spanwise_nodes  = lifting_surface->n_spanwise_nodes();
+    int n_spanwise_panels = lifting_surface->n_spanwise_panels();
+    
+    if (node_velocities.size() == nodes.size())
+        node_velocities.erase(node_velocities.begin(), node_velocities.begin() + n * n_spanwise_nodes);
+    else
+        node_velocities.clear();
+        
+    nodes.erase(nodes.begin(), nodes.begin() + n * n_spanwise_nodes);
+    node_panel_neighbors.erase(node_panel_neighbors.begin(), node_panel_neighbors.begin() + n * n_spanwise_nodes);
+    
+    panel_nodes.erase(panel_nodes.begin(), panel_nodes.begin() + n * n_spanwise_panels);
+    panel_neighbors.erase(panel_neighbors.begin(), panel_neighbors.begin() + n * n_spanwise_panels);
+    doublet_coefficients.erase(doublet_coefficients.begin(), doublet_coefficients.begin() + n * n_spanwise_panels);
+    
+    n_merged_rows = max(0, n_merged_rows - n);
+    
+    renumber_panel_nodes();
+    
+    compute_geometry();
+}
+
+/**
+   Merges consecutive rows of wake panels into a single row.  The merged vortex rings span the outer node layers of
+   the original rows.  Their strengths are the area-weighted means of the original strengths, so that the far-field
+   doublet moment, i.e., the vortex impulse, of every spanwise strip is conserved.
+   
+   @param[in]   first_row   First row to merge.
+   @param[in]   n           Number of rows to merge.
+*/
+void
+Wake::merge_rows(int first_row, int n)
+{
+    if (n < 2)
+        return;
+        
+    int n_spanwise_nodes  = lifting_surface->n_spanwise_nodes();
+    int n_spanwise_panels = lifting_surface->n_spanwise_panels();
+    
+    // Merged strengths:
+    for (int k = 0; k < n_spanwise_panels; k++) {
+        double moment = 0.0;
+        double area   = 0.0;
+        for (int row = first_row; row < first_row + n; row++) {
+            int panel = row * n_spanwise_panels + k;
+            
+            moment += doublet_coefficients[panel] * panel_surface_area(panel);
+            area   += panel_surface_area(panel);
+        }
+        
+        if (area > Parameters::inversion_tolerance)
+            doublet_coefficients[first_row * n_spanwise_panels + k] = moment / area;
+    }
+    
+    // Remove the inner node layers, and the panels of all but the first row:
+    if (node_velocities.size() == nodes.size())
+        node_velocities.erase(node_velocities.begin() + (first_row + 1) * n_spanwise_nodes, node_velocities.begin() + (first_row + n) * n_spanwise_nodes);
+    else
+        node_velocities.clear();
+        
+    nodes.erase(nodes.begin() + (first_row + 1) * n_spanwise_nodes, nodes.begin() + (first_row + n) * n_spanwise_nodes);
+    node_panel_neighbors.erase(node_panel_neighbors.begin() + (first_row + 1) * n_spanwise_nodes,
+                               node_panel_neighbors.begin() + (first_row + n) * n_spanwise_nodes);
+    
+    panel_nodes.erase(panel_nodes.begin() + (first_row + 1) * n_spanwise_panels, panel_nodes.begin() + (first_row + n) * n_spanwise_panels);
+    panel_neighbors.erase(panel_neighbors.begin() + (first_row + 1) * n_spanwise_panels,
+                          panel_neighbors.begin() + (first_row + n) * n_spanwise_panels);
+    doublet_coefficients.erase(doublet_coefficients.begin() + (first_row + 1) * n_spanwise_panels,
+                               doublet_coefficients.begin() + (first_row + n) * n_spanwise_panels);
+    
+    renumber_panel_nodes();
+    
+    compute_geometry();
+}
+
+/**
+   Drops, converts, and merges old rows of wake panels, according to the max_wake_rows, max_wake_distance,
+   vortex_particle_wake_age, wake_agglomeration_factor, and wake_agglomeration_age parameters.  The row attached to the trailing edge is never modified.
+*/
+void
+Wake::coarsen()
+{
+    int n_spanwise_nodes = lifting_surface->n_spanwise_nodes();
+    
+    // Drop rows beyond the maximum age:
+    if (parameters.max_wake_rows > 0 && n_rows() > parameters.max_wake_rows)
+        delete_rows(n_rows() - max(1, parameters.max_wake_rows));
+        
+    // Drop rows beyond the maximum distance from the trailing edge.  The oldest node layer is tested:
+    if (parameters.max_wake_distance > 0) {
+        int n_far_rows = 0;
+        while (n_far_rows < n_rows() - 1) {
+            bool far = true;
+            for (int k = 0; k < n_spanwise_nodes; k++) {
+                const Vector3d &trailing_edge_point = lifting_surface->nodes[lifting_surface->trailing_edge_node(k)];
+                
+                if ((nodes[n_far_rows * n_spanwise_nodes + k] - trailing_edge_point).norm() <= parameters.max_wake_distance) {
+                    far = false;
+                    break;
+                }
+            }
+            
+            if (!far)
+                break;
+                
+            n_far_rows++;
+        }
+        
+        if (n_far_rows > 0)
+            delete_rows(n_far_rows);
+    }
+    
+    // Convert old rows into vortex particles:
+    if (parameters.vortex_particle_wake_age > 0 && n_rows() > parameters.vortex_particle_wake_age)
+        convert_rows_to_particles(n_rows() - parameters.vortex_particle_wake_age);
+        
+    // Merge the oldest unmerged rows, once enough of them are older than the agglomeration age:
+    if (parameters.wake_agglomeration_factor > 1) {
+        int age = max(1, parameters.wake_agglomeration_age);
+        
+        while (n_rows() - n_merged_rows - age >= parameters.wake_agglomeration_factor) {
+            merge_rows(n_merged_rows, parameters.wake_agglomeration_factor);
+            
+            n_merged_rows++;
+        }
+    }
+}
+
+/**
+   Writes the state of this wake, i.e., its nodes, panels, doublet coefficients, vortex particles, and the convection
+   velocities held for the far wake, into a checkpoint.
+   
+   @param[in]   writer   Checkpoint writer.
+*/
+void
+Wake::write_checkpoint(CheckpointWriter &writer) const
+{
+    writer.write(nodes);
+    
+    vector<int> counts, panel_node_list;
+    for (int i = 0; i < n_panels(); i++) {
+        counts.push_back(panel_nodes[i].size());
+        panel_node_list.insert(panel_node_list.end(), panel_nodes[i].begin(), panel_nodes[i].end());
+    }
+        
+    writer.write(counts);
+    writer.write(panel_node_list);
+    
+    writer.write(doublet_coefficients);
+    
+    writer.write((int64_t) n_merged_rows);
+    
+    writer.write(particle_positions);
+    writer.write(particle_strengths);
+    writer.write(particle_core_radii);
+    
+    // Convection velocities, for reuse in the far wake:
+    writer.write(node_velocities);
+    writer.write(particle_velocities);
+}
+
+/**
+   Reads the state of this wake from a checkpoint written by write_checkpoint(), and validates it.  The wake itself is
+   left unchanged; the state is applied by restore_checkpoint().
+   
+   @param[in]   reader   Checkpoint reader.
+   
+   @returns The state read, or a null pointer on failure.
+*/
+shared_ptr<Wake::CheckpointState>
+Wake::read_checkpoint(CheckpointReader &reader) const
+{
+    shared_ptr<CheckpointState> state(new CheckpointState());
+    if (!read_wake_checkpoint(reader, *state))
+        return shared_ptr<CheckpointState>();
+        
+    return state;
+}
+
+// Reads the state written by Wake::write_checkpoint() into the given state, and validates it:
+bool
+Wake::read_wake_checkpoint(CheckpointReader &reader, CheckpointState &state) const
+{
+    vector<int> counts, panel_node_list;
+    int64_t merged_rows;
+    
+    if (!reader.read(state.nodes) || !reader.read(counts) || !reader.read(panel_node_list) || !reader.read(state.doublet_coefficients) ||
+        !reader.read(merged_rows) || !reader.read(state.particle_positions) || !reader.read(state.particle_strengths) ||
+        !reader.read(state.particle_core_radii) || !reader.read(state.node_velocities) || !reader.read(state.particle_velocities))
+        return false;
+        
+    if (state.doublet_coefficients.size() != counts.size() || state.particle_strengths.size() != state.particle_positions.size() ||
+        state.particle_core_radii.size() != state.particle_positions.size())
+        return false;
+        
+    // The convection velocities are either absent, or given for all nodes and particles:
+    if ((state.node_velocities.size() > 0 && state.node_velocities.size() != state.nodes.size()) ||
+        (state.particle_velocities.size() > 0 && state.particle_velocities.size() != state.particle_positions.size()))
+        return false;
+        
+    if (merged_rows < 0)
+        return false;
+        
+    state.n_merged_rows = merged_rows;
+    
+    int offset = 0;
+    for (int i = 0; i < (int) counts.size(); i++) {
+        if (counts[i] < 3 || counts[i] > max_panel_nodes || offset + counts[i] > (int) panel_node_list.size())
+            return false;
+            
+        vector<int> vertices(panel_node_list.begin() + offset, panel_node_list.begin() + offset + counts[i]);
+        for (int j = 0; j < counts[i]; j++) {
+            if (vertices[j] < 0 || vertices[j] >= (int) state.nodes.size())
+                return false;
+        }
+        
+        state.panel_nodes.push_back(vertices);
+        
+        offset += counts[i];
+    }
+    
+    return true;
+}
+
+/**
+   Restores the state of this wake from a state returned by read_checkpoint() of this wake, and recomputes its
+   geometry.
+   
+   @param[in]   state   Checkpoint state.
+*/
+void
+Wake::restore_checkpoint(const CheckpointState &state)
+{
+    nodes                = state.nodes;
+    panel_nodes          = state.panel_nodes;
+    doublet_coefficients = state.doublet_coefficients;
+    
+    n_merged_rows = state.n_merged_rows;
+    
+    particle_positions  = state.particle_positions;
+    particle_strengths  = state.particle_strengths;
+    particle_core_radii = state.particle_core_radii;
+    
+    node_velocities     = state.node_velocities;
+    particle_velocities = state.particle_velocities;
+    
+    // The panels of a wake have no neighbor relationships:
+    panel_neighbors.assign(n_panels(), map<int, pair<int, int> >());
+    
+    node_panel_neighbors.clear();
+    for (int i = 0; i < n_nodes(); i++) {
+        shared_ptr<vector<int> > empty = make_shared<vector<int> >();
+        node_panel_neighbors.push_back(empty);
+    }
+    
+    compute_geometry();
+}
+
+/**
+   Returns the number of vortex particles in this wake.
+   
+   @returns Number of vortex particles.
+*/
+int
+Wake::n_particles() const
+{
+    return particle_positions.size();
+}
+
+/**
+   Converts the given number of oldest rows of wake panels into vortex particles.  Every vortex filament of the
+   vortex rings is replaced by a particle at its midpoint, with a strength equal to its circulation times its
+   filament vector.  Filaments shared by neighboring vortex rings are combined into a single particle.
+   
+   @param[in]   n   Number of rows to convert.
+*/
+void
+Wake::convert_rows_to_particles(int n)
+{
+    int n_converted_panels = n * lifting_surface->n_spanwise_panels();
+    
+    // Accumulate the filaments:
+    FilamentMap filaments;
+    
+    for (int panel = 0; panel < n_converted_panels; panel++) {
+        const int *single_panel_nodes = &panel_node_table[max_panel_nodes * panel];
+        
+        for (int i = 0; i < panel_node_counts[panel]; i++) {
+            int previous_idx;
+            if (i == 0)
+                previous_idx = panel_node_counts[panel] - 1;
+            else
+                previous_idx = i - 1;
+                
+            int node_a = single_panel_nodes[previous_idx];
+            int node_b = single_panel_nodes[i];
+            
+            // The vortex rings of Surface::vortex_ring_unit_velocity() circulate opposite to the node ordering:
+            Vector3d strength = doublet_coefficients[panel] * (nodes[node_a] - nodes[node_b]);
+            
+            pair<int, int> key(min(node_a, node_b), max(node_a, node_b));
+            
+            FilamentMap::iterator it = filaments.find(key);
+            if (it == filaments.end())
+                filaments[key] = strength;
+            else
+                it->second += strength;
+        }
+    }
+    
+    // Create particles.  If the convection velocities of the nodes are known, the particles inherit them:
+    bool velocities_valid = (node_velocities.size() == nodes.size() && particle_velocities.size() == particle_positions.size());
+    
+    FilamentMap::const_iterator it;
+    for (it = filaments.begin(); it != filaments.end(); it++) {
+        const Vector3d &node_a = nodes[it->first.first];
+        const Vector3d &node_b = nodes[it->first.second];
+        
+        if (it->second.norm() < Parameters::inversion_tolerance)
+            continue;
+            
+        particle_positions.push_back(0.5 * (node_a + node_b));
+        particle_strengths.push_back(it->second);
+        particle_core_radii.push_back(parameters.vortex_particle_core_radius_factor * (node_b - node_a).norm());
+        
+        if (velocities_valid)
+            particle_velocities.push_back(0.5 * (node_velocities[it->first.first] + node_velocities[it->first.second]));
+    }
+    
+    if (!velocities_valid)
+        particle_velocities.clear();
+    
+    // Remove the panels:
+    delete_rows(n);
+}
+
+/**
+   Computes the velocity induced by a vortex particle.  The singularity of the particle is regularized using an
+   algebraic (Rosenhead-Moore) core.
+   
+   @param[in]   x          Point at which the velocity is evaluated.
+   @param[in]   particle   Vortex particle number.
+   
+   @returns Velocity induced by the vortex particle.
+*/
+Vector3d
+Wake::particle_velocity(const Vector3d &x, int particle) const
+{
+    Vector3d r = x - particle_positions[particle];
+    
+    double r_sqnorm = r.squaredNorm() + particle_core_radii[particle] * particle_core_radii[particle];
+    
+    if (r_sqnorm < Parameters::inversion_tolerance)
+        return Vector3d(0, 0, 0);
+        
+    return one_over_4pi * particle_strengths[particle].cross(r) / (r_sqnorm * sqrt(r_sqnorm));
+}
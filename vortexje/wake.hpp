@@ -10,10 +10,13 @@
 #define __WAKE_HPP__
 
 #include <memory>
+#include <vector>
 
 #include <Eigen/Geometry>
 
 #include <vortexje/lifting-surface.hpp>
+#include <vortexje/parameters.hpp>
+#include <vortexje/checkpoint.hpp>
 
 namespace Vortexje
 {
@@ -35,17 +38,128 @@ public:
     */
     std::shared_ptr<LiftingSurface> lifting_surface;
     
+    /**
+       Parameters that control the emission, truncation, and coarsening of this wake.  These are overwritten with the
+       parameters of the owning Solver whenever the solver adds or updates the wake.
+    */
+    SolverParameters parameters;
+    
     virtual void add_layer();
     
     void translate_trailing_edge(const Eigen::Vector3d &translation);
     void transform_trailing_edge(const Eigen::Transform<double, 3, Eigen::Affine> &transformation);
+    void displace_trailing_edge(const std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > &displacements);
     
     virtual void update_properties(double dt);
     
+    int n_rows() const;
+    
+    virtual void delete_rows(int n);
+    virtual void merge_rows(int first_row, int n);
+    
+    void coarsen();
+    
+    /**
+       State of a wake as read from a checkpoint by read_checkpoint(), but not yet restored by restore_checkpoint().
+       
+       @brief Wake checkpoint state.
+    */
+    class CheckpointState {
+    public:
+        virtual ~CheckpointState() {}
+        
+        /**
+           Node positions.
+        */
+        std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > nodes;
+        
+        /**
+           Nodes of every panel.
+        */
+        std::vector<std::vector<int> > panel_nodes;
+        
+        /**
+           Strengths of the doublet panels.
+        */
+        std::vector<double> doublet_coefficients;
+        
+        /**
+           Number of oldest rows of wake panels that are the result of merging.
+        */
+        int n_merged_rows;
+        
+        /**
+           Positions, strengths, and core radii of the vortex particles.
+        */
+        std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > particle_positions;
+        std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > particle_strengths;
+        std::vector<double> particle_core_radii;
+        
+        /**
+           Convection velocities of the nodes and of the vortex particles.
+        */
+        std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > node_velocities;
+        std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > particle_velocities;
+    };
+    
+    virtual void write_checkpoint(CheckpointWriter &writer) const;
+    virtual std::shared_ptr<CheckpointState> read_checkpoint(CheckpointReader &reader) const;
+    virtual void restore_checkpoint(const CheckpointState &state);
+    
     /**
        Strengths of the doublet, or vortex ring, panels.
     */
     std::vector<double> doublet_coefficients; 
+    
+    /**
+       Positions of the vortex particles that make up the far wake.
+    */
+    std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > particle_positions;
+    
+    /**
+       Strengths of the vortex particles, i.e., circulation times filament vector.
+    */
+    std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > particle_strengths;
+    
+    /**
+       Core radii of the vortex particles.
+    */
+    std::vector<double> particle_core_radii;
+    
+    /**
+       Convection velocities of the nodes, as last evaluated by the Solver.  Velocities that are not re-evaluated
+       every time step are reused from here, see Parameters::far_wake_update_interval.  This is kept in step with the
+       nodes when layers are added, and when rows are deleted or merged.  It is invalid if its size differs from the
+       number of nodes.
+    */
+    std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > node_velocities;
+    
+    /**
+       Convection velocities of the vortex particles, as last evaluated by the Solver.  Particles created from rows
+       of panels inherit the mean velocity of the nodes of their filament.  It is invalid if its size differs from
+       the number of particles.
+    */
+    std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > particle_velocities;
+    
+    int n_particles() const;
+    
+    void convert_rows_to_particles(int n);
+    
+    Eigen::Vector3d particle_velocity(const Eigen::Vector3d &x, int particle) const;
+    
+protected:
+    /**
+       Number of oldest rows of wake panels that are the result of merging.
+    */
+    int n_merged_rows;
+    
+    void renumber_panel_nodes();
+    
+    void update_trailing_edge_geometry(int first_node);
+    
+    void reserve_rows(int n);
+    
+    bool read_wake_checkpoint(CheckpointReader &reader, CheckpointState &state) const;
 };
 
 };